@@ -29,6 +29,7 @@ object ArduinoCodeGenerator {
             val sbSetupMid = base.optString("setup_mid", "")
             val sbLoop = StringBuilder(base.optString("loop_start", ""))
             val sbReceiver = StringBuilder(base.optString("receiver_head", ""))
+            val tableEntries = mutableListOf<TopicEntry>()
 
             // Mapping Table Builder
             val sbMapping = StringBuilder()
@@ -94,7 +95,23 @@ object ArduinoCodeGenerator {
                     val loopLogic = processPlaceholders(tmpl.optString("loop_logic", ""))
                     if (loopLogic.isNotEmpty()) sbLoop.append(loopLogic).append("\n")
 
-                    // --- Receiver Logic ---
+                    // --- Topic Table (Receive) ---
+                    val tableKind = tmpl.optString("table_kind", "")
+                    if (tableKind.isNotEmpty()) {
+                        val hook = processPlaceholders(tmpl.optString("table_hook", ""))
+                        if (hook.isNotEmpty()) sbGlobals.append(hook).append("\n")
+                        tableEntries.add(
+                                TopicEntry(
+                                        comp.label,
+                                        relTopicSet,
+                                        tableKind,
+                                        processPlaceholders(tmpl.optString("table_var", "NULL")),
+                                        processPlaceholders(tmpl.optString("table_fn", "NULL"))
+                                )
+                        )
+                    }
+
+                    // --- Receiver Logic (topics outside the table) ---
                     val recvLogic = processPlaceholders(tmpl.optString("receiver_logic", ""))
                     if (recvLogic.isNotEmpty()) sbReceiver.append(recvLogic).append("\n")
                 }
@@ -117,7 +134,25 @@ object ArduinoCodeGenerator {
             fullCode.append(header)
             fullCode.append(sbMapping) // Inject Mapping Table
 
-            fullCode.append(sbGlobals).append("\n")
+            fullCode.append(sbGlobals)
+
+            // Topic table: sorted here (byte order) so the sketch can static_assert it
+            // and mqttpanel can binary-search it; omitted when nothing subscribes.
+            val setupStartLen = base.optString("setup_start", "").length
+            if (tableEntries.isNotEmpty()) {
+                val sorted = tableEntries.sortedWith { a, b -> compareUtf8(a.topic, b.topic) }
+                // Two components on one topic: only one would ever match (and the static_assert fails)
+                sorted.zipWithNext().firstOrNull { (a, b) -> a.topic == b.topic }?.let { (a, b) ->
+                    return "// Error: \"${a.label}\" and \"${b.label}\" both use the topic ${a.topic}"
+                }
+                fullCode.append(base.optString("table_head", ""))
+                sorted.forEach { e ->
+                    fullCode.append("  { \"${e.topic}\", ${e.kind}, ${e.variable}, ${e.fn} },\n")
+                }
+                fullCode.append(base.optString("table_tail", ""))
+                sbSetup.insert(setupStartLen, base.optString("setup_table", ""))
+            }
+            fullCode.append("\n")
 
             fullCode.append(sbSetup)
             fullCode.append(sbSetupMid)
@@ -284,6 +319,26 @@ object ArduinoCodeGenerator {
         }
     }
 
+    private data class TopicEntry(
+            val label: String,
+            val topic: String,
+            val kind: String,
+            val variable: String,
+            val fn: String
+    )
+
+    // strcmp() order, as mp_table_sorted() checks it: UTF-8 bytes compared unsigned.
+    // String.compareTo works on UTF-16 units and disagrees once topics leave ASCII.
+    private fun compareUtf8(a: String, b: String): Int {
+        val x = a.toByteArray(Charsets.UTF_8)
+        val y = b.toByteArray(Charsets.UTF_8)
+        for (i in 0 until minOf(x.size, y.size)) {
+            val d = (x[i].toInt() and 0xFF) - (y[i].toInt() and 0xFF)
+            if (d != 0) return d
+        }
+        return x.size - y.size
+    }
+
     private fun resolveTopic(arg: String, varMap: Map<String, String>): String {
         val trimmed = arg.trim()
 
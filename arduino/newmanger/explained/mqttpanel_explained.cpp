@@ -1,23 +1,50 @@
 #include "mqttpanel.h" // 引入我們定義好的 Header 檔
+#include <ArduinoJson.h> // State 模式用：整包狀態打包成一則 JSON
+#include <atomic>        // 雙核心模式用：兩個核心之間交接的讀寫位置
+#include <math.h>        // CBOR 的 half float 解碼 (ldexpf)
 
 // --- Private Types (私有型別) ---
-// 定義這套系統支援哪幾種類型
-enum MpType {
-  MP_SWITCH, // 開關 (0/1)
-  MP_DIMMER, // 調光 (0-100)
-  MP_SELECT, // 選單 (0-N)
-  MP_NUMBER, // 數字 (僅回報)
-  MP_TEXT,   // 文字
-  MP_SYNC    // 同步訊號
-};
+// 以前這裡有一個 MpType 列舉 (Switch/Dimmer/...)，收訊息時用 if/else 判斷型別。
+// 現在每個通道直接指向它自己的 MpBindingOps (見 mqttpanel.h 的 Typed Binding API)，
+// 型別在編譯時就決定好了。
 
 // 定義一個「通道」長什麼樣子
+// 以前每個通道都存兩份完整 Topic (topicSet + topicVal，共 240 bytes)，
+// 但前綴 "<project>/<id>/" 大家都一樣。現在前綴只存一份 (_baseTopic)，
+// 通道只記相對路徑 (例如 "dimmer/1/set")；/val Topic 要發送時才組出來。
 struct MpChannel {
-  bool active;                       // 這個位置是否已經被使用了？
-  MpType type;                       // 這條通道是什麼類型 (Switch? Dimmer?)
-  char topicSet[MPTP_MAX_TOPIC_LEN]; // 監聽的 Topic (App -> ESP32)
-  char topicVal[MPTP_MAX_TOPIC_LEN]; // 回報的 Topic (ESP32 -> App)
   void* varPtr;                      // 【關鍵】指標：指向使用者真正的變數地址 (void* 表示它可以存任何類型的地址)
+  const MpBindingOps* ops;           // 這條通道怎麼解析/格式化 (編譯時決定，存在 Flash)
+  bool active;                       // 這個位置是否已經被使用了？
+  bool absolute;                     // true = 這個 Topic 不在 base 底下，key 存的是完整 Topic
+  bool tracked;                      // 有沒有開啟變更偵測 (mqttpanel_track)
+  bool shadowValid;                  // shadow 有沒有值 (false = 還沒送過，下一圈要送)
+  uint8_t keyLen;                    // key 的長度
+  uint16_t absOff;                   // absolute 時：完整 Topic 在 _absTopics 裡的位置
+  uint16_t minIntervalMs;            // 兩次發送的最短間隔
+  float deadband;                    // 數值變化超過多少才送
+  MpShadow shadow;                   // 上一次送出的值 (或它的 hash)
+  uint32_t lastPubMs;                // 上一次送出的時間
+  char key[MPTP_MAX_KEY_LEN];        // 監聽的相對 Topic (App -> ESP32)，例如 "dimmer/1/set" (absolute 時不用)
+};
+
+// --- Router Index (路由索引) ---
+// 所有 Topic 都長得像 "<base>/<type>/<idx>/set"，前綴每個通道都一樣。
+// 所以收到訊息時只比對「一次」前綴，再把剩下的相對路徑 (例如 "dimmer/1/set")
+// 算 hash 去查表。查一次的成本只跟 Topic 長度有關，跟通道數量無關。
+//
+// 表格是 open addressing (線性探測)，大小是通道數兩倍以上的 2 的次方，
+// 所以一定有空格，探測很短。
+static constexpr int _mp_pow2_at_least(int s, int n) { return s >= n ? s : _mp_pow2_at_least(s * 2, n); }
+#define MP_ROUTE_SLOTS _mp_pow2_at_least(8, MPTP_MAX_CHANNELS * 2)
+
+static_assert(MPTP_MAX_KEY_LEN <= 255, "keyLen 是 uint8_t，相對 Topic 長度上限不能超過 255");
+static_assert(MPTP_MAX_TOPIC_LEN <= 256, "keyLen 是 uint8_t，absolute Topic 長度上限不能超過 255");
+static_assert(MPTP_ABS_TOPIC_BYTES <= 65535, "absOff 是 uint16_t");
+
+struct MpRouteSlot {
+  uint16_t ch;  // 通道編號 + 1 (0 = 空格)
+  uint16_t tag; // hash 的高 16 位，先比這個，不一樣就不用 memcmp
 };
 
 // --- Globals (全域變數) ---
@@ -26,20 +53,174 @@ static PubSubClient* _mqttClient = NULL;      // 存下來的 MQTT Client 指標
 static MpChannel _channels[MPTP_MAX_CHANNELS]; // 產生 24 個空格的陣列，用來存通道資料
 static int _channelCount = 0;                 // 目前用了幾個通道
 
+// 不在 base 底下的完整 Topic 很少見，但可能很長：不放進每個通道的 key，
+// 而是一個接一個放在這塊共用空間，通道只記位置。
+static char _absTopics[MPTP_ABS_TOPIC_BYTES];
+static uint16_t _absUsed = 0;
+
+static MpRouteSlot _routes[MP_ROUTE_SLOTS];   // Topic -> 通道 的查表
+static char _baseTopic[MPTP_MAX_TOPIC_LEN];   // 共用前綴 (不含結尾的 '/')
+static size_t _baseLen = 0;                   // 前綴長度 (0 = 沒有前綴)
+static bool _baseFixed = false;               // true = 使用者有指定；false = 等第一個註冊的 Topic 來推算
+
+// --- Outbound Queue State (發送佇列) ---
+// 兩種待發送的東西：
+//  1. 通道 (Sync 觸發的全體廣播)：只記一個 bit，送的時候才讀變數，重複標記不會重複送
+//  2. 一般訊息 (*_pub)：topic + payload 複製進環狀緩衝區 (ring buffer)
+// 每筆記錄的格式：[topic 長度 1B][payload 長度 2B][topic][payload]
+static uint8_t _txPending[(MPTP_MAX_CHANNELS + 7) / 8]; // 待發送的通道 (bitmap)
+static uint16_t _txPendingCount = 0;
+static uint16_t _txScan = 0;                  // 下次從哪個通道開始找
+static uint8_t _txRing[MPTP_TXQ_BYTES];
+static uint16_t _txHead = 0;                  // 讀取位置
+static uint16_t _txUsed = 0;                  // 已使用 bytes
+static uint16_t _txRawCount = 0;              // ring 裡有幾則
+static uint8_t _txMaxMsgs = 4;                // 每圈最多送幾則
+static uint16_t _txMaxBytes = 512;            // 每圈最多送幾 bytes
+static Client* _txSock = NULL;                // (選用) 用來查 TCP 送出緩衝區
+static bool _txRoomSeen = false;              // availableForWrite() 有沒有回過非 0 (沒有 = 核心沒實作)
+static unsigned long _txBusySince = 0;        // 佇列從空變成有東西的時間
+static MpTxStats _txStats;
+static uint16_t _trackCount = 0;              // 開啟變更偵測的通道數 (0 = loop 裡完全不用檢查)
+
+// --- State Mode (整包狀態模式) ---
+static bool _stateMode = false;               // true = 全體廣播改成送一則 <base>/state
+static bool _statePending = false;            // 有一份 state 等著送
+static MpFrameFormat _frameFmt = MP_FRAME_JSON; // <base>/state 的格式 (預設 JSON)
+
+// --- Time Series State (時間序列) ---
+// 每個序列在共用池 _srPool 裡有自己的一段環狀緩衝區，一個點佔 width 個 word：
+//   [時間][欄位 0][欄位 1]...  欄位是量化後的整數 (值 / q 四捨五入)，依序是 v / lo / hi 裡有送的
+// 降採樣時，還沒結束的窗先累積在 wSum / wMin / wMax，結束才變成一個點放進去。
+struct MpSeries {
+  uint32_t* ring;                    // 在 _srPool 裡的起點
+  uint16_t cap;                      // 放幾個點
+  uint16_t head;                     // 最舊的點在哪
+  uint16_t count;                    // 現在有幾個點
+  uint16_t flushSamples;
+  uint16_t flushMs;
+  uint16_t windowMs;
+  float q;
+  uint8_t fields;                    // 送哪些陣列 (MpReduce 的 bit；沒有降採樣 = 只有 MEAN，就是 "v")
+  uint8_t width;                     // 每個點幾個 word
+  bool absolute;                     // true = 不在 base 底下，key 存的是完整 Topic
+  bool due;                          // 等著送
+  bool flushing;                     // mqttpanel_series_flush()：不滿一批也全部送完
+  uint8_t keyLen;
+  uint16_t absOff;                   // absolute 時：完整 Topic 在 _absTopics 裡的位置
+  uint32_t firstMs;                  // 緩衝區從空變成有東西的時間 (flushMs 用)
+  uint32_t wStart;                   // 目前這個窗：第一個點的時間
+  uint32_t wOpenMs;                  //   開窗的 millis() (給 mqttpanel_loop 判斷窗過期)
+  uint32_t wN;                       //   累積了幾個點 (0 = 沒有開窗)
+  float wSum, wMin, wMax;
+  MpSeriesStats st;
+  char key[MPTP_MAX_KEY_LEN];        // 要送到的 Topic (相對 base，規則跟通道一樣；absolute 時不用)
+};
+
+static MpSeries _series[MPTP_MAX_SERIES];
+static int _seriesCount = 0;
+static uint16_t _seriesDueCount = 0;          // 等著送的序列數 (算在發送佇列深度裡)
+static uint32_t _srPool[MPTP_SERIES_WORDS];
+static uint32_t _srPoolUsed = 0;
+
+// --- Dual-Core State (雙核心交接) ---
+// 單一生產者/單一消費者 (SPSC) 的環狀佇列：head 只有生產者改，tail 只有消費者改。
+// 兩個位置都一直往上加 (不繞回)，用的時候才 & mask，所以 head - tail 就是已用 bytes。
+// 生產者先寫資料再用 release 更新 head，消費者用 acquire 讀 head，就保證看得到完整的資料。
+static_assert((MPTP_RXQ_BYTES & (MPTP_RXQ_BYTES - 1)) == 0, "MPTP_RXQ_BYTES 要是 2 的次方");
+static_assert((MPTP_XQ_BYTES & (MPTP_XQ_BYTES - 1)) == 0, "MPTP_XQ_BYTES 要是 2 的次方");
+static_assert(MPTP_SNAPSHOT_LEN % 4 == 0 && MPTP_SNAPSHOT_LEN >= 8, "MPTP_SNAPSHOT_LEN 要是 4 的倍數");
+
+struct MpSpsc {
+  uint8_t* buf;
+  uint32_t mask;                     // 容量 - 1
+  std::atomic<uint32_t> head;        // 寫入位置 (生產者)
+  std::atomic<uint32_t> tail;        // 讀取位置 (消費者)
+};
+
+// 通道目前的值 (格式跟 /val 一樣)，用 seqlock 保護：
+// 應用核心改之前把 seq 加成奇數、改完再加成偶數；讀的人前後 seq 一樣而且是偶數才算數。
+// 內容也用 atomic 的 4-byte word 存，讀到一半被改也不會是未定義行為 (只是這次作廢重讀)。
+struct MpSnapSlot {
+  std::atomic<uint32_t> seq;         // 0 = 還沒寫過；奇數 = 正在寫
+  std::atomic<uint32_t> w[MPTP_SNAPSHOT_LEN / 4];
+};
+
+// 統計：每個欄位只有一個核心在寫，用 atomic 讓另一個核心也能讀
+struct MpDualCounters {
+  std::atomic<uint32_t> rxMsgs, rxDropped, rxPeakBytes, rxLastUs, rxMaxUs;
+  std::atomic<uint32_t> txMsgs, txPeakBytes, txLastUs, txMaxUs;
+};
+
+#define MP_RX_BATCH 0xFFFF                     // RX 記錄的通道編號：<base>/set 整包設定
+
+static bool _dualCore = false;                 // setup() 設好之後就不再變
+static uint8_t _rxBuf[MPTP_RXQ_BYTES];
+static uint8_t _xqBuf[MPTP_XQ_BYTES];
+static MpSpsc _rxq = { _rxBuf, MPTP_RXQ_BYTES - 1, {0}, {0} }; // 網路核心 -> 應用核心：收到的 /set
+static MpSpsc _xq = { _xqBuf, MPTP_XQ_BYTES - 1, {0}, {0} };   // 應用核心 -> 網路核心：要送的訊息
+// 應用核心專用的暫存區 (不放在 stack：NetTask/loopTask 的 stack 很小，payload 可能很大)
+static uint8_t _xqOut[MPTP_XQ_BYTES];          // state / frame / series 先序列化在這裡，再 _xq_push
+static char _rxMsg[MPTP_RXQ_BYTES];            // 從 RX 佇列拿出來的 payload (一定比整個佇列小)
+static MpSnapSlot _snaps[MPTP_MAX_CHANNELS];
+static MpDualCounters _dual;
+static std::atomic<bool> _netUp(false);        // 網路核心看到的連線狀態 (應用核心不直接問 client)
+static std::atomic<bool> _syncReq(false);      // 網路核心要求應用核心做一次全體廣播
+static std::atomic<uint32_t> _rxTooLong(0);    // 超過 MPTP_MAX_VALUE_LEN 的值 (兩個核心都可能加)
+
 // --- Private Prototypes (私有函式宣告) ---
 void mqttpanel_router_callback(char* topic, byte* payload, unsigned int length);
-bool _register_channel(MpType type, const char* topicSet, void* varPtr);
+bool _register_channel(const MpBindingOps* ops, const char* topicSet, void* varPtr);
+static int _find_channel(const char* topic, size_t len);
+static size_t _key_offset(const char* topic, size_t len);
+static int _find_key(const char* key, size_t keyLen, bool absolute);
+static bool _channel_val_topic(const MpChannel& c, char* out, size_t size);
+static bool _tx_enqueue(const char* topic, const char* payload);
+static void _tx_drain();
+static void _tx_reset();
+static bool _tx_mark(int i);
+static void _track_scan();
+static uint16_t _tx_depth();
+static bool _tx_send_state(size_t& packetLen);
+static void _state_apply(const byte* payload, unsigned int length);
+static bool _tx_send_frame(bool all, size_t& packetLen);
+static void _frame_apply(const byte* payload, unsigned int length);
+static bool _net_up();
+static void _rx_push(uint16_t ch, const byte* payload, unsigned int length);
+static bool _xq_push(const char* topic, size_t tl, const uint8_t* p1, uint16_t n1, const uint8_t* p2, uint16_t n2);
+static void _xq_drain();
+static void _snap_update();
+static void _series_scan();
+static bool _series_send(MpSeries& s, size_t& packetLen);
 
 // --- Core Implementation (核心實作) ---
 
 // 初始化：把 MQTT Client 存起來，並清空通道表
-void mqttpanel_begin(PubSubClient* client) {
+void mqttpanel_begin(PubSubClient* client, const char* baseTopic) {
   _mqttClient = client;
   // 清空陣列
   for(int i=0; i<MPTP_MAX_CHANNELS; i++) {
     _channels[i].active = false;
   }
   _channelCount = 0;
+  _trackCount = 0;
+  _stateMode = false;
+  _frameFmt = MP_FRAME_JSON;
+  _dualCore = false;
+  _seriesCount = 0;
+  _srPoolUsed = 0;
+  _absUsed = 0;
+  memset(_routes, 0, sizeof(_routes));
+  _tx_reset();
+
+  // 記下共用前綴 (去掉結尾的 '/')
+  _baseLen = 0;
+  _baseFixed = (baseTopic != NULL);
+  if (baseTopic) {
+    strlcpy(_baseTopic, baseTopic, sizeof(_baseTopic));
+    _baseLen = strlen(_baseTopic);
+    if (_baseLen > 0 && _baseTopic[_baseLen-1] == '/') _baseTopic[--_baseLen] = '\0';
+  }
   
   if (_mqttClient) {
     // 【最重要的一步】設定 Callback
@@ -52,6 +233,14 @@ void mqttpanel_begin(PubSubClient* client) {
 void mqttpanel_loop() {
   if (_mqttClient) {
     _mqttClient->loop();
+    _netUp.store(_mqttClient->connected(), std::memory_order_relaxed);
+    if (_dualCore) {
+      _xq_drain(); // 雙核心：變數交給應用核心處理，這裡只送出交接過來的訊息
+      return;
+    }
+    _track_scan(); // 有變的通道排進佇列
+    _series_scan(); // 時間到的序列排進佇列
+    _tx_drain();   // 送出佇列裡的訊息 (每圈有額度)
   }
 }
 
@@ -59,82 +248,155 @@ void mqttpanel_loop() {
 // --- Router & Handler (路由器與處理器) ---
 // 這是整個模組的大腦。當收到 MQTT 訊息時，這個函式會被呼叫。
 void mqttpanel_router_callback(char* topic, byte* payload, unsigned int length) {
-  // 1. 把收到的 Payload (byte陣列) 轉成乾淨的字串 (String)
-  char msg[length + 1];
-  memcpy(msg, payload, length);
-  msg[length] = '\0'; // 補上結尾符號，確保是標準字串
-  
-  // 2. 搜尋：這個 Topic 對應到我們哪一個通道？
-  // 如果通道數很多，這邊可以用 Hash Map 優化，但 24 個用 for 迴圈跑就夠快了。
-  for(int i=0; i<MPTP_MAX_CHANNELS; i++) {
-    // 如果這個通道有啟用，且 Topic 字串完全一樣
-    if (_channels[i].active && strcmp(_channels[i].topicSet, topic) == 0) {
-       
-       // 3. 找到了！準備更新變數
-       MpType t = _channels[i].type;  // 取出類型
-       void* ptr = _channels[i].varPtr; // 取出變數的地址
-       
-       // 4. 根據不同類型，做不同的解析
-       if (t == MP_SWITCH) {
-          // 如果是開關
-          bool* v = (bool*)ptr; // 把 void* 轉回 bool* 才能操作
-          if (strcmp(msg, "1") == 0) { *v = true; }      // 收到 "1" -> 變數設為 true
-          else if (strcmp(msg, "0") == 0) { *v = false; } // 收到 "0" -> 變數設為 false
-       }
-       else if (t == MP_DIMMER || t == MP_SELECT) {
-          // 如果是數字類
-          int* v = (int*)ptr; // 轉回 int*
-          int val = atoi(msg); // 把字串轉成整數 (atoi = ASCII to Integer)
-          
-          if (t == MP_DIMMER) {
-             // 調光器要限制在 0-100 之間，防止錯誤數據
-             if (val < 0) val = 0;
-             if (val > 100) val = 100;
-          }
-          *v = val; // 更新變數
-       }
-       else if (t == MP_TEXT) {
-          // 如果是文字
-          String* v = (String*)ptr; // 轉回 String*
-          *v = String(msg); // 更新變數
-       }
-       else if (t == MP_SYNC) {
-          // 如果是同步訊號 (通常 payload 是 "1")
-          if (msg[0] == '1') {
-             mqttpanel_publish_all_vals(); // 呼叫全體廣播
-          }
-       }
-       
-       return; // 任務完成，收工離開
+  // 1. 搜尋：這個 Topic 對應到我們哪一個通道？
+  // 先去掉共用前綴，再用相對路徑查 hash table (見上方 Router Index 說明)。
+  size_t topicLen = strlen(topic);
+  bool batch = _stateMode && _baseLen > 0 && topicLen == _baseLen + 4 && _key_offset(topic, topicLen) > 0 &&
+               memcmp(topic + _baseLen + 1, "set", 3) == 0; // <base>/set：一次改很多個通道
+  int i = batch ? -1 : _find_channel(topic, topicLen);
+  if (i >= 0 && length >= MPTP_MAX_VALUE_LEN) { // 太長：整則丟掉，不截斷
+    _rxTooLong.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  // 雙核心：這裡跑在網路核心，不能碰變數。只把「哪個通道 + 內容」交給應用核心。
+  if (_dualCore) {
+    if (batch) _rx_push(MP_RX_BATCH, payload, length);
+    else if (i >= 0) _rx_push((uint16_t)i, payload, length);
+    return;
+  }
+
+  if (batch) {
+    _state_apply(payload, length);
+    return;
+  }
+  if (i >= 0) {
+       // 2. 把收到的 Payload (byte陣列) 轉成乾淨的字串 (上面已經確定放得下)
+       char msg[MPTP_MAX_VALUE_LEN];
+       memcpy(msg, payload, length);
+       msg[length] = '\0'; // 補上結尾符號，確保是標準字串
+
+       // 3. 找到了！直接交給這個通道自己的解析函式 (型別在註冊時就決定好了)
+       const MpChannel& c = _channels[i];
+       c.ops->apply(c.varPtr, msg, length);
+  }
+}
+
+// --- Router Index Impl (查表實作) ---
+
+// FNV-1a hash：簡單、夠快、分布也不錯
+static uint32_t _mp_hash(const char* s, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// 把完整 Topic 拆成「查表用的 key」：在 base 底下就去掉 "<base>/"，否則整串當 key。
+static size_t _key_offset(const char* topic, size_t len) {
+  if (_baseLen > 0 && len > _baseLen + 1 && topic[_baseLen] == '/' &&
+      memcmp(topic, _baseTopic, _baseLen) == 0) {
+    return _baseLen + 1;
+  }
+  return 0;
+}
+
+// 通道 / 序列的 key：相對的存在自己身上，absolute 的在 _absTopics
+template <typename T>
+static const char* _key_of(const T& x) { return x.absolute ? _absTopics + x.absOff : x.key; }
+
+// 把 Topic 存成 key (off = _key_offset 的結果)；放不下就回傳 false (不要默默截斷，不然會對不到)
+template <typename T>
+static bool _key_store(T& x, const char* topic, size_t len, size_t off) {
+  size_t kl = len - off;
+  if (off == 0) {
+    if (kl >= MPTP_MAX_TOPIC_LEN || _absUsed + kl + 1 > sizeof(_absTopics)) return false;
+    x.absOff = _absUsed;
+    memcpy(_absTopics + _absUsed, topic, kl);
+    _absTopics[_absUsed + kl] = '\0';
+    _absUsed = (uint16_t)(_absUsed + kl + 1);
+  } else {
+    if (kl >= MPTP_MAX_KEY_LEN) return false;
+    memcpy(x.key, topic + off, kl);
+    x.key[kl] = '\0';
+  }
+  x.absolute = (off == 0);
+  x.keyLen = (uint8_t)kl;
+  return true;
+}
+
+static int _find_channel(const char* topic, size_t len) {
+  size_t off = _key_offset(topic, len);
+  return _find_key(topic + off, len - off, off == 0);
+}
+
+static int _find_key(const char* key, size_t keyLen, bool absolute) {
+  uint32_t h = _mp_hash(key, keyLen);
+  uint16_t tag = (uint16_t)(h >> 16);
+
+  for (uint32_t n = 0, slot = h & (MP_ROUTE_SLOTS - 1); n < MP_ROUTE_SLOTS; n++, slot = (slot + 1) & (MP_ROUTE_SLOTS - 1)) {
+    const MpRouteSlot& e = _routes[slot];
+    if (e.ch == 0) return -1; // 碰到空格 = 表裡沒有
+    if (e.tag != tag) continue;
+    const MpChannel& c = _channels[e.ch - 1];
+    // key 在 base 底下的，只能對到同樣在 base 底下的通道 (反之亦然)
+    if (c.absolute == absolute && c.keyLen == keyLen && memcmp(_key_of(c), key, keyLen) == 0) {
+      return e.ch - 1;
+    }
+  }
+  return -1;
+}
+
+// 沒有指定 base 時，從第一個 Topic 推算："a/b/switch/1/set" -> "a/b"
+static void _infer_base(const char* topic) {
+  size_t len = strlen(topic);
+  int slashes = 0;
+  for (size_t i = len; i > 0; i--) {
+    if (topic[i-1] == '/' && ++slashes == 3) {
+      size_t n = i - 1;
+      if (n >= sizeof(_baseTopic)) return;
+      memcpy(_baseTopic, topic, n);
+      _baseTopic[n] = '\0';
+      _baseLen = n;
+      return;
     }
   }
 }
 
+static void _index_channel(int idx) {
+  MpChannel& c = _channels[idx];
+  uint32_t h = _mp_hash(_key_of(c), c.keyLen);
+  uint32_t slot = h & (MP_ROUTE_SLOTS - 1);
+  while (_routes[slot].ch != 0) slot = (slot + 1) & (MP_ROUTE_SLOTS - 1); // 表一定比通道數大，不會滿
+  _routes[slot].ch = (uint16_t)(idx + 1);
+  _routes[slot].tag = (uint16_t)(h >> 16);
+}
+
 // --- Subscription Impl (註冊邏輯實作) ---
 // 這是內部共用的註冊函式
-bool _register_channel(MpType type, const char* topicSet, void* varPtr) {
+bool _register_channel(const MpBindingOps* ops, const char* topicSet, void* varPtr) {
    if (_channelCount >= MPTP_MAX_CHANNELS) return false; // 滿了就不收
    if (!_mqttClient) return false;
 
+   // 第一次註冊時順便決定共用前綴
+   if (!_baseFixed && _channelCount == 0) _infer_base(topicSet);
+
+   // 在 base 底下的只存「去掉前綴」的相對路徑，其他的整串放進共用空間
+   size_t len = strlen(topicSet);
+   size_t off = _key_offset(topicSet, len);
    int idx = _channelCount;
-   _channels[idx].active = true;
-   _channels[idx].type = type;
-   _channels[idx].varPtr = varPtr; // 把變數地址存起來
-   
-   // 複製 Topic 字串進去
-   strncpy(_channels[idx].topicSet, topicSet, MPTP_MAX_TOPIC_LEN);
-   _channels[idx].topicSet[MPTP_MAX_TOPIC_LEN-1] = '\0'; // 確保結尾安全
-
-   // 自動產生 topicVal (也就是把 .../set 改成 .../val)
-   // 這樣你就不用手動指定兩個 Topic 了
-   strncpy(_channels[idx].topicVal, topicSet, MPTP_MAX_TOPIC_LEN);
-   char* ptr = strstr(_channels[idx].topicVal, "/set"); // 找 "/set" 在哪
-   if (ptr) {
-      strcpy(ptr, "/val"); // 替換成 "/val"
-   } else {
-      // 如果原本沒寫 /set，就在後面硬加 _val，避免重複
-      strncat(_channels[idx].topicVal, "_val", MPTP_MAX_TOPIC_LEN - strlen(_channels[idx].topicVal) - 1);
-   }
+   MpChannel& c = _channels[idx];
+   if (!_key_store(c, topicSet, len, off)) return false;
+   c.active = true;
+   c.ops = ops;
+   c.varPtr = varPtr; // 把變數地址存起來
+   c.tracked = false;
+   c.shadowValid = false;
+
+   // 登記到查表
+   _index_channel(idx);
 
    _channelCount++; // 用量+1
 
@@ -143,86 +405,1365 @@ bool _register_channel(MpType type, const char* topicSet, void* varPtr) {
    return true;
 }
 
-// 以下都是轉呼叫上面的共用函式，只是為了型別安全 (Type Safety)
+bool mqttpanel_bind_ops(const char* topicSet, void* var, const MpBindingOps* ops) {
+  if (!ops || !ops->apply) return false;
+  return _register_channel(ops, topicSet, var);
+}
+
+// 以下都是 mqttpanel_bind 的簡寫，型別由編譯器檢查 (Type Safety)
 bool mqttpanel_switch_sub(const char* topicSet, bool* varBool) {
-  return _register_channel(MP_SWITCH, topicSet, (void*)varBool);
+  return mqttpanel_bind(topicSet, varBool);
 }
 
 bool mqttpanel_dimmer_sub(const char* topicSet, int* varInt) {
-  return _register_channel(MP_DIMMER, topicSet, (void*)varInt);
+  return mqttpanel_bind(topicSet, varInt, MpClamp<0, 100>()); // 調光器限制在 0-100
 }
 
 bool mqttpanel_select_sub(const char* topicSet, int* varInt) {
-  return _register_channel(MP_SELECT, topicSet, (void*)varInt);
+  return mqttpanel_bind(topicSet, varInt);
 }
 
 bool mqttpanel_text_sub(const char* topicSet, String* varString) {
-  return _register_channel(MP_TEXT, topicSet, (void*)varString);
+  return mqttpanel_bind(topicSet, varString);
 }
 
+// Sync 沒有變數：收到 "1" 就全體廣播；format = NULL 表示它自己不回報
+static void _sync_apply(void*, const char* msg, size_t) {
+  if (msg[0] == '1') mqttpanel_publish_all_vals();
+}
+static const MpBindingOps _syncOps = { &_sync_apply, NULL, NULL, NULL, NULL, NULL };
+
 bool mqttpanel_sync_sub(const char* topicSet) {
-  return _register_channel(MP_SYNC, topicSet, NULL);
+  return _register_channel(&_syncOps, topicSet, NULL);
+}
+
+uint32_t mqttpanel_rx_dropped() {
+  return _rxTooLong.load(std::memory_order_relaxed);
 }
 
 // --- Publish Impl (發信邏輯實作) ---
+// 全部只是排進佇列，真正送出在 _tx_drain()
 
 bool mqttpanel_switch_pub(const char* topicVal, bool varBool) {
-  if (!_mqttClient || !_mqttClient->connected()) return false;
-  return _mqttClient->publish(topicVal, varBool ? "1" : "0");
+  return _tx_enqueue(topicVal, varBool ? "1" : "0");
 }
 
 bool mqttpanel_dimmer_pub(const char* topicVal, int varInt) {
-  if (!_mqttClient || !_mqttClient->connected()) return false;
   char buf[16];
-  itoa(varInt, buf, 10); // 整數轉字串 (Integer to ASCII)
-  return _mqttClient->publish(topicVal, buf);
+  return _tx_enqueue(topicVal, MpCodec<int>::format(varInt, buf, sizeof(buf))); // 整數轉字串 (itoa)
 }
 
 bool mqttpanel_select_pub(const char* topicVal, int varInt) {
-  if (!_mqttClient || !_mqttClient->connected()) return false;
   char buf[16];
-  itoa(varInt, buf, 10);
-  return _mqttClient->publish(topicVal, buf);
+  return _tx_enqueue(topicVal, MpCodec<int>::format(varInt, buf, sizeof(buf)));
 }
 
 bool mqttpanel_number_pub(const char* topicVal, float varFloat) {
-  if (!_mqttClient || !_mqttClient->connected()) return false;
   char buf[32];
-  dtostrf(varFloat, 1, 2, buf); // Arduino 獨家的浮點數轉字串函式 (值, 最小寬度, 小數點位數, buffer)
-  return _mqttClient->publish(topicVal, buf);
+  // dtostrf：Arduino 獨家的浮點數轉字串函式 (值, 最小寬度, 小數點位數, buffer)
+  return _tx_enqueue(topicVal, MpCodec<float>::format(varFloat, buf, sizeof(buf)));
 }
 
 bool mqttpanel_text_pub(const char* topicVal, const String& varString) {
-  if (!_mqttClient || !_mqttClient->connected()) return false;
-  return _mqttClient->publish(topicVal, varString.c_str());
+  return _tx_enqueue(topicVal, varString.c_str());
 }
 
-// 全體廣播
+// 全體廣播：把每個有綁變數的通道標成「待發送」，馬上返回。
+// (以前在這裡每個通道 delay(10)，而且常常是在收訊息的 callback 裡面被呼叫，整個程式會卡住)
 void mqttpanel_publish_all_vals() {
   if (!_mqttClient) return;
 
-  // 跑迴圈，看哪個通道是啟用的，就發送它的目前數值
-  for(int i=0; i<MPTP_MAX_CHANNELS; i++) {
-     if (_channels[i].active && _channels[i].type != MP_SYNC) {
-        
-        MpType t = _channels[i].type;
-        void* ptr = _channels[i].varPtr;
-        const char* tVal = _channels[i].topicVal; // 自動產生好的 /val topic
-
-        if (t == MP_SWITCH) {
-           mqttpanel_switch_pub(tVal, *(bool*)ptr);
-        }
-        else if (t == MP_DIMMER) {
-           mqttpanel_dimmer_pub(tVal, *(int*)ptr);
-        }
-        else if (t == MP_SELECT) {
-           mqttpanel_select_pub(tVal, *(int*)ptr);
-        }
-        else if (t == MP_TEXT) {
-           mqttpanel_text_pub(tVal, *(String*)ptr);
-        }
-        
-        delay(10); // 稍微暫停 10ms，避免瞬間塞爆網路緩衝區
-     }
+  // State 模式：整包只算一則
+  if (_stateMode) {
+    if (_statePending) return;
+    if (_tx_depth() == 0) _txBusySince = millis();
+    _statePending = true;
+    _txStats.enqueued++;
+    uint16_t depth = _tx_depth();
+    if (depth > _txStats.peakDepth) _txStats.peakDepth = depth;
+    return;
+  }
+
+  for(int i=0; i<_channelCount; i++) {
+     const MpChannel& c = _channels[i];
+     if (!c.active || !c.ops->format) continue; // format = NULL 的 (Sync) 不回報
+     _tx_mark(i);
+  }
+}
+
+// --- Change Tracking Impl (變更偵測實作) ---
+
+uint32_t mqttpanel_text_hash(const char* s) {
+  return _mp_hash(s, strlen(s));
+}
+
+static void _track_channel(MpChannel& c, uint16_t minIntervalMs, float deadband) {
+  if (!c.tracked) _trackCount++;
+  c.tracked = true;
+  c.shadowValid = false; // 開啟後先送一次目前的值
+  c.minIntervalMs = minIntervalMs;
+  c.deadband = deadband < 0 ? -deadband : deadband;
+}
+
+bool mqttpanel_track(const char* topicSet, uint16_t minIntervalMs, float deadband) {
+  int i = _find_channel(topicSet, strlen(topicSet));
+  if (i < 0 || !_channels[i].ops->snapshot) return false;
+  _track_channel(_channels[i], minIntervalMs, deadband);
+  return true;
+}
+
+void mqttpanel_track_all(uint16_t minIntervalMs, float deadband) {
+  for (int i = 0; i < _channelCount; i++) {
+    if (_channels[i].active && _channels[i].ops->snapshot) _track_channel(_channels[i], minIntervalMs, deadband);
+  }
+}
+
+// 每圈掃一次：跟影子比，有變 (而且離上次發送夠久) 就標成待發送。
+// 影子在 _tx_drain() 真正送出時才更新，所以斷線期間的變化，連上後還是會送。
+static void _track_scan() {
+  if (_trackCount == 0 || !_net_up()) return;
+  unsigned long now = millis();
+  for (int i = 0; i < _channelCount; i++) {
+    const MpChannel& c = _channels[i];
+    if (!c.tracked || (_txPending[i >> 3] & (1 << (i & 7)))) continue;
+    if (c.shadowValid) {
+      if (now - c.lastPubMs < c.minIntervalMs) continue;
+      if (!c.ops->differs(c.varPtr, &c.shadow, c.deadband)) continue;
+    }
+    _tx_mark(i);
+  }
+}
+
+// --- Outbound Queue Impl (發送佇列實作) ---
+
+void mqttpanel_tx_budget(uint8_t maxMsgs, uint16_t maxBytes) {
+  _txMaxMsgs = maxMsgs ? maxMsgs : 1;
+  _txMaxBytes = maxBytes;
+}
+
+void mqttpanel_tx_client(Client* sock) {
+  _txSock = sock;
+  _txRoomSeen = false;
+}
+
+void mqttpanel_tx_stats(MpTxStats* out) {
+  if (!out) return;
+  *out = _txStats;
+  out->depth = _tx_depth();
+}
+
+// 把通道 i 標成待發送；已經在排了就不重複 (送的時候本來就會讀最新值)
+static bool _tx_mark(int i) {
+  uint8_t bit = (uint8_t)(1 << (i & 7));
+  if (_txPending[i >> 3] & bit) return false;
+  if (_tx_depth() == 0) _txBusySince = millis();
+  _txPending[i >> 3] |= bit;
+  _txPendingCount++;
+  _txStats.enqueued++;
+  uint16_t depth = _tx_depth();
+  if (depth > _txStats.peakDepth) _txStats.peakDepth = depth;
+  return true;
+}
+
+static uint16_t _tx_depth() {
+  return _txPendingCount + _txRawCount + (_statePending ? 1 : 0) + _seriesDueCount;
+}
+
+static void _tx_reset() {
+  _statePending = false;
+  memset(_txPending, 0, sizeof(_txPending));
+  _txPendingCount = 0;
+  _txScan = 0;
+  _txHead = 0;
+  _txUsed = 0;
+  _txRawCount = 0;
+  _seriesDueCount = 0;
+}
+
+// ring buffer 的讀寫 (會自動繞回開頭)
+static void _ring_put(uint16_t pos, const void* src, uint16_t n) {
+  uint16_t first = (uint16_t)(MPTP_TXQ_BYTES - pos);
+  if (first > n) first = n;
+  memcpy(_txRing + pos, src, first);
+  memcpy(_txRing, (const uint8_t*)src + first, n - first);
+}
+
+static void _ring_get(uint16_t pos, void* dst, uint16_t n) {
+  uint16_t first = (uint16_t)(MPTP_TXQ_BYTES - pos);
+  if (first > n) first = n;
+  memcpy(dst, _txRing + pos, first);
+  memcpy((uint8_t*)dst + first, _txRing, n - first);
+}
+
+static uint16_t _ring_pos(uint32_t pos) { return (uint16_t)(pos % MPTP_TXQ_BYTES); }
+
+static bool _tx_enqueue(const char* topic, const char* payload) {
+  if (!_mqttClient || !_net_up()) { _txStats.dropped++; return false; }
+
+  size_t tl = strlen(topic);
+  size_t pl = strlen(payload);
+  size_t need = 3 + tl + pl;
+  if (tl > 255 || pl > 0xFFFF || need > (size_t)(MPTP_TXQ_BYTES - _txUsed)) {
+    _txStats.dropped++;
+    return false;
+  }
+
+  if (_tx_depth() == 0) _txBusySince = millis();
+  uint8_t hdr[3] = { (uint8_t)tl, (uint8_t)(pl & 0xFF), (uint8_t)(pl >> 8) };
+  uint16_t pos = _ring_pos((uint32_t)_txHead + _txUsed);
+  _ring_put(pos, hdr, 3);
+  _ring_put(_ring_pos((uint32_t)pos + 3), topic, (uint16_t)tl);
+  _ring_put(_ring_pos((uint32_t)pos + 3 + tl), payload, (uint16_t)pl);
+  _txUsed += (uint16_t)need;
+  _txRawCount++;
+  _txStats.enqueued++;
+
+  uint16_t depth = _tx_depth();
+  if (depth > _txStats.peakDepth) _txStats.peakDepth = depth;
+  return true;
+}
+
+// TCP 送出緩衝區放得下 packetLen 嗎？(沒給 socket 或核心沒實作就當作放得下)
+static bool _tx_has_room(size_t packetLen) {
+  if (!_txSock) return true;
+  int room = _txSock->availableForWrite();
+  if (room > 0) _txRoomSeen = true;
+  if (!_txRoomSeen) return true;
+  return (size_t)room >= packetLen;
+}
+
+// 串流送出 (beginPublish / endPublish) 失敗之後：斷線了回傳 false，東西留著連上後再送；
+// 連線還在 (例如超過封包大小) 重送也一樣，記成 dropped 回傳 true
+static bool _tx_failed(size_t& packetLen) {
+  packetLen = 0;
+  if (!_mqttClient->connected()) return false;
+  _txStats.dropped++;
+  return true;
+}
+
+static void _tx_sent(size_t packetLen, uint8_t& msgs, uint32_t& bytes) {
+  msgs++;
+  bytes += packetLen;
+  _txStats.sent++;
+}
+
+// 雙核心時這裡跑在應用核心：不是送出，而是把訊息格式化好交給網路核心 (_xq_push)，
+// 額度 (每圈幾則) 由網路核心那邊的 _xq_drain() 控制。
+static void _tx_drain() {
+  if (!_net_up()) return;
+  if (_tx_depth() == 0) return;
+
+  uint8_t msgs = 0;
+  uint32_t bytes = 0;
+  uint8_t maxMsgs = _dualCore ? 255 : _txMaxMsgs;
+  uint32_t maxBytes = _dualCore ? 0xFFFFFFFFu : _txMaxBytes;
+
+  // 1. 一般訊息 (先進先出)
+  while (_txRawCount > 0 && msgs < maxMsgs && bytes < maxBytes) {
+    uint8_t hdr[3];
+    _ring_get(_txHead, hdr, 3);
+    uint16_t tl = hdr[0];
+    uint16_t pl = (uint16_t)(hdr[1] | (hdr[2] << 8));
+    size_t packetLen = MQTT_MAX_HEADER_SIZE + 2 + tl + pl;
+    if (!_dualCore && !_tx_has_room(packetLen)) return;
+
+    char topic[256];
+    _ring_get(_ring_pos((uint32_t)_txHead + 3), topic, tl);
+    topic[tl] = '\0';
+
+    // payload 直接從 ring 串流寫進 socket (繞回開頭時分兩段寫)，不用再複製一份
+    uint16_t pos = _ring_pos((uint32_t)_txHead + 3 + tl);
+    uint16_t first = (uint16_t)(MPTP_TXQ_BYTES - pos);
+    if (first > pl) first = pl;
+    bool sent = true;
+    if (_dualCore) {
+      if (!_xq_push(topic, tl, _txRing + pos, first, _txRing, (uint16_t)(pl - first))) return;
+    } else {
+      if (!_mqttClient->beginPublish(topic, pl, false)) return; // 開不了頭：留在佇列最前面，下一圈再試
+      _mqttClient->write(_txRing + pos, first);
+      if (pl > first) _mqttClient->write(_txRing, pl - first);
+      sent = _mqttClient->endPublish() == 1;
+    }
+
+    _txHead = _ring_pos((uint32_t)_txHead + 3 + tl + pl);
+    _txUsed -= (uint16_t)(3 + tl + pl);
+    _txRawCount--;
+    if (sent) _tx_sent(packetLen, msgs, bytes);
+    else _txStats.dropped++; // 寫到一半失敗，已經收不回來了
+  }
+
+  // 2. 整包狀態 (State 模式的全體廣播)
+  if (_statePending && msgs < maxMsgs && bytes < maxBytes) {
+    size_t packetLen = 0;
+    if (!_tx_send_state(packetLen)) return; // TCP 緩衝區不夠 / 斷線，下一圈再試
+    _statePending = false;
+    if (packetLen) _tx_sent(packetLen, msgs, bytes);
+  }
+
+  // 3. 待發送的通道 (全體廣播 / 變更偵測)：送的當下才讀變數
+  // CBOR 模式：base 底下的先打包成一則 <base>/state，剩下的 (absolute) 才一個一個送
+  if (_stateMode && _frameFmt == MP_FRAME_CBOR && _txPendingCount > 0 && msgs < maxMsgs && bytes < maxBytes) {
+    size_t packetLen = 0;
+    if (!_tx_send_frame(false, packetLen)) return;
+    if (packetLen) _tx_sent(packetLen, msgs, bytes);
+  }
+  while (_txPendingCount > 0 && msgs < maxMsgs && bytes < maxBytes) {
+    int i = _txScan;
+    while (!(_txPending[i >> 3] & (1 << (i & 7)))) i = (i + 1) % MPTP_MAX_CHANNELS;
+    MpChannel& c = _channels[i];
+
+    char tVal[MPTP_MAX_TOPIC_LEN];            // 當場組出 /val topic (不用常駐記憶體)
+    char buf[32];
+    bool ok = c.active && c.ops->format && _channel_val_topic(c, tVal, sizeof(tVal));
+    const char* payload = ok ? c.ops->format(c.varPtr, buf, sizeof(buf)) : "";
+    size_t packetLen = ok ? MQTT_MAX_HEADER_SIZE + 2 + strlen(tVal) + strlen(payload) : 0;
+    bool sent;
+    if (_dualCore) {
+      if (ok && !_xq_push(tVal, strlen(tVal), (const uint8_t*)payload, (uint16_t)strlen(payload), NULL, 0)) return;
+      sent = ok;
+    } else {
+      if (ok && !_tx_has_room(packetLen)) return;
+      sent = ok && _mqttClient->publish(tVal, payload);
+      if (ok && !sent && !_mqttClient->connected()) return; // 斷線了：保留待發送，連上後再送
+    }
+    if (sent && c.tracked) {
+      // 記下這次送出的值，之後跟它比
+      c.ops->snapshot(c.varPtr, &c.shadow);
+      c.shadowValid = true;
+      c.lastPubMs = millis();
+    }
+    _txPending[i >> 3] &= (uint8_t)~(1 << (i & 7));
+    _txPendingCount--;
+    _txScan = (uint16_t)((i + 1) % MPTP_MAX_CHANNELS);
+    if (sent) _tx_sent(packetLen, msgs, bytes);
+    else if (ok) _txStats.dropped++; // 連線還在卻送不出去 (例如超過封包大小)，重送也一樣
+  }
+
+  // 4. 時間序列：一個序列一則 (緩衝區裡的點整批送)
+  for (int i = 0; _seriesDueCount > 0 && i < _seriesCount && msgs < maxMsgs && bytes < maxBytes; i++) {
+    if (!_series[i].due) continue;
+    size_t packetLen = 0;
+    if (!_series_send(_series[i], packetLen)) return;
+    if (packetLen) _tx_sent(packetLen, msgs, bytes);
+    if (_series[i].due) i--; // 還有滿一批的，同一個序列再送一則
   }
+
+  // 5. 清空了：記錄這次花了多久
+  if (_tx_depth() == 0) {
+    _txStats.lastDrainMs = millis() - _txBusySince;
+    if (_txStats.lastDrainMs > _txStats.maxDrainMs) _txStats.maxDrainMs = _txStats.lastDrainMs;
+  }
+}
+
+// --- State Mode Impl (整包狀態實作) ---
+// <base>/state 的內容長這樣 (key = 相對 Topic 去掉 "/set")：
+//   {"switch/1":"1","dimmer/2":"50","text/4":"Hello"}
+// <base>/set 收同樣格式的 JSON (數值也可以不加引號)，一次改很多個通道。
+// 不在 base 底下的通道 (absolute) 沒辦法用相對 key 表示，不會出現在 state 裡。
+
+bool mqttpanel_state_mode(bool enable) {
+  if (!_mqttClient) return false;
+  if (enable && _baseLen == 0) return false; // 還不知道前綴 (先註冊通道，或在 begin 指定 baseTopic)
+  if (enable && !_stateMode) {
+    char t[MPTP_MAX_TOPIC_LEN];
+    if (_baseLen + 5 > sizeof(t)) return false;
+    memcpy(t, _baseTopic, _baseLen);
+    strcpy(t + _baseLen, "/set");
+    _mqttClient->subscribe(t);
+  }
+  _stateMode = enable;
+  return true;
+}
+
+// 通道的 state key："dimmer/1/set" -> "dimmer/1"；沒有 "/set" 結尾的就整串用
+static size_t _state_key_len(const MpChannel& c) {
+  if (c.keyLen > 4 && memcmp(_key_of(c) + c.keyLen - 4, "/set", 4) == 0) return c.keyLen - 4;
+  return c.keyLen;
+}
+
+// 組成一份 JSON，量好長度後直接串流寫進 MQTT (不用另外準備一大塊 buffer)
+// 回傳 false = TCP 送出緩衝區不夠 / 斷線了，這次先不送
+static bool _tx_send_state(size_t& packetLen) {
+  if (_frameFmt == MP_FRAME_CBOR) return _tx_send_frame(true, packetLen);
+  JsonDocument doc; // ArduinoJson 7：const char* 的值會被複製進 doc，所以 buf 可以重複使用
+  char buf[32];
+  for (int i = 0; i < _channelCount; i++) {
+    const MpChannel& c = _channels[i];
+    if (!c.active || c.absolute || !c.ops->format) continue;
+    char key[MPTP_MAX_KEY_LEN];
+    size_t kl = _state_key_len(c);
+    memcpy(key, _key_of(c), kl);
+    key[kl] = '\0';
+    const char* v = c.ops->format(c.varPtr, buf, sizeof(buf));
+    doc[key] = v;
+  }
+
+  char topic[MPTP_MAX_TOPIC_LEN];
+  memcpy(topic, _baseTopic, _baseLen);
+  strcpy(topic + _baseLen, "/state");
+  size_t len = measureJson(doc);
+  packetLen = MQTT_MAX_HEADER_SIZE + 2 + _baseLen + 6 + len;
+  if (_dualCore) {
+    // 應用核心先在這裡序列化好，網路核心只負責搬；交接佇列放不下的整份丟掉
+    if (7 + _baseLen + 6 + len > MPTP_XQ_BYTES) { packetLen = 0; _txStats.dropped++; return true; }
+    serializeJson(doc, (char*)_xqOut, len + 1);
+    return _xq_push(topic, _baseLen + 6, _xqOut, (uint16_t)len, NULL, 0);
+  }
+  if (!_tx_has_room(packetLen)) return false;
+
+  bool ok = _mqttClient->beginPublish(topic, (unsigned int)len, false);
+  if (ok) {
+    serializeJson(doc, *_mqttClient);
+    ok = _mqttClient->endPublish() == 1;
+  }
+  if (!ok) return _tx_failed(packetLen); // 斷線：_statePending 留著，連上後再送
+  return true;
+}
+
+// state key ("dimmer/1") -> 通道編號
+static int _state_find(const char* k, size_t kl) {
+  char rel[MPTP_MAX_KEY_LEN];
+  if (kl + 5 > sizeof(rel)) return -1;
+  memcpy(rel, k, kl);
+  strcpy(rel + kl, "/set");
+  int i = _find_key(rel, kl + 4, false);
+  if (i < 0) i = _find_key(k, kl, false); // 沒有 "/set" 結尾的通道
+  return i;
+}
+
+// 把 JSON 裡的值轉成跟單一 /set 一樣的字串，再交給通道自己的 apply
+static void _state_apply(const byte* payload, unsigned int length) {
+  if (length > 0 && (payload[0] & 0xE0) == 0xA0) { // CBOR map (major type 5)；JSON 一定是 '{' 或空白開頭
+    _frame_apply(payload, length);
+    return;
+  }
+  JsonDocument doc;
+  if (deserializeJson(doc, payload, length)) return; // 格式錯誤就整包忽略
+
+  for (JsonPair kv : doc.as<JsonObject>()) {
+    const char* k = kv.key().c_str();
+    int i = _state_find(k, strlen(k));
+    if (i < 0) continue;
+
+    const MpChannel& c = _channels[i];
+    if (!c.varPtr) continue; // Sync 不接受整包設定
+    char buf[32];
+    const char* msg;
+    if (kv.value().is<const char*>()) msg = kv.value().as<const char*>();
+    else if (kv.value().is<bool>()) msg = kv.value().as<bool>() ? "1" : "0";
+    else if (kv.value().is<long>()) msg = ltoa(kv.value().as<long>(), buf, 10);
+    else if (kv.value().is<float>()) msg = dtostrf(kv.value().as<float>(), 1, 2, buf);
+    else continue;
+    c.ops->apply(c.varPtr, msg, strlen(msg));
+  }
+}
+
+// --- Binary Frame Impl (二進位 frame 實作) ---
+// CBOR 只用到一小部分：一個 map，key 是文字，值是 bool / 整數 / float / 文字。
+// 每個項目前面有一個 byte：高 3 bit 是型別 (major)，低 5 bit 是長度或數值，
+// 放不下的時候後面再接 1/2/4/8 bytes (big-endian)。
+//   {"dimmer/2": 50}  ->  A1  68 "dimmer/2"  18 32   (12 bytes；JSON 是 16)
+
+void mqttpanel_state_format(MpFrameFormat fmt) {
+  _frameFmt = fmt;
+}
+
+const char* mqttpanel_value_text(const MpValue& v, char* buf, size_t size) {
+  switch (v.type) {
+    case MP_VAL_BOOL: return v.b ? "1" : "0";
+    case MP_VAL_INT: return ltoa((long)v.i, buf, 10);
+    case MP_VAL_FLOAT: return size >= 32 ? dtostrf(v.f, 1, 2, buf) : "";
+    case MP_VAL_TEXT: return v.s;
+    default: return "";
+  }
+}
+
+MpFrameWriter::MpFrameWriter(uint8_t* buf, size_t cap, Print* out)
+  : _buf(buf), _cap(cap), _len(0), _out(out), _overflow(false), _staged(0) {}
+
+void MpFrameWriter::_put(const void* p, size_t n) {
+  const uint8_t* src = (const uint8_t*)p;
+  _len += n;
+  if (_out) {
+    // 串流：小片段先累積，免得每個 byte 都呼叫一次 client->write()
+    while (n > 0) {
+      size_t k = sizeof(_stage) - _staged;
+      if (k > n) k = n;
+      memcpy(_stage + _staged, src, k);
+      _staged = (uint8_t)(_staged + k);
+      src += k;
+      n -= k;
+      if (_staged == sizeof(_stage)) flush();
+    }
+    return;
+  }
+  if (!_buf) return; // 只量長度
+  if (_len > _cap) { _overflow = true; return; }
+  memcpy(_buf + _len - n, src, n);
+}
+
+void MpFrameWriter::flush() {
+  if (_out && _staged) _out->write(_stage, _staged);
+  _staged = 0;
+}
+
+void MpFrameWriter::_head(uint8_t major, uint32_t n) {
+  uint8_t b[5];
+  size_t k;
+  major = (uint8_t)(major << 5);
+  if (n < 24) { b[0] = (uint8_t)(major | n); k = 1; }
+  else if (n <= 0xFF) { b[0] = (uint8_t)(major | 24); b[1] = (uint8_t)n; k = 2; }
+  else if (n <= 0xFFFF) { b[0] = (uint8_t)(major | 25); b[1] = (uint8_t)(n >> 8); b[2] = (uint8_t)n; k = 3; }
+  else {
+    b[0] = (uint8_t)(major | 26);
+    b[1] = (uint8_t)(n >> 24); b[2] = (uint8_t)(n >> 16); b[3] = (uint8_t)(n >> 8); b[4] = (uint8_t)n;
+    k = 5;
+  }
+  _put(b, k);
+}
+
+void MpFrameWriter::map(uint32_t n) { _head(5, n); }
+
+void MpFrameWriter::array(uint32_t n) { _head(4, n); }
+
+void MpFrameWriter::uint(uint32_t n) { _head(0, n); }
+
+void MpFrameWriter::raw(const void* p, size_t n) { _put(p, n); }
+
+void MpFrameWriter::key(const char* k, size_t len) {
+  _head(3, (uint32_t)len);
+  _put(k, len);
+}
+
+void MpFrameWriter::value(const MpValue& v) {
+  switch (v.type) {
+    case MP_VAL_BOOL: { uint8_t b = v.b ? 0xF5 : 0xF4; _put(&b, 1); break; }
+    case MP_VAL_INT:
+      if (v.i >= 0) _head(0, (uint32_t)v.i);
+      else _head(1, (uint32_t)(-(v.i + 1))); // 負數存 -1-n
+      break;
+    case MP_VAL_FLOAT: {
+      uint32_t bits;
+      memcpy(&bits, &v.f, 4);
+      uint8_t b[5] = { 0xFA, (uint8_t)(bits >> 24), (uint8_t)(bits >> 16), (uint8_t)(bits >> 8), (uint8_t)bits };
+      _put(b, 5);
+      break;
+    }
+    case MP_VAL_TEXT:
+      _head(3, (uint32_t)v.len);
+      _put(v.s, v.len);
+      break;
+    default: { uint8_t b = 0xF6; _put(&b, 1); break; } // null
+  }
+}
+
+void MpFrameWriter::add(const char* k, bool v) {
+  MpValue x; x.type = MP_VAL_BOOL; x.b = v;
+  key(k, strlen(k)); value(x);
+}
+
+void MpFrameWriter::add(const char* k, int v) {
+  MpValue x; x.type = MP_VAL_INT; x.i = v;
+  key(k, strlen(k)); value(x);
+}
+
+void MpFrameWriter::add(const char* k, float v) {
+  MpValue x; x.type = MP_VAL_FLOAT; x.f = v;
+  key(k, strlen(k)); value(x);
+}
+
+void MpFrameWriter::add(const char* k, const char* text) {
+  MpValue x; x.type = MP_VAL_TEXT; x.s = text; x.len = strlen(text);
+  key(k, strlen(k)); value(x);
+}
+
+MpFrameReader::MpFrameReader(const uint8_t* p, size_t len)
+  : _p(p), _len(len), _pos(0), _count(0), _index(0), _error(false) {
+  uint8_t major, info;
+  uint64_t n;
+  if (!_head(&major, &info, &n) || major != 5 || n > 0xFFFFFFFFu) { _error = true; return; }
+  _count = (uint32_t)n;
+}
+
+// 讀一個項目的開頭；不支援「不定長度」(info 31)
+bool MpFrameReader::_head(uint8_t* major, uint8_t* info, uint64_t* n) {
+  if (_pos >= _len) return false;
+  uint8_t b = _p[_pos++];
+  *major = b >> 5;
+  *info = b & 31;
+  if (*info < 24) { *n = *info; return true; }
+  if (*info > 27) return false;
+  size_t k = (size_t)1 << (*info - 24); // 1 / 2 / 4 / 8 bytes
+  if (_len - _pos < k) return false;
+  uint64_t x = 0;
+  for (size_t i = 0; i < k; i++) x = (x << 8) | _p[_pos++];
+  *n = x;
+  return true;
+}
+
+static float _half_to_float(uint16_t h) {
+  int e = (h >> 10) & 0x1F;
+  int m = h & 0x3FF;
+  float f;
+  if (e == 0) f = ldexpf((float)m, -24);
+  else if (e == 31) f = m ? NAN : INFINITY;
+  else f = ldexpf((float)(m + 1024), e - 25);
+  return (h & 0x8000) ? -f : f;
+}
+
+bool MpFrameReader::next(const char** key, size_t* keyLen, MpValue* v) {
+  if (_error || _index >= _count) return false;
+  uint8_t major, info;
+  uint64_t n;
+
+  // key：一定是文字
+  if (!_head(&major, &info, &n) || major != 3 || n > _len - _pos) { _error = true; return false; }
+  *key = (const char*)_p + _pos;
+  *keyLen = (size_t)n;
+  _pos += (size_t)n;
+
+  if (!_head(&major, &info, &n)) { _error = true; return false; }
+  switch (major) {
+    case 0: // 正整數
+      if (n > 0x7FFFFFFF) { _error = true; return false; }
+      v->type = MP_VAL_INT; v->i = (int32_t)n;
+      break;
+    case 1: // 負整數 (-1-n)
+      if (n > 0x7FFFFFFF) { _error = true; return false; }
+      v->type = MP_VAL_INT; v->i = (int32_t)(-1 - (int64_t)n);
+      break;
+    case 3: // 文字
+      if (n > _len - _pos) { _error = true; return false; }
+      v->type = MP_VAL_TEXT; v->s = (const char*)_p + _pos; v->len = (size_t)n;
+      _pos += (size_t)n;
+      break;
+    case 7:
+      if (info == 20 || info == 21) { v->type = MP_VAL_BOOL; v->b = (info == 21); }
+      else if (info == 22 || info == 23) v->type = MP_VAL_NONE; // null / undefined：略過
+      else if (info == 25) { v->type = MP_VAL_FLOAT; v->f = _half_to_float((uint16_t)n); }
+      else if (info == 26) { uint32_t bits = (uint32_t)n; v->type = MP_VAL_FLOAT; memcpy(&v->f, &bits, 4); }
+      else if (info == 27) { double d; memcpy(&d, &n, 8); v->type = MP_VAL_FLOAT; v->f = (float)d; }
+      else { _error = true; return false; }
+      break;
+    default: // byte string / array / map / tag：面板用不到
+      _error = true;
+      return false;
+  }
+  _index++;
+  return true;
+}
+
+// 把通道寫進 frame：all = 全部 (全體廣播)，否則只寫待發送的 (變更偵測)。回傳寫了幾組。
+static uint32_t _frame_entries(MpFrameWriter& w, bool all) {
+  uint32_t n = 0;
+  char buf[32];
+  for (int i = 0; i < _channelCount; i++) {
+    const MpChannel& c = _channels[i];
+    if (!c.active || c.absolute || !c.ops->format) continue;
+    if (!all && !(_txPending[i >> 3] & (1 << (i & 7)))) continue;
+    MpValue v;
+    if (c.ops->pack) {
+      c.ops->pack(c.varPtr, &v, buf, sizeof(buf));
+    } else { // 自己組的 MpBindingOps 沒有 pack：送文字
+      v.type = MP_VAL_TEXT;
+      v.s = c.ops->format(c.varPtr, buf, sizeof(buf));
+      v.len = strlen(v.s);
+    }
+    w.key(_key_of(c), _state_key_len(c));
+    w.value(v);
+    n++;
+  }
+  return n;
+}
+
+// 有變的通道打包送出之後：清掉待發送；真的送到了 (delivered) 才記下影子，
+// 丟掉的不動影子，變更偵測之後還會再抓到它
+static void _frame_sent(bool delivered) {
+  for (int i = 0; i < _channelCount; i++) {
+    MpChannel& c = _channels[i];
+    if (!(_txPending[i >> 3] & (1 << (i & 7))) || !c.active || c.absolute || !c.ops->format) continue;
+    if (delivered && c.tracked) {
+      c.ops->snapshot(c.varPtr, &c.shadow);
+      c.shadowValid = true;
+      c.lastPubMs = millis();
+    }
+    _txPending[i >> 3] &= (uint8_t)~(1 << (i & 7));
+    _txPendingCount--;
+  }
+}
+
+// 先量長度 (MQTT 要先知道 payload 多長)，再直接串流寫進 client，跟 JSON 一樣不用一大塊 buffer。
+// 回傳 false = TCP 送出緩衝區不夠 / 斷線了，這次先不送；packetLen = 0 表示沒有送出東西。
+static bool _tx_send_frame(bool all, size_t& packetLen) {
+  MpFrameWriter body(NULL, 0);
+  uint32_t n = _frame_entries(body, all);
+  packetLen = 0;
+  if (n == 0 && !all) return true; // 待發送的都是 absolute 通道
+  MpFrameWriter head(NULL, 0);
+  head.map(n);
+  size_t len = head.size() + body.size();
+
+  char topic[MPTP_MAX_TOPIC_LEN];
+  memcpy(topic, _baseTopic, _baseLen);
+  strcpy(topic + _baseLen, "/state");
+  packetLen = MQTT_MAX_HEADER_SIZE + 2 + _baseLen + 6 + len;
+  if (_dualCore) {
+    if (7 + _baseLen + 6 + len > MPTP_XQ_BYTES) {
+      packetLen = 0;
+      _txStats.dropped++;
+      if (!all) _frame_sent(false);
+      return true;
+    }
+    MpFrameWriter w(_xqOut, len);
+    w.map(n);
+    _frame_entries(w, all);
+    if (!_xq_push(topic, _baseLen + 6, _xqOut, (uint16_t)len, NULL, 0)) return false;
+  } else {
+    if (!_tx_has_room(packetLen)) return false;
+    bool ok = _mqttClient->beginPublish(topic, (unsigned int)len, false);
+    if (ok) {
+      MpFrameWriter w(NULL, 0, _mqttClient);
+      w.map(n);
+      _frame_entries(w, all);
+      w.flush();
+      ok = _mqttClient->endPublish() == 1;
+    }
+    if (!ok) {
+      if (!_tx_failed(packetLen)) return false; // 待發送跟影子都不動，連上後再送
+      if (!all) _frame_sent(false);
+      return true;
+    }
+  }
+  if (!all) _frame_sent(true);
+  return true;
+}
+
+// <base>/set 的 CBOR 版：先整包檢查一次 (格式錯誤就整包忽略，跟 JSON 一樣)，再一組一組套用
+static void _frame_apply(const byte* payload, unsigned int length) {
+  const char* k;
+  size_t kl;
+  MpValue v;
+  MpFrameReader check(payload, length);
+  while (check.next(&k, &kl, &v)) {}
+  if (check.error()) return;
+
+  MpFrameReader r(payload, length);
+  while (r.next(&k, &kl, &v)) {
+    if (v.type == MP_VAL_NONE) continue;
+    int i = _state_find(k, kl);
+    if (i < 0) continue;
+    const MpChannel& c = _channels[i];
+    if (!c.varPtr) continue; // Sync 不接受整包設定
+    if (v.type == MP_VAL_TEXT && v.len >= MPTP_MAX_VALUE_LEN) { // 跟單則 /set 一樣：太長就丟掉，不截斷
+      _rxTooLong.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    if (c.ops->unpack) {
+      c.ops->unpack(c.varPtr, v); // 數字直接寫進變數，不用轉成字串
+      continue;
+    }
+    char buf[32];
+    const char* text = mqttpanel_value_text(v, buf, sizeof(buf));
+    size_t len = v.type == MP_VAL_TEXT ? v.len : strlen(text);
+    char msg[MPTP_MAX_VALUE_LEN];
+    memcpy(msg, text, len);
+    msg[len] = '\0';
+    c.ops->apply(c.varPtr, msg, len);
+  }
+}
+
+// --- Time Series Impl (時間序列實作) ---
+// 加點只是寫進緩衝區；_series_scan() 每圈看觸發條件，_tx_drain() 第 4 步整批送出。
+// 送的時候跟 frame 一樣先量長度再直接串流寫進 client，不用另外準備 buffer。
+
+static const char* const _srNames[3] = { "v", "lo", "hi" }; // MP_REDUCE_MEAN / MIN / MAX 的 key
+
+int mqttpanel_series(const char* topicVal, const MpSeriesConfig& cfg) {
+  if (!_mqttClient || !topicVal || _seriesCount >= MPTP_MAX_SERIES) return -1;
+  uint8_t fields = cfg.windowMs ? (uint8_t)(cfg.reduce & (MP_REDUCE_MEAN | MP_REDUCE_MIN | MP_REDUCE_MAX)) : 0;
+  if (!fields) fields = MP_REDUCE_MEAN; // 沒有降採樣：每個點就是 "v"
+  uint8_t width = 1;
+  for (int f = 0; f < 3; f++) if (fields & (1 << f)) width++;
+  uint16_t cap = cfg.capacity ? cfg.capacity : 1;
+  uint32_t words = (uint32_t)cap * width;
+  if (words > MPTP_SERIES_WORDS - _srPoolUsed) return -1; // 共用池不夠 (調大 MPTP_SERIES_WORDS)
+
+  size_t len = strlen(topicVal);
+  size_t off = _key_offset(topicVal, len);
+
+  MpSeries& s = _series[_seriesCount];
+  memset(&s, 0, sizeof(s));
+  if (!_key_store(s, topicVal, len, off)) return -1;
+  s.ring = _srPool + _srPoolUsed;
+  s.cap = cap;
+  s.flushSamples = (cfg.flushSamples == 0 || cfg.flushSamples > cap) ? cap : cfg.flushSamples;
+  s.flushMs = cfg.flushMs;
+  s.windowMs = cfg.windowMs;
+  s.q = cfg.resolution > 0 ? cfg.resolution : 0.01f;
+  s.fields = fields;
+  s.width = width;
+  _srPoolUsed += words;
+  return _seriesCount++;
+}
+
+// 值 -> q 的整數倍 (限制在 ±1e9，相鄰兩點的差才放得進 int32)
+static int32_t _series_quant(const MpSeries& s, float v) {
+  float x = v / s.q;
+  if (x > 1e9f) x = 1e9f;
+  if (x < -1e9f) x = -1e9f;
+  return (int32_t)lroundf(x);
+}
+
+// 第 i 舊的點
+static const uint32_t* _series_at(const MpSeries& s, uint16_t i) {
+  return s.ring + (uint32_t)((s.head + i) % s.cap) * s.width;
+}
+
+// 跟 _tx_mark 一樣：標成待發送，算進佇列深度
+static void _series_mark(MpSeries& s) {
+  if (s.due) return;
+  if (_tx_depth() == 0) _txBusySince = millis();
+  s.due = true;
+  _seriesDueCount++;
+  _txStats.enqueued++;
+  uint16_t depth = _tx_depth();
+  if (depth > _txStats.peakDepth) _txStats.peakDepth = depth;
+}
+
+static void _series_push(MpSeries& s, uint32_t t, float mean, float lo, float hi) {
+  if (s.count == s.cap) { // 滿了 (通常是斷線中)：丟最舊的
+    s.head = (uint16_t)((s.head + 1) % s.cap);
+    s.count--;
+    s.st.dropped++;
+  }
+  if (s.count == 0) s.firstMs = millis();
+  uint32_t* p = s.ring + (uint32_t)((s.head + s.count) % s.cap) * s.width;
+  *p++ = t;
+  if (s.fields & MP_REDUCE_MEAN) *p++ = (uint32_t)_series_quant(s, mean);
+  if (s.fields & MP_REDUCE_MIN) *p++ = (uint32_t)_series_quant(s, lo);
+  if (s.fields & MP_REDUCE_MAX) *p++ = (uint32_t)_series_quant(s, hi);
+  s.count++;
+  s.st.points++;
+  if (s.count > s.st.peak) s.st.peak = s.count;
+  if (s.count >= s.flushSamples && _net_up()) _series_mark(s);
+}
+
+// 降採樣：把目前的窗收成一個點
+static void _series_close(MpSeries& s) {
+  if (!s.wN) return;
+  _series_push(s, s.wStart, s.wSum / (float)s.wN, s.wMin, s.wMax);
+  s.wN = 0;
+}
+
+static bool _series_sample(int id, uint32_t t, float v) {
+  if (id < 0 || id >= _seriesCount || isnan(v)) return false;
+  MpSeries& s = _series[id];
+  s.st.samples++;
+  if (!s.windowMs) {
+    _series_push(s, t, v, v, v);
+    return true;
+  }
+  if (s.wN && t - s.wStart >= s.windowMs) _series_close(s);
+  if (!s.wN) {
+    s.wStart = t;
+    s.wOpenMs = millis();
+    s.wSum = 0;
+    s.wMin = v;
+    s.wMax = v;
+  }
+  s.wN++;
+  s.wSum += v;
+  if (v < s.wMin) s.wMin = v;
+  if (v > s.wMax) s.wMax = v;
+  return true;
+}
+
+bool mqttpanel_series_add(int id, float v) {
+  return _series_sample(id, millis(), v);
+}
+
+bool mqttpanel_series_add_at(int id, uint32_t tMs, float v) {
+  return _series_sample(id, tMs, v);
+}
+
+void mqttpanel_series_flush(int id) {
+  for (int i = 0; i < _seriesCount; i++) {
+    if (id >= 0 && i != id) continue;
+    MpSeries& s = _series[i];
+    _series_close(s);
+    if (s.count == 0) continue;
+    s.flushing = true;
+    _series_mark(s);
+  }
+}
+
+bool mqttpanel_series_stats(int id, MpSeriesStats* out) {
+  if (id < 0 || id >= _seriesCount || !out) return false;
+  *out = _series[id].st;
+  out->depth = _series[id].count;
+  return true;
+}
+
+// 每圈掃一次：收掉過期的窗，點數夠了或最舊的點放太久就標成待發送
+static void _series_scan() {
+  if (_seriesCount == 0) return;
+  bool up = _net_up();
+  uint32_t now = millis();
+  for (int i = 0; i < _seriesCount; i++) {
+    MpSeries& s = _series[i];
+    if (s.wN && now - s.wOpenMs >= s.windowMs) _series_close(s); // 點停了，窗也要結束
+    if (!up || s.due || s.count == 0) continue;
+    if (s.count >= s.flushSamples || (s.flushMs && now - s.firstMs >= s.flushMs)) _series_mark(s);
+  }
+}
+
+// 同一段程式寫 JSON 或 CBOR (CBOR 的 map / array 要先給個數，JSON 要逗號和括號)
+struct MpSeriesOut {
+  MpFrameWriter& w;
+  bool cbor;
+  bool sep;                          // JSON：下一個元素前面要不要逗號
+
+  MpSeriesOut(MpFrameWriter& writer, bool c) : w(writer), cbor(c), sep(false) {}
+  void comma() { if (sep) w.raw(",", 1); sep = true; }
+  void map(uint32_t n) { if (cbor) w.map(n); else { comma(); w.raw("{", 1); sep = false; } }
+  void array(uint32_t n) { if (cbor) w.array(n); else { comma(); w.raw("[", 1); sep = false; } }
+  void end(char c) { if (!cbor) { w.raw(&c, 1); sep = true; } }
+  void key(const char* k) {
+    size_t n = strlen(k);
+    if (cbor) { w.key(k, n); return; }
+    comma();
+    w.raw("\"", 1);
+    w.raw(k, n);
+    w.raw("\":", 2);
+    sep = false;
+  }
+  void num(int32_t v) {
+    if (cbor) { MpValue x; x.type = MP_VAL_INT; x.i = v; w.value(x); return; }
+    char b[12];
+    comma();
+    ltoa((long)v, b, 10);
+    w.raw(b, strlen(b));
+  }
+  void unum(uint32_t v) {
+    if (cbor) { w.uint(v); return; }
+    char b[12];
+    comma();
+    ultoa((unsigned long)v, b, 10);
+    w.raw(b, strlen(b));
+  }
+  void flt(float v) {
+    if (cbor) { MpValue x; x.type = MP_VAL_FLOAT; x.f = v; w.value(x); return; }
+    char b[16];
+    comma();
+    snprintf(b, sizeof(b), "%g", (double)v);
+    w.raw(b, strlen(b));
+  }
+};
+
+// 最舊的 n 個點：{"t":..,"dt":..,"q":..,["w":..,]"v":[..],"lo":[..],"hi":[..]}
+static void _series_write(const MpSeries& s, uint16_t n, MpSeriesOut& o) {
+  int32_t dt = n > 1 ? (int32_t)(_series_at(s, 1)[0] - _series_at(s, 0)[0]) : 0;
+  bool uniform = true;
+  for (uint16_t i = 2; i < n && uniform; i++) uniform = (int32_t)(_series_at(s, i)[0] - _series_at(s, i - 1)[0]) == dt;
+
+  o.map(3 + (s.windowMs ? 1 : 0) + (s.width - 1));
+  o.key("t");
+  o.unum(_series_at(s, 0)[0]);
+  o.key("dt");
+  if (uniform) {
+    o.num(dt); // 固定間隔：一個數字就好
+  } else {
+    o.array(n);
+    for (uint16_t i = 0; i < n; i++) o.num(i ? (int32_t)(_series_at(s, i)[0] - _series_at(s, i - 1)[0]) : 0);
+    o.end(']');
+  }
+  o.key("q");
+  o.flt(s.q);
+  if (s.windowMs) {
+    o.key("w");
+    o.unum(s.windowMs);
+  }
+  uint8_t col = 1;
+  for (int f = 0; f < 3; f++) {
+    if (!(s.fields & (1 << f))) continue;
+    o.key(_srNames[f]);
+    o.array(n);
+    int32_t prev = 0;
+    for (uint16_t i = 0; i < n; i++) {
+      int32_t x = (int32_t)_series_at(s, i)[col];
+      o.num(x - prev);
+      prev = x;
+    }
+    o.end(']');
+    col++;
+  }
+  o.end('}');
+}
+
+static size_t _series_len(const MpSeries& s, uint16_t n, bool cbor) {
+  MpFrameWriter w(NULL, 0);
+  MpSeriesOut o(w, cbor);
+  _series_write(s, n, o);
+  return w.size();
+}
+
+// 送出之後：拿掉最舊的 n 個點；剩下不滿一批的，等 flushMs 或下一批 (flush 的話繼續送)
+static void _series_consume(MpSeries& s, uint16_t n) {
+  s.head = (uint16_t)((s.head + n) % s.cap);
+  s.count = (uint16_t)(s.count - n);
+  if (s.count) s.firstMs = millis();
+  if (s.count == 0) s.flushing = false;
+  if (s.count == 0 || (s.count < s.flushSamples && !s.flushing)) {
+    s.due = false;
+    _seriesDueCount--;
+  }
+}
+
+// 一則最多 flushSamples 個點。回傳 false = TCP 送出緩衝區 / 交接佇列不夠 / 斷線，下一圈再試
+static bool _series_send(MpSeries& s, size_t& packetLen) {
+  packetLen = 0;
+  uint16_t n = s.count < s.flushSamples ? s.count : s.flushSamples;
+  if (n == 0) { _series_consume(s, 0); return true; }
+
+  char topic[MPTP_MAX_TOPIC_LEN + MPTP_MAX_KEY_LEN];
+  size_t tl = 0;
+  if (!s.absolute) {
+    memcpy(topic, _baseTopic, _baseLen);
+    topic[_baseLen] = '/';
+    tl = _baseLen + 1;
+  }
+  memcpy(topic + tl, _key_of(s), s.keyLen);
+  tl += s.keyLen;
+  topic[tl] = '\0';
+
+  bool cbor = (_frameFmt == MP_FRAME_CBOR);
+  size_t len = _series_len(s, n, cbor);
+  if (_dualCore) {
+    // 一則要放得進交接佇列：放不下就少送幾個點，剩下的下一則
+    while (n > 1 && 7 + tl + len > MPTP_XQ_BYTES) {
+      n /= 2;
+      len = _series_len(s, n, cbor);
+    }
+    if (tl > 255 || 7 + tl + len > MPTP_XQ_BYTES) {
+      _txStats.dropped++;
+      s.st.dropped += n;
+      _series_consume(s, n);
+      return true;
+    }
+    MpFrameWriter w(_xqOut, len);
+    MpSeriesOut o(w, cbor);
+    _series_write(s, n, o);
+    if (!_xq_push(topic, tl, _xqOut, (uint16_t)len, NULL, 0)) return false;
+  } else {
+    if (!_tx_has_room(MQTT_MAX_HEADER_SIZE + 2 + tl + len)) return false;
+    bool ok = _mqttClient->beginPublish(topic, (unsigned int)len, false);
+    if (ok) {
+      MpFrameWriter w(NULL, 0, _mqttClient);
+      MpSeriesOut o(w, cbor);
+      _series_write(s, n, o);
+      w.flush();
+      ok = _mqttClient->endPublish() == 1;
+    }
+    if (!ok) {
+      if (!_tx_failed(packetLen)) return false; // 斷線：點留在環裡，連上後再送
+      s.st.dropped += n;
+      _series_consume(s, n);
+      return true;
+    }
+  }
+  packetLen = MQTT_MAX_HEADER_SIZE + 2 + tl + len;
+  s.st.batches++;
+  s.st.bytes += (uint32_t)len;
+  _series_consume(s, n);
+  return true;
+}
+
+// --- Dual-Core Impl (雙核心實作) ---
+// 誰在哪個核心跑：
+//   網路核心：mqttpanel_loop() -> router callback -> _rx_push()        (RX 生產者)
+//                               -> _xq_drain() 真正送出               (TX 消費者)
+//   應用核心：mqttpanel_app_loop() -> _rx_drain() 寫進變數             (RX 消費者)
+//                               -> _track_scan() / _tx_drain() -> _xq_push() (TX 生產者)
+//                               -> _snap_update() 更新副本
+// 通道表、查表、base 在開啟雙核心之前就註冊好，之後兩邊都只讀不寫。
+
+void mqttpanel_dual_core(bool enable) {
+  _dualCore = false;
+  _rxq.head.store(0); _rxq.tail.store(0);
+  _xq.head.store(0);  _xq.tail.store(0);
+  _syncReq.store(false);
+  _netUp.store(_mqttClient && _mqttClient->connected());
+  _dual.rxMsgs = 0; _dual.rxDropped = 0; _dual.rxPeakBytes = 0; _dual.rxLastUs = 0; _dual.rxMaxUs = 0;
+  _dual.txMsgs = 0; _dual.txPeakBytes = 0; _dual.txLastUs = 0; _dual.txMaxUs = 0;
+  for (int i = 0; i < MPTP_MAX_CHANNELS; i++) _snaps[i].seq.store(0);
+  if (!enable) return;
+  _dualCore = true;
+  _snap_update(); // 一開啟就有副本可以讀
+}
+
+void mqttpanel_app_loop() {
+  if (!_dualCore || !_mqttClient) return;
+  // 1. 網路核心收到的 /set 寫進變數 (只有這裡會改變數)
+  uint32_t tail = _rxq.tail.load(std::memory_order_relaxed);
+  uint32_t head = _rxq.head.load(std::memory_order_acquire);
+  while (tail != head) {
+    uint8_t hdr[8];
+    for (int k = 0; k < 8; k++) hdr[k] = _rxBuf[(tail + k) & _rxq.mask];
+    uint16_t ch = (uint16_t)(hdr[0] | (hdr[1] << 8));
+    uint16_t len = (uint16_t)(hdr[2] | (hdr[3] << 8));
+    uint32_t stamp = (uint32_t)hdr[4] | ((uint32_t)hdr[5] << 8) | ((uint32_t)hdr[6] << 16) | ((uint32_t)hdr[7] << 24);
+
+    char* msg = _rxMsg; // 8 + len <= MPTP_RXQ_BYTES，'\0' 一定放得下
+    for (uint16_t k = 0; k < len; k++) msg[k] = (char)_rxBuf[(tail + 8 + k) & _rxq.mask];
+    msg[len] = '\0';
+    tail += 8 + len;
+    _rxq.tail.store(tail, std::memory_order_release); // 先還位置，網路核心可以繼續放
+
+    if (ch == MP_RX_BATCH) _state_apply((const byte*)msg, len);
+    else _channels[ch].ops->apply(_channels[ch].varPtr, msg, len);
+
+    uint32_t us = (uint32_t)micros() - stamp;
+    _dual.rxLastUs.store(us, std::memory_order_relaxed);
+    if (us > _dual.rxMaxUs.load(std::memory_order_relaxed)) _dual.rxMaxUs.store(us, std::memory_order_relaxed);
+  }
+
+  // 2. 網路核心剛重新連上：全體廣播
+  if (_syncReq.exchange(false, std::memory_order_acquire)) mqttpanel_publish_all_vals();
+
+  // 3. 變更偵測 + 把發送佇列格式化好交給網路核心
+  _track_scan();
+  _series_scan();
+  _tx_drain();
+
+  // 4. 更新給其他核心讀的副本
+  _snap_update();
+}
+
+// 網路核心：收到的 /set 原封不動放進 RX 佇列
+// 記錄格式：[通道編號 2B][長度 2B][收到時間 4B][payload]
+static void _rx_push(uint16_t ch, const byte* payload, unsigned int length) {
+  uint32_t need = 8 + length;
+  uint32_t head = _rxq.head.load(std::memory_order_relaxed);
+  uint32_t used = head - _rxq.tail.load(std::memory_order_acquire);
+  if (length > 0xFFFF || need > MPTP_RXQ_BYTES - used) {
+    _dual.rxDropped.store(_dual.rxDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return;
+  }
+  uint32_t stamp = (uint32_t)micros();
+  uint8_t hdr[8] = { (uint8_t)ch, (uint8_t)(ch >> 8), (uint8_t)length, (uint8_t)(length >> 8),
+                     (uint8_t)stamp, (uint8_t)(stamp >> 8), (uint8_t)(stamp >> 16), (uint8_t)(stamp >> 24) };
+  for (int k = 0; k < 8; k++) _rxBuf[(head + k) & _rxq.mask] = hdr[k];
+  for (unsigned int k = 0; k < length; k++) _rxBuf[(head + 8 + k) & _rxq.mask] = payload[k];
+  _rxq.head.store(head + need, std::memory_order_release);
+
+  _dual.rxMsgs.store(_dual.rxMsgs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  if (used + need > _dual.rxPeakBytes.load(std::memory_order_relaxed)) _dual.rxPeakBytes.store(used + need, std::memory_order_relaxed);
+}
+
+static void _xq_put(uint32_t pos, const void* src, uint32_t n) {
+  uint32_t at = pos & _xq.mask;
+  uint32_t first = MPTP_XQ_BYTES - at;
+  if (first > n) first = n;
+  memcpy(_xqBuf + at, src, first);
+  memcpy(_xqBuf, (const uint8_t*)src + first, n - first);
+}
+
+static void _xq_get(uint32_t pos, void* dst, uint32_t n) {
+  uint32_t at = pos & _xq.mask;
+  uint32_t first = MPTP_XQ_BYTES - at;
+  if (first > n) first = n;
+  memcpy(dst, _xqBuf + at, first);
+  memcpy((uint8_t*)dst + first, _xqBuf, n - first);
+}
+
+// 應用核心：一則格式化好的訊息交給網路核心 (payload 可以分兩段給)
+// 記錄格式：[topic 長度 1B][payload 長度 2B][排進去的時間 4B][topic][payload]
+// 回傳 false = 佇列現在放不下，留在發送佇列下一圈再試；比整個佇列還大的直接丟掉 (記在 dropped)
+static bool _xq_push(const char* topic, size_t tl, const uint8_t* p1, uint16_t n1, const uint8_t* p2, uint16_t n2) {
+  uint32_t need = 7 + (uint32_t)tl + n1 + n2;
+  if (tl > 255 || need > MPTP_XQ_BYTES) { _txStats.dropped++; return true; }
+  uint32_t head = _xq.head.load(std::memory_order_relaxed);
+  uint32_t used = head - _xq.tail.load(std::memory_order_acquire);
+  if (need > MPTP_XQ_BYTES - used) return false;
+
+  uint16_t pl = (uint16_t)(n1 + n2);
+  uint32_t stamp = (uint32_t)micros();
+  uint8_t hdr[7] = { (uint8_t)tl, (uint8_t)pl, (uint8_t)(pl >> 8),
+                     (uint8_t)stamp, (uint8_t)(stamp >> 8), (uint8_t)(stamp >> 16), (uint8_t)(stamp >> 24) };
+  _xq_put(head, hdr, 7);
+  _xq_put(head + 7, topic, (uint32_t)tl);
+  _xq_put(head + 7 + tl, p1, n1);
+  if (n2) _xq_put(head + 7 + tl + n1, p2, n2);
+  _xq.head.store(head + need, std::memory_order_release);
+
+  _dual.txMsgs.store(_dual.txMsgs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  if (used + need > _dual.txPeakBytes.load(std::memory_order_relaxed)) _dual.txPeakBytes.store(used + need, std::memory_order_relaxed);
+  return true;
+}
+
+// 網路核心：把交接過來的訊息送出 (每圈額度跟單核心一樣是 mqttpanel_tx_budget)
+static void _xq_drain() {
+  if (!_mqttClient->connected()) return; // 斷線時留在佇列，連上再送
+  uint8_t msgs = 0;
+  uint32_t bytes = 0;
+  uint32_t tail = _xq.tail.load(std::memory_order_relaxed);
+  uint32_t head = _xq.head.load(std::memory_order_acquire);
+  while (tail != head && msgs < _txMaxMsgs && bytes < _txMaxBytes) {
+    uint8_t hdr[7];
+    _xq_get(tail, hdr, 7);
+    uint16_t tl = hdr[0];
+    uint16_t pl = (uint16_t)(hdr[1] | (hdr[2] << 8));
+    uint32_t stamp = (uint32_t)hdr[3] | ((uint32_t)hdr[4] << 8) | ((uint32_t)hdr[5] << 16) | ((uint32_t)hdr[6] << 24);
+    size_t packetLen = MQTT_MAX_HEADER_SIZE + 2 + tl + pl;
+    if (!_tx_has_room(packetLen)) return;
+
+    char topic[256];
+    _xq_get(tail + 7, topic, tl);
+    topic[tl] = '\0';
+    uint32_t at = (tail + 7 + tl) & _xq.mask;
+    uint32_t first = MPTP_XQ_BYTES - at;
+    if (first > pl) first = pl;
+    if (_mqttClient->beginPublish(topic, pl, false)) {
+      _mqttClient->write(_xqBuf + at, first);
+      if (pl > first) _mqttClient->write(_xqBuf, pl - first);
+      _mqttClient->endPublish();
+    }
+    tail += 7 + tl + pl;
+    _xq.tail.store(tail, std::memory_order_release);
+    msgs++;
+    bytes += packetLen;
+
+    uint32_t us = (uint32_t)micros() - stamp;
+    _dual.txLastUs.store(us, std::memory_order_relaxed);
+    if (us > _dual.txMaxUs.load(std::memory_order_relaxed)) _dual.txMaxUs.store(us, std::memory_order_relaxed);
+  }
+}
+
+static bool _net_up() {
+  return _dualCore ? _netUp.load(std::memory_order_relaxed) : _mqttClient->connected();
+}
+
+// 應用核心：值有變才寫 (沒變就不動 seq，讀的人不會白白重試)
+static void _snap_store(MpSnapSlot& s, const char* text) {
+  uint32_t words[MPTP_SNAPSHOT_LEN / 4];
+  memset(words, 0, sizeof(words));
+  size_t n = strlen(text);
+  if (n > MPTP_SNAPSHOT_LEN - 1) n = MPTP_SNAPSHOT_LEN - 1; // 太長就截斷，保證有結尾 '\0'
+  memcpy(words, text, n);
+
+  uint32_t seq = s.seq.load(std::memory_order_relaxed);
+  if (seq != 0) {
+    bool same = true;
+    for (size_t k = 0; k < MPTP_SNAPSHOT_LEN / 4 && same; k++) same = s.w[k].load(std::memory_order_relaxed) == words[k];
+    if (same) return;
+  }
+  // release：讀的人只要看到任何一個新 word，就一定也看到奇數的 seq
+  s.seq.store(seq + 1, std::memory_order_relaxed);
+  for (size_t k = 0; k < MPTP_SNAPSHOT_LEN / 4; k++) s.w[k].store(words[k], std::memory_order_release);
+  s.seq.store(seq + 2, std::memory_order_release);
+}
+
+static void _snap_update() {
+  char buf[32];
+  for (int i = 0; i < _channelCount; i++) {
+    const MpChannel& c = _channels[i];
+    if (c.active && c.ops->format) _snap_store(_snaps[i], c.ops->format(c.varPtr, buf, sizeof(buf)));
+  }
+}
+
+bool mqttpanel_snapshot(const char* topicSet, char* out, size_t size) {
+  if (!topicSet || !out || size == 0) return false;
+  int i = _find_channel(topicSet, strlen(topicSet));
+  if (i < 0 || !_channels[i].ops->format) return false;
+
+  if (!_dualCore) { // 單核心：變數只有一個核心在用，直接格式化
+    char buf[32];
+    strlcpy(out, _channels[i].ops->format(_channels[i].varPtr, buf, sizeof(buf)), size);
+    return true;
+  }
+
+  const MpSnapSlot& s = _snaps[i];
+  for (int tries = 0; tries < 8; tries++) {
+    uint32_t s1 = s.seq.load(std::memory_order_acquire);
+    if (s1 == 0) return false; // 還沒有副本
+    if (s1 & 1) continue;      // 正在寫
+    uint32_t words[MPTP_SNAPSHOT_LEN / 4];
+    for (size_t k = 0; k < MPTP_SNAPSHOT_LEN / 4; k++) words[k] = s.w[k].load(std::memory_order_acquire);
+    if (s.seq.load(std::memory_order_relaxed) != s1) continue; // 讀到一半被改了，重讀
+    strlcpy(out, (const char*)words, size);
+    return true;
+  }
+  return false;
+}
+
+// 網路核心重新連上之後：重新訂閱 (只讀通道表)，全體廣播交給應用核心
+void mqttpanel_reconnected() {
+  if (!_mqttClient) return;
+  _netUp.store(_mqttClient->connected(), std::memory_order_relaxed);
+  char t[MPTP_MAX_TOPIC_LEN];
+  for (int i = 0; i < _channelCount; i++) {
+    const MpChannel& c = _channels[i];
+    if (!c.active) continue;
+    size_t n = 0;
+    if (!c.absolute) {
+      if (_baseLen + 1 + c.keyLen >= sizeof(t)) continue;
+      memcpy(t, _baseTopic, _baseLen);
+      t[_baseLen] = '/';
+      n = _baseLen + 1;
+    }
+    memcpy(t + n, _key_of(c), c.keyLen);
+    t[n + c.keyLen] = '\0';
+    _mqttClient->subscribe(t);
+  }
+  if (_stateMode) {
+    memcpy(t, _baseTopic, _baseLen);
+    strcpy(t + _baseLen, "/set");
+    _mqttClient->subscribe(t);
+  }
+  if (_dualCore) _syncReq.store(true, std::memory_order_release);
+  else mqttpanel_publish_all_vals();
+}
+
+void mqttpanel_dual_stats(MpDualStats* out) {
+  if (!out) return;
+  out->rxMsgs = _dual.rxMsgs.load(std::memory_order_relaxed);
+  out->rxDropped = _dual.rxDropped.load(std::memory_order_relaxed);
+  out->rxPeakBytes = _dual.rxPeakBytes.load(std::memory_order_relaxed);
+  out->rxLastUs = _dual.rxLastUs.load(std::memory_order_relaxed);
+  out->rxMaxUs = _dual.rxMaxUs.load(std::memory_order_relaxed);
+  out->txMsgs = _dual.txMsgs.load(std::memory_order_relaxed);
+  out->txPeakBytes = _dual.txPeakBytes.load(std::memory_order_relaxed);
+  out->txLastUs = _dual.txLastUs.load(std::memory_order_relaxed);
+  out->txMaxUs = _dual.txMaxUs.load(std::memory_order_relaxed);
+}
+
+// --- Topic & RAM Helpers (Topic 組裝與記憶體報告) ---
+
+// 從通道組出完整的 /val Topic：base + "/" + key，再把 "/set" 換成 "/val"
+// (規則跟以前一樣：沒寫 /set 的 Topic 就在後面加 "_val")
+static bool _channel_val_topic(const MpChannel& c, char* out, size_t size) {
+  size_t n = 0;
+  if (!c.absolute) {
+    if (_baseLen + 1 >= size) return false;
+    memcpy(out, _baseTopic, _baseLen);
+    out[_baseLen] = '/';
+    n = _baseLen + 1;
+  }
+  if (n + c.keyLen + 4 >= size) return false; // 最多多出 "_val" 四個字
+  memcpy(out + n, _key_of(c), c.keyLen);
+  out[n + c.keyLen] = '\0';
+
+  char* ptr = strstr(out + n, "/set"); // 找 "/set" 在哪
+  if (ptr) strcpy(ptr, "/val");        // 替換成 "/val"
+  else strcat(out, "_val");
+  return true;
+}
+
+size_t mqttpanel_ram_per_channel() {
+  // 通道本身 + 它在查表中攤到的格子 + 雙核心用的副本
+  return sizeof(MpChannel) + sizeof(MpRouteSlot) * MP_ROUTE_SLOTS / MPTP_MAX_CHANNELS + sizeof(MpSnapSlot);
+}
+
+size_t mqttpanel_ram_total() {
+  return sizeof(_channels) + sizeof(_routes) + sizeof(_snaps) + sizeof(_baseTopic) + sizeof(_absTopics);
 }
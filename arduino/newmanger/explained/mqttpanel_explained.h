@@ -8,8 +8,40 @@
 #include <PubSubClient.h> // 引入 MQTT 函式庫 (為了能操作 PubSubClient 物件)
 
 // --- Configuration (設定區) ---
+// 用 #ifndef 包起來，讓您可以在編譯參數 (或 include 之前) 自行調大，例如 -DMPTP_MAX_CHANNELS=128
+#ifndef MPTP_MAX_CHANNELS
 #define MPTP_MAX_CHANNELS 24   // 定義最大通道數：最多能註冊 24 個變數 (Switch/Dimmer...)
+#endif
+#ifndef MPTP_MAX_TOPIC_LEN
 #define MPTP_MAX_TOPIC_LEN 120 // 定義 Topic 最大長度：避免 Topic 太長導致記憶體爆掉
+#endif
+#ifndef MPTP_TXQ_BYTES
+#define MPTP_TXQ_BYTES 1024    // 發送佇列 (給 *_pub 用) 的大小，滿了新的訊息會被丟掉並計數
+#endif
+#ifndef MPTP_MAX_VALUE_LEN
+#define MPTP_MAX_VALUE_LEN 128 // 收到的單一個值 (/set 的 payload、CBOR <base>/set 裡的文字) 最多幾個字 (含結尾 '\0')，超過的丟掉並計數
+#endif
+#ifndef MPTP_MAX_KEY_LEN
+#define MPTP_MAX_KEY_LEN 24    // 每個通道存的「相對 Topic」最大長度 (含結尾 '\0')，例如 "dimmer/12/set"
+#endif
+#ifndef MPTP_ABS_TOPIC_BYTES
+#define MPTP_ABS_TOPIC_BYTES 256 // 不在 base 底下的完整 Topic 共用的空間 (每個佔 長度+1)
+#endif
+#ifndef MPTP_RXQ_BYTES
+#define MPTP_RXQ_BYTES 512     // 雙核心模式：收到的 /set 從網路核心交給應用核心的佇列 (要是 2 的次方)
+#endif
+#ifndef MPTP_XQ_BYTES
+#define MPTP_XQ_BYTES 1024     // 雙核心模式：要送的訊息從應用核心交給網路核心的佇列 (要是 2 的次方)
+#endif
+#ifndef MPTP_SNAPSHOT_LEN
+#define MPTP_SNAPSHOT_LEN 32   // mqttpanel_snapshot() 每個通道最多存幾個字 (含結尾 '\0'，4 的倍數)
+#endif
+#ifndef MPTP_MAX_SERIES
+#define MPTP_MAX_SERIES 4      // 最多幾個時間序列通道
+#endif
+#ifndef MPTP_SERIES_WORDS
+#define MPTP_SERIES_WORDS 512  // 所有序列共用的緩衝區 (4-byte word)；每個點佔 1 (時間) + 送的欄位數
+#endif
 
 // --- API (介面區) ---
 // 這邊只宣告函數的「長相」(名字、參數、回傳值)，不寫具體邏輯。
@@ -17,14 +49,275 @@
 class PubSubClient; // 前向宣告 (Forward Declaration)：告訴編譯器「有 PubSubClient 這個類別」，細節之後再說。
 
 // 初始化函式：在 setup() 裡呼叫，把 MQTT client 的指揮權交給這個模組
-void mqttpanel_begin(PubSubClient* client);
+// baseTopic: 所有通道共用的前綴 (例如 "MyProject/1700000000000")。
+//            收到訊息時只會比對一次前綴，剩下的 "type/idx/set" 再去查表。
+//            不給 (NULL) 的話，會從第一個註冊的 Topic 自動推算 (去掉最後三段)。
+void mqttpanel_begin(PubSubClient* client, const char* baseTopic = NULL);
 
 // 迴圈函式：在 loop() 裡呼叫，讓模組能持續檢查有沒有收到 MQTT 訊息
 void mqttpanel_loop();
 
+// --------------------------------------------------------------------------
+// Typed Binding API (型別安全的綁定)
+// mqttpanel_bind(topic, &變數, Policy) 會在「編譯時」依變數型別挑好
+// 解析 (收到字串 -> 變數) 與格式化 (變數 -> 字串) 的函式。
+// 收訊息時直接呼叫它們，不用再執行期判斷「這是 Switch 還是 Dimmer」。
+//
+// 自訂型別：特化 MpCodec<您的型別>，或自己寫一個 Policy 傳進去。
+// Policy 只要有這兩個 static 函式：
+//   static bool parse(const char* msg, size_t len, T& out); // msg 保證以 '\0' 結尾；
+//                                                           // 回傳 false = 忽略這則訊息 (這時不可以改 out)
+//   static const char* format(const T& v, char* buf, size_t size); // 回傳要發送的字串 (可以指向 buf)
+//
+// 範例：
+//   enum Mode { OFF, AUTO, ON };
+//   template <> struct MpCodec<Mode> { ... };
+//   mqttpanel_bind(".../select/1/set", &mode);
+//   mqttpanel_bind(".../dimmer/1/set", &level, MpClamp<0, 255>());
+// --------------------------------------------------------------------------
+
+// 變更偵測用的「影子」：上一次送出時的值 (數字) 或 字串的 hash (其他型別)，固定 4 bytes
+union MpShadow {
+  int32_t i;
+  float f;
+  uint32_t h;
+};
+
+struct MpValue; // 帶型別的值，定義在下面
+
+// 每種 (型別, Policy) 組合各有一份，存在 Flash；通道只記一個指標指過來。
+struct MpBindingOps {
+  void (*apply)(void* var, const char* msg, size_t len);       // 收到 /set -> 更新變數
+  const char* (*format)(const void* var, char* buf, size_t size); // 變數 -> /val 字串 (NULL = 不回報)
+  void (*snapshot)(const void* var, MpShadow* out);             // 記下目前的值 (給 mqttpanel_track 用)
+  bool (*differs)(const void* var, const MpShadow* s, float deadband); // 跟影子比，算不算「有變」
+  void (*pack)(const void* var, MpValue* out, char* buf, size_t size); // 變數 -> 帶型別的值 (二進位 frame 用)
+  void (*unpack)(void* var, const MpValue& v);           // 帶型別的值 -> 變數 (NULL = 轉成文字走 apply)
+};
+
+// 內部註冊函式 (請用下面的 mqttpanel_bind)
+bool mqttpanel_bind_ops(const char* topicSet, void* var, const MpBindingOps* ops);
+
+// 預設的編解碼 (Codec)：bool / int / float / String
+template <typename T> struct MpCodec;
+
+template <> struct MpCodec<bool> {
+  // 只認 "1" 和 "0"，其他內容不動變數
+  static bool parse(const char* msg, size_t len, bool& out) {
+    if (len != 1 || (msg[0] != '0' && msg[0] != '1')) return false;
+    out = (msg[0] == '1');
+    return true;
+  }
+  static const char* format(const bool& v, char*, size_t) { return v ? "1" : "0"; }
+};
+
+template <> struct MpCodec<int> {
+  static bool parse(const char* msg, size_t, int& out) { out = atoi(msg); return true; }
+  static const char* format(const int& v, char* buf, size_t) { return itoa(v, buf, 10); } // buf 至少 12 bytes
+};
+
+template <> struct MpCodec<float> {
+  static bool parse(const char* msg, size_t, float& out) { out = (float)atof(msg); return true; }
+  static const char* format(const float& v, char* buf, size_t) { return dtostrf(v, 1, 2, buf); } // 小數 2 位
+};
+
+template <> struct MpCodec<String> {
+  static bool parse(const char* msg, size_t, String& out) { out = msg; return true; }
+  static const char* format(const String& v, char*, size_t) { return v.c_str(); } // 直接用 String 的內容，不複製
+};
+
+// 限制範圍的 Policy：例如 Dimmer 用 MpClamp<0, 100>
+template <long LO, long HI, typename T = int, typename Base = MpCodec<T> >
+struct MpClamp {
+  static bool parse(const char* msg, size_t len, T& out) {
+    T v;
+    if (!Base::parse(msg, len, v)) return false;
+    if (v < (T)LO) v = (T)LO;
+    if (v > (T)HI) v = (T)HI;
+    out = v;
+    return true;
+  }
+  static const char* format(const T& v, char* buf, size_t size) { return Base::format(v, buf, size); }
+};
+
+// 變更偵測的比較方式
+// 預設：比較「格式化後的字串」的 hash，任何型別都能用 (deadband 不適用)。
+// int / float 特化成直接比數值，才能用 deadband (例如溫度變化超過 0.5 度才回報)。
+uint32_t mqttpanel_text_hash(const char* s);
+
+template <typename T, typename Policy>
+struct MpShadowTraits {
+  static void take(const T& v, MpShadow* out) {
+    char buf[32];
+    out->h = mqttpanel_text_hash(Policy::format(v, buf, sizeof(buf)));
+  }
+  static bool differs(const T& v, const MpShadow* s, float) {
+    MpShadow now;
+    take(v, &now);
+    return now.h != s->h;
+  }
+};
+
+template <typename Policy>
+struct MpShadowTraits<int, Policy> {
+  static void take(const int& v, MpShadow* out) { out->i = v; }
+  static bool differs(const int& v, const MpShadow* s, float deadband) {
+    float d = (float)v - (float)s->i;
+    return v != s->i && (d > deadband || -d > deadband);
+  }
+};
+
+template <typename Policy>
+struct MpShadowTraits<float, Policy> {
+  static void take(const float& v, MpShadow* out) { out->f = v; }
+  static bool differs(const float& v, const MpShadow* s, float deadband) {
+    float d = v - s->f;
+    return v != s->f && (d > deadband || -d > deadband);
+  }
+};
+
+// 帶型別的值 (二進位 frame 用)
+// 文字格式每則都要 itoa / atoi / dtostrf；frame 裡直接放 bool / 整數 / float，
+// 收的時候也直接寫進變數 (float 不會被截成小數 2 位)。
+enum MpValueType : uint8_t { MP_VAL_NONE = 0, MP_VAL_BOOL, MP_VAL_INT, MP_VAL_FLOAT, MP_VAL_TEXT };
+
+struct MpValue {
+  MpValueType type;
+  union {
+    bool b;
+    int32_t i;
+    float f;
+  };
+  const char* s;   // TEXT：指向 frame 或變數裡的字 (不一定以 '\0' 結尾，長度看 len)
+  size_t len;
+};
+
+// 非文字的值轉成跟 /set 一樣的字串 ("1"/"0"、整數、小數 2 位)；TEXT 直接回傳 s (沒有結尾 '\0')
+const char* mqttpanel_value_text(const MpValue& v, char* buf, size_t size);
+
+// 預設：一律當文字，走 Policy 的 format / parse (自訂型別不用改就能用)
+template <typename T, typename Policy>
+struct MpTextValue {
+  static void pack(const T& v, MpValue* out, char* buf, size_t size) {
+    out->type = MP_VAL_TEXT;
+    out->s = Policy::format(v, buf, size);
+    out->len = strlen(out->s);
+  }
+  static bool unpack(const MpValue& v, T& out) {
+    char buf[32];
+    const char* text = mqttpanel_value_text(v, buf, sizeof(buf));
+    size_t len = v.type == MP_VAL_TEXT ? v.len : strlen(text);
+    if (len >= MPTP_MAX_VALUE_LEN) return false; // 跟 router 一樣：太長就不收，不截斷
+    char msg[MPTP_MAX_VALUE_LEN]; // 補上結尾 '\0' 再交給 Policy
+    memcpy(msg, text, len);
+    msg[len] = '\0';
+    return Policy::parse(msg, len, out);
+  }
+};
+
+// 要在 frame 裡用數字表示，就特化這個 (bool / int / float / MpClamp 已經做好了)
+template <typename T, typename Policy>
+struct MpValueTraits : MpTextValue<T, Policy> {};
+
+template <>
+struct MpValueTraits<bool, MpCodec<bool> > {
+  static void pack(const bool& v, MpValue* out, char*, size_t) { out->type = MP_VAL_BOOL; out->b = v; }
+  static bool unpack(const MpValue& v, bool& out) {
+    if (v.type == MP_VAL_BOOL) { out = v.b; return true; }
+    if (v.type == MP_VAL_INT) { // 跟文字一樣只認 0 和 1
+      if (v.i != 0 && v.i != 1) return false;
+      out = (v.i == 1);
+      return true;
+    }
+    return MpTextValue<bool, MpCodec<bool> >::unpack(v, out);
+  }
+};
+
+template <>
+struct MpValueTraits<int, MpCodec<int> > {
+  static void pack(const int& v, MpValue* out, char*, size_t) { out->type = MP_VAL_INT; out->i = v; }
+  static bool unpack(const MpValue& v, int& out) {
+    if (v.type == MP_VAL_INT) out = (int)v.i;
+    else if (v.type == MP_VAL_FLOAT) out = (int)v.f; // 跟 atoi("2.5") 一樣捨去小數
+    else if (v.type == MP_VAL_BOOL) out = v.b ? 1 : 0;
+    else return MpTextValue<int, MpCodec<int> >::unpack(v, out);
+    return true;
+  }
+};
+
+template <>
+struct MpValueTraits<float, MpCodec<float> > {
+  static void pack(const float& v, MpValue* out, char*, size_t) { out->type = MP_VAL_FLOAT; out->f = v; }
+  static bool unpack(const MpValue& v, float& out) {
+    if (v.type == MP_VAL_FLOAT) out = v.f;
+    else if (v.type == MP_VAL_INT) out = (float)v.i;
+    else if (v.type == MP_VAL_BOOL) out = v.b ? 1.0f : 0.0f;
+    else return MpTextValue<float, MpCodec<float> >::unpack(v, out);
+    return true;
+  }
+};
+
+template <long LO, long HI, typename T, typename Base>
+struct MpValueTraits<T, MpClamp<LO, HI, T, Base> > {
+  static void pack(const T& v, MpValue* out, char* buf, size_t size) { MpValueTraits<T, Base>::pack(v, out, buf, size); }
+  static bool unpack(const MpValue& v, T& out) {
+    T x;
+    if (!MpValueTraits<T, Base>::unpack(v, x)) return false;
+    if (x < (T)LO) x = (T)LO;
+    if (x > (T)HI) x = (T)HI;
+    out = x;
+    return true;
+  }
+};
+
+// 把 (T, Policy) 轉成 MpBindingOps 的橋接 (編譯器會幫每種組合各產生一份)
+template <typename T, typename Policy>
+struct MpBindingThunk {
+  // 直接解析進使用者的變數 (String 可以沿用原本的 buffer，不用多配置一次)
+  static void apply(void* var, const char* msg, size_t len) {
+    Policy::parse(msg, len, *static_cast<T*>(var));
+  }
+  static const char* format(const void* var, char* buf, size_t size) {
+    return Policy::format(*static_cast<const T*>(var), buf, size);
+  }
+  static void snapshot(const void* var, MpShadow* out) {
+    MpShadowTraits<T, Policy>::take(*static_cast<const T*>(var), out);
+  }
+  static bool differs(const void* var, const MpShadow* s, float deadband) {
+    return MpShadowTraits<T, Policy>::differs(*static_cast<const T*>(var), s, deadband);
+  }
+  static void pack(const void* var, MpValue* out, char* buf, size_t size) {
+    MpValueTraits<T, Policy>::pack(*static_cast<const T*>(var), out, buf, size);
+  }
+  static void unpack(void* var, const MpValue& v) {
+    MpValueTraits<T, Policy>::unpack(v, *static_cast<T*>(var));
+  }
+  static const MpBindingOps ops;
+};
+
+template <typename T, typename Policy>
+const MpBindingOps MpBindingThunk<T, Policy>::ops = {
+  &MpBindingThunk<T, Policy>::apply, &MpBindingThunk<T, Policy>::format,
+  &MpBindingThunk<T, Policy>::snapshot, &MpBindingThunk<T, Policy>::differs,
+  &MpBindingThunk<T, Policy>::pack, &MpBindingThunk<T, Policy>::unpack
+};
+
+template <typename T, typename Policy = MpCodec<T> >
+bool mqttpanel_bind(const char* topicSet, T* var, Policy = Policy()) {
+  return mqttpanel_bind_ops(topicSet, var, &MpBindingThunk<T, Policy>::ops);
+}
+
 // --------------------------------------------------------------------------
 // Subscription API (訂閱/註冊通道)
 // 這些函式是用來把您的變數 (bool, int, String) 跟一個 Topic 綁定在一起。
+// (其實都是 mqttpanel_bind 的簡寫)
+//
+// Topic 長度限制：
+//   - 在 base 底下的 Topic 只存相對路徑 ("dimmer/12/set")，最多 MPTP_MAX_KEY_LEN - 1 個字
+//   - 不在 base 底下的 (例如 "home/livingroom/lamp/1/set") 整串存進共用空間，
+//     最多 MPTP_MAX_TOPIC_LEN - 1 個字，全部加起來不超過 MPTP_ABS_TOPIC_BYTES
+//   放不下就回傳 false (不會默默截斷)；mqttpanel_series() 的 Topic 規則也一樣
+// 收到的值最多 MPTP_MAX_VALUE_LEN - 1 個字，超過的整則丟掉 (不截斷)，記在 mqttpanel_rx_dropped()
 // --------------------------------------------------------------------------
 
 // 註冊開關 (Switch)
@@ -48,9 +341,14 @@ bool mqttpanel_text_sub(const char* topicSet, String* varString);
 // 這是特殊的，沒有綁定變數。收到訊號後會自動觸發「全體廣播」。
 bool mqttpanel_sync_sub(const char* topicSet);
 
+// 因為太長 (超過 MPTP_MAX_VALUE_LEN - 1 個字) 被丟掉的值，任何核心都能呼叫
+uint32_t mqttpanel_rx_dropped();
+
 // --------------------------------------------------------------------------
 // Publish API (發布/回報狀態)
 // 當您的變數改變時 (例如手動按了開關)，呼叫這些函式通知手機 App。
+// 注意：這些函式只會「排進發送佇列」馬上返回，真正送出是在 mqttpanel_loop() 裡。
+// 回傳 false = 沒連線或佇列滿了 (會記在 MpTxStats.dropped)。
 // --------------------------------------------------------------------------
 
 bool mqttpanel_switch_pub(const char* topicVal, bool varBool);
@@ -61,6 +359,237 @@ bool mqttpanel_text_pub(const char* topicVal, const String& varString);
 
 // 全體廣播：強制把目前所有註冊的變數數值，全部發送一次給 MQTT Broker。
 // 通常配合 Sync 功能使用 (App 一連線就叫 ESP32 全部報數)。
+// 只是把每個通道標記成「待發送」，不會卡住；數值在真正送出時才讀取 (永遠是最新的)。
 void mqttpanel_publish_all_vals();
 
+// --------------------------------------------------------------------------
+// Change Tracking (變更偵測，只送有變的)
+// 以前的寫法是用計時器每隔幾秒 publish_all_vals()，沒變的值也一直重送。
+// 開啟追蹤後，mqttpanel_loop() 每圈會把變數跟「上次送出的值」比較，
+// 有變的通道才排進發送佇列 (跟全體廣播用同一個機制，送的當下才讀值)。
+// --------------------------------------------------------------------------
+
+// topicSet: 註冊時用的 Topic (例如 ".../number/1/set")
+// minIntervalMs: 同一個通道兩次發送至少隔多久 (0 = 不限制，最多 65535ms)
+// deadband: 數值 (int/float) 變化要「超過」這麼多才算有變 (0 = 有變就送)；其他型別忽略
+// 開啟後第一圈會先送一次目前的值。回傳 false = 找不到這個通道 (或它是 Sync)。
+bool mqttpanel_track(const char* topicSet, uint16_t minIntervalMs = 0, float deadband = 0);
+
+// 所有已註冊的通道都用同一組設定 (之後個別呼叫 mqttpanel_track 可以覆蓋)
+void mqttpanel_track_all(uint16_t minIntervalMs = 0, float deadband = 0);
+
+// --------------------------------------------------------------------------
+// State Mode (整包狀態模式，選用)
+// 平常全體廣播是「每個通道各送一則 /val」，N 個通道就是 N 則訊息，
+// 每則都要帶完整的 Topic。開啟後改成只送一則 JSON 到 <base>/state：
+//   {"switch/1":"1","dimmer/2":"50","text/4":"Hello"}
+// 同時會訂閱 <base>/set，App 可以用同樣的格式一次設定很多個通道。
+// (變更偵測 mqttpanel_track 還是照舊一個通道送一則 /val，因為通常只有少數幾個在變)
+// --------------------------------------------------------------------------
+
+// 在註冊完通道之後呼叫 (要先知道 base 前綴)。回傳 false = 還沒有 base 或沒有 client。
+bool mqttpanel_state_mode(bool enable);
+
+// --------------------------------------------------------------------------
+// Binary Frame (二進位整包格式，選用)
+// State 模式預設還是 JSON 文字 (跟以前的 App 相容)。切成 CBOR (RFC 8949) 之後：
+//   <base>/state 改送一個 CBOR map，值直接帶型別：
+//     {"switch/1": true, "dimmer/2": 50, "number/1": 21.5, "text/4": "Hello"}
+//   變更偵測 (mqttpanel_track) 有變的通道也打包成「一則」送到 <base>/state，
+//     裡面只有有變的那幾個 key，App 要「合併」進目前的狀態 (不是整個取代)。
+//     (不在 base 底下的通道還是各送各的 /val)
+// <base>/set 兩種都收：第一個 byte 是 CBOR map 就當 CBOR，不然當 JSON。
+// 編碼、解碼都不配置記憶體；App 端用任何 CBOR 函式庫都能解。
+// --------------------------------------------------------------------------
+
+enum MpFrameFormat : uint8_t { MP_FRAME_JSON = 0, MP_FRAME_CBOR = 1 };
+
+// 選 <base>/state 的格式 (預設 JSON)。跟 state_mode 一樣在 setup() 設好。
+void mqttpanel_state_format(MpFrameFormat fmt);
+
+// 自己組 CBOR frame (例如測試、或另一台板子當遙控器送 <base>/set)
+// buf = NULL 只量長度；out 不是 NULL 就直接串流寫出去 (先累積一小段再寫，記得最後 flush())
+struct MpFrameWriter {
+  MpFrameWriter(uint8_t* buf, size_t cap, Print* out = NULL);
+  void map(uint32_t n);                      // map 開頭：後面接 n 組 key / value
+  void key(const char* k, size_t len);
+  void value(const MpValue& v);
+  void add(const char* k, bool v);
+  void add(const char* k, int v);
+  void add(const char* k, float v);
+  void add(const char* k, const char* text);
+  void array(uint32_t n);                    // 陣列開頭：後面接 n 個 value
+  void uint(uint32_t n);                     // 正整數 (超過 int32 的，例如 millis())
+  void raw(const void* p, size_t n);         // 原樣寫進去 (例如 JSON 文字)
+  void flush();                              // 串流模式：把還沒寫出去的寫完
+  size_t size() const { return _len; }       // 總共 (要) 寫幾 bytes
+  bool ok() const { return !_overflow; }     // false = buf 放不下
+private:
+  void _head(uint8_t major, uint32_t n);
+  void _put(const void* p, size_t n);
+  uint8_t* _buf;
+  size_t _cap;
+  size_t _len;
+  Print* _out;
+  bool _overflow;
+  uint8_t _stage[64];
+  uint8_t _staged;
+};
+
+// 拆 CBOR frame：一組一組讀出來，key / 文字值都直接指向原本的 buffer
+struct MpFrameReader {
+  MpFrameReader(const uint8_t* p, size_t len);
+  bool next(const char** key, size_t* keyLen, MpValue* v); // false = 讀完了 (或格式錯誤，看 error())
+  bool error() const { return _error; }
+  uint32_t count() const { return _count; }
+private:
+  bool _head(uint8_t* major, uint8_t* info, uint64_t* n);
+  const uint8_t* _p;
+  size_t _len;
+  size_t _pos;
+  uint32_t _count;
+  uint32_t _index;
+  bool _error;
+};
+
+// --------------------------------------------------------------------------
+// Time Series (時間序列，折線圖用，選用)
+// 感測器 100 Hz 取樣、每個點呼叫一次 mqttpanel_number_pub，就是每秒 100 則訊息，
+// 每則都帶完整 Topic，佇列跟 TCP 都吃不消。時間序列通道先把點放進固定大小的
+// 環狀緩衝區 (從 MPTP_SERIES_WORDS 的共用池切出來，不用 heap)，累積到 flushSamples 個
+// 或最舊的點放了 flushMs 毫秒，才打包成「一則」送到 topicVal：
+//   {"t":123400,"dt":10,"q":0.01,"v":[2153,2,-1,0,3]}
+//   t  = 第一個點的時間 (毫秒)
+//   dt = 相鄰兩點的間隔：全部一樣就是一個數字，不一樣就是陣列 (第一個是 0)
+//   q  = 解析度：值先四捨五入成 q 的整數倍，v 第一個是本身，後面每個是跟前一個的差
+//   還原：x0 = v[0]，xi = x(i-1) + v[i]，值 = xi * q；時間 ti = t(i-1) + dt
+// 差值通常只有一兩位數，JSON 每個點 2~4 個字；CBOR 模式 (mqttpanel_state_format) 送
+// 同樣 key 的 CBOR map，每個點 1~2 bytes。
+//
+// 降採樣 (windowMs > 0)：每個窗的點合成一個，依 reduce 送 "v" (平均) / "lo" (最小) / "hi" (最大)
+// (每個陣列各自做差值)，再多一個 "w":windowMs；t / dt 是每個窗第一個點的時間。
+// 沒連線時點照樣收，緩衝區滿了丟最舊的 (記在 dropped)，連上後再補送。
+// 跟 *_pub 一樣：雙核心時只能在應用核心 (loop()) 呼叫。
+// --------------------------------------------------------------------------
+
+enum MpReduce : uint8_t { MP_REDUCE_MEAN = 1, MP_REDUCE_MIN = 2, MP_REDUCE_MAX = 4 };
+
+struct MpSeriesConfig {
+  uint16_t capacity = 64;          // 緩衝區放幾個點
+  uint16_t flushSamples = 32;      // 累積幾個點就送 (最多 capacity)
+  uint16_t flushMs = 1000;         // 最舊的點放了多久就送 (0 = 只看點數)
+  float resolution = 0.01f;        // 量化解析度 q
+  uint16_t windowMs = 0;           // 降採樣的窗 (0 = 每個點都送)
+  uint8_t reduce = MP_REDUCE_MEAN; // 降採樣時送哪些 (可以 | 起來，例如 MP_REDUCE_MIN | MP_REDUCE_MAX)
+};
+
+// 註冊一個時間序列：回傳編號 (0 起算)，-1 = 滿了 / 共用池不夠 / Topic 太長
+int mqttpanel_series(const char* topicVal, const MpSeriesConfig& cfg = MpSeriesConfig());
+
+// 加一個點 (時間 = millis())；_at 版自己給時間 (例如感測器的時間戳，要遞增)
+// 只是放進緩衝區，真正送出在 mqttpanel_loop()。回傳 false = 編號不對或值是 NaN。
+bool mqttpanel_series_add(int id, float v);
+bool mqttpanel_series_add_at(int id, uint32_t tMs, float v);
+
+// 不等觸發條件，下一圈就送 (還沒結束的降採樣窗也一起收掉)；id = -1 是全部
+void mqttpanel_series_flush(int id = -1);
+
+struct MpSeriesStats {
+  uint32_t samples;       // 總共加了幾個點
+  uint32_t points;        // 放進緩衝區的點 (降採樣後)
+  uint32_t batches;       // 送了幾則
+  uint32_t bytes;         // payload 總共幾 bytes
+  uint32_t dropped;       // 緩衝區滿了丟掉的點
+  uint16_t depth;         // 現在緩衝區裡有幾個點
+  uint16_t peak;          // 最多曾經有幾個
+};
+bool mqttpanel_series_stats(int id, MpSeriesStats* out);
+
+// --------------------------------------------------------------------------
+// Outbound Queue (發送佇列)
+// mqttpanel_loop() 每一圈最多送 maxMsgs 則 / maxBytes bytes，剩下的留到下一圈。
+// 以前是每則 delay(10)，24 個通道會卡住整個程式 240ms；現在改成分批慢慢送。
+// --------------------------------------------------------------------------
+
+// 每圈的發送額度 (預設 4 則 / 512 bytes)
+void mqttpanel_tx_budget(uint8_t maxMsgs, uint16_t maxBytes);
+
+// (選用) 把底層的 WiFiClient 交給模組：送之前會看 availableForWrite()，
+// TCP 送出緩衝區不夠放下一則就先停，等下一圈。
+// 有些核心沒有實作 availableForWrite() (永遠回 0)，這種情況會自動忽略。
+void mqttpanel_tx_client(Client* sock);
+
+struct MpTxStats {
+  uint16_t depth;         // 現在佇列裡還有幾則 (含待發送的通道)
+  uint16_t peakDepth;     // 最高曾經到幾則
+  uint32_t enqueued;      // 總共排進幾則
+  uint32_t sent;          // 總共送出幾則
+  uint32_t dropped;       // 因為佇列滿 / 沒連線 / 太長 被丟掉的
+  uint32_t lastDrainMs;   // 上一次從「有東西」到「清空」花了多久
+  uint32_t maxDrainMs;    // 最久的一次
+};
+void mqttpanel_tx_stats(MpTxStats* out);
+
+// --------------------------------------------------------------------------
+// Dual-Core Mode (ESP32 雙核心模式，選用)
+// 以前的範例把 mqttpanel_loop() 丟到 Core 0 的 networkTask，loop() 在 Core 1
+// 同時讀寫同一批變數，完全沒有保護：String 被兩個核心一起改，heap 會壞掉。
+//
+// 開啟後兩個核心各做各的，中間用兩條「單一生產者/單一消費者」的無鎖佇列交接：
+//   Core 0 (網路)  mqttpanel_loop()      收 MQTT -> 把 /set 丟進 RX 佇列
+//                                         從 TX 佇列拿出來 -> 真正送出
+//   Core 1 (應用)  mqttpanel_app_loop()  從 RX 佇列拿出來 -> 寫進您的變數
+//                                         變更偵測 / 全體廣播 / *_pub -> 丟進 TX 佇列
+// 所以綁定的變數只會在 Core 1 被改，loop() 裡直接讀寫它們是安全的。
+//
+// 規則：
+//  1. 註冊通道、track、state_mode、tx_budget 都在 setup() 做完，再開啟雙核心、建立 Task。
+//  2. *_pub、mqttpanel_publish_all_vals()、mqttpanel_tx_stats() 只能在應用核心 (loop()) 呼叫。
+//     (MpTxStats 的 sent 在雙核心時是「已交給網路核心」的數量)
+//  3. 其他 Task / 核心要讀變數，用 mqttpanel_snapshot()，不要直接讀。
+// --------------------------------------------------------------------------
+
+// 在 setup() 最後呼叫 (建立網路 Task 之前)。關掉 = 回到單核心，全部在 mqttpanel_loop() 做。
+void mqttpanel_dual_core(bool enable);
+
+// 應用核心每圈呼叫一次 (放在 loop() 的最前面)。沒開雙核心時什麼都不做，可以放心留著。
+void mqttpanel_app_loop();
+
+// 網路核心重新連上 MQTT 之後呼叫：重新訂閱所有通道，並排一次全體廣播
+// (雙核心時廣播交給應用核心做，這個函式本身不會碰到變數)。
+void mqttpanel_reconnected();
+
+// 任何核心都能呼叫：讀出通道目前的值 (格式跟 /val 一樣)，保證不會讀到寫一半的值。
+// 雙核心時讀的是應用核心每圈更新的副本 (最多 MPTP_SNAPSHOT_LEN-1 個字)。
+// 回傳 false = 找不到通道 / 它是 Sync / 一直剛好碰到正在更新 (再試一次就好)。
+bool mqttpanel_snapshot(const char* topicSet, char* out, size_t size);
+
+// 型別版：用同一個 Policy 把副本解析回變數型別
+// 例如：int level; mqttpanel_snapshot_as(".../dimmer/1/set", &level);
+template <typename T, typename Policy = MpCodec<T> >
+bool mqttpanel_snapshot_as(const char* topicSet, T* out, Policy = Policy()) {
+  char buf[MPTP_SNAPSHOT_LEN];
+  return mqttpanel_snapshot(topicSet, buf, sizeof(buf)) && Policy::parse(buf, strlen(buf), *out);
+}
+
+struct MpDualStats {
+  uint32_t rxMsgs;        // Core 0 -> Core 1：交接了幾則 /set
+  uint32_t rxDropped;     // RX 佇列滿了被丟掉的 (mqttpanel_app_loop() 太久沒跑)
+  uint32_t rxPeakBytes;   // RX 佇列最多用到幾 bytes
+  uint32_t rxLastUs;      // 上一則從收到到寫進變數花了多久 (微秒)
+  uint32_t rxMaxUs;       // 最久的一次
+  uint32_t txMsgs;        // Core 1 -> Core 0：交接了幾則要送的訊息
+  uint32_t txPeakBytes;   // TX 佇列最多用到幾 bytes (滿了會留在發送佇列等，不會丟)
+  uint32_t txLastUs;      // 上一則從排進去到被網路核心送出花了多久
+  uint32_t txMaxUs;
+};
+void mqttpanel_dual_stats(MpDualStats* out); // 任何核心都能呼叫
+
+// --------------------------------------------------------------------------
+// RAM Report (記憶體用量)
+// 規劃大型面板時用：總用量 ≈ mqttpanel_ram_per_channel() * MPTP_MAX_CHANNELS
+// --------------------------------------------------------------------------
+size_t mqttpanel_ram_per_channel(); // 每個通道佔用的 bytes (含查表)
+size_t mqttpanel_ram_total();       // 整張通道表 + 查表 + 前綴 的靜態 RAM
+
 #endif // 結束 #ifndef 的範圍
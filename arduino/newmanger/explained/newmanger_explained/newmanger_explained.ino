@@ -42,9 +42,14 @@ void setup() {
   int port = atoi(mqtt_port);
   client.setServer(mqtt_server, port);
 
-  // 3. 啟動雙核心任務 (僅限 ESP32)
+  // 3. 註冊通道 (只做一次；之後斷線重連只要 mqttpanel_reconnected())
+  setupMqttChannels();
+
+  // 4. 啟動雙核心任務 (僅限 ESP32)
   #ifdef ESP32
     Serial.println("[System] ESP32 Dual-Core Mode: Active");
+    // 一定要在建立 Task 之前開啟：之後變數只會在 Core 1 (loop) 被改
+    mqttpanel_dual_core(true);
     // 建立一個 Task 叫做 "NetTask"，跑在核心 0
     xTaskCreatePinnedToCore(networkTask, "NetTask", 8192, NULL, 1, NULL, 0);
   #else
@@ -55,6 +60,9 @@ void setup() {
 // --- Main Loop (主程式迴圈) ---
 // 這裡跑在核心 1 (Core 1)
 void loop() {
+  // 0. 把 Core 0 收到的指令寫進變數、把要回報的交給 Core 0 (ESP8266 上什麼都不做)
+  mqttpanel_app_loop();
+
   // 1. 每一圈都要檢查系統事件 (例如有沒有人長按 Reset 鍵)
   sys_loop();
 
@@ -68,6 +76,7 @@ void loop() {
 
   // --- USER LOGIC HERE (您的程式碼) ---
   // 這裡變得超乾淨！！！
+  // 變數只會在這個核心被改，可以直接讀寫 (其他 Task 要讀請用 mqttpanel_snapshot)。
   // 您可以直接寫您的邏輯，例如：
   
   /*
@@ -115,7 +124,7 @@ void mqttReconnect() {
     
     if (client.connect(clientId.c_str())) {
       Serial.println("done.");
-      setupMqttChannels(); // 【重點】連上後，立刻重新註冊所有變數
+      mqttpanel_reconnected(); // 【重點】連上後重新訂閱所有通道，並回報一次現況
     } else {
       Serial.print("fail rc=");
       Serial.print(client.state());
@@ -129,7 +138,7 @@ void mqttReconnect() {
   }
 }
 
-// 設定 MQTT 通道
+// 設定 MQTT 通道 (setup() 裡呼叫一次)
 void setupMqttChannels() {
   mqttpanel_begin(&client); // 啟動面板
   
@@ -144,7 +153,6 @@ void setupMqttChannels() {
   mqttpanel_text_sub((prefix + "/text/1/set").c_str(), &demoText);
   mqttpanel_sync_sub((prefix + "/sync/1/set").c_str());
   
-  // 註冊完立刻回報一次現況
-  mqttpanel_publish_all_vals();
+  // 還沒連上，訂閱會在 mqttpanel_reconnected() 補做
   Serial.println("[MP] Channels Ready");
 }
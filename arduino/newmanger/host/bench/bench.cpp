@@ -0,0 +1,55 @@
+#include "bench.h"
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Count every operator new against the same counters String uses.
+void* operator new(size_t size) {
+  host::alloc_count++;
+  host::alloc_bytes += size;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+static bool s_quick = false;
+static unsigned long s_iters = 0;
+static int s_failures = 0;
+
+void bench_init(int argc, char** argv, const char* title) {
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--quick")) s_quick = true;
+    else if (!strncmp(argv[i], "--iters=", 8)) s_iters = strtoul(argv[i] + 8, nullptr, 10);
+  }
+  printf("== %s%s ==\n", title, s_quick ? " (quick)" : "");
+  printf("%-44s %12s %12s %10s %12s\n", "bench", "msgs/sec", "ns/msg", "allocs/msg", "bytes/msg");
+}
+
+unsigned long bench_iters(unsigned long full) {
+  if (s_iters) return s_iters;
+  if (s_quick) return full / 100 ? full / 100 : 1;
+  return full;
+}
+
+void bench_report(const BenchResult& r) {
+  printf("%-44s %12.0f %12.1f %10.2f %12.1f\n", r.name, r.opsPerSec, r.nsPerOp, r.allocsPerOp, r.bytesPerOp);
+  fflush(stdout);
+}
+
+void bench_check(bool ok, const char* what) {
+  if (ok) return;
+  s_failures++;
+  fprintf(stderr, "CHECK FAILED: %s\n", what);
+}
+
+int bench_finish() {
+  if (s_failures) fprintf(stderr, "%d check(s) failed\n", s_failures);
+  return s_failures ? 1 : 0;
+}
@@ -0,0 +1,49 @@
+#ifndef MP_BENCH_H
+#define MP_BENCH_H
+// Tiny benchmark harness for the host build.
+// Every bench prints one row: msgs/sec, ns/msg, allocs/msg, alloc bytes/msg.
+// Allocations cover String buffers (host::tracked_realloc) and operator new.
+
+#include <stdint.h>
+#include <chrono>
+
+#include "host_hooks.h"
+
+struct BenchResult {
+  const char* name;
+  unsigned long iters;
+  double nsPerOp;
+  double opsPerSec;
+  double allocsPerOp;
+  double bytesPerOp;
+};
+
+// Parses --quick (smoke run for ctest) and --iters=N.
+void bench_init(int argc, char** argv, const char* title);
+// Scales a full-run iteration count down in --quick mode.
+unsigned long bench_iters(unsigned long full);
+void bench_report(const BenchResult& r);
+// Records a failed expectation; bench_finish() then returns non-zero.
+void bench_check(bool ok, const char* what);
+int bench_finish();
+
+template <typename F>
+BenchResult bench_run(const char* name, unsigned long iters, F&& fn) {
+  for (unsigned long i = 0; i < iters / 10 + 1; i++) fn(i); // warm-up
+  unsigned long a0 = host::alloc_count, b0 = host::alloc_bytes;
+  auto t0 = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < iters; i++) fn(i);
+  auto t1 = std::chrono::steady_clock::now();
+  double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+  BenchResult r;
+  r.name = name;
+  r.iters = iters;
+  r.nsPerOp = ns / (double)iters;
+  r.opsPerSec = r.nsPerOp > 0 ? 1e9 / r.nsPerOp : 0;
+  r.allocsPerOp = (double)(host::alloc_count - a0) / (double)iters;
+  r.bytesPerOp = (double)(host::alloc_bytes - b0) / (double)iters;
+  bench_report(r);
+  return r;
+}
+
+#endif
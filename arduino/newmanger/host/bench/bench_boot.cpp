@@ -0,0 +1,121 @@
+// Fast boot (mqttpanel_fast_boot) in mqttpanel.cpp: boot-phase timing of a
+// cold boot (config.json + WiFiManager scan + DHCP) vs. a warm boot from the
+// binary record, and the fallbacks when the cache no longer matches.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <LittleFS.h>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static char mqtt_server[40] = "";
+static char mqtt_port[6] = "";
+static char mqtt_topic[40] = "";
+
+static void rx_raw(const char*, size_t, const uint8_t*, size_t) {}
+
+static void writeConfigJson() {
+  LittleFS.begin();
+  File f = LittleFS.open("/config.json", "w");
+  f.print("{\"mqtt_server\":\"192.168.1.10\",\"mqtt_port\":\"1883\",\"mqtt_topic\":\"MyProject/1700000000000\"}");
+  f.close();
+}
+
+// Power cycle: drop Wi-Fi + MQTT, wipe the RAM copies, run setup() + loop()
+// until the first publish would go out.
+static MpBootReport reboot() {
+  client.disconnect();
+  host::wifi_set_connected(false);
+  mqtt_server[0] = mqtt_port[0] = mqtt_topic[0] = 0;
+  mqttpanel_begin(&client, rx_raw, mqtt_server, mqtt_port, mqtt_topic, 3, 10, 0, 4, 20);
+  for (int i = 0; i < 100 && !client.connected(); i++) mqttpanel_loop();
+  MpBootReport r;
+  mqttpanel_boot_report(&r);
+  return r;
+}
+
+static void print(const char* what, const MpBootReport& r) {
+  printf("%-28s fs %4u ms  config %4u ms (%s)  wifi %5u ms (%s)  mqtt %3u ms  total %5u ms\n", what,
+         (unsigned)r.fsMountMs, (unsigned)r.configMs, r.configCached ? "bin " : "json",
+         (unsigned)r.wifiMs, r.wifiCached ? "cached" : "scan", (unsigned)r.mqttMs, (unsigned)r.totalMs);
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp (fast boot)");
+
+  // Typical ESP numbers: full scan over all channels, association, DHCP, TCP.
+  host::clock_manual(true);
+  host::wifi_set_timing(2200, 300, 900);
+  host::tcp_set_broker(true, 30);
+  writeConfigJson();
+  mqttpanel_fast_boot(true);
+
+  MpBootReport cold = reboot();
+  print("cold boot (no record)", cold);
+  bench_check(!cold.configCached && !cold.wifiCached, "first boot takes the normal path");
+  bench_check(!strcmp(mqtt_server, "192.168.1.10"), "config.json loaded on cold boot");
+  bench_check(LittleFS.host_file_size("/mp_boot.bin") > 0, "cold boot writes the binary record");
+  {
+    File f = LittleFS.open("/mp_boot.bin", "r");
+    uint8_t buf[512];
+    size_t n = f.read(buf, sizeof(buf));
+    f.close();
+    bench_check(n > 0 && !memmem(buf, n, "password", 8), "record does not hold the WiFi password");
+  }
+
+  MpBootReport warm = reboot();
+  print("warm boot (record)", warm);
+  bench_check(warm.configCached && warm.wifiCached, "warm boot uses the record and the cached AP");
+  bench_check(!strcmp(mqtt_topic, "MyProject/1700000000000"), "config restored from the record");
+  bench_check(warm.totalMs * 2 < cold.totalMs && warm.wifiMs >= 900, "warm boot skips the scan, still asks DHCP");
+
+  // Opt-in IP reuse (router reserves the address): no DHCP either
+  mqttpanel_fast_boot(true, true);
+  MpBootReport reuse = reboot();
+  print("warm boot, reused IP", reuse);
+  bench_check(reuse.wifiCached && reuse.wifiMs < 900 && client.connected(), "reuseIp skips DHCP");
+  bench_check(reuse.totalMs * 3 < cold.totalMs, "and reaches MQTT at least 3x sooner");
+  mqttpanel_fast_boot(true);
+
+  // AP replaced (new BSSID): cached join fails, falls back to scan, record refreshed.
+  const uint8_t newBssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+  host::wifi_set_ap("HostAP", "password", newBssid, 11);
+  MpBootReport moved = reboot();
+  print("warm boot, AP replaced", moved);
+  bench_check(moved.configCached && !moved.wifiCached && client.connected(), "stale BSSID falls back to a scan");
+  MpBootReport again = reboot();
+  print("next boot", again);
+  bench_check(again.wifiCached, "record follows the new AP");
+
+  // Corrupt the record: CRC mismatch -> config.json.
+  {
+    File f = LittleFS.open("/mp_boot.bin", "r");
+    size_t n = f.size();
+    uint8_t buf[512];
+    f.read(buf, n);
+    f.close();
+    buf[20] ^= 0xFF;
+    f = LittleFS.open("/mp_boot.bin", "w");
+    f.write(buf, n);
+    f.close();
+  }
+  MpBootReport corrupt = reboot();
+  print("warm boot, corrupted record", corrupt);
+  bench_check(!corrupt.configCached && !strcmp(mqtt_server, "192.168.1.10"), "CRC mismatch falls back to config.json");
+
+  // --- CPU cost of begin() itself (no simulated radio time) ---
+  host::clock_manual(false);
+  host::wifi_set_timing(0, 0, 0);
+  host::tcp_set_broker(true, 0);
+  const unsigned long N = bench_iters(100000);
+  mqttpanel_fast_boot(false);
+  bench_run("begin: config.json + autoConnect", N, [&](unsigned long) { reboot(); });
+  mqttpanel_fast_boot(true);
+  reboot(); // rebuild the record
+  bench_run("begin: binary record + cached AP", N, [&](unsigned long) { reboot(); });
+
+  return bench_finish();
+}
@@ -0,0 +1,171 @@
+// Button / LED engine in mqttpanel.cpp on the simulated clock and GPIO:
+// contact bounce filtering, click / portal / factory events and their hold
+// times, LED pattern timing, the boot reset (one read in mqttpanel_begin,
+// before the WiFi step, instead of the old 2 s wait), and what an idle mqttpanel_loop() costs now that the pin
+// is no longer read on every pass.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <vector>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient net;
+static PubSubClient client(net);
+static char mqtt_server[40] = "192.168.1.10";
+static char mqtt_port[6] = "1883";
+static char mqtt_topic[40] = "site/7";
+
+static const uint8_t BTN = 0, LED = 4;
+static const int PORTAL_SEC = 3, FACTORY_SEC = 10;
+
+static std::vector<MpButtonEvent> events;
+static std::vector<unsigned long> eventAt;
+static bool wifiAtEvent = false;
+static bool on_button(const MpButtonEvent& ev, void*) {
+  events.push_back(ev);
+  eventAt.push_back(millis());
+  wifiAtEvent = WiFi.status() == WL_CONNECTED;
+  return true; // the defaults would open the portal / restart
+}
+static void rx_raw(const char*, size_t, const uint8_t*, size_t) {}
+
+// LED level changes seen while looping (1 ms steps)
+static std::vector<unsigned long> ledAt;
+static void run_ms(unsigned long ms) {
+  int led = host::gpio_get_output(LED);
+  for (unsigned long t = millis(); millis() - t < ms;) {
+    mqttpanel_loop();
+    if (host::gpio_get_output(LED) != led) {
+      led = host::gpio_get_output(LED);
+      ledAt.push_back(millis());
+    }
+    delay(1);
+  }
+}
+
+// Contact bounce: n short flips 0.2 ms apart, ending on level (2n + 1 edges)
+static void bounce(int level, int n) {
+  for (int i = 0; i < n; i++) {
+    host::gpio_set_input(BTN, level);
+    host::clock_advance_us(200);
+    host::gpio_set_input(BTN, !level);
+    host::clock_advance_us(200);
+  }
+  host::gpio_set_input(BTN, level);
+}
+
+static void press(unsigned long ms) {
+  bounce(LOW, 3);
+  run_ms(ms);
+  bounce(HIGH, 3);
+  run_ms(100);
+}
+
+static bool near(unsigned long v, unsigned long want, unsigned long tol) {
+  return v + tol >= want && v <= want + tol;
+}
+
+// Every gap between LED changes from index `from` on
+static bool steady(size_t from, unsigned long stepMs) {
+  if (ledAt.size() < from + 3) return false;
+  for (size_t i = from + 1; i < ledAt.size(); i++) {
+    if (!near(ledAt[i] - ledAt[i - 1], stepMs, 1)) return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp (button / LED engine)");
+  host::clock_manual(true);
+  MpConnPolicy policy;
+  policy.portalAfterFailures = 0;
+  policy.portalOnWifiLoss = false;
+  mqttpanel_conn_policy(policy);
+  mqttpanel_on_button(on_button);
+
+  // --- Boot reset: held at power-on, raised inside begin before the WiFi step (which may sit in the portal) ---
+  host::gpio_set_input(BTN, LOW);
+  host::wifi_set_connected(false);
+  unsigned long t0 = millis();
+  mqttpanel_begin(&client, rx_raw, mqtt_server, mqtt_port, mqtt_topic, PORTAL_SEC, FACTORY_SEC, BTN, LED, 20);
+  unsigned long beginMs = millis() - t0;
+  printf("mqttpanel_begin with the button held: %lu ms (was >= 2000 ms)\n", beginMs);
+  bench_check(events.size() == 1 && events[0].kind == MP_BTN_BOOT_RESET && eventAt[0] == t0 && !wifiAtEvent,
+              "boot reset is raised from begin, before WiFi, without waiting");
+  run_ms(2100);
+  bench_check(events.size() == 1, "holding it longer raises nothing more");
+  bounce(HIGH, 3);
+  run_ms(100);
+  bench_check(events.size() == 1, "releasing it raises nothing more");
+
+  // --- Click through contact bounce ---
+  events.clear();
+  eventAt.clear();
+  MpButtonStats bs0, bs;
+  mqttpanel_button_stats(&bs0);
+  press(150);
+  mqttpanel_button_stats(&bs);
+  bench_check(events.size() == 1 && events[0].kind == MP_BTN_CLICK, "bouncy press -> exactly one click");
+  bench_check(near(events[0].heldMs, 150, 3), "click hold time is the debounced press");
+  bench_check(bs.edges - bs0.edges == 14 && bs.bounces - bs0.bounces == 12, "bounce edges are counted and filtered");
+
+  // A 1 ms spike is noise
+  events.clear();
+  host::gpio_set_input(BTN, LOW);
+  host::clock_advance_us(1000);
+  host::gpio_set_input(BTN, HIGH);
+  run_ms(100);
+  bench_check(events.empty(), "a glitch shorter than the debounce raises nothing");
+
+  // --- Portal: LED slow from 3 s, event on release ---
+  events.clear();
+  ledAt.clear();
+  unsigned long pressAt = millis();
+  press(4000);
+  bench_check(events.size() == 1 && events[0].kind == MP_BTN_PORTAL && near(events[0].heldMs, 4000, 3),
+              "hold 4 s -> portal event with its hold time");
+  bench_check(!ledAt.empty() && near(ledAt[0] - pressAt, PORTAL_SEC * 1000, 2), "LED starts blinking at portal_sec");
+  size_t n = ledAt.size();
+  ledAt.pop_back(); // the release
+  bench_check(n >= 6 && steady(0, MP_LED_SLOW.stepMs), "slow blink is 200 ms per step");
+  bench_check(host::gpio_get_output(LED) == LOW, "LED is back to the user pattern (off) after release");
+
+  // --- Factory: LED fast from 10 s ---
+  events.clear();
+  ledAt.clear();
+  pressAt = millis();
+  press(11000);
+  ledAt.pop_back();
+  size_t fastFrom = 0;
+  while (fastFrom < ledAt.size() && ledAt[fastFrom] - pressAt < FACTORY_SEC * 1000UL) fastFrom++;
+  bench_check(events.size() == 1 && events[0].kind == MP_BTN_FACTORY && near(events[0].heldMs, 11000, 3),
+              "hold 11 s -> factory event");
+  // the switch may land on a step where the slow blink is already on: then the first change is one step later
+  bench_check(fastFrom < ledAt.size() && ledAt[fastFrom] - pressAt <= FACTORY_SEC * 1000UL + MP_LED_FAST.stepMs + 2 &&
+              steady(fastFrom, MP_LED_FAST.stepMs), "fast blink (50 ms) from factory_sec");
+
+  // --- User pattern: only level changes are written, and it comes back after a long press ---
+  mqttpanel_led(MP_LED_HEARTBEAT);
+  run_ms(1000);
+  unsigned long io = host::gpio_access_count();
+  ledAt.clear();
+  run_ms(1000);
+  bench_check(host::gpio_access_count() - io == 4 && ledAt.size() == 4, "heartbeat: 4 pin writes per second, nothing else");
+  press(3500);
+  ledAt.clear();
+  run_ms(1000);
+  bench_check(ledAt.size() == 4, "heartbeat resumes after the held-button blink");
+  mqttpanel_led(MP_LED_OFF);
+
+  // --- Idle cost ---
+  io = host::gpio_access_count();
+  host::clock_manual(false);
+  const unsigned long N = bench_iters(2000000);
+  BenchResult idle = bench_run("mqttpanel_loop, button idle", N, [](unsigned long) { mqttpanel_loop(); });
+  printf("pin reads in %lu idle loops: %lu (was %lu)\n", N, host::gpio_access_count() - io, N);
+  bench_check(host::gpio_access_count() == io, "idle loop does not touch the pin");
+  bench_check(idle.allocsPerOp == 0, "idle loop does not allocate");
+
+  return bench_finish();
+}
@@ -0,0 +1,212 @@
+// Benchmarks for the channel router in explained/mqttpanel_explained.cpp:
+// inbound lookup + apply, and the typed *_pub helpers.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <string>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static const char* kBase = "MyProject/1700000000000";
+
+static bool sw[MPTP_MAX_CHANNELS];
+static int dim[MPTP_MAX_CHANNELS];
+static int sel[MPTP_MAX_CHANNELS];
+static String txt[MPTP_MAX_CHANNELS];
+
+static char lastTopic[MPTP_MAX_TOPIC_LEN];
+static bool sawDimmerVal = false;
+
+static void record_topic(const char* topic, const uint8_t*, unsigned int, bool) {
+  strlcpy(lastTopic, topic, sizeof(lastTopic));
+  if (!strcmp(topic, "MyProject/1700000000000/dimmer/2/val")) sawDimmerVal = true;
+}
+
+static String topicOf(const char* type, int idx, const char* leaf) {
+  return String(kBase) + "/" + type + "/" + String(idx) + "/" + leaf;
+}
+
+// A user-defined type bound through its own codec.
+enum FanMode { FAN_OFF, FAN_LOW, FAN_HIGH };
+template <> struct MpCodec<FanMode> {
+  static bool parse(const char* msg, size_t, FanMode& out) {
+    if (!strcmp(msg, "off")) out = FAN_OFF;
+    else if (!strcmp(msg, "low")) out = FAN_LOW;
+    else if (!strcmp(msg, "high")) out = FAN_HIGH;
+    else return false;
+    return true;
+  }
+  static const char* format(const FanMode& v, char*, size_t) {
+    return v == FAN_HIGH ? "high" : v == FAN_LOW ? "low" : "off";
+  }
+};
+
+static FanMode fan = FAN_OFF;
+static float setpoint = 0;
+
+// Same shape as a generated panel: switches, dimmers, selects, texts, one
+// sync, plus a float and a custom enum bound with mqttpanel_bind.
+static int registerPanel() {
+  mqttpanel_bind(topicOf("select", 99, "set").c_str(), &fan);
+  mqttpanel_bind(topicOf("number", 99, "set").c_str(), &setpoint, MpClamp<5, 30, float>());
+  int n = 0;
+  for (int i = 1; n < MPTP_MAX_CHANNELS - 3; i++) {
+    switch (n % 4) {
+      case 0: mqttpanel_switch_sub(topicOf("switch", i, "set").c_str(), &sw[n]); break;
+      case 1: mqttpanel_dimmer_sub(topicOf("dimmer", i, "set").c_str(), &dim[n]); break;
+      case 2: mqttpanel_select_sub(topicOf("select", i, "set").c_str(), &sel[n]); break;
+      case 3: mqttpanel_text_sub(topicOf("text", i, "set").c_str(), &txt[n]); break;
+    }
+    n++;
+  }
+  mqttpanel_sync_sub(topicOf("sync", 1, "set").c_str());
+  return n + 3;
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "explained/mqttpanel_explained.cpp (channel router)");
+
+  client.connect("bench");
+  mqttpanel_begin(&client);
+  int channels = registerPanel();
+  printf("channels registered: %d\n", channels);
+  printf("channel table RAM: %u bytes/channel, %u bytes total\n",
+         (unsigned)mqttpanel_ram_per_channel(), (unsigned)mqttpanel_ram_total());
+
+  const unsigned long N = bench_iters(1000000);
+
+  // --- Inbound: first channel (best case) and last data channel (worst case) ---
+  String first = topicOf("switch", 1, "set");
+  // Channel n uses index n+1 (see registerPanel); the last data channel is a
+  // dimmer when MPTP_MAX_CHANNELS-2 is 1 mod 4, etc. Find it by registration order.
+  int lastIdx = channels - 4;
+  const char* lastTypes[4] = {"switch", "dimmer", "select", "text"};
+  String last = topicOf(lastTypes[lastIdx % 4], lastIdx + 1, "set");
+  String miss = String(kBase) + "/unknown/1/set";
+
+  bench_run("rx router: first channel", N, [&](unsigned long i) {
+    client.host_inject(first.c_str(), (const uint8_t*)((i & 1) ? "1" : "0"), 1);
+  });
+  bench_run("rx router: last channel", N, [&](unsigned long i) {
+    client.host_inject(last.c_str(), (const uint8_t*)((i & 1) ? "10" : "20"), 2);
+  });
+  bench_run("rx router: no match", N, [&](unsigned long) {
+    client.host_inject(miss.c_str(), (const uint8_t*)"1", 1);
+  });
+
+  client.host_inject(topicOf("dimmer", 2, "set").c_str(), (const uint8_t*)"250", 3);
+  bench_check(dim[1] == 100, "dimmer clamps to 100");
+  client.host_inject(topicOf("select", 99, "set").c_str(), (const uint8_t*)"high", 4);
+  bench_check(fan == FAN_HIGH, "custom codec parses enum");
+  client.host_inject(topicOf("select", 99, "set").c_str(), (const uint8_t*)"max", 3);
+  bench_check(fan == FAN_HIGH, "custom codec rejection leaves the value alone");
+  client.host_inject(topicOf("number", 99, "set").c_str(), (const uint8_t*)"42.5", 4);
+  bench_check(setpoint == 30.0f, "float binding clamps through MpClamp");
+  String txt4 = topicOf("text", 4, "set");
+  std::string big(MPTP_MAX_VALUE_LEN, 'x');
+  client.host_inject(txt4.c_str(), (const uint8_t*)big.data(), MPTP_MAX_VALUE_LEN - 1);
+  bench_check(txt[3].length() == MPTP_MAX_VALUE_LEN - 1 && mqttpanel_rx_dropped() == 0, "a value of MPTP_MAX_VALUE_LEN - 1 fits");
+  client.host_inject(txt4.c_str(), (const uint8_t*)"short", 5);
+  client.host_inject(txt4.c_str(), (const uint8_t*)big.data(), MPTP_MAX_VALUE_LEN);
+  bench_check(txt[3] == "short" && mqttpanel_rx_dropped() == 1, "a longer value is dropped and counted, not cut");
+
+  // --- Outbound ---
+  String dimVal = topicOf("dimmer", 2, "val");
+  String numVal = topicOf("number", 1, "val");
+  String txtVal = topicOf("text", 4, "val");
+  String hello = "Hello from the bench";
+  // *_pub only enqueues; each row includes the mqttpanel_loop() that sends it.
+  client.host_reset_counters();
+  bench_run("pub mqttpanel_dimmer_pub + loop", N, [&](unsigned long i) {
+    mqttpanel_dimmer_pub(dimVal.c_str(), (int)(i % 101));
+    mqttpanel_loop();
+  });
+  bench_check(client.host_pub_count() > 0, "dimmer_pub reached the client");
+  bench_run("pub mqttpanel_number_pub + loop", N, [&](unsigned long i) {
+    mqttpanel_number_pub(numVal.c_str(), (float)i * 0.25f);
+    mqttpanel_loop();
+  });
+  bench_run("pub mqttpanel_text_pub + loop", N, [&](unsigned long) {
+    mqttpanel_text_pub(txtVal.c_str(), hello);
+    mqttpanel_loop();
+  });
+
+  // /val topics are rebuilt from base + relative key at publish time.
+  client.host_set_observer(record_topic);
+  lastTopic[0] = 0;
+  mqttpanel_publish_all_vals();
+  MpTxStats st;
+  for (mqttpanel_tx_stats(&st); st.depth > 0; mqttpanel_tx_stats(&st)) mqttpanel_loop();
+  client.host_set_observer(nullptr);
+  bench_check(sawDimmerVal, "publish_all_vals derives <base>/dimmer/2/val");
+
+  // Sync no longer blocks: the call only marks channels, loop() drains them.
+  host::clock_manual(true);
+  unsigned long t0 = millis();
+  bench_run("sync: mqttpanel_publish_all_vals (enqueue)", bench_iters(100000), [&](unsigned long) {
+    mqttpanel_publish_all_vals();
+  });
+  bench_check(millis() == t0, "publish_all_vals does not sleep");
+  unsigned long loops = 0;
+  bench_run("sync: enqueue + drain all channels", bench_iters(100000), [&](unsigned long) {
+    mqttpanel_publish_all_vals();
+    MpTxStats s;
+    for (mqttpanel_tx_stats(&s); s.depth > 0; mqttpanel_tx_stats(&s)) { mqttpanel_loop(); loops++; }
+  });
+  host::clock_manual(false);
+  mqttpanel_tx_stats(&st);
+  printf("sync drain: %.1f loop() calls per sync, peak depth %u, dropped %lu\n",
+         (double)loops / (double)(bench_iters(100000) + bench_iters(100000) / 10 + 1),
+         (unsigned)st.peakDepth, (unsigned long)st.dropped);
+
+  // A full ring drops new messages and counts them.
+  unsigned long dropsBefore = st.dropped;
+  for (int k = 0; k < MPTP_TXQ_BYTES; k++) mqttpanel_text_pub(txtVal.c_str(), hello);
+  mqttpanel_tx_stats(&st);
+  bench_check(st.dropped > dropsBefore, "overflowing the queue counts drops");
+  for (mqttpanel_tx_stats(&st); st.depth > 0; mqttpanel_tx_stats(&st)) mqttpanel_loop();
+
+  // A publish cut off mid-payload is a drop, not a send.
+  MpTxStats st0;
+  mqttpanel_tx_stats(&st0);
+  mqttpanel_text_pub(txtVal.c_str(), hello);
+  client.host_drop_mid_publish(1);
+  mqttpanel_loop();
+  mqttpanel_tx_stats(&st);
+  bench_check(st.depth == 0 && st.dropped == st0.dropped + 1 && st.sent == st0.sent, "failed raw publish counts as dropped");
+  client.connect("bench");
+
+  // A channel whose /val does not fit the packet buffer: dropped once, the rest still sent.
+  txt[3] = String('x');
+  while (txt[3].length() < MQTT_MAX_PACKET_SIZE) txt[3] += txt[3];
+  mqttpanel_tx_stats(&st0);
+  mqttpanel_publish_all_vals();
+  for (mqttpanel_tx_stats(&st); st.depth > 0; mqttpanel_tx_stats(&st)) mqttpanel_loop();
+  bench_check(st.dropped == st0.dropped + 1 && st.sent == st0.sent + (uint32_t)channels - 2,
+              "failed channel publish counts as dropped, not sent");
+
+  // --- Absolute topics (outside the base) keep the full topic length ---
+  mqttpanel_begin(&client);
+  bool lamp = false, porch = false;
+  bench_check(mqttpanel_switch_sub(topicOf("switch", 1, "set").c_str(), &sw[0]), "base inferred from the first channel");
+  bench_check(mqttpanel_switch_sub("home/livingroom/lamp/1/set", &lamp), "absolute topic longer than a relative key registers");
+  bench_check(mqttpanel_switch_sub("home/frontyard/porch/light/1/set", &porch), "several absolute topics share the pool");
+  String longKey = String(kBase) + "/switch/" + String(std::string(MPTP_MAX_KEY_LEN, '9').c_str()) + "/set";
+  bench_check(!mqttpanel_switch_sub(longKey.c_str(), &sw[1]), "relative key over MPTP_MAX_KEY_LEN is refused");
+  String tooLong = "home/" + String(std::string(MPTP_MAX_TOPIC_LEN, 'x').c_str()) + "/set";
+  bench_check(!mqttpanel_switch_sub(tooLong.c_str(), &sw[1]), "absolute topic over MPTP_MAX_TOPIC_LEN is refused");
+  client.host_inject("home/livingroom/lamp/1/set", (const uint8_t*)"1", 1);
+  client.host_inject("home/frontyard/porch/light/1/set", (const uint8_t*)"1", 1);
+  bench_check(lamp && porch, "absolute topics route to their variables");
+  client.host_set_observer(record_topic);
+  lastTopic[0] = 0;
+  mqttpanel_publish_all_vals();
+  for (mqttpanel_tx_stats(&st); st.depth > 0; mqttpanel_tx_stats(&st)) mqttpanel_loop();
+  client.host_set_observer(nullptr);
+  bench_check(!strcmp(lastTopic, "home/frontyard/porch/light/1/val"), "/val of an absolute topic is the full topic");
+
+  return bench_finish();
+}
@@ -0,0 +1,133 @@
+// Change tracking (mqttpanel_track) in explained/mqttpanel_explained.cpp:
+// broker traffic of a sensor panel republished on a timer vs. tracked with a
+// deadband + minimum interval, and the per-loop cost of the change scan.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static const char* kBase = "MyProject/1700000000000";
+static const int kSensors = 16;
+
+static float temp[kSensors];
+static int level[4];
+static String status = "idle";
+
+static String topicOf(const char* type, int idx) {
+  return String(kBase) + "/" + type + "/" + String(idx) + "/set";
+}
+
+static void registerPanel() {
+  for (int i = 0; i < kSensors; i++) mqttpanel_bind(topicOf("number", i + 1).c_str(), &temp[i]);
+  for (int i = 0; i < 4; i++) mqttpanel_dimmer_sub(topicOf("dimmer", i + 1).c_str(), &level[i]);
+  mqttpanel_text_sub(topicOf("text", 1).c_str(), &status);
+  mqttpanel_sync_sub(topicOf("sync", 1).c_str());
+}
+
+// One simulated minute of sensor noise: +-0.05 jitter on a slow drift, a
+// dimmer nudged every 10 s and a status text that flips twice.
+static void simulate(unsigned long step) {
+  for (int i = 0; i < kSensors; i++) {
+    temp[i] = 20.0f + (float)i + 0.002f * (float)(step / 10) + 0.05f * (float)((int)((step * 7 + i * 13) % 3) - 1);
+  }
+  if (step % 1000 == 0) level[step / 1000 % 4] = (int)(step / 1000 % 100);
+  if (step == 2000) status = "heating";
+  if (step == 4000) status = "idle";
+}
+
+static void drain() {
+  MpTxStats st;
+  for (mqttpanel_tx_stats(&st); st.depth > 0; mqttpanel_tx_stats(&st)) mqttpanel_loop();
+}
+
+// 6000 loops, 10 ms apart. timerMs > 0 = the old sketch: publish_all_vals()
+// every timerMs; otherwise only tracking publishes.
+static unsigned long runMinute(unsigned long timerMs) {
+  client.host_reset_counters();
+  unsigned long lastTimer = millis();
+  for (unsigned long step = 0; step < 6000; step++) {
+    simulate(step);
+    if (timerMs && millis() - lastTimer >= timerMs) {
+      mqttpanel_publish_all_vals();
+      lastTimer = millis();
+    }
+    mqttpanel_loop();
+    host::clock_advance_us(10000);
+  }
+  drain();
+  return client.host_pub_count();
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "explained/mqttpanel_explained.cpp (change tracking)");
+  host::clock_manual(true);
+
+  client.connect("bench");
+  mqttpanel_begin(&client);
+  registerPanel();
+  mqttpanel_tx_budget(32, 4096);
+  printf("channel table RAM: %u bytes/channel, %u bytes total\n",
+         (unsigned)mqttpanel_ram_per_channel(), (unsigned)mqttpanel_ram_total());
+
+  // --- Traffic over one simulated minute ---
+  unsigned long timer = runMinute(1000);
+  mqttpanel_track_all(1000, 0.5f);
+  mqttpanel_loop(); // first tracked loop sends the current values once
+  drain();
+  unsigned long tracked = runMinute(0);
+  printf("1 min, %d channels: timer publish_all_vals every 1 s = %lu msgs, tracked (1 s, deadband 0.5) = %lu msgs\n",
+         kSensors + 5, timer, tracked);
+  bench_check(tracked * 10 <= timer, "tracking cuts traffic by at least 10x");
+
+  // --- Semantics ---
+  const String t0 = topicOf("number", 1);
+  mqttpanel_track(t0.c_str(), 0, 0.5f);
+  temp[0] = 30.0f;
+  mqttpanel_loop();
+  drain();
+  client.host_reset_counters();
+  temp[0] = 30.4f;
+  mqttpanel_loop();
+  bench_check(client.host_pub_count() == 0, "change inside the deadband is not sent");
+  temp[0] = 30.6f;
+  mqttpanel_loop();
+  bench_check(client.host_pub_count() == 1, "change beyond the deadband is sent");
+
+  mqttpanel_track(t0.c_str(), 500, 0);
+  mqttpanel_loop(); // re-tracking sends the current value once
+  client.host_reset_counters();
+  temp[0] = 31.0f;
+  mqttpanel_loop();
+  bench_check(client.host_pub_count() == 0, "min interval holds back a fast change");
+  host::clock_advance_us(500000);
+  mqttpanel_loop();
+  bench_check(client.host_pub_count() == 1, "held-back change is sent once the interval passes");
+
+  client.host_reset_counters();
+  status = "heating";
+  host::clock_advance_us(1000000);
+  mqttpanel_loop();
+  bench_check(client.host_pub_count() == 1, "String channel tracked through its text hash");
+  bench_check(!mqttpanel_track(topicOf("sync", 1).c_str()), "sync channel cannot be tracked");
+  bench_check(!mqttpanel_track(topicOf("number", 99).c_str()), "unknown topic cannot be tracked");
+
+  client.host_drop_connection();
+  level[0] = 77;
+  host::clock_advance_us(1000000);
+  mqttpanel_loop();
+  client.connect("bench");
+  client.host_reset_counters();
+  mqttpanel_loop();
+  bench_check(client.host_pub_count() == 1, "change made while offline is sent after reconnect");
+
+  // --- Cost of the scan when nothing changed ---
+  host::clock_manual(false);
+  const unsigned long N = bench_iters(1000000);
+  bench_run("loop: 21 tracked channels, no change", N, [&](unsigned long) { mqttpanel_loop(); });
+
+  return bench_finish();
+}
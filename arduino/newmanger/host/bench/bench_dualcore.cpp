@@ -0,0 +1,232 @@
+// Dual-core mode (mqttpanel_dual_core) in explained/mqttpanel_explained.cpp:
+// three std::threads stand in for the ESP32 cores - "net" runs mqttpanel_loop()
+// and injects /set traffic, "app" runs mqttpanel_app_loop() and publishes, a
+// third task polls mqttpanel_snapshot(). Checks ordering, loss and torn reads,
+// and reports the cross-core latency in both directions. The _tsan build of
+// this bench runs the same thing under ThreadSanitizer.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static const char* kBase = "MyProject/1700000000000";
+static const int kRing = 1024; // latency stamps kept per direction (window is far smaller)
+static const int kWindow = 16; // net stops injecting while this many /set are unapplied
+
+static int seqVal = -1;        // select/1: sequence number of the last applied /set
+static String text = "a";      // text/1: 'a' + (len - 1) repeated len times
+static int level = 0;
+static bool sw = false;
+
+static std::atomic<uint64_t> rxStamp[kRing];
+static std::atomic<uint64_t> txStamp[kRing];
+static std::atomic<long> applied(-1);   // last seqVal seen by app
+static std::atomic<long> txSeen(0);     // counters received by the "broker"
+static std::atomic<long> txBad(0);      // out of order / duplicated counters
+static std::vector<uint32_t> rxLat, txLat;
+
+static String topicOf(const char* type, int idx, const char* leaf = "set") {
+  return String(kBase) + "/" + type + "/" + String(idx) + "/" + leaf;
+}
+
+static String pattern(unsigned long m) {
+  int len = 1 + (int)(m % 26);
+  String s;
+  for (int i = 0; i < len; i++) s += (char)('a' + len - 1);
+  return s;
+}
+
+static bool wellFormed(const char* s) {
+  size_t len = strlen(s);
+  if (len == 0 || len > 26) return false;
+  for (size_t i = 0; i < len; i++) if (s[i] != (char)('a' + len - 1)) return false;
+  return true;
+}
+
+// Runs on the net thread (the fake client calls observers from publish).
+static void record(const char* topic, const uint8_t* payload, unsigned int len, bool) {
+  if (!strstr(topic, "/counter/")) return;
+  std::string p((const char*)payload, len);
+  long k = atol(p.c_str());
+  if (k != txSeen.load()) txBad++;
+  txLat.push_back((uint32_t)(host::clock_now_us() - txStamp[k % kRing].load()));
+  txSeen = k + 1;
+}
+
+static uint32_t pct(std::vector<uint32_t>& v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[(size_t)(p * (double)(v.size() - 1))];
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "explained/mqttpanel_explained.cpp (dual-core mode)");
+
+  client.connect("bench");
+  mqttpanel_begin(&client);
+  String sSeq = topicOf("select", 1), sText = topicOf("text", 1), sDim = topicOf("dimmer", 1);
+  String sSw = topicOf("switch", 1), sSync = topicOf("sync", 1), tCounter = topicOf("counter", 1, "val");
+  mqttpanel_select_sub(sSeq.c_str(), &seqVal);
+  mqttpanel_text_sub(sText.c_str(), &text);
+  mqttpanel_dimmer_sub(sDim.c_str(), &level);
+  mqttpanel_switch_sub(sSw.c_str(), &sw);
+  mqttpanel_sync_sub(sSync.c_str());
+  mqttpanel_tx_budget(16, 2048);
+  mqttpanel_dual_core(true);
+
+  // --- Hand-off rules, driven from one thread ---
+  char snap[MPTP_SNAPSHOT_LEN];
+  client.host_inject(sDim.c_str(), (const uint8_t*)"42", 2);
+  mqttpanel_loop();
+  bench_check(level == 0, "net core does not touch bound variables");
+  mqttpanel_app_loop();
+  bench_check(level == 42, "app core applies the /set");
+  bench_check(mqttpanel_snapshot(sDim.c_str(), snap, sizeof(snap)) && !strcmp(snap, "42"), "snapshot follows the app core");
+  int lv = 0;
+  bench_check(mqttpanel_snapshot_as(sDim.c_str(), &lv) && lv == 42, "typed snapshot parses back");
+  bench_check(!mqttpanel_snapshot(sSync.c_str(), snap, sizeof(snap)), "sync has no snapshot");
+
+  client.host_reset_counters();
+  mqttpanel_dimmer_pub(topicOf("dimmer", 1, "val").c_str(), 7);
+  mqttpanel_app_loop();
+  bench_check(client.host_pub_count() == 0, "app core only hands off");
+  mqttpanel_loop();
+  bench_check(client.host_pub_count() == 1, "net core publishes the hand-off");
+
+  client.host_reset_counters();
+  client.host_inject(sSync.c_str(), (const uint8_t*)"1", 1);
+  mqttpanel_loop();
+  mqttpanel_app_loop();
+  mqttpanel_loop();
+  bench_check(client.host_pub_count() == 4, "sync publishes every bound channel");
+  client.host_reset_counters();
+  mqttpanel_reconnected();
+  bench_check(client.host_sub_count() == 5 && client.host_pub_count() == 0, "reconnect resubscribes on the net core");
+  mqttpanel_app_loop();
+  mqttpanel_loop();
+  bench_check(client.host_pub_count() == 4, "reconnect sync runs through the app core");
+
+  // A state document bigger than the hand-off ring is dropped on the app core, JSON and CBOR alike
+  mqttpanel_state_mode(true);
+  text = String(std::string(2 * MPTP_XQ_BYTES, 'z').c_str());
+  for (MpFrameFormat fmt : { MP_FRAME_JSON, MP_FRAME_CBOR }) {
+    MpTxStats ts0, ts;
+    mqttpanel_state_format(fmt);
+    mqttpanel_tx_stats(&ts0);
+    client.host_reset_counters();
+    mqttpanel_publish_all_vals();
+    mqttpanel_app_loop();
+    mqttpanel_loop();
+    mqttpanel_tx_stats(&ts);
+    bench_check(ts.dropped == ts0.dropped + 1 && client.host_pub_count() == 0,
+                fmt == MP_FRAME_JSON ? "oversized JSON state is dropped" : "oversized CBOR state is dropped");
+  }
+  mqttpanel_state_format(MP_FRAME_JSON);
+  mqttpanel_state_mode(false);
+  text = "a";
+
+  const unsigned long N = bench_iters(200000);
+  bench_run("rx: inject + hand-off + apply (one thread)", N, [&](unsigned long i) {
+    client.host_inject(sDim.c_str(), (const uint8_t*)((i & 1) ? "1" : "2"), 1);
+    mqttpanel_app_loop();
+  });
+  bench_run("tx: pub + hand-off + publish (one thread)", N, [&](unsigned long i) {
+    mqttpanel_select_pub(tCounter.c_str(), (int)i);
+    mqttpanel_app_loop();
+    mqttpanel_loop();
+  });
+
+  // --- Stress: three threads ---
+  mqttpanel_dual_core(true); // fresh stats
+  seqVal = -1;
+  client.host_set_observer(record);
+  const long M = (long)bench_iters(500000);
+  const uint64_t deadline = host::clock_now_us() + 60ull * 1000 * 1000;
+  std::atomic<bool> stop(false);
+  long appTorn = 0, snapTorn = 0, snapReads = 0, snapMisses = 0, snapBack = 0;
+
+  std::thread net([&] {
+    long m = 0;
+    while (host::clock_now_us() < deadline) {
+      if (m < M && m - applied.load() < kWindow) {
+        String p = pattern((unsigned long)m);
+        client.host_inject(sText.c_str(), (const uint8_t*)p.c_str(), p.length());
+        char num[16];
+        ltoa(m, num, 10);
+        rxStamp[m % kRing] = host::clock_now_us();
+        client.host_inject(sSeq.c_str(), (const uint8_t*)num, (unsigned)strlen(num));
+        m++;
+      }
+      mqttpanel_loop();
+      if (m == M && applied.load() == M - 1 && txSeen.load() == M) break;
+      std::this_thread::yield();
+    }
+  });
+
+  std::thread app([&] {
+    long k = 0;
+    while (host::clock_now_us() < deadline && !(applied.load() == M - 1 && k == M)) {
+      mqttpanel_app_loop();
+      if (seqVal != applied.load()) {
+        rxLat.push_back((uint32_t)(host::clock_now_us() - rxStamp[seqVal % kRing].load()));
+        if (seqVal < applied.load()) appTorn++;
+        applied = seqVal;
+      }
+      if (!wellFormed(text.c_str())) appTorn++;
+      if (k < M && k - txSeen.load() < kWindow) {
+        txStamp[k % kRing] = host::clock_now_us();
+        if (mqttpanel_select_pub(tCounter.c_str(), (int)k)) k++;
+      }
+      std::this_thread::yield();
+    }
+    mqttpanel_app_loop(); // hand off anything still queued
+  });
+
+  std::thread reader([&] {
+    int last = -1;
+    while (!stop.load()) {
+      char buf[MPTP_SNAPSHOT_LEN];
+      if (!mqttpanel_snapshot(sText.c_str(), buf, sizeof(buf))) snapMisses++;
+      else if (!wellFormed(buf)) snapTorn++;
+      int v;
+      if (mqttpanel_snapshot_as(sSeq.c_str(), &v)) {
+        if (v < last) snapBack++;
+        last = v;
+      }
+      snapReads++;
+      std::this_thread::yield();
+    }
+  });
+
+  net.join();
+  app.join();
+  stop = true;
+  reader.join();
+  client.host_set_observer(nullptr);
+
+  MpDualStats ds;
+  mqttpanel_dual_stats(&ds);
+  printf("stress: %ld /set + %ld pubs across threads, %ld snapshot reads (%ld retried out)\n",
+         M, M, snapReads, snapMisses);
+  printf("  core0 -> core1 (/set applied): p50 %u us, p99 %u us, max %u us (lib: max %u us), queue peak %u/%d B\n",
+         pct(rxLat, 0.5), pct(rxLat, 0.99), pct(rxLat, 1.0), (unsigned)ds.rxMaxUs, (unsigned)ds.rxPeakBytes, MPTP_RXQ_BYTES);
+  printf("  core1 -> core0 (pub on wire):  p50 %u us, p99 %u us, max %u us (lib: max %u us), queue peak %u/%d B\n",
+         pct(txLat, 0.5), pct(txLat, 0.99), pct(txLat, 1.0), (unsigned)ds.txMaxUs, (unsigned)ds.txPeakBytes, MPTP_XQ_BYTES);
+
+  bench_check(applied.load() == M - 1 && ds.rxDropped == 0, "every /set reaches the app core");
+  bench_check(appTorn == 0, "app core sees /set in order and never a half-written String");
+  bench_check(txSeen.load() == M && txBad.load() == 0, "every pub reaches the broker once, in order");
+  bench_check(snapTorn == 0 && snapBack == 0, "snapshots are never torn or stale-after-newer");
+  bench_check(snapReads > snapMisses, "snapshot reads mostly succeed while the app core writes");
+
+  return bench_finish();
+}
@@ -0,0 +1,326 @@
+// Binary frames (mqttpanel_state_format(MP_FRAME_CBOR)) in
+// explained/mqttpanel_explained.cpp: bytes on the wire and cost of a sync,
+// tracked changes and a batched <base>/set as per-channel text, a JSON
+// document and one CBOR frame; plus the bare value codecs side by side.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <string>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static const char* kBase = "MyProject/1700000000000";
+
+static bool sw1 = false, sw2 = true;
+static int dim3 = 40, dim4 = 80, sel5 = 2;
+static float num6 = 21.537f, num7 = -3.25f;
+static String txt8 = "Hello";
+
+static std::string lastTopic, lastPayload;
+static unsigned long frames = 0;
+
+static void record(const char* topic, const uint8_t* payload, unsigned int len, bool) {
+  lastTopic = topic;
+  lastPayload.assign((const char*)payload, len);
+  frames++;
+}
+
+static String topicOf(const char* type, int idx) {
+  return String(kBase) + "/" + type + "/" + String(idx) + "/set";
+}
+
+static void drain() {
+  MpTxStats st;
+  for (mqttpanel_tx_stats(&st); st.depth > 0; mqttpanel_tx_stats(&st)) mqttpanel_loop();
+}
+
+static void sync() {
+  mqttpanel_publish_all_vals();
+  drain();
+}
+
+// Finds key in a CBOR frame; false = missing or malformed.
+static bool frameGet(const std::string& f, const char* key, MpValue* out) {
+  MpFrameReader r((const uint8_t*)f.data(), f.size());
+  const char* k;
+  size_t kl;
+  MpValue v;
+  while (r.next(&k, &kl, &v)) {
+    if (kl == strlen(key) && !memcmp(k, key, kl)) { *out = v; return true; }
+  }
+  return false;
+}
+
+static uint32_t frameCount(const std::string& f) {
+  MpFrameReader r((const uint8_t*)f.data(), f.size());
+  return r.error() ? 0 : r.count();
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "explained/mqttpanel_explained.cpp (binary frames)");
+
+  client.connect("bench");
+  mqttpanel_begin(&client, kBase);
+  mqttpanel_switch_sub(topicOf("switch", 1).c_str(), &sw1);
+  mqttpanel_switch_sub(topicOf("switch", 2).c_str(), &sw2);
+  mqttpanel_dimmer_sub(topicOf("dimmer", 3).c_str(), &dim3);
+  mqttpanel_dimmer_sub(topicOf("dimmer", 4).c_str(), &dim4);
+  mqttpanel_select_sub(topicOf("select", 5).c_str(), &sel5);
+  mqttpanel_bind(topicOf("number", 6).c_str(), &num6);
+  mqttpanel_bind(topicOf("number", 7).c_str(), &num7);
+  mqttpanel_text_sub(topicOf("text", 8).c_str(), &txt8);
+  mqttpanel_sync_sub(topicOf("sync", 1).c_str());
+  mqttpanel_tx_budget(16, 4096);
+  const unsigned long N = bench_iters(100000);
+
+  // --- Sync: 8 per-channel /val vs. one JSON <base>/state vs. one CBOR <base>/state ---
+  client.host_reset_counters();
+  sync();
+  unsigned long txtMsgs = client.host_pub_count(), txtBytes = client.host_pub_bytes();
+  bench_run("sync: per-channel text /val", N, [&](unsigned long) { sync(); });
+
+  mqttpanel_state_mode(true);
+  client.host_reset_counters();
+  sync();
+  unsigned long jsonBytes = client.host_pub_bytes();
+  client.host_set_observer(record);
+  sync();
+  std::string json = lastPayload;
+  client.host_set_observer(nullptr);
+  bench_run("sync: JSON <base>/state", N, [&](unsigned long) { sync(); });
+
+  mqttpanel_state_format(MP_FRAME_CBOR);
+  client.host_reset_counters();
+  sync();
+  unsigned long cborMsgs = client.host_pub_count(), cborBytes = client.host_pub_bytes();
+  client.host_set_observer(record);
+  sync();
+  std::string cbor = lastPayload;
+  client.host_set_observer(nullptr);
+  BenchResult syncCbor = bench_run("sync: CBOR <base>/state", N, [&](unsigned long) { sync(); });
+
+  printf("sync of 8 channels on the wire: text %lu msgs / %lu B, JSON 1 msg / %lu B (payload %u), CBOR %lu msg / %lu B (payload %u)\n",
+         txtMsgs, txtBytes, jsonBytes, (unsigned)json.size(), cborMsgs, cborBytes, (unsigned)cbor.size());
+  bench_check(cborMsgs == 1 && cborBytes < jsonBytes && jsonBytes < txtBytes, "CBOR frame is the smallest sync");
+  bench_check(syncCbor.allocsPerOp == 0, "CBOR encode allocates nothing");
+  bench_check(json.find("\"number/6\":\"21.54\"") != std::string::npos, "JSON stays the default text format");
+  MpValue v;
+  bench_check(frameCount(cbor) == 8, "CBOR frame holds every bound channel and skips sync");
+  bench_check(frameGet(cbor, "switch/2", &v) && v.type == MP_VAL_BOOL && v.b, "bool travels as a CBOR bool");
+  bench_check(frameGet(cbor, "dimmer/4", &v) && v.type == MP_VAL_INT && v.i == 80, "int travels as a CBOR integer");
+  bench_check(frameGet(cbor, "number/7", &v) && v.type == MP_VAL_FLOAT && v.f == -3.25f &&
+              frameGet(cbor, "number/6", &v) && v.f == 21.537f, "float keeps full precision (text path: 2 decimals)");
+  bench_check(frameGet(cbor, "text/8", &v) && v.type == MP_VAL_TEXT && std::string(v.s, v.len) == "Hello", "text travels as a CBOR string");
+
+  // --- Tracked changes: one /val each (JSON state mode) vs. one CBOR delta frame ---
+  mqttpanel_track_all();
+  drain();
+  int flip = 0;
+  auto change3 = [&]() {
+    flip ^= 1;
+    sw1 = flip;
+    dim3 = flip ? 55 : 45;
+    num6 = flip ? 22.5f : 21.5f;
+    mqttpanel_loop();
+    drain();
+  };
+  mqttpanel_state_format(MP_FRAME_JSON);
+  change3();
+  client.host_reset_counters();
+  change3();
+  unsigned long jdMsgs = client.host_pub_count(), jdBytes = client.host_pub_bytes();
+  bench_run("track 3 changes: text /val each", N, [&](unsigned long) { change3(); });
+
+  mqttpanel_state_format(MP_FRAME_CBOR);
+  change3();
+  client.host_reset_counters();
+  client.host_set_observer(record);
+  change3();
+  client.host_set_observer(nullptr);
+  unsigned long cdMsgs = client.host_pub_count(), cdBytes = client.host_pub_bytes();
+  std::string delta = lastPayload;
+  BenchResult trackCbor = bench_run("track 3 changes: one CBOR frame", N, [&](unsigned long) { change3(); });
+  printf("3 tracked changes: text %lu msgs / %lu B, CBOR %lu msg / %lu B\n", jdMsgs, jdBytes, cdMsgs, cdBytes);
+  bench_check(jdMsgs == 3 && cdMsgs == 1 && cdBytes < jdBytes, "tracked changes are batched into one frame");
+  bench_check(lastTopic == std::string(kBase) + "/state" && frameCount(delta) == 3, "delta frame carries only the changed keys");
+  bench_check(trackCbor.allocsPerOp == 0, "delta frames allocate nothing");
+  client.host_reset_counters();
+  mqttpanel_loop();
+  drain();
+  bench_check(client.host_pub_count() == 0, "shadows update after a delta frame");
+
+  // A delta frame cut off by a link drop: pending and shadows stay, the change goes out after the reconnect
+  client.host_set_observer(record);
+  frames = 0;
+  dim3 = 66;
+  client.host_drop_mid_publish(1);
+  for (int i = 0; i < 3; i++) mqttpanel_loop();
+  MpTxStats ts;
+  mqttpanel_tx_stats(&ts);
+  bench_check(!client.connected() && frames == 0 && ts.depth > 0, "failed delta frame stays pending");
+  client.connect("bench");
+  drain();
+  client.host_set_observer(nullptr);
+  bench_check(frames == 1 && frameGet(lastPayload, "dimmer/3", &v) && v.i == 66, "and is sent after the reconnect");
+
+  // --- Batched <base>/set: CBOR and JSON are both accepted ---
+  String setTopic = String(kBase) + "/set";
+  uint8_t buf[128];
+  MpFrameWriter w(buf, sizeof(buf));
+  w.map(5);
+  w.add("switch/1", true);
+  w.add("dimmer/3", 75);
+  w.add("select/5", -3);
+  w.add("number/6", 19.25f);
+  w.add("text/8", "Hi");
+  bench_check(w.ok(), "writer fits the buffer");
+  client.host_inject(setTopic.c_str(), buf, (unsigned)w.size());
+  bench_check(sw1 && dim3 == 75 && sel5 == -3 && num6 == 19.25f && txt8 == "Hi", "CBOR set applies every key");
+
+  MpFrameWriter w2(buf, sizeof(buf));
+  w2.map(2);
+  w2.add("dimmer/3", 250);
+  w2.add("switch/2", 0);
+  client.host_inject(setTopic.c_str(), buf, (unsigned)w2.size());
+  bench_check(dim3 == 100 && !sw2, "CBOR set goes through the channel's own policy");
+  client.host_inject(setTopic.c_str(), buf, (unsigned)w2.size() - 1);
+  MpFrameWriter w3(buf, sizeof(buf));
+  w3.map(1);
+  w3.add("dimmer/3", 10);
+  client.host_inject(setTopic.c_str(), buf, (unsigned)w3.size() - 1);
+  bench_check(dim3 == 100, "truncated frame is ignored as a whole");
+  const char* jsonSet = "{\"dimmer/3\":\"42\"}";
+  client.host_inject(setTopic.c_str(), (const uint8_t*)jsonSet, (unsigned)strlen(jsonSet));
+  bench_check(dim3 == 42, "JSON set still works in CBOR mode");
+  uint8_t small[8];
+  MpFrameWriter w4(small, sizeof(small));
+  w4.map(1);
+  w4.add("switch/1", true);
+  bench_check(!w4.ok() && w4.size() == 11, "writer reports overflow and the full size");
+
+  // Text values are copied into a MPTP_MAX_VALUE_LEN buffer before parsing: longer ones are refused, not cut
+  std::string big(MPTP_MAX_VALUE_LEN, 'y');
+  MpValue longText;
+  longText.type = MP_VAL_TEXT;
+  longText.s = big.data();
+  longText.len = big.size();
+  String keep = "keep";
+  bool refused = !MpValueTraits<String, MpCodec<String> >::unpack(longText, keep) && keep == "keep";
+  longText.len--;
+  bool fits = MpValueTraits<String, MpCodec<String> >::unpack(longText, keep) && keep.length() == MPTP_MAX_VALUE_LEN - 1;
+  bench_check(refused && fits, "text unpack refuses values over MPTP_MAX_VALUE_LEN - 1");
+  uint8_t bigBuf[MPTP_MAX_VALUE_LEN + 32];
+  MpFrameWriter wl(bigBuf, sizeof(bigBuf));
+  wl.map(2);
+  wl.add("dimmer/3", 43);
+  wl.add("text/8", big.c_str());
+  uint32_t droppedBefore = mqttpanel_rx_dropped();
+  client.host_inject(setTopic.c_str(), bigBuf, (unsigned)wl.size());
+  bench_check(wl.ok() && dim3 == 43 && txt8 == "Hi" && mqttpanel_rx_dropped() == droppedBefore + 1,
+              "CBOR set: an over-long text is dropped and counted, the other keys still apply");
+
+  String s1 = topicOf("switch", 1), d3 = topicOf("dimmer", 3), n6 = topicOf("number", 6);
+  bench_run("rx: 3 single text /set", N, [&](unsigned long i) {
+    client.host_inject(s1.c_str(), (const uint8_t*)((i & 1) ? "1" : "0"), 1);
+    client.host_inject(d3.c_str(), (const uint8_t*)"42", 2);
+    client.host_inject(n6.c_str(), (const uint8_t*)"19.25", 5);
+  });
+  const char* three = "{\"switch/1\":\"1\",\"dimmer/3\":42,\"number/6\":19.25}";
+  bench_run("rx: JSON <base>/set (3 keys)", N, [&](unsigned long) {
+    client.host_inject(setTopic.c_str(), (const uint8_t*)three, (unsigned)strlen(three));
+  });
+  MpFrameWriter w5(buf, sizeof(buf));
+  w5.map(3);
+  w5.add("switch/1", true);
+  w5.add("dimmer/3", 42);
+  w5.add("number/6", 19.25f);
+  BenchResult rxCbor = bench_run("rx: CBOR <base>/set (3 keys)", N, [&](unsigned long) {
+    client.host_inject(setTopic.c_str(), buf, (unsigned)w5.size());
+  });
+  printf("batched set of 3 keys: JSON %u B, CBOR %u B\n", (unsigned)strlen(three), (unsigned)w5.size());
+  bench_check(rxCbor.allocsPerOp == 0, "CBOR decode allocates nothing");
+
+  // --- Bare codecs: 8 values to text and back vs. CBOR ---
+  char tb[32];
+  volatile size_t sink = 0;
+  bench_run("codec: 8 values -> text (itoa/dtostrf)", N, [&](unsigned long i) {
+    sink += strlen(MpCodec<bool>::format(i & 1, tb, sizeof(tb)));
+    sink += strlen(MpCodec<bool>::format(true, tb, sizeof(tb)));
+    sink += strlen(MpCodec<int>::format((int)(i & 127), tb, sizeof(tb)));
+    sink += strlen(MpCodec<int>::format(80, tb, sizeof(tb)));
+    sink += strlen(MpCodec<int>::format(-3, tb, sizeof(tb)));
+    sink += strlen(MpCodec<float>::format(21.537f, tb, sizeof(tb)));
+    sink += strlen(MpCodec<float>::format(-3.25f, tb, sizeof(tb)));
+    sink += strlen(MpCodec<String>::format(txt8, tb, sizeof(tb)));
+  });
+  bench_run("codec: 8 values -> CBOR", N, [&](unsigned long i) {
+    MpFrameWriter e(buf, sizeof(buf));
+    e.map(8);
+    e.add("switch/1", (bool)(i & 1));
+    e.add("switch/2", true);
+    e.add("dimmer/3", (int)(i & 127));
+    e.add("dimmer/4", 80);
+    e.add("select/5", -3);
+    e.add("number/6", 21.537f);
+    e.add("number/7", -3.25f);
+    e.add("text/8", txt8.c_str());
+    sink += e.size();
+  });
+  const char* texts[8] = { "1", "0", "42", "80", "-3", "21.54", "-3.25", "Hello" };
+  bench_run("codec: 8 values <- text (atoi/atof)", N, [&](unsigned long) {
+    bool b;
+    int n;
+    float f;
+    MpCodec<bool>::parse(texts[0], 1, b);
+    MpCodec<bool>::parse(texts[1], 1, b);
+    MpCodec<int>::parse(texts[2], 2, n);
+    MpCodec<int>::parse(texts[3], 2, n);
+    MpCodec<int>::parse(texts[4], 2, n);
+    MpCodec<float>::parse(texts[5], 5, f);
+    MpCodec<float>::parse(texts[6], 5, f);
+    MpCodec<String>::parse(texts[7], 5, txt8);
+    sink += (size_t)n + (size_t)f + b;
+  });
+  MpFrameWriter e8(buf, sizeof(buf));
+  e8.map(8);
+  e8.add("switch/1", true); e8.add("switch/2", false); e8.add("dimmer/3", 42); e8.add("dimmer/4", 80);
+  e8.add("select/5", -3); e8.add("number/6", 21.537f); e8.add("number/7", -3.25f); e8.add("text/8", "Hello");
+  bench_run("codec: 8 values <- CBOR", N, [&](unsigned long) {
+    MpFrameReader r(buf, e8.size());
+    const char* k;
+    size_t kl;
+    MpValue x;
+    bool b = false;
+    int n = 0;
+    float f = 0;
+    for (int j = 0; r.next(&k, &kl, &x); j++) {
+      if (j < 2) MpValueTraits<bool, MpCodec<bool> >::unpack(x, b);
+      else if (j < 5) MpValueTraits<int, MpCodec<int> >::unpack(x, n);
+      else if (j < 7) MpValueTraits<float, MpCodec<float> >::unpack(x, f);
+      else MpValueTraits<String, MpCodec<String> >::unpack(x, txt8);
+    }
+    sink += (size_t)n + (size_t)f + b;
+  });
+
+  // --- Dual-core: the app core encodes, the net core only forwards ---
+  mqttpanel_loop(); // send the deltas left by the /set tests first
+  drain();
+  mqttpanel_dual_core(true);
+  client.host_reset_counters();
+  client.host_set_observer(record);
+  mqttpanel_publish_all_vals();
+  mqttpanel_app_loop();
+  mqttpanel_loop();
+  client.host_set_observer(nullptr);
+  bench_check(client.host_pub_count() == 1 && frameCount(lastPayload) == 8, "dual-core sync sends one CBOR frame");
+  client.host_inject(setTopic.c_str(), buf, (unsigned)w5.size());
+  mqttpanel_loop();
+  mqttpanel_app_loop();
+  bench_check(dim3 == 42 && num6 == 19.25f, "dual-core CBOR set is applied on the app core");
+  mqttpanel_dual_core(false);
+
+  return bench_finish();
+}
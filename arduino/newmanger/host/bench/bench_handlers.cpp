@@ -0,0 +1,185 @@
+// Topic handlers (mqttpanel_on) in mqttpanel.cpp: the if (topic == String(
+// mqtt_topic_head) + "...") chain the app's code generator emits vs. the match
+// tree, with 24 exact patterns and with 3 "+" patterns; plus the wildcard
+// rules and the fallback to the begin() callback.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <string>
+#include <vector>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static char mqtt_server[40] = "127.0.0.1";
+static char mqtt_port[6] = "1883";
+static char mqtt_topic_head[40] = "MyProject/1700000000000/"; // as generated: trailing slash
+
+static const char* kTypes[3] = { "switch", "dimmer", "text" };
+static bool sw[9];
+static int dim[9];
+static String txt[9];
+static unsigned long fallback = 0;
+
+// What the generator emits today: one String per comparison, per message.
+static void mq_receiver(String topic, String msg) {
+  fallback++;
+  for (int i = 1; i <= 8; i++) {
+    if (topic == String(mqtt_topic_head) + "switch/" + String(i) + "/set") { sw[i] = (msg == "1"); return; }
+  }
+  for (int i = 1; i <= 8; i++) {
+    if (topic == String(mqtt_topic_head) + "dimmer/" + String(i) + "/set") { dim[i] = msg.toInt(); return; }
+  }
+  for (int i = 1; i <= 8; i++) {
+    if (topic == String(mqtt_topic_head) + "text/" + String(i) + "/set") { txt[i] = msg; return; }
+  }
+}
+
+// --- Handlers ---
+static void on_switch(const char*, size_t, const uint8_t* p, size_t n, void* arg) {
+  *(bool*)arg = (n == 1 && p[0] == '1');
+}
+static void on_dimmer(const char*, size_t, const uint8_t* p, size_t n, void* arg) {
+  int v = 0;
+  for (size_t i = 0; i < n && p[i] >= '0' && p[i] <= '9'; i++) v = v * 10 + (p[i] - '0');
+  *(int*)arg = v;
+}
+static void on_text(const char*, size_t, const uint8_t* p, size_t n, void* arg) {
+  String& s = *(String*)arg;
+  s = "";
+  s.concat((const char*)p, (unsigned)n);
+}
+
+// "+" versions: the channel index comes from the topic.
+static int levelIndex(const char* topic, size_t topicLen) {
+  const char* l;
+  size_t n;
+  if (!mqttpanel_topic_level(topic, topicLen, -2, &l, &n)) return 0;
+  int v = 0;
+  for (size_t i = 0; i < n; i++) v = v * 10 + (l[i] - '0');
+  return v >= 1 && v <= 8 ? v : 0;
+}
+static void on_any_switch(const char* t, size_t tl, const uint8_t* p, size_t n, void*) {
+  on_switch(t, tl, p, n, &sw[levelIndex(t, tl)]);
+}
+static void on_any_dimmer(const char* t, size_t tl, const uint8_t* p, size_t n, void*) {
+  on_dimmer(t, tl, p, n, &dim[levelIndex(t, tl)]);
+}
+static void on_any_text(const char* t, size_t tl, const uint8_t* p, size_t n, void*) {
+  on_text(t, tl, p, n, &txt[levelIndex(t, tl)]);
+}
+
+static std::vector<std::string> hits;
+static void tag(const char*, size_t, const uint8_t*, size_t, void* arg) { hits.push_back((const char*)arg); }
+
+static bool routes(const char* topic, const char* expect) {
+  hits.clear();
+  client.host_inject(topic, (const uint8_t*)"1", 1);
+  std::string got;
+  for (size_t i = 0; i < hits.size(); i++) got += (i ? "," : "") + hits[i];
+  if (got != expect) printf("  %s -> [%s], expected [%s]\n", topic, got.c_str(), expect);
+  return got == expect;
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp (topic handlers)");
+
+  mqttpanel_begin(&client, mq_receiver, mqtt_server, mqtt_port, mqtt_topic_head, 3, 10, 0, 4, 20);
+  for (int i = 0; i < 3; i++) mqttpanel_loop();
+  bench_check(client.connected(), "client connected after the first loops");
+
+  std::vector<String> topics;
+  for (int t = 0; t < 3; t++)
+    for (int i = 1; i <= 8; i++) topics.push_back(String(mqtt_topic_head) + kTypes[t] + "/" + String(i) + "/set");
+  const char* payloads[3] = { "1", "57", "Hello" };
+  auto inject = [&](unsigned long i) {
+    size_t k = i % topics.size();
+    const char* p = payloads[k / 8];
+    client.host_inject(topics[k].c_str(), (const uint8_t*)p, (unsigned)strlen(p));
+  };
+  const unsigned long N = bench_iters(500000);
+
+  // --- Generated if-chain (String callback) ---
+  BenchResult chain = bench_run("24 topics: generated if (topic == String(...)) chain", N, inject);
+  bench_check(sw[8] && dim[8] == 57 && txt[8] == "Hello", "if-chain applies the values");
+
+  // --- Match tree, 24 exact patterns ---
+  char pat[40];
+  bool ok = true;
+  for (int i = 1; i <= 8; i++) {
+    snprintf(pat, sizeof(pat), "switch/%d/set", i); ok &= mqttpanel_on(pat, on_switch, &sw[i]);
+    snprintf(pat, sizeof(pat), "dimmer/%d/set", i); ok &= mqttpanel_on(pat, on_dimmer, &dim[i]);
+    snprintf(pat, sizeof(pat), "text/%d/set", i);   ok &= mqttpanel_on(pat, on_text, &txt[i]);
+  }
+  bench_check(ok, "24 exact patterns fit the default tree");
+  for (int i = 1; i <= 8; i++) { sw[i] = false; dim[i] = 0; txt[i] = ""; }
+  fallback = 0;
+  BenchResult tree = bench_run("24 topics: mqttpanel_on, 24 exact patterns", N, inject);
+  bench_check(fallback == 0 && sw[8] && dim[8] == 57 && txt[8] == "Hello", "handlers apply the values, callback not called");
+  bench_check(tree.allocsPerOp == 0, "dispatch allocates nothing");
+  printf("per message: if-chain %.0f ns / %.1f allocs, match tree %.0f ns / %.1f allocs\n",
+         chain.nsPerOp, chain.allocsPerOp, tree.nsPerOp, tree.allocsPerOp);
+
+  // --- Match tree, 3 "+" patterns: the index comes from the topic ---
+  mqttpanel_on_clear();
+  mqttpanel_on("switch/+/set", on_any_switch);
+  mqttpanel_on("dimmer/+/set", on_any_dimmer);
+  mqttpanel_on("text/+/set", on_any_text);
+  for (int i = 1; i <= 8; i++) { sw[i] = false; dim[i] = 0; txt[i] = ""; }
+  BenchResult plus = bench_run("24 topics: mqttpanel_on, 3 '+' patterns", N, inject);
+  bench_check(fallback == 0 && sw[8] && dim[8] == 57 && txt[8] == "Hello" && plus.allocsPerOp == 0,
+              "'+' patterns route all 24 topics without allocating");
+
+  // --- Wildcard rules ---
+  mqttpanel_on_clear();
+  mqttpanel_on("switch/+/set", tag, (void*)"sw+");
+  mqttpanel_on("+/+/set", tag, (void*)"++set");
+  mqttpanel_on("cmd/#", tag, (void*)"cmd#");
+  mqttpanel_on("#", tag, (void*)"#");
+  mqttpanel_on("cmd/reboot", tag, (void*)"reboot");
+  mqttpanel_on("cmd/reboot", tag, (void*)"reboot2");
+  mqttpanel_on("sensor/+", tag, (void*)"sensor+");
+  std::string h = mqtt_topic_head;
+  bench_check(routes((h + "cmd/reboot").c_str(), "reboot,reboot2,cmd#,#"), "exact before '+' before '#', duplicates in order");
+  bench_check(routes((h + "cmd").c_str(), "cmd#,#"), "'a/#' also matches 'a'");
+  bench_check(routes((h + "cmd/a/b/c").c_str(), "cmd#,#"), "'#' matches any depth");
+  bench_check(routes((h + "switch/9/set").c_str(), "sw+,++set,#"), "'+' matches one level");
+  bench_check(routes((h + "sensor/1/raw").c_str(), "#"), "'+' does not match two levels");
+  bench_check(routes((h + "sensor/").c_str(), "sensor+,#"), "'+' matches an empty level");
+  bench_check(routes((h + "$sys/x").c_str(), ""), "wildcards skip a leading '$' level");
+  bench_check(routes("elsewhere/cmd/x", "#"), "topics outside <topic> match as a whole");
+
+  strcpy(mqtt_topic_head, "MyProject/1700000000000"); // the plain sketch form, no trailing slash
+  bench_check(routes("MyProject/1700000000000/cmd/reboot", "reboot,reboot2,cmd#,#"), "<topic> without a trailing slash");
+  strcpy(mqtt_topic_head, "MyProject/1700000000000/");
+
+  bench_check(!mqttpanel_on("a/#/b", tag, NULL), "'#' must be last");
+  bench_check(!mqttpanel_on("a+/b", tag, NULL) && !mqttpanel_on("a/b#", tag, NULL), "wildcards fill a whole level");
+
+  const char* l;
+  size_t n;
+  bool lvOk = mqttpanel_topic_level("a/bb/ccc", 8, -2, &l, &n) && n == 2 && !memcmp(l, "bb", 2);
+  lvOk = lvOk && mqttpanel_topic_level("a/bb/ccc", 8, 0, &l, &n) && n == 1 && *l == 'a';
+  lvOk = lvOk && !mqttpanel_topic_level("a/bb/ccc", 8, 3, &l, &n);
+  bench_check(lvOk, "mqttpanel_topic_level");
+
+  // --- Unmatched traffic still reaches the begin() callback ---
+  mqttpanel_on_clear();
+  mqttpanel_on("cmd/#", tag, (void*)"cmd#");
+  fallback = 0;
+  client.host_inject(topics[0].c_str(), (const uint8_t*)"1", 1);
+  bench_check(fallback == 1, "no match falls back to the begin() callback");
+
+  // --- Capacity: refused, never overwritten ---
+  char pat2[16];
+  int added = 0;
+  for (int i = 0; i < MP_MAX_HANDLERS; i++) {
+    snprintf(pat2, sizeof(pat2), "x/%d", i);
+    added += mqttpanel_on(pat2, tag, NULL);
+  }
+  bench_check(added == MP_MAX_HANDLERS - 1 && routes((h + "cmd/x").c_str(), "cmd#"), "registry refuses handlers once full");
+
+  return bench_finish();
+}
@@ -0,0 +1,200 @@
+// Tickless idle in mqttpanel.cpp on the simulated clock: the deadline
+// mqttpanel_idle() sleeps to (tasks, keepalive, backoff, replay, $stats,
+// button timers), early wake-ups from the button, a LAN datagram and a
+// dropped MQTT socket in the middle of a sleep, and the duty cycle of a node
+// that reports every 10 s compared with the spinning loop().
+//
+// Every mqttpanel_loop() pass is charged PASS_US of simulated CPU time, so
+// the duty cycle means "share of time the CPU is awake".
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient net;
+static PubSubClient client(net);
+static WiFiUDP lanUdp;
+static char mqtt_server[40] = "192.168.1.10";
+static char mqtt_port[6] = "1883";
+static char mqtt_topic[40] = "site/7";
+
+static const uint8_t BTN = 0, LED = 4;
+static const uint32_t PASS_US = 200;
+
+static unsigned long reports = 0, lanSets = 0;
+static void report(void*) { if (mqttpanel_is_connected()) mqttpanel_pub("site/7/status", "ok"); reports++; }
+static void rx_raw(const char*, size_t, const uint8_t*, size_t) {}
+static void on_set(const char*, size_t, const uint8_t*, size_t, void*) { lanSets++; }
+static bool on_button(const MpButtonEvent&, void*) { return true; }
+
+static unsigned long passes = 0;
+static void pass() {
+  mqttpanel_loop();
+  host::clock_advance_us(PASS_US);
+  passes++;
+}
+
+// What the sketch's loop() does in each mode, for `ms` of simulated time
+static void run_spin(unsigned long ms) {
+  for (unsigned long t = millis(); millis() - t < ms;) pass();
+}
+static void run_idle(unsigned long ms, uint16_t sliceMs = MP_IDLE_SLICE_MS) {
+  for (unsigned long t = millis(); millis() - t < ms;) {
+    pass();
+    mqttpanel_idle(1000, sliceMs);
+  }
+}
+
+static bool near(unsigned long v, unsigned long want, unsigned long tol) {
+  return v + tol >= want && v <= want + tol;
+}
+
+// --- Outside events, fired by the simulated clock in the middle of a sleep ---
+static int app = -1;
+static sockaddr_in device;
+static void ev_press() { host::gpio_set_input(BTN, LOW); }
+static void ev_release() { host::gpio_set_input(BTN, HIGH); }
+static void ev_datagram() {
+  const char* cmd = "dimmer/1/set 40";
+  sendto(app, cmd, strlen(cmd), 0, (sockaddr*)&device, sizeof(device));
+}
+static void ev_drop() { client.host_drop_connection(); }
+
+// One loop() pass, then a sleep that `fn` interrupts atMs into it
+static uint32_t idle_after(uint32_t atMs, void (*fn)()) {
+  pass();
+  host::clock_at(host::clock_now_us() + atMs * 1000ULL, fn);
+  return mqttpanel_idle(60000);
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp (tickless idle)");
+  host::clock_manual(true);
+  MpConnPolicy policy;
+  policy.portalAfterFailures = 0;
+  policy.portalOnWifiLoss = false;
+  policy.backoffMinMs = 2000;
+  policy.jitterPct = 0;
+  mqttpanel_conn_policy(policy);
+  mqttpanel_on_button(on_button);
+  mqttpanel_begin(&client, rx_raw, mqtt_server, mqtt_port, mqtt_topic, 3, 10, BTN, LED, 20);
+  mqttpanel_on("dimmer/+/set", on_set);
+  run_spin(50);
+  bench_check(client.connected(), "device is on the broker");
+
+  // --- Deadlines ---
+  bench_check(mqttpanel_idle_deadline() == policy.keepAliveSec * 250UL, "online, nothing scheduled: keepalive / 4");
+  int task = mqttpanel_every(1000, report);
+  bench_check(mqttpanel_idle_deadline() == 1000, "scheduled task is the next deadline");
+  mqttpanel_cancel(task);
+  mqttpanel_stats_interval(3000);
+  bench_check(mqttpanel_idle_deadline() == 3000, "$stats interval is a deadline");
+  mqttpanel_stats_interval(0);
+  bench_check(mqttpanel_idle(60000) == MP_IDLE_SLICE_MS, "no socket to watch: sleeps one slice at most");
+
+  mqttpanel_conn_socket(&net);
+  uint32_t slept = mqttpanel_idle(60000);
+  bench_check(slept == policy.keepAliveSec * 250UL, "with the socket: sleeps to the keepalive check");
+
+  client.host_set_connect_result(false);
+  client.host_drop_connection();
+  pass();
+  pass();
+  MpConnStats cs;
+  mqttpanel_conn_stats(&cs);
+  bench_check(cs.state == MP_CONN_BACKOFF && mqttpanel_idle_deadline() == cs.nextRetryMs,
+              "broker down: sleeps through the backoff");
+  for (int i = 0; i < 10; i++) mqttpanel_pub("site/7/log", String(i)); // buffered for replay
+  client.host_set_connect_result(true);
+  slept = mqttpanel_idle(60000);
+  for (int i = 0; i < 3; i++) pass(); // TCP, CONNECT, online
+  bench_check(slept == cs.nextRetryMs && client.connected(), "wakes on time for the retry, reconnects");
+  bench_check(mqttpanel_idle_deadline() <= 1000 / 20 + 1, "replay backlog: next deadline is the replay rate");
+  run_idle(2000);
+  MpSfStats sf;
+  mqttpanel_sf_stats(&sf);
+  bench_check(sf.queued == 0, "backlog replays while idling between messages");
+
+  // --- Wake-ups in the middle of a sleep ---
+  MpIdleStats st0, st;
+  mqttpanel_idle_stats(&st0);
+  slept = idle_after(1234, ev_press);
+  bench_check(near(slept, 1234, MP_IDLE_SLICE_MS), "button press wakes it (within one slice)");
+  pass();
+  slept = mqttpanel_idle(60000);
+  bench_check(near(slept, MP_BTN_DEBOUNCE_MS, 1), "then sleeps to the debounce timer");
+  bench_check(idle_after(200, ev_release) <= 200 + MP_IDLE_SLICE_MS, "release wakes it too");
+  run_idle(100);
+
+  app = socket(AF_INET, SOCK_DGRAM, 0);
+  bench_check(mqttpanel_lan_begin(&lanUdp, 0), "LAN endpoint opens");
+  memset(&device, 0, sizeof(device));
+  device.sin_family = AF_INET;
+  device.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  device.sin_port = htons(lanUdp.host_port());
+  slept = idle_after(500, ev_datagram);
+  bench_check(near(slept, 500, MP_IDLE_SLICE_MS), "LAN datagram wakes it");
+  pass();
+  bench_check(lanSets == 1, "the datagram that woke it is handled, not lost");
+
+  policy.keepAliveSec = 60; // keep the keepalive out of the way of the next check
+  mqttpanel_conn_policy(policy);
+  slept = idle_after(700, ev_drop);
+  bench_check(near(slept, 700, MP_IDLE_SLICE_MS), "MQTT socket closing wakes it");
+  mqttpanel_idle_stats(&st);
+  bench_check(st.wakeButton - st0.wakeButton == 2 && st.wakeIo - st0.wakeIo == 2, "wake reasons are counted");
+  run_idle(500);
+  policy.keepAliveSec = 15;
+  mqttpanel_conn_policy(policy);
+  run_idle(policy.backoffMinMs + 500);
+  bench_check(client.connected(), "back online");
+
+  // --- Duty cycle: one report every 10 s for a minute ---
+  const unsigned long MIN_MS = 60000;
+  printf("%-34s %10s %10s %9s %9s\n", "loop()", "passes", "reports", "awake %", "max sleep");
+  task = mqttpanel_every(10000, report);
+  passes = reports = 0;
+  mqttpanel_idle_stats_reset();
+  run_spin(MIN_MS);
+  unsigned long spinPasses = passes, spinReports = reports;
+  printf("%-34s %10lu %10lu %9s %9s\n", "mqttpanel_loop() only (spinning)", spinPasses, spinReports, "100", "-");
+
+  mqttpanel_conn_socket(NULL);
+  passes = reports = 0;
+  mqttpanel_idle_stats_reset();
+  run_idle(MIN_MS);
+  mqttpanel_idle_stats(&st);
+  unsigned long slicePasses = passes;
+  printf("%-34s %10lu %10lu %9u %9u\n", "+ mqttpanel_idle(), no socket", passes, reports, (unsigned)st.awakePct,
+         (unsigned)st.maxSleepMs);
+  bench_check(near(reports, spinReports, 1) && st.awakePct <= 3, "no socket: same work, a few % awake");
+
+  mqttpanel_conn_socket(&net);
+  passes = reports = 0;
+  mqttpanel_idle_stats_reset();
+  MpTaskStats ts;
+  run_idle(MIN_MS, 100);
+  mqttpanel_idle_stats(&st);
+  mqttpanel_task_stats(task, &ts);
+  printf("%-34s %10lu %10lu %9.3f %9u\n", "+ mqttpanel_idle(1000, 100), socket", passes, reports,
+         st.awakeMs * 100.0 / MIN_MS, (unsigned)st.maxSleepMs);
+  bench_check(near(reports, spinReports, 1) && ts.late.maxUs <= 1000 + PASS_US, "tasks still run on time");
+  bench_check(passes * 50 < slicePasses && st.maxSleepMs <= 1000, "with the socket: passes only for real deadlines");
+  printf("duty cycle: spinning %lu passes/min -> %lu with idle (%.0fx fewer wake-ups)\n", spinPasses, passes,
+         (double)spinPasses / (double)passes);
+
+  // --- Cost of working out the deadline ---
+  host::clock_manual(false);
+  const unsigned long N = bench_iters(1000000);
+  BenchResult dl = bench_run("mqttpanel_idle_deadline()", N, [](unsigned long) { (void)mqttpanel_idle_deadline(); });
+  bench_check(dl.allocsPerOp == 0, "deadline computation does not allocate");
+
+  close(app);
+  return bench_finish();
+}
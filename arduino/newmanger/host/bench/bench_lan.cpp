@@ -0,0 +1,119 @@
+// Direct LAN control channel in mqttpanel.cpp: newmanger.ino answers
+// "dimmer/<n>/set" datagrams from an app-side UDP socket over loopback with
+// "dimmer/<n>/val", without the broker. Checks the line format, that the
+// broker path keeps working alongside (and without) it, peer expiry, and
+// times the set -> val round trip through the real socket shim.
+
+#include "newmanger.ino"
+#include "bench.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+static int app = -1;                 // the phone
+static sockaddr_in device;
+
+static void app_send(const std::string& s) {
+  sendto(app, s.data(), s.size(), 0, (sockaddr*)&device, sizeof(device));
+}
+
+// Runs loop() until nothing more arrives for the app; returns every datagram it got.
+static std::vector<std::string> app_recv(int passes = 3) {
+  std::vector<std::string> got;
+  char buf[512];
+  for (int i = 0; i < passes; i++) {
+    loop();
+    for (ssize_t n; (n = recv(app, buf, sizeof(buf), MSG_DONTWAIT)) > 0;) got.emplace_back(buf, (size_t)n);
+  }
+  return got;
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp (direct LAN control over UDP)");
+  host::clock_manual(true);
+  setup();
+  for (int i = 0; i < 10 && !client.connected(); i++) loop();
+  bench_check(client.connected(), "device is on the broker");
+
+  // The sketch asked for UDP 1884; rebind to a free port so parallel runs do not collide
+  bench_check(mqttpanel_lan_begin(&lanUdp, 0), "LAN endpoint opens");
+  app = socket(AF_INET, SOCK_DGRAM, 0);
+  memset(&device, 0, sizeof(device));
+  device.sin_family = AF_INET;
+  device.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  device.sin_port = htons(lanUdp.host_port());
+
+  // --- Protocol ---
+  MpLanStats st;
+  app_send("?");
+  bench_check(app_recv().empty(), "hello is not answered");
+  mqttpanel_lan_stats(&st);
+  bench_check(st.peers == 1 && st.cmds == 0, "hello registers the phone");
+
+  unsigned long brokerPubs = client.host_pub_count();
+  app_send("dimmer/1/set 40");
+  std::vector<std::string> got = app_recv();
+  bench_check(got.size() == 1 && got[0] == "dimmer/1/val 40", "set is answered with val, straight from the device");
+  bench_check(client.host_pub_count() == brokerPubs + 1, "the broker still gets the val (remote viewers)");
+
+  app_send("dimmer/1/set 10\r\ndimmer/2/set 250\n");
+  got = app_recv();
+  bench_check(got.size() == 2 && got[0] == "dimmer/1/val 10" && got[1] == "dimmer/2/val 100",
+              "several lines per datagram, same handler as the broker path");
+
+  mqttpanel_lan_stats(&st);
+  unsigned long bad = st.bad;
+  app_send("dimmer/1/val 5");
+  app_send("status Running");
+  app_send(std::string(MP_LAN_PACKET + 1, 'x'));
+  bench_check(app_recv().empty(), "only /set topics are accepted");
+  mqttpanel_lan_stats(&st);
+  bench_check(st.bad == bad + 3, "rejected lines are counted");
+
+  // --- Broker-originated sets reach the LAN phone too (its sliders stay in sync) ---
+  std::string remote = std::string(mqtt_topic) + "/dimmer/3/set";
+  client.host_inject(remote.c_str(), (const uint8_t*)"70", 2);
+  got = app_recv();
+  bench_check(got.size() == 1 && got[0] == "dimmer/3/val 70", "remote set is mirrored to LAN peers");
+
+  // --- Broker down: LAN control keeps working ---
+  client.host_set_connect_result(false);
+  client.host_drop_connection();
+  app_send("dimmer/1/set 55");
+  got = app_recv();
+  bench_check(!client.connected() && got.size() == 1 && got[0] == "dimmer/1/val 55", "LAN works without the broker");
+  client.host_set_connect_result(true);
+  for (int i = 0; i < 2000 && !client.connected(); i++) { loop(); delay(10); }
+
+  // --- Peers expire ---
+  delay(MP_LAN_PEER_TTL_MS);
+  mqttpanel_lan_stats(&st);
+  unsigned long vals = st.vals;
+  on_dimmer(remote.c_str(), remote.size(), (const uint8_t*)"1", 1, nullptr);
+  mqttpanel_lan_stats(&st);
+  bench_check(st.peers == 0 && st.vals == vals, "silent phones stop getting vals");
+
+  // --- Round trip through the socket shim (device work + loopback kernel path) ---
+  host::clock_manual(false);
+  app_send("?");
+  app_recv();
+  const unsigned long N = bench_iters(200000);
+  unsigned long answered = 0;
+  char buf[64];
+  static const char* cmds[4] = { "dimmer/1/set 10", "dimmer/1/set 20", "dimmer/1/set 30", "dimmer/1/set 40" };
+  bench_run("LAN set -> val round trip (UDP loopback)", N, [&](unsigned long i) {
+    const char* c = cmds[i & 3];
+    sendto(app, c, strlen(c), 0, (sockaddr*)&device, sizeof(device));
+    loop();
+    if (recv(app, buf, sizeof(buf), MSG_DONTWAIT) > 0) answered++;
+  });
+  bench_check(answered == N + N / 10 + 1, "every timed set got its val in the same loop() pass");
+
+  close(app);
+  return bench_finish();
+}
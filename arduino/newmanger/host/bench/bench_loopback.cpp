@@ -0,0 +1,226 @@
+// End-to-end set -> val latency over real TCP: newmanger.ino + mqttpanel.cpp
+// (built-in MQTT client) run as the "device" on their own thread, an app-side
+// client publishes <topic>/dimmer/1/set at fixed rates and times each echoed
+// <topic>/dimmer/1/val. Reports p50/p99/p999 per rate and the highest rate
+// the device sustains, as a table and as one JSON line (--json=FILE also
+// writes it to a file) for comparing revisions.
+//
+// Broker: the in-process MiniBroker on a free port, or an external one with
+// --broker=host:port (or MP_BROKER=host:port), e.g. a local mosquitto.
+// Runs on the real clock; the device thread sleeps in host_wait() between
+// loop() passes instead of spinning, so it also works on a single core.
+
+#include "newmanger.ino"
+#include "mini_broker.h"
+#include "bench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static std::atomic<bool> deviceRun{true};
+
+static void device_main() {
+  setup();
+  while (deviceRun) {
+    loop();
+    espClient.host_wait(1000);
+  }
+}
+
+// --- App side ---
+static WiFiClient appSock;
+static MpMqttClient app(appSock);
+static std::vector<uint32_t> sentAt; // micros() of every set, in send order
+static std::vector<uint32_t> lat;    // set -> val, microseconds
+static size_t nextVal = 0;           // vals arrive in set order (one TCP path each way)
+static unsigned long wrongVal = 0, extraVal = 0;
+
+static void on_val(char*, uint8_t* payload, unsigned int len) {
+  uint32_t now = micros();
+  if (nextVal >= sentAt.size()) {
+    extraVal++;
+    return;
+  }
+  int v = 0;
+  for (unsigned i = 0; i < len; i++) v = v * 10 + (payload[i] - '0');
+  if (v != (int)(nextVal % 101)) wrongVal++;
+  lat.push_back(now - sentAt[nextVal++]);
+}
+
+static void app_wait(uint32_t us) {
+  app.loop();
+  if (us) appSock.host_wait(us);
+  app.loop();
+}
+
+struct Step {
+  unsigned long offered;
+  double achieved;
+  unsigned long sent, received;
+  uint32_t p50, p99, p999, max;
+  bool ok;
+};
+
+static uint32_t pct(const std::vector<uint32_t>& v, double p) {
+  if (v.empty()) return 0;
+  size_t k = (size_t)(p * (double)v.size());
+  return v[k < v.size() ? k : v.size() - 1];
+}
+
+// Open loop: set i goes out at start + i / rate whether or not earlier vals
+// came back, so a device that falls behind shows up as growing latency.
+static Step run_rate(const char* setTopic, unsigned long rate, uint32_t durMs, uint32_t sloUs) {
+  sentAt.clear();
+  lat.clear();
+  nextVal = 0;
+  unsigned long n = rate * durMs / 1000;
+  if (n == 0) n = 1;
+  sentAt.reserve(n);
+  lat.reserve(n);
+  uint32_t start = micros();
+  char payload[8];
+  for (unsigned long i = 0; i < n && app.connected(); i++) {
+    uint32_t due = start + (uint32_t)((uint64_t)i * 1000000 / rate);
+    for (int32_t left; (left = (int32_t)(due - micros())) > 0;) app_wait((uint32_t)std::min<int32_t>(left, 1000));
+    snprintf(payload, sizeof(payload), "%lu", i % 101);
+    sentAt.push_back(micros());
+    app.publish(setTopic, payload);
+    app.flush();
+    app.loop();
+  }
+  uint32_t end = micros();
+  uint32_t waitFrom = millis();
+  while (nextVal < sentAt.size() && millis() - waitFrom < 1000) app_wait(1000);
+
+  Step s;
+  s.offered = rate;
+  s.sent = sentAt.size();
+  s.received = lat.size();
+  s.achieved = end != start ? (double)s.sent * 1e6 / (double)(end - start) : 0;
+  std::sort(lat.begin(), lat.end());
+  s.p50 = pct(lat, 0.50);
+  s.p99 = pct(lat, 0.99);
+  s.p999 = pct(lat, 0.999);
+  s.max = lat.empty() ? 0 : lat.back();
+  s.ok = s.sent == n && s.received == s.sent && s.achieved >= 0.95 * rate && s.p99 <= sloUs;
+  return s;
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "newmanger.ino + mqttpanel.cpp (set -> val loopback over TCP)");
+  const char* brokerArg = getenv("MP_BROKER");
+  const char* jsonPath = nullptr;
+  uint32_t sloMs = 20;
+  bool quick = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i], "--broker=", 9)) brokerArg = argv[i] + 9;
+    else if (!strncmp(argv[i], "--json=", 7)) jsonPath = argv[i] + 7;
+    else if (!strncmp(argv[i], "--slo-ms=", 9)) sloMs = (uint32_t)atoi(argv[i] + 9);
+    else if (!strcmp(argv[i], "--quick")) quick = true;
+  }
+
+  MiniBroker broker;
+  std::string host = "127.0.0.1";
+  uint16_t port = 0;
+  if (brokerArg && *brokerArg) {
+    std::string b = brokerArg;
+    size_t colon = b.rfind(':');
+    host = b.substr(0, colon);
+    port = colon == std::string::npos ? 1883 : (uint16_t)atoi(b.c_str() + colon + 1);
+  } else {
+    bench_check(broker.start(), "built-in broker listens on 127.0.0.1");
+    port = broker.port();
+  }
+  printf("broker: %s:%u (%s)\n", host.c_str(), (unsigned)port, brokerArg && *brokerArg ? "external" : "built-in");
+
+  // The sketch's defaults; mqttpanel_begin keeps them (no saved config on the host)
+  host::tcp_use_sockets(true);
+  snprintf(mqtt_server, sizeof(mqtt_server), "%s", host.c_str());
+  snprintf(mqtt_port, sizeof(mqtt_port), "%u", (unsigned)port);
+  snprintf(mqtt_topic, sizeof(mqtt_topic), "mpbench/%u", (unsigned)getpid());
+  std::thread device(device_main);
+
+  std::string setTopic = std::string(mqtt_topic) + "/dimmer/1/set";
+  std::string valTopic = std::string(mqtt_topic) + "/dimmer/1/val";
+  app.setServer(host.c_str(), port);
+  app.setCallback(on_val);
+  app.setTxBufferSize(64);
+  bool up = false;
+  for (int i = 0; i < 50 && !up; i++) {
+    up = app.connect("mpbench-app");
+    if (!up) delay(100);
+  }
+  bench_check(up, "app connects to the broker");
+  app.subscribe(valTopic.c_str());
+
+  // Device online and subscribed: the first set that comes back
+  bool echo = false;
+  uint32_t t0 = millis();
+  while (up && !echo && millis() - t0 < 10000) {
+    sentAt.assign(1, micros());
+    nextVal = 0;
+    lat.clear();
+    app.publish(setTopic.c_str(), "0");
+    for (uint32_t w = millis(); lat.empty() && millis() - w < 200;) app_wait(1000);
+    echo = !lat.empty();
+  }
+  bench_check(echo, "device answers dimmer/1/set with dimmer/1/val");
+  for (uint32_t w = millis(); millis() - w < 200;) app_wait(1000); // late answers to the probes
+
+  std::vector<Step> steps;
+  unsigned long best = 0;
+  if (echo) {
+    std::vector<unsigned long> rates;
+    if (quick) rates = {100, 1000};
+    else for (unsigned long r = 250; r <= 256000; r *= 2) rates.push_back(r);
+    uint32_t durMs = quick ? 300 : 2000;
+    printf("%10s %10s %8s %8s %9s %9s %9s %9s  %s\n", "offered/s", "achieved/s", "sent", "lost",
+           "p50 us", "p99 us", "p999 us", "max us", "sustained");
+    for (unsigned long r : rates) {
+      Step s = run_rate(setTopic.c_str(), r, durMs, sloMs * 1000);
+      steps.push_back(s);
+      printf("%10lu %10.0f %8lu %8lu %9u %9u %9u %9u  %s\n", s.offered, s.achieved, s.sent, s.sent - s.received,
+             (unsigned)s.p50, (unsigned)s.p99, (unsigned)s.p999, (unsigned)s.max, s.ok ? "yes" : "no");
+      fflush(stdout);
+      if (!s.ok) break;
+      best = r;
+    }
+    printf("max sustained: %lu set/s (no loss, >= 95%% of offered, p99 <= %u ms)\n", best, (unsigned)sloMs);
+    bench_check(steps[0].received == steps[0].sent && wrongVal == 0, "every set is answered with its own value");
+    bench_check(best >= 100, "sustains at least 100 set/s");
+  }
+
+  std::string json = "{\"bench\":\"loopback\",\"client\":\"mpmqtt\",\"broker\":\"";
+  json += brokerArg && *brokerArg ? "external" : "builtin";
+  json += "\",\"slo_p99_us\":" + std::to_string(sloMs * 1000) + ",\"steps\":[";
+  for (size_t i = 0; i < steps.size(); i++) {
+    const Step& s = steps[i];
+    char row[256];
+    snprintf(row, sizeof(row),
+             "%s{\"offered\":%lu,\"achieved\":%.0f,\"sent\":%lu,\"received\":%lu,\"p50_us\":%u,\"p99_us\":%u,"
+             "\"p999_us\":%u,\"max_us\":%u,\"sustained\":%s}",
+             i ? "," : "", s.offered, s.achieved, s.sent, s.received, (unsigned)s.p50, (unsigned)s.p99,
+             (unsigned)s.p999, (unsigned)s.max, s.ok ? "true" : "false");
+    json += row;
+  }
+  json += "],\"max_sustained_per_sec\":" + std::to_string(best) + "}";
+  printf("%s\n", json.c_str());
+  if (jsonPath) {
+    FILE* f = fopen(jsonPath, "w");
+    bench_check(f != nullptr, "--json file can be written");
+    if (f) {
+      fprintf(f, "%s\n", json.c_str());
+      fclose(f);
+    }
+  }
+
+  app.disconnect();
+  deviceRun = false;
+  device.join();
+  broker.stop();
+  return bench_finish();
+}
@@ -0,0 +1,121 @@
+// Runtime metrics in mqttpanel.cpp: cost of the counters on the loop and
+// receive paths (on vs. off), the histograms, the heap low-watermark and the
+// periodic <topic>/$stats publish.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <string>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static char mqtt_server[40] = "127.0.0.1";
+static char mqtt_port[6] = "1883";
+static char mqtt_topic[40] = "MyProject/1700000000000";
+
+static unsigned long rxCount = 0;
+static uint64_t rxWorkUs = 0; // simulated callback duration (manual clock)
+
+static void rx_raw(const char*, size_t, const uint8_t*, size_t) {
+  rxCount++;
+  if (rxWorkUs) host::clock_advance_us(rxWorkUs);
+}
+
+static std::string statsTopic, statsPayload;
+static unsigned long statsCount = 0;
+
+static void record(const char* topic, const uint8_t* payload, unsigned int len, bool) {
+  if (!strstr(topic, "/$stats")) return;
+  statsCount++;
+  statsTopic = topic;
+  statsPayload.assign((const char*)payload, len);
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp (metrics)");
+
+  mqttpanel_begin(&client, rx_raw, mqtt_server, mqtt_port, mqtt_topic, 3, 10, 0, 4, 20);
+  for (int i = 0; i < 3; i++) mqttpanel_loop();
+  bench_check(client.connected(), "client connected after the first loops");
+
+  const unsigned long N = bench_iters(2000000);
+  String dimTopic = String(mqtt_topic) + "/dimmer/1/set";
+
+  // --- Overhead: the same loop / receive with the counters off and on ---
+  // Wall-clock numbers are only printed: under a parallel ctest they say more about the machine than the code.
+  mqttpanel_metrics_enable(false);
+  BenchResult loopOff = bench_run("loop: metrics off", N, [&](unsigned long) { mqttpanel_loop(); });
+  mqttpanel_metrics_enable(true);
+  BenchResult loopOn = bench_run("loop: metrics on", N, [&](unsigned long) { mqttpanel_loop(); });
+
+  mqttpanel_metrics_enable(false);
+  BenchResult rxOff = bench_run("rx raw cb: metrics off", N, [&](unsigned long) {
+    client.host_inject(dimTopic.c_str(), (const uint8_t*)"57", 2);
+  });
+  mqttpanel_metrics_enable(true);
+  BenchResult rxOn = bench_run("rx raw cb: metrics on", N, [&](unsigned long) {
+    client.host_inject(dimTopic.c_str(), (const uint8_t*)"57", 2);
+  });
+
+  double loopCost = loopOn.nsPerOp - loopOff.nsPerOp, rxCost = rxOn.nsPerOp - rxOff.nsPerOp;
+  printf("overhead: loop %+.1f ns, rx %+.1f ns (two clock reads + a bucket increment)\n", loopCost, rxCost);
+  bench_check(loopOn.allocsPerOp == 0 && rxOn.allocsPerOp == 0, "metrics allocate nothing");
+
+  MpMetrics m;
+  mqttpanel_metrics(&m);
+  bench_check(m.loops >= N && m.msgsIn >= N, "loops and inbound messages are counted");
+
+  // --- Deterministic checks on the manual clock ---
+  host::clock_manual(true);
+  mqttpanel_metrics_reset();
+  rxCount = 0;
+  rxWorkUs = 3000;
+  for (int i = 0; i < 99; i++) client.host_inject(dimTopic.c_str(), (const uint8_t*)"57", 2);
+  rxWorkUs = 40000;
+  client.host_inject(dimTopic.c_str(), (const uint8_t*)"57", 2);
+  rxWorkUs = 0;
+  mqttpanel_metrics(&m);
+  bench_check(m.msgsIn == 100 && m.bytesIn == 100 * (dimTopic.length() + 2), "inbound messages and bytes");
+  bench_check(mqttpanel_hist_percentile(m.rx, 50) == 4096 && mqttpanel_hist_percentile(m.rx, 99) == 4096 &&
+              mqttpanel_hist_percentile(m.rx, 100) == 40000 && m.rx.maxUs == 40000,
+              "rx histogram: 3 ms callbacks land below 4096 us, the 40 ms one sets the max");
+
+  mqttpanel_pub(String(mqtt_topic) + "/status", "ok");
+  mqttpanel_metrics(&m);
+  bench_check(m.msgsOut == 1 && m.bytesOut == strlen(mqtt_topic) + 7 + 2, "outbound messages and bytes");
+
+  host::heap_set(20000, 9000);
+  delay(200);
+  mqttpanel_loop();
+  host::heap_set(40 * 1024, 32 * 1024);
+  delay(200);
+  mqttpanel_loop();
+  mqttpanel_metrics(&m);
+  bench_check(m.heapFree == 40 * 1024 && m.heapMin == 20000 && m.blockMin == 9000, "heap low-watermark survives recovery");
+
+  client.host_drop_connection();
+  for (int i = 0; i < 400 && !client.connected(); i++) { mqttpanel_loop(); delay(10); }
+  mqttpanel_metrics(&m);
+  bench_check(m.reconnects == 1, "reconnects are counted");
+
+  // --- $stats ---
+  client.host_set_observer(record);
+  mqttpanel_stats_interval(60000);
+  for (int i = 0; i < 12050; i++) { mqttpanel_loop(); delay(10); } // just over 2 simulated minutes
+  bench_check(statsCount == 2, "one $stats per interval");
+  printf("%s %s (%u bytes)\n", statsTopic.c_str(), statsPayload.c_str(), (unsigned)statsPayload.size());
+  bench_check(statsTopic == std::string(mqtt_topic) + "/$stats", "stats go to <topic>/$stats");
+  bench_check(statsPayload.find("\"heapMin\":20000") != std::string::npos &&
+              statsPayload.find("\"rc\":1") != std::string::npos &&
+              statsPayload.find("\"rx\":[4096,4096,40000]") != std::string::npos,
+              "stats payload carries the counters");
+
+  unsigned long before = rxCount;
+  client.host_inject(statsTopic.c_str(), (const uint8_t*)statsPayload.data(), (unsigned)statsPayload.size());
+  bench_check(rxCount == before, "our own $stats echo is not delivered to the callback");
+  client.host_set_observer(nullptr);
+
+  return bench_finish();
+}
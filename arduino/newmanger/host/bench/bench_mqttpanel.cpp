@@ -0,0 +1,82 @@
+// Benchmarks for mqttpanel.cpp: inbound dispatch (_internal_callback via the
+// PubSubClient callback) and outbound mqttpanel_pub.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static char mqtt_server[40] = "127.0.0.1";
+static char mqtt_port[6] = "1883";
+static char mqtt_topic[40] = "MyProject/1700000000000";
+
+static unsigned long rxCount = 0;
+static unsigned long rxBytes = 0;
+
+static void rx_string(String topic, String msg) {
+  rxCount++;
+  rxBytes += topic.length() + msg.length();
+}
+
+static void rx_raw(const char* topic, size_t topicLen, const uint8_t* payload, size_t len) {
+  (void)topic; (void)payload;
+  rxCount++;
+  rxBytes += topicLen + len;
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp");
+
+  mqttpanel_begin(&client, rx_string, mqtt_server, mqtt_port, mqtt_topic, 3, 10, 0, 4, 20);
+  // The connection state machine does one step per loop (see bench_reconnect).
+  for (int i = 0; i < 3; i++) mqttpanel_loop(); // connects + subscribes <topic>/#
+  bench_check(client.connected(), "client connected after the first loops");
+
+  const unsigned long N = bench_iters(1000000);
+
+  // --- Inbound ---
+  String dimTopic = String(mqtt_topic) + "/dimmer/1/set";
+  String txtTopic = String(mqtt_topic) + "/text/1/set";
+  const char* txtPayload = "The quick brown fox jumps over the lazy dog 0123456789";
+
+  rxCount = 0;
+  bench_run("rx String cb: dimmer/1/set \"57\"", N, [&](unsigned long) {
+    client.host_inject(dimTopic.c_str(), (const uint8_t*)"57", 2);
+  });
+  bench_check(rxCount > 0, "String callback received messages");
+
+  bench_run("rx String cb: text/1/set 54B", N, [&](unsigned long) {
+    client.host_inject(txtTopic.c_str(), (const uint8_t*)txtPayload, (unsigned)strlen(txtPayload));
+  });
+
+  // Same traffic through the zero-copy callback.
+  mqttpanel_begin(&client, rx_raw, mqtt_server, mqtt_port, mqtt_topic, 3, 10, 0, 4, 20);
+  rxCount = 0;
+  bench_run("rx raw cb: dimmer/1/set \"57\"", N, [&](unsigned long) {
+    client.host_inject(dimTopic.c_str(), (const uint8_t*)"57", 2);
+  });
+  BenchResult raw = bench_run("rx raw cb: text/1/set 54B", N, [&](unsigned long) {
+    client.host_inject(txtTopic.c_str(), (const uint8_t*)txtPayload, (unsigned)strlen(txtPayload));
+  });
+  bench_check(rxCount > 0, "raw callback received messages");
+  bench_check(raw.allocsPerOp == 0, "raw inbound path allocates nothing");
+
+  // --- Outbound ---
+  String valTopic = String(mqtt_topic) + "/dimmer/1/val";
+  String valPayload = "57";
+  client.host_reset_counters();
+  bench_run("pub mqttpanel_pub(String, String)", N, [&](unsigned long) {
+    mqttpanel_pub(valTopic, valPayload);
+  });
+  bench_check(client.host_pub_count() > 0, "mqttpanel_pub reached the client");
+
+  // The sketch idiom: topic built with String + on every call.
+  bench_run("pub sketch idiom String(topic)+\"/status\"", N, [&](unsigned long) {
+    mqttpanel_pub(String(mqtt_topic) + "/status", "Running...");
+  });
+
+  return bench_finish();
+}
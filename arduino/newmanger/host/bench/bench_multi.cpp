@@ -0,0 +1,154 @@
+// Two brokers in mqttpanel.cpp: the main panel on a LAN broker plus a second
+// MqttPanel on a cloud broker. Checks that connections, handlers and
+// store-and-forward stay independent (a cloud outage does not touch the
+// local path), and measures the bridge: /val topics mirrored to the cloud at
+// a reduced rate, latest value wins.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <string>
+#include <map>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient lanNet, cloudNet;
+static PubSubClient lan(lanNet), cloudClient(cloudNet);
+static MqttPanel cloud;
+
+static char mqtt_server[40] = "192.168.1.10";
+static char mqtt_port[6] = "1883";
+static char mqtt_topic[40] = "site/7";
+static const char* cloudTopic = "fleet/site7";
+
+static unsigned long lanPubs = 0, cloudPubs = 0;
+static std::map<std::string, std::string> cloudLast; // topic -> last payload the cloud got
+static unsigned long localSets = 0, cloudCmds = 0, unmatched = 0;
+
+static void lan_obs(const char*, const uint8_t*, unsigned int, bool) { lanPubs++; }
+static void cloud_obs(const char* topic, const uint8_t* payload, unsigned int len, bool) {
+  cloudPubs++;
+  cloudLast[topic].assign((const char*)payload, len);
+}
+static void rx_raw(const char*, size_t, const uint8_t*, size_t) { unmatched++; }
+static void on_set(const char*, size_t, const uint8_t*, size_t, void*) { localSets++; }
+static void on_cmd(const char*, size_t, const uint8_t*, size_t, void*) { cloudCmds++; }
+
+static void inject(PubSubClient& c, const std::string& topic, const std::string& payload) {
+  c.host_inject(topic.c_str(), (const uint8_t*)payload.data(), (unsigned)payload.size());
+}
+
+static void run_ms(unsigned long ms) {
+  for (unsigned long t = millis(); millis() - t < ms;) { mqttpanel_loop(); delay(1); }
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp (two brokers + bridge)");
+  host::clock_manual(true);
+
+  MpConnPolicy policy;
+  policy.backoffMinMs = 100;
+  policy.backoffMaxMs = 1000;
+  policy.portalAfterFailures = 0;
+  mqttpanel_conn_policy(policy);
+  mqttpanel_begin(&lan, rx_raw, mqtt_server, mqtt_port, mqtt_topic, 3, 10, 0, 4, 20);
+  cloud.conn_policy(policy);
+  cloud.sf_config(100, 0);
+  bench_check(cloud.begin(&cloudClient, rx_raw, "cloud.example.com", 8883, cloudTopic), "second panel starts");
+  MqttPanel extra;
+  bench_check(MP_MAX_PANELS > 2 || !extra.begin(&cloudClient, rx_raw, "x", 1883, "x"), "panel slots are bounded");
+  run_ms(50);
+  bench_check(lan.connected() && cloudClient.connected() && cloud.connected(), "both panels connect");
+  lan.host_set_observer(lan_obs);
+  cloudClient.host_set_observer(cloud_obs);
+
+  // --- Independent handler trees and publish paths ---
+  mqttpanel_on("dimmer/+/set", on_set);
+  cloud.on("cmd/#", on_cmd);
+  inject(lan, "site/7/dimmer/1/set", "40");
+  inject(cloudClient, "fleet/site7/cmd/reboot", "1");
+  inject(cloudClient, "fleet/site7/dimmer/1/set", "40"); // cloud panel has no such handler
+  bench_check(localSets == 1 && cloudCmds == 1 && unmatched == 1, "each panel dispatches with its own handlers");
+  mqttpanel_pub("site/7/dimmer/1/val", "40");
+  cloud.pub("fleet/site7/status", "ok");
+  bench_check(lanPubs == 1 && cloudPubs == 1, "mqttpanel_pub and cloud.pub use their own clients");
+
+  // --- Bridge: 4 dimmers report at 100 Hz each on the LAN, the cloud gets 1 Hz per topic ---
+  bench_check(mqttpanel_main().bridge(cloud, "dimmer/+/val", 1000), "bridge rule accepted");
+  bench_check(!cloud.bridge(cloud, "#", 0), "a panel does not bridge to itself");
+  lanPubs = cloudPubs = 0;
+  cloudLast.clear();
+  const int secs = 10;
+  unsigned long localIn = 0;
+  for (int tick = 0; tick < secs * 100; tick++) {
+    for (int d = 1; d <= 4; d++) {
+      // what the LAN broker echoes back through <topic>/# for the device's own /val publishes
+      inject(lan, "site/7/dimmer/" + std::to_string(d) + "/val", std::to_string(tick * 4 + d));
+      localIn++;
+    }
+    run_ms(10);
+  }
+  run_ms(1100); // the last values are due one interval later
+  MpBridgeStats bs;
+  mqttpanel_main().bridge_stats(&bs);
+  printf("bridge: %lu local msgs in %d s -> %u to the cloud (seen %u, coalesced %u, dropped %u)\n", localIn, secs,
+         (unsigned)bs.forwarded, (unsigned)bs.seen, (unsigned)bs.coalesced, (unsigned)bs.dropped);
+  bench_check(bs.seen == localIn && bs.dropped == 0, "every local /val is seen by the bridge");
+  bench_check(bs.forwarded >= 4 * secs && bs.forwarded <= 4 * (secs + 2),
+              "cloud rate is one message per topic per interval");
+  bench_check(bs.forwarded + bs.coalesced == bs.seen, "every value is either forwarded or replaced by a newer one");
+  bool latest = true;
+  for (int d = 1; d <= 4; d++) {
+    latest &= cloudLast["fleet/site7/dimmer/" + std::to_string(d) + "/val"] == std::to_string((secs * 100 - 1) * 4 + d);
+  }
+  bench_check(latest, "the cloud ends with the newest value of every topic");
+  bench_check(lanPubs == 0, "nothing is sent back to the LAN broker");
+
+  // --- Cloud outage: the local path is untouched, bridged values wait (latest only) ---
+  cloudClient.host_set_connect_result(false);
+  cloudClient.host_drop_connection();
+  localSets = 0;
+  cloudPubs = 0;
+  for (int tick = 0; tick < 500; tick++) {
+    inject(lan, "site/7/dimmer/1/set", std::to_string(tick % 101));
+    inject(lan, "site/7/dimmer/1/val", std::to_string(tick));
+    mqttpanel_pub("site/7/dimmer/1/val", std::to_string(tick).c_str());
+    cloud.pub("fleet/site7/status", String(tick));
+    run_ms(10);
+  }
+  MpSfStats lanSf, cloudSf;
+  mqttpanel_sf_stats(&lanSf);
+  cloud.sf_stats(&cloudSf);
+  MpConnStats lanConn, cloudConn;
+  mqttpanel_conn_stats(&lanConn);
+  cloud.conn_stats(&cloudConn);
+  bench_check(localSets == 500 && lan.connected() && lanConn.failures == 0,
+              "LAN control keeps working during a cloud outage");
+  bench_check(lanSf.queued == 0 && cloudSf.queued > 0, "only the cloud panel buffers");
+  bench_check(cloudConn.failures > 0 && cloudPubs == 0, "the cloud panel retries on its own");
+  cloudClient.host_set_connect_result(true);
+  cloudLast.clear();
+  run_ms(3000);
+  cloud.sf_stats(&cloudSf);
+  bench_check(cloud.connected() && cloudSf.queued == 0, "cloud reconnects and replays its backlog");
+  bench_check(cloudLast["fleet/site7/dimmer/1/val"] == "499", "bridged topic resumes with its newest value");
+
+  // --- Cost on the local receive path ---
+  host::clock_manual(false);
+  lan.host_set_observer(nullptr);
+  cloudClient.host_set_observer(nullptr);
+  const unsigned long N = bench_iters(1000000);
+  const char* valTopic = "site/7/dimmer/3/val";
+  const char* setTopic = "site/7/dimmer/3/set";
+  const uint8_t payload[] = "57";
+  BenchResult off = bench_run("local set, no bridge rule match", N, [&](unsigned long) {
+    lan.host_inject(setTopic, payload, 2);
+  });
+  BenchResult on = bench_run("local val, captured by the bridge", N, [&](unsigned long) {
+    lan.host_inject(valTopic, payload, 2);
+  });
+  BenchResult svc = bench_run("mqttpanel_loop, two panels + bridge", N, [&](unsigned long) { mqttpanel_loop(); });
+  bench_check(on.allocsPerOp == 0 && svc.allocsPerOp == 0 && off.allocsPerOp == 0,
+              "bridge capture and service do not allocate");
+
+  return bench_finish();
+}
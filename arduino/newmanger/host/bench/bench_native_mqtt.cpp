@@ -0,0 +1,445 @@
+// Built-in MQTT client (mpmqtt.cpp, -DMP_NATIVE_MQTT) against a scripted
+// in-memory broker: QoS 1 throughput with a window vs. stop-and-wait at 10 ms
+// RTT, socket writes per message, every buffered packet handled in one
+// loop(), separate RX/TX buffers, resend after a reconnect, keepalive, and
+// mqttpanel.cpp running on top of it. Runs on the manual clock.
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "mqttpanel.h"
+#include "bench.h"
+
+// Speaks just enough MQTT 3.1.1 for the client: answers CONNECT, SUBSCRIBE,
+// PUBLISH (QoS 1) and PINGREQ after rttUs of simulated time, loops PUBLISHes
+// on subscribed topics back, and records everything. Fixed-size queues, so
+// it does not show up in the allocation columns.
+class ScriptedBroker : public Client {
+public:
+  struct Msg {
+    std::string topic, payload;
+    uint8_t qos;
+    bool dup;
+    uint16_t id;
+  };
+
+  uint32_t rttUs = 10000;
+  uint8_t connackRc = 0;
+  bool up = true;
+  bool sendAcks = true;
+  bool answerPing = true;
+  bool record = true;           // keep every PUBLISH in got (off while timing)
+  unsigned long writes = 0, connects = 0, pings = 0, publishes = 0;
+  std::vector<Msg> got;
+  std::vector<uint16_t> clientAcks; // PUBACKs from the client (inbound QoS 1)
+  std::vector<std::string> subs;
+
+  int connect(const char*, uint16_t) override {
+    if (!up) return 0;
+    _open = true;
+    _inLen = 0;
+    _qHead = _qTail = 0;
+    _rd = _rdEnd = 0;
+    connects++;
+    return 1;
+  }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* b, size_t n) override {
+    if (!_open) return 0;
+    writes++;
+    if (_inLen + n > sizeof(_in)) n = sizeof(_in) - _inLen;
+    memcpy(_in + _inLen, b, n);
+    _inLen += n;
+    _parse();
+    return n;
+  }
+  int available() override {
+    if (!_open) return 0;
+    uint64_t now = host::clock_now_us();
+    while (_qHead != _qTail && _q[_qHead].due <= now && _rdEnd + _q[_qHead].len <= sizeof(_rdBuf)) {
+      if (_rd == _rdEnd) _rd = _rdEnd = 0;
+      memcpy(_rdBuf + _rdEnd, _q[_qHead].data, _q[_qHead].len);
+      _rdEnd += _q[_qHead].len;
+      _qHead = (_qHead + 1) % kQueue;
+    }
+    return (int)(_rdEnd - _rd);
+  }
+  int read() override {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+  int read(uint8_t* buf, size_t size) override {
+    if (!available()) return -1;
+    size_t n = _rdEnd - _rd;
+    if (n > size) n = size;
+    memcpy(buf, _rdBuf + _rd, n);
+    _rd += n;
+    return (int)n;
+  }
+  int peek() override { return available() ? _rdBuf[_rd] : -1; }
+  void flush() override {}
+  void stop() override { _open = false; }
+  uint8_t connected() override { return _open; }
+  operator bool() override { return _open; }
+  using Print::write;
+
+  void drop() { _open = false; }
+
+  // Broker -> client PUBLISH, readable right away.
+  void inject(const char* topic, const std::string& payload, uint8_t qos = 0, uint16_t id = 0) {
+    size_t tl = strlen(topic);
+    std::string p;
+    uint32_t len = (uint32_t)(2 + tl + (qos ? 2 : 0) + payload.size());
+    p += (char)(0x30 | (qos << 1));
+    do {
+      uint8_t b = len % 128;
+      len /= 128;
+      p += (char)(len ? b | 128 : b);
+    } while (len);
+    p += (char)(tl >> 8);
+    p += (char)tl;
+    p.append(topic, tl);
+    if (qos) {
+      p += (char)(id >> 8);
+      p += (char)id;
+    }
+    p += payload;
+    // Large packets bypass the small reply queue: straight into the read buffer
+    if (_rd == _rdEnd) _rd = _rdEnd = 0;
+    if (_rdEnd + p.size() <= sizeof(_rdBuf)) {
+      memcpy(_rdBuf + _rdEnd, p.data(), p.size());
+      _rdEnd += p.size();
+    }
+  }
+
+private:
+  static const size_t kQueue = 256;
+  struct Reply {
+    uint64_t due;
+    uint8_t len;
+    uint8_t data[64];
+  };
+
+  void _reply(const uint8_t* d, size_t n) {
+    size_t next = (_qTail + 1) % kQueue;
+    if (next == _qHead || n > sizeof(_q[0].data)) return;
+    _q[_qTail].due = host::clock_now_us() + rttUs;
+    _q[_qTail].len = (uint8_t)n;
+    memcpy(_q[_qTail].data, d, n);
+    _qTail = next;
+  }
+
+  bool _subscribed(const char* t, size_t n) const {
+    for (const std::string& s : subs) {
+      if (s.size() == n && memcmp(s.data(), t, n) == 0) return true;
+      if (s.size() && s.back() == '#' && n >= s.size() - 1 && memcmp(s.data(), t, s.size() - 1) == 0) return true;
+    }
+    return false;
+  }
+
+  void _parse() {
+    size_t at = 0;
+    while (at + 2 <= _inLen) {
+      uint8_t type = _in[at];
+      uint32_t len = 0, mul = 1;
+      size_t k = at + 1;
+      for (;;) {
+        if (k >= _inLen) goto partial;
+        uint8_t b = _in[k++];
+        len += (b & 127) * mul;
+        mul *= 128;
+        if (!(b & 128)) break;
+      }
+      if (k + len > _inLen) break;
+      _packet(type, _in + k, len);
+      at = k + len;
+    }
+  partial:
+    memmove(_in, _in + at, _inLen - at);
+    _inLen -= at;
+  }
+
+  void _packet(uint8_t type, const uint8_t* b, uint32_t len) {
+    switch (type & 0xF0) {
+      case 0x10: { // CONNECT
+        uint8_t r[4] = { 0x20, 2, 0, connackRc };
+        _reply(r, 4);
+        break;
+      }
+      case 0x30: { // PUBLISH
+        uint8_t qos = (type >> 1) & 3;
+        uint16_t tl = (uint16_t)((b[0] << 8) | b[1]);
+        uint32_t at = 2 + tl;
+        uint16_t id = 0;
+        if (qos) {
+          id = (uint16_t)((b[at] << 8) | b[at + 1]);
+          at += 2;
+        }
+        publishes++;
+        if (record) got.push_back({std::string((const char*)b + 2, tl), std::string((const char*)b + at, len - at), qos, (type & 0x08) != 0, id});
+        if (qos == 1 && sendAcks) {
+          uint8_t r[4] = { 0x40, 2, (uint8_t)(id >> 8), (uint8_t)id };
+          _reply(r, 4);
+        }
+        if (_subscribed((const char*)b + 2, tl) && len + 2 <= sizeof(_q[0].data)) {
+          uint8_t r[64];
+          r[0] = 0x30;
+          r[1] = (uint8_t)(len - (qos ? 2 : 0));
+          memcpy(r + 2, b, 2 + tl);
+          memcpy(r + 4 + tl, b + at, len - at);
+          _reply(r, 2 + r[1]);
+        }
+        break;
+      }
+      case 0x40: // PUBACK
+        clientAcks.push_back((uint16_t)((b[0] << 8) | b[1]));
+        break;
+      case 0x80: { // SUBSCRIBE
+        uint16_t tl = (uint16_t)((b[2] << 8) | b[3]);
+        subs.push_back(std::string((const char*)b + 4, tl));
+        uint8_t r[5] = { 0x90, 3, b[0], b[1], b[4 + tl] };
+        _reply(r, 5);
+        break;
+      }
+      case 0xC0: // PINGREQ
+        pings++;
+        if (answerPing) {
+          uint8_t r[2] = { 0xD0, 0 };
+          _reply(r, 2);
+        }
+        break;
+      case 0xE0: // DISCONNECT
+        _open = false;
+        break;
+    }
+  }
+
+  bool _open = false;
+  uint8_t _in[8192];
+  size_t _inLen = 0;
+  Reply _q[kQueue];
+  size_t _qHead = 0, _qTail = 0;
+  uint8_t _rdBuf[65536];
+  size_t _rd = 0, _rdEnd = 0;
+};
+
+// Collects the payload bytes of oversized messages (setStream).
+class ByteSink : public Stream {
+public:
+  std::string data;
+  size_t write(uint8_t c) override { data += (char)c; return 1; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
+
+static std::vector<ScriptedBroker::Msg> rx;
+static size_t rxLen = 0;
+static void on_msg(char* topic, uint8_t* payload, unsigned int len) {
+  rx.push_back({topic, std::string((const char*)payload, len), 0, false, 0});
+  rxLen = len;
+}
+
+static MpMqttClient* echoClient = nullptr;
+static void on_echo(char* topic, uint8_t* payload, unsigned int len) {
+  std::string t = std::string("out/echo/") + topic;
+  echoClient->publish(t.c_str(), payload, len);
+}
+
+struct Run {
+  double simMs;
+  double msgsPerSec;
+  double writesPerMsg;
+  MpMqttStats st;
+};
+
+// n QoS 1 messages, loop() after every batch (what a sketch's loop() does),
+// then until all are acknowledged. Simulated time only.
+static Run qosRun(uint8_t window, unsigned long n, unsigned batch) {
+  ScriptedBroker broker;
+  broker.record = false;
+  MpMqttClient c(broker);
+  c.setServer("broker", 1883);
+  c.setQos(1, window, 4096);
+  c.setTxBufferSize(1024);
+  c.connect("bench");
+  unsigned long w0 = broker.writes;
+  uint64_t t0 = host::clock_now_us();
+  for (unsigned long i = 0; i < n; i++) {
+    c.publish("MyProject/1700000000000/dimmer/1/val", "57");
+    if ((i + 1) % batch == 0) c.loop();
+  }
+  MpMqttStats st;
+  for (c.stats(&st); st.inflight && c.connected(); c.stats(&st)) {
+    c.loop();
+    delay(1);
+  }
+  Run r;
+  r.simMs = (double)(host::clock_now_us() - t0) / 1000.0;
+  r.msgsPerSec = (double)n * 1000.0 / r.simMs;
+  r.writesPerMsg = (double)(broker.writes - w0) / (double)n;
+  r.st = st;
+  bench_check(broker.publishes == n && st.acked == n, "every message reaches the broker and is acknowledged");
+  return r;
+}
+
+static char mqtt_server[40] = "127.0.0.1";
+static char mqtt_port[6] = "1883";
+static char mqtt_topic[40] = "MyProject/1700000000000";
+static unsigned long panelRx = 0;
+static void panel_rx(const char*, size_t, const uint8_t*, size_t) { panelRx++; }
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mpmqtt.cpp (built-in MQTT client)");
+  host::clock_manual(true);
+
+  // --- QoS 1: window vs. stop-and-wait at 10 ms RTT ---
+  const unsigned long M = bench_iters(20000) < 400 ? 400 : bench_iters(20000);
+  Run w1 = qosRun(1, M / 10, 10);
+  Run w16 = qosRun(16, M, 10);
+  printf("QoS 1, 10 ms RTT: window 1 %.0f msg/s (%.2f writes/msg), window 16 %.0f msg/s (%.2f writes/msg), "
+         "peak in flight %u, max ack %u us\n",
+         w1.msgsPerSec, w1.writesPerMsg, w16.msgsPerSec, w16.writesPerMsg, (unsigned)w16.st.peakInflight,
+         (unsigned)w16.st.maxAckUs);
+  bench_check(w1.msgsPerSec <= 105, "window 1 is bound by the RTT");
+  bench_check(w16.msgsPerSec >= 10 * w1.msgsPerSec, "window 16 is at least 10x faster");
+  bench_check(w16.st.peakInflight == 16, "the window fills");
+  bench_check(w16.writesPerMsg <= 0.2, "batched: 10 messages per socket write");
+
+  ScriptedBroker broker;
+  MpMqttClient client(broker);
+  client.setServer("broker", 1883);
+  client.setCallback(on_msg);
+
+  // --- Connect ---
+  broker.connackRc = 5;
+  bench_check(!client.connect("dev") && client.state() == 5 && !broker.connected(),
+              "CONNACK refusal: connect() fails with the broker's code, socket closed");
+  broker.connackRc = 0;
+  bench_check(client.connect("dev") && client.connected() && client.state() == MQTT_CONNECTED, "connects");
+  client.subscribe("in/#");
+  client.loop();
+
+  // --- Inbound: everything the socket holds in one loop() ---
+  rx.clear();
+  for (int i = 0; i < 5; i++) broker.inject("in/x", std::to_string(i));
+  client.loop();
+  bench_check(rx.size() == 5 && rx[4].payload == "4" && rx[0].topic == "in/x", "5 queued messages, one loop()");
+
+  broker.inject("in/q1", "on", 1, 0x1234);
+  client.loop();
+  bench_check(broker.clientAcks.size() == 1 && broker.clientAcks[0] == 0x1234, "inbound QoS 1 is acknowledged");
+
+  // --- Separate RX / TX buffers ---
+  client.setBufferSize(64);
+  std::string big(4000, 'x');
+  rx.clear();
+  broker.inject("in/big", big);
+  broker.inject("in/x", "after");
+  client.loop();
+  MpMqttStats st;
+  client.stats(&st);
+  bench_check(st.dropped == 1 && rx.size() == 1 && rx[0].payload == "after",
+              "oversized without a stream: dropped, the next one still arrives");
+  ByteSink sink;
+  client.setStream(sink);
+  rx.clear();
+  broker.inject("in/big", big);
+  client.loop();
+  bench_check(sink.data == big && rx.size() == 1 && rxLen == 64 - 2 - 6,
+              "with setStream(): all 4000 B to the stream, callback gets what fit");
+  bench_check(client.publish("out/big", (const uint8_t*)big.data(), (unsigned)big.size()),
+              "a 4000 B publish does not need a 4000 B RX buffer");
+  client.loop();
+  bench_check(broker.got.back().payload == big, "and arrives intact");
+  client.setBufferSize(256);
+
+  // --- Publishing from inside the callback ---
+  echoClient = &client;
+  client.setCallback(on_echo);
+  broker.inject("in/e", "ping");
+  client.loop();
+  bench_check(broker.got.back().topic == "out/echo/in/e" && broker.got.back().payload == "ping",
+              "publish() from the callback");
+  client.setCallback(on_msg);
+
+  // --- Resend after a reconnect ---
+  client.setQos(1, 8);
+  broker.sendAcks = false;
+  size_t g0 = broker.got.size();
+  for (int i = 0; i < 3; i++) client.publish("out/q", std::to_string(i).c_str());
+  client.loop();
+  client.stats(&st);
+  bench_check(st.inflight == 3 && broker.got.size() == g0 + 3, "3 unacknowledged in flight");
+  uint16_t firstId = broker.got[g0].id;
+  broker.drop();
+  bench_check(!client.loop() && client.state() == MQTT_CONNECTION_LOST, "connection loss noticed");
+  broker.sendAcks = true;
+  bench_check(client.connect("dev"), "reconnects");
+  bench_check(broker.got.size() == g0 + 6 && broker.got[g0 + 3].dup && broker.got[g0 + 3].id == firstId &&
+              broker.got[g0 + 5].payload == "2", "resent with DUP, same ids, same order");
+  delay(20);
+  client.loop();
+  client.stats(&st);
+  bench_check(st.inflight == 0 && st.resent == 3, "acknowledged after the resend");
+
+  // --- Keepalive ---
+  client.setKeepAlive(1);
+  unsigned long p0 = broker.pings;
+  host::clock_advance_us(1100000);
+  client.loop();
+  delay(20);
+  client.loop();
+  bench_check(broker.pings == p0 + 1 && client.connected(), "idle: PINGREQ, answered");
+  broker.answerPing = false;
+  host::clock_advance_us(1100000);
+  client.loop();
+  host::clock_advance_us(1100000);
+  client.loop();
+  bench_check(client.state() == MQTT_CONNECTION_TIMEOUT, "unanswered PINGREQ: timeout");
+  broker.answerPing = true;
+  client.setKeepAlive(15);
+  client.connect("dev");
+
+  // --- CPU cost (host timing) ---
+  broker.record = false;
+  client.setQos(1, 16);
+  client.setTxBufferSize(1024);
+  const unsigned long N = bench_iters(200000);
+  BenchResult q1 = bench_run("publish QoS 1, window 16 (10 ms RTT, loop every 8)", N, [&](unsigned long i) {
+    client.publish("MyProject/1700000000000/dimmer/1/val", "57");
+    if ((i & 7) == 7) client.loop();
+  });
+  client.setQos(0);
+  BenchResult q0 = bench_run("publish QoS 0 (loop every 8)", N, [&](unsigned long i) {
+    client.publish("MyProject/1700000000000/dimmer/1/val", "57");
+    if ((i & 7) == 7) client.loop();
+  });
+  bench_check(q1.allocsPerOp == 0 && q0.allocsPerOp == 0, "the client allocates nothing per message");
+
+  // --- mqttpanel.cpp on top ---
+  ScriptedBroker pb;
+  MpMqttClient pc(pb);
+  pc.setQos(1, 16);
+  pc.setTxBufferSize(1024);
+  mqttpanel_begin(&pc, panel_rx, mqtt_server, mqtt_port, mqtt_topic, 3, 10, 0, 4, 20);
+  for (int i = 0; i < 200 && !pc.connected(); i++) { mqttpanel_loop(); delay(10); }
+  bench_check(pc.connected(), "mqttpanel connects through MpMqttClient");
+  for (int i = 0; i < 5; i++) { mqttpanel_loop(); delay(10); }
+  unsigned long w0 = pb.writes;
+  size_t pg0 = pb.got.size();
+  for (int i = 0; i < 8; i++) mqttpanel_pub(String(mqtt_topic) + "/dimmer/" + String(i) + "/val", String(i * 10));
+  mqttpanel_loop();
+  bench_check(pb.got.size() == pg0 + 8 && pb.got.back().qos == 1, "8 mqttpanel_pub at QoS 1");
+  printf("mqttpanel: 8 x mqttpanel_pub + mqttpanel_loop() = %lu socket write(s)\n", pb.writes - w0);
+  bench_check(pb.writes - w0 == 1, "one socket write per mqttpanel_loop()");
+  delay(20);
+  mqttpanel_loop(); // PUBACKs (and the broker echoing <topic>/# back)
+  panelRx = 0;
+  pb.inject((String(mqtt_topic) + "/dimmer/1/set").c_str(), "40");
+  pb.inject((String(mqtt_topic) + "/dimmer/2/set").c_str(), "50");
+  mqttpanel_loop();
+  bench_check(panelRx == 2, "both commands in one mqttpanel_loop()");
+
+  return bench_finish();
+}
@@ -0,0 +1,191 @@
+// Store-and-forward in mqttpanel.cpp: readings published during a broker
+// outage are buffered (RAM ring, optional LittleFS spool) and replayed in
+// order, rate limited, after the reconnect.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <LittleFS.h>
+#include <string>
+#include <vector>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static char mqtt_server[40] = "127.0.0.1";
+static char mqtt_port[6] = "1883";
+static char mqtt_topic[40] = "MyProject/1700000000000";
+
+static void rx_raw(const char*, size_t, const uint8_t*, size_t) {}
+
+static String readingTopic = String(mqtt_topic) + "/number/1/val";
+static String statusTopic = String(mqtt_topic) + "/text/1/val";
+
+static std::vector<long> seen;        // reading sequence numbers, in arrival order
+static std::vector<std::string> statuses;
+
+static void record(const char* topic, const uint8_t* payload, unsigned int len, bool) {
+  std::string p((const char*)payload, len);
+  if (readingTopic == topic) seen.push_back(atol(p.c_str()));
+  else if (statusTopic == topic) statuses.push_back(p);
+}
+
+static bool inOrder() {
+  for (size_t i = 1; i < seen.size(); i++)
+    if (seen[i] <= seen[i - 1]) return false;
+  return true;
+}
+
+// 60 s outage, one reading + one status update every 100 ms, then the broker
+// returns and the sketch keeps looping until the backlog is gone.
+struct Run {
+  unsigned long replayMs;
+  MpSfStats st;
+};
+
+static Run outage(long& seq) {
+  seen.clear();
+  statuses.clear();
+  host::tcp_set_broker(false);
+  client.host_drop_connection();
+  for (int i = 0; i < 600; i++) {
+    mqttpanel_pub(readingTopic, String(seq++));
+    mqttpanel_pub_latest(statusTopic, "step " + String(i));
+    mqttpanel_loop();
+    delay(100);
+  }
+  host::tcp_set_broker(true);
+  while (!client.connected()) { mqttpanel_loop(); delay(10); }
+
+  Run r;
+  unsigned long t0 = millis();
+  for (int guard = 0; guard < 200000; guard++) {
+    mqttpanel_sf_stats(&r.st);
+    if (r.st.queued == 0 && r.st.spillBytes == 0) break;
+    mqttpanel_loop();
+    delay(10);
+  }
+  r.replayMs = millis() - t0;
+  mqttpanel_sf_stats(&r.st);
+  return r;
+}
+
+static void print(const char* what, const Run& r) {
+  printf("%-22s delivered %zu/600, dropped %u, collapsed %u, RAM peak %u B, spool peak %u B, "
+         "replay %lu ms @ %u msg/s\n", what, seen.size(), (unsigned)r.st.dropped, (unsigned)r.st.collapsed,
+         (unsigned)r.st.ramPeak, (unsigned)r.st.spillPeak, r.replayMs, (unsigned)r.st.replayMsgsPerSec);
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp (store-and-forward)");
+  host::clock_manual(true);
+
+  MpConnPolicy policy;
+  policy.backoffMinMs = 100;
+  policy.backoffMaxMs = 1000;
+  policy.portalAfterFailures = 0;
+  mqttpanel_conn_policy(policy);
+  mqttpanel_begin(&client, rx_raw, mqtt_server, mqtt_port, mqtt_topic, 3, 10, 0, 4, 20);
+  while (!client.connected()) { mqttpanel_loop(); delay(10); }
+  client.host_set_observer(record);
+  long seq = 0;
+
+  // --- RAM ring only: the oldest readings are dropped, the rest arrive in order ---
+  mqttpanel_sf_config(50, 0);
+  Run ram = outage(seq);
+  print("RAM only (2 KB)", ram);
+  bench_check(ram.st.dropped > 0 && !seen.empty() && inOrder(), "RAM-only keeps the newest readings, in order");
+  bench_check(seen.back() == seq - 1, "the last reading before the reconnect is delivered");
+  bench_check(statuses.size() == 1 && statuses[0] == "step 599", "latest-only topic replays just its newest value");
+  // 50 msg/s plus the initial burst of 4
+  bench_check(seen.size() + statuses.size() <= 4 + 50 * ram.replayMs / 1000 + 1, "replay respects the rate limit");
+
+  // --- Link drops in the middle of the replay: the record being sent stays queued ---
+  seen.clear();
+  host::tcp_set_broker(false);
+  client.host_drop_connection();
+  long first = seq;
+  for (int i = 0; i < 20; i++) mqttpanel_pub(readingTopic, String(seq++));
+  client.host_drop_mid_publish(5);
+  host::tcp_set_broker(true);
+  while (!client.connected()) { mqttpanel_loop(); delay(10); }
+  for (int i = 0; i < 200 && client.connected(); i++) { mqttpanel_loop(); delay(10); }
+  MpSfStats cut;
+  mqttpanel_sf_stats(&cut);
+  bench_check(!client.connected() && seen.size() == 4 && cut.queued == 16, "record cut off by the drop is still queued");
+  for (int i = 0; i < 2000 && seen.size() < 20; i++) { mqttpanel_loop(); delay(10); }
+  bench_check(seen.size() == 20 && seen.front() == first && seen.back() == seq - 1 && inOrder(),
+              "after the reconnect all 20 arrive, none missing");
+
+  // --- With the LittleFS spool: nothing lost ---
+  mqttpanel_sf_config(50, 64 * 1024);
+  MpSfStats before;
+  mqttpanel_sf_stats(&before);
+  Run spool = outage(seq);
+  print("RAM + 64 KB spool", spool);
+  bench_check(spool.st.dropped == before.dropped, "spool absorbs a 60 s outage without drops");
+  bench_check(seen.size() == 600 && inOrder(), "all 600 readings replayed in order");
+  bench_check(spool.st.spillPeak > 0 && !LittleFS.exists("/mp_spool.bin"), "spool used, then removed once replayed");
+
+  // --- Spool survives a reboot ---
+  seen.clear();
+  host::tcp_set_broker(false);
+  client.host_drop_connection();
+  for (int i = 0; i < 200; i++) mqttpanel_pub(readingTopic, String(seq++));
+  mqttpanel_begin(&client, rx_raw, mqtt_server, mqtt_port, mqtt_topic, 3, 10, 0, 4, 20); // reboot: RAM ring lost
+  host::tcp_set_broker(true);
+  for (int i = 0; i < 2000; i++) { mqttpanel_loop(); delay(10); }
+  bench_check(!seen.empty() && inOrder(), "spooled readings are replayed after a reboot");
+
+  // --- Flash I/O error while replaying the spool: retried, nothing lost ---
+  seen.clear();
+  host::tcp_set_broker(false);
+  client.host_drop_connection();
+  first = seq;
+  for (int i = 0; i < 200; i++) mqttpanel_pub(readingTopic, String(seq++));
+  MpSfStats io;
+  mqttpanel_sf_stats(&io);
+  uint32_t spilled = io.spillBytes;
+  LittleFS.host_fail_opens(5);
+  host::tcp_set_broker(true);
+  while (!client.connected()) { mqttpanel_loop(); delay(10); }
+  for (int i = 0; i < 3; i++) { mqttpanel_loop(); delay(10); }
+  mqttpanel_sf_stats(&io);
+  bench_check(spilled > 0 && io.spillBytes == spilled && seen.empty() && LittleFS.exists("/mp_spool.bin"),
+              "unreadable spool is kept, not deleted");
+  for (int i = 0; i < 2000 && seen.size() < 200; i++) { mqttpanel_loop(); delay(10); }
+  bench_check(seen.size() == 200 && seen.front() == first && seen.back() == seq - 1 && inOrder(),
+              "and replays in full once the flash reads again");
+
+  // --- publish() fails while online ---
+  MpSfStats pf0, pf;
+  mqttpanel_sf_stats(&pf0);
+  seen.clear();
+  mqttpanel_pub(readingTopic, String(seq) + std::string(400, ' ').c_str()); // bigger than the client buffer
+  mqttpanel_sf_stats(&pf);
+  bench_check(client.connected() && seen.empty() && pf.queued == 0 && pf.dropped == pf0.dropped + 1,
+              "refused with the link up: counted as dropped, not queued");
+  client.host_drop_on_publish(1);
+  mqttpanel_pub(readingTopic, String(seq));
+  mqttpanel_sf_stats(&pf);
+  bench_check(!client.connected() && pf.queued == 1 && pf.dropped == pf0.dropped + 1,
+              "link lost during publish(): the message goes to store-and-forward");
+  for (int i = 0; i < 2000 && seen.empty(); i++) { mqttpanel_loop(); delay(10); }
+  bench_check(seen.size() == 1 && seen[0] == seq, "and is delivered after the reconnect");
+  seq++;
+
+  // --- Cost ---
+  host::clock_manual(false);
+  const unsigned long N = bench_iters(1000000);
+  client.host_set_observer(nullptr);
+  mqttpanel_sf_config(50, 0);
+  client.host_drop_connection();
+  host::tcp_set_broker(false);
+  String payload = "21.50";
+  bench_run("pub while offline (ring, full)", N, [&](unsigned long) { mqttpanel_pub(readingTopic, payload); });
+  bench_run("pub_latest while offline", N, [&](unsigned long) { mqttpanel_pub_latest(statusTopic, payload); });
+  host::tcp_set_broker(true);
+
+  return bench_finish();
+}
@@ -0,0 +1,110 @@
+// MQTT connection state machine in mqttpanel.cpp: how long loop() stalls
+// while the broker is down, the backoff schedule, and time-to-reconnect.
+// Runs on the manual clock; the WiFiClient shim "blocks" by advancing it.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static char mqtt_server[40] = "127.0.0.1";
+static char mqtt_port[6] = "1883";
+static char mqtt_topic[40] = "MyProject/1700000000000";
+
+static void rx_raw(const char*, size_t, const uint8_t*, size_t) {}
+
+struct Outage {
+  unsigned long loops;
+  unsigned long maxStallMs;
+  uint32_t attempts;
+};
+
+// Broker down for durMs of simulated time, the sketch looping every 10 ms.
+static Outage brokerDown(unsigned long durMs) {
+  Outage o = {0, 0, 0};
+  MpConnStats st;
+  mqttpanel_conn_stats(&st);
+  uint32_t a0 = st.attempts;
+  host::tcp_set_broker(false);
+  client.host_drop_connection();
+  unsigned long end = millis() + durMs;
+  while ((long)(millis() - end) < 0) {
+    unsigned long t0 = millis();
+    mqttpanel_loop();
+    unsigned long stall = millis() - t0;
+    if (stall > o.maxStallMs) o.maxStallMs = stall;
+    o.loops++;
+    delay(10);
+  }
+  mqttpanel_conn_stats(&st);
+  o.attempts = st.attempts - a0;
+  return o;
+}
+
+static unsigned long loopUntilOnline(unsigned long limitMs) {
+  unsigned long t0 = millis();
+  while (!client.connected() && millis() - t0 < limitMs) {
+    mqttpanel_loop();
+    delay(10);
+  }
+  return millis() - t0;
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp (connection state machine)");
+  host::clock_manual(true);
+
+  MpConnPolicy policy;
+  policy.backoffMinMs = 500;
+  policy.backoffMaxMs = 8000;
+  policy.connectTimeoutMs = 250;
+  policy.portalAfterFailures = 0; // never open the (blocking) portal here
+  mqttpanel_conn_policy(policy);
+  mqttpanel_conn_socket(&espClient);
+  mqttpanel_begin(&client, rx_raw, mqtt_server, mqtt_port, mqtt_topic, 3, 10, 0, 4, 20);
+
+  loopUntilOnline(1000);
+  MpConnStats st;
+  mqttpanel_conn_stats(&st);
+  bench_check(st.state == MP_CONN_ONLINE && st.connects == 1, "boots online");
+
+  // --- One minute with the broker down ---
+  Outage o = brokerDown(60000);
+  printf("broker down 60 s: %lu loop() calls, %u connect attempts, worst loop() stall %lu ms\n",
+         o.loops, (unsigned)o.attempts, o.maxStallMs);
+  bench_check(o.maxStallMs <= policy.connectTimeoutMs, "a loop() never blocks longer than connectTimeoutMs");
+  bench_check(o.attempts >= 6 && o.attempts <= 14, "retries back off toward backoffMaxMs");
+  mqttpanel_conn_stats(&st);
+  bench_check(st.state == MP_CONN_BACKOFF && st.nextRetryMs <= 10000, "backoff capped at max + jitter");
+
+  // --- Broker comes back ---
+  host::tcp_set_broker(true, 20);
+  unsigned long waited = loopUntilOnline(20000);
+  mqttpanel_conn_stats(&st);
+  printf("broker back: online %lu ms later, outage-to-reconnect %u ms, max step %u ms\n",
+         waited, (unsigned)st.lastReconnectMs, (unsigned)st.maxBlockMs);
+  bench_check(st.state == MP_CONN_ONLINE, "reconnects once the broker is back");
+  bench_check(waited <= 10000 + 100, "reconnect within one capped backoff");
+  bench_check(st.lastReconnectMs >= 60000, "time-to-reconnect covers the whole outage");
+  bench_check(st.streak == 0, "success clears the failure streak");
+
+  // --- Without the socket hook: one combined step, bounded by the core timeout ---
+  mqttpanel_conn_socket(NULL);
+  espClient.setTimeout(1000);
+  Outage plain = brokerDown(20000);
+  printf("no socket hook, broker down 20 s: worst loop() stall %lu ms\n", plain.maxStallMs);
+  bench_check(plain.maxStallMs >= 1000, "combined connect blocks for the core's TCP timeout");
+  host::tcp_set_broker(true);
+  loopUntilOnline(20000);
+  bench_check(client.connected(), "reconnects without the socket hook");
+
+  // --- Cost of the state machine while online ---
+  host::clock_manual(false);
+  const unsigned long N = bench_iters(1000000);
+  bench_run("loop: online, no traffic", N, [&](unsigned long) { mqttpanel_loop(); });
+
+  return bench_finish();
+}
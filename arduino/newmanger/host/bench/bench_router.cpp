@@ -0,0 +1,95 @@
+// Router lookup at MPTP_MAX_CHANNELS channels: the library's prefix-strip +
+// hash router against the original linear strcmp scan (kept here verbatim as
+// the reference). Built once per channel count, see CMakeLists.txt.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static const char* kBase = "MyProject/1700000000000";
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);  // library router
+static PubSubClient refClient(espClient); // reference linear scan
+
+static int dims[MPTP_MAX_CHANNELS];
+
+// --- Reference: the pre-hash router ---
+struct RefChannel {
+  bool active;
+  char topicSet[MPTP_MAX_TOPIC_LEN];
+  int* varPtr;
+};
+static RefChannel refChannels[MPTP_MAX_CHANNELS];
+
+static void ref_router(char* topic, byte* payload, unsigned int length) {
+  char msg[length + 1];
+  memcpy(msg, payload, length);
+  msg[length] = '\0';
+  for (int i = 0; i < MPTP_MAX_CHANNELS; i++) {
+    if (refChannels[i].active && strcmp(refChannels[i].topicSet, topic) == 0) {
+      int val = atoi(msg);
+      if (val < 0) val = 0;
+      if (val > 100) val = 100;
+      *refChannels[i].varPtr = val;
+      return;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  char title[96];
+  snprintf(title, sizeof(title), "router @ %d channels", MPTP_MAX_CHANNELS);
+  bench_init(argc, argv, title);
+
+  client.connect("bench");
+  refClient.connect("ref");
+  mqttpanel_begin(&client, kBase);
+  refClient.setCallback(ref_router);
+
+  String topics[MPTP_MAX_CHANNELS];
+  for (int i = 0; i < MPTP_MAX_CHANNELS; i++) {
+    topics[i] = String(kBase) + "/dimmer/" + String(i + 1) + "/set";
+    bench_check(mqttpanel_dimmer_sub(topics[i].c_str(), &dims[i]), "dimmer_sub accepted");
+    refChannels[i].active = true;
+    strlcpy(refChannels[i].topicSet, topics[i].c_str(), MPTP_MAX_TOPIC_LEN);
+    refChannels[i].varPtr = &dims[i];
+  }
+
+  const unsigned long N = bench_iters(1000000);
+  const String& last = topics[MPTP_MAX_CHANNELS - 1];
+
+  bench_run("linear scan: last channel", N, [&](unsigned long) {
+    refClient.host_inject(last.c_str(), (const uint8_t*)"42", 2);
+  });
+  bench_run("hash router: last channel", N, [&](unsigned long) {
+    client.host_inject(last.c_str(), (const uint8_t*)"42", 2);
+  });
+  bench_run("linear scan: spread over all channels", N, [&](unsigned long i) {
+    refClient.host_inject(topics[i % MPTP_MAX_CHANNELS].c_str(), (const uint8_t*)"42", 2);
+  });
+  bench_run("hash router: spread over all channels", N, [&](unsigned long i) {
+    client.host_inject(topics[i % MPTP_MAX_CHANNELS].c_str(), (const uint8_t*)"42", 2);
+  });
+
+  // Every channel must still resolve to its own variable.
+  for (int i = 0; i < MPTP_MAX_CHANNELS; i++) dims[i] = -1;
+  for (int i = 0; i < MPTP_MAX_CHANNELS; i++) {
+    char v[8];
+    snprintf(v, sizeof(v), "%d", i % 101);
+    client.host_inject(topics[i].c_str(), (const uint8_t*)v, (unsigned)strlen(v));
+  }
+  bool allRouted = true;
+  for (int i = 0; i < MPTP_MAX_CHANNELS; i++) allRouted &= (dims[i] == i % 101);
+  bench_check(allRouted, "every topic routed to its own channel");
+
+  String miss = String(kBase) + "/dimmer/999999/set";
+  client.host_inject(miss.c_str(), (const uint8_t*)"1", 1);
+  String foreign = String("other/") + "dimmer/1/set";
+  int before = dims[0];
+  client.host_inject(foreign.c_str(), (const uint8_t*)"7", 1);
+  bench_check(dims[0] == before, "topic outside the base does not match a relative key");
+
+  return bench_finish();
+}
@@ -0,0 +1,151 @@
+// Cooperative scheduler in mqttpanel.cpp: a 10 ms control task run by
+// mqttpanel_every() vs. the hand-rolled millis() timer the sketch used, the
+// task's jitter while the broker is down, overrun / skip accounting, one-shot
+// tasks and the loop budget. Runs on the manual clock; "work" advances it.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static char mqtt_server[40] = "127.0.0.1";
+static char mqtt_port[6] = "1883";
+static char mqtt_topic[40] = "MyProject/1700000000000";
+
+static void rx_raw(const char*, size_t, const uint8_t*, size_t) {}
+
+static unsigned long ctlRuns = 0;
+static uint32_t ctlWorkUs = 100; // simulated control-loop work
+
+static void control(void*) {
+  ctlRuns++;
+  host::clock_advance_us(ctlWorkUs);
+}
+
+static int shots = 0;
+static int rearm = 0;
+static void oneShot(void*) {
+  shots++;
+  if (rearm > 0 && rearm--) mqttpanel_after(5, oneShot);
+}
+
+static void noop(void*) {}
+
+// The sketch's loop(): mqttpanel_loop() plus other user code taking passUs.
+static void runFor(unsigned long ms, uint32_t passUs) {
+  unsigned long end = millis() + ms;
+  while ((long)(millis() - end) < 0) {
+    mqttpanel_loop();
+    host::clock_advance_us(passUs);
+  }
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp (scheduler)");
+  host::clock_manual(true);
+
+  MpConnPolicy policy;
+  policy.connectTimeoutMs = 250;
+  policy.portalAfterFailures = 0;
+  mqttpanel_conn_policy(policy);
+  mqttpanel_conn_socket(&espClient);
+  mqttpanel_begin(&client, rx_raw, mqtt_server, mqtt_port, mqtt_topic, 3, 10, 0, 4, 20);
+  runFor(100, 1000);
+  bench_check(client.connected(), "boots online");
+
+  // --- Hand-rolled timer vs. mqttpanel_every, loop() passes of 3 ms ---
+  unsigned long handRuns = 0, last = millis(), end = millis() + 10000;
+  while ((long)(millis() - end) < 0) {
+    mqttpanel_loop();
+    if (millis() - last > 10) { last = millis(); handRuns++; host::clock_advance_us(ctlWorkUs); }
+    host::clock_advance_us(3000);
+  }
+  int ctl = mqttpanel_every(10, control, NULL, 500);
+  runFor(10000, 3000);
+  MpTaskStats ts;
+  mqttpanel_task_stats(ctl, &ts);
+  printf("10 ms task over 10 s, 3 ms loop passes: millis() timer %lu runs, mqttpanel_every %lu runs\n", handRuns, ctlRuns);
+  printf("  task lateness p50 %u us, p99 %u us, max %u us\n",
+         (unsigned)mqttpanel_hist_percentile(ts.late, 50), (unsigned)mqttpanel_hist_percentile(ts.late, 99),
+         (unsigned)ts.late.maxUs);
+  bench_check(ctlRuns >= 999 && ctlRuns <= 1001, "fixed-rate task does not drift");
+  bench_check(handRuns < 900, "the millis() timer drifts by a loop pass every period");
+  bench_check(ts.late.maxUs <= 3200 && ts.overruns == 0 && ts.skipped == 0, "jitter bounded by one loop pass");
+
+  // --- Broker down: the task keeps its rate between the connection slices ---
+  host::tcp_set_broker(false);
+  client.host_drop_connection();
+  ctlRuns = 0;
+  runFor(5000, 1000);
+  mqttpanel_task_stats(ctl, &ts);
+  MpSchedStats ss;
+  mqttpanel_sched_stats(&ss);
+  printf("broker down 5 s: %lu runs, worst lateness %u us, io slice max %u us, loop() period max %u us\n",
+         ctlRuns, (unsigned)ts.late.maxUs, (unsigned)ss.ioMaxUs, (unsigned)ss.period.maxUs);
+  bench_check(ss.ioMaxUs >= 250000, "a connect attempt blocks its slice for connectTimeoutMs");
+  bench_check(ts.skipped > 0 && ctlRuns + ts.skipped >= 495, "periods lost to a blocked slice are skipped, not burst");
+  host::tcp_set_broker(true);
+  runFor(10000, 1000);
+  bench_check(client.connected(), "back online");
+
+  // --- Overruns ---
+  mqttpanel_cancel(ctl);
+  ctlWorkUs = 2000;
+  ctlRuns = 0;
+  int slow = mqttpanel_every(10, control, NULL, 1000);
+  runFor(1000, 1000);
+  mqttpanel_task_stats(slow, &ts);
+  bench_check(ts.runs == ctlRuns && ts.overruns == ts.runs && ts.maxUs == 2000, "every run over budget is an overrun");
+  mqttpanel_cancel(slow);
+  bench_check(!mqttpanel_task_stats(slow, &ts), "cancelled id is dead");
+
+  // --- One-shot tasks ---
+  rearm = 3;
+  int shot = mqttpanel_after(20, oneShot);
+  runFor(10, 1000);
+  bench_check(shots == 0, "one-shot waits for its delay");
+  runFor(100, 1000);
+  bench_check(shots == 4, "one-shot runs once and can re-arm itself");
+  mqttpanel_cancel(shot); // stale id: must not hit whatever reused the slot
+  int keep = mqttpanel_every(5, noop);
+  mqttpanel_cancel(shot);
+  runFor(50, 1000);
+  bench_check(mqttpanel_task_stats(keep, &ts) && ts.runs >= 9, "a stale id does not cancel a newer task");
+  mqttpanel_cancel(keep);
+
+  // --- Loop budget: optional slices yield when user tasks ate the pass ---
+  mqttpanel_sf_config(1000, 0);
+  client.host_drop_connection();
+  for (int i = 0; i < 20; i++) mqttpanel_pub(String(mqtt_topic) + "/log", String(i));
+  ctlWorkUs = 800;
+  int heavy = mqttpanel_every(1, control);
+  mqttpanel_loop_budget(500);
+  runFor(2000, 1000);
+  mqttpanel_sched_stats(&ss);
+  MpSfStats sf;
+  mqttpanel_sf_stats(&sf);
+  bench_check(ss.deferred > 0 && sf.queued == 20, "replay is deferred while the pass is over budget");
+  mqttpanel_cancel(heavy);
+  runFor(2000, 1000);
+  mqttpanel_sf_stats(&sf);
+  bench_check(sf.queued == 0, "replay resumes once the pass fits the budget");
+  mqttpanel_loop_budget(0);
+
+  // --- Cost ---
+  host::clock_manual(false);
+  const unsigned long N = bench_iters(1000000);
+  bench_run("loop: online, no tasks", N, [&](unsigned long) { mqttpanel_loop(); });
+  int ids[MP_MAX_TASKS];
+  for (int i = 0; i < MP_MAX_TASKS; i++) ids[i] = mqttpanel_every(3600000, noop);
+  bench_run("loop: online, 8 tasks not due", N, [&](unsigned long) { mqttpanel_loop(); });
+  for (int i = 0; i < MP_MAX_TASKS; i++) mqttpanel_cancel(ids[i]);
+  bench_run("loop: online, 1 task due every pass", N, [&](unsigned long i) {
+    if (i == 0) ids[0] = mqttpanel_every(0, noop);
+    mqttpanel_loop();
+  });
+
+  return bench_finish();
+}
@@ -0,0 +1,394 @@
+// Time-series channels (mqttpanel_series) in explained/mqttpanel_explained.cpp:
+// a 100 Hz sensor sent as one mqttpanel_number_pub per sample vs. batched,
+// delta-encoded JSON and CBOR; plus reconstruction accuracy, the size / time
+// triggers, downsampling and what happens while the broker is away.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <math.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static const char* kBase = "MyProject/1700000000000";
+
+struct Point { uint32_t t; float v, lo, hi; };
+
+// Every batch that reached the broker, decoded back into points.
+static std::vector<Point> rx;
+static unsigned long batches = 0, packets = 0, wireBytes = 0;
+static bool decodeOk = true, sawDtArray = false;
+static uint32_t lastW = 0;
+static std::string chartTopic;
+
+// --- Minimal decoders for the batch format (what the app side would do) ---
+struct Batch {
+  uint32_t t0 = 0;
+  std::vector<int64_t> dt;   // one entry = uniform spacing
+  bool dtArray = false;
+  double q = 0;
+  uint32_t w = 0;
+  std::map<std::string, std::vector<int64_t> > cols;
+};
+
+static bool jsonNum(const char*& p, double* out) {
+  char* end;
+  *out = strtod(p, &end);
+  if (end == p) return false;
+  p = end;
+  return true;
+}
+
+static bool parseJson(const std::string& s, Batch* b) {
+  const char* p = s.c_str();
+  if (*p++ != '{') return false;
+  while (*p == '"') {
+    const char* k = ++p;
+    while (*p && *p != '"') p++;
+    std::string key(k, p - k);
+    if (*p++ != '"' || *p++ != ':') return false;
+    std::vector<int64_t> arr;
+    double x = 0;
+    bool isArr = (*p == '[');
+    if (isArr) {
+      p++;
+      while (*p != ']') {
+        if (!jsonNum(p, &x)) return false;
+        arr.push_back((int64_t)x);
+        if (*p == ',') p++;
+      }
+      p++;
+    } else if (!jsonNum(p, &x)) {
+      return false;
+    }
+    if (key == "t") b->t0 = (uint32_t)x;
+    else if (key == "q") b->q = x;
+    else if (key == "w") b->w = (uint32_t)x;
+    else if (key == "dt") { b->dtArray = isArr; b->dt = isArr ? arr : std::vector<int64_t>(1, (int64_t)x); }
+    else b->cols[key] = arr;
+    if (*p == ',') p++;
+  }
+  return *p == '}' && p[1] == '\0';
+}
+
+struct Cbor {
+  const uint8_t* p;
+  size_t n, i;
+  bool head(uint8_t* major, uint64_t* v, uint8_t* info) {
+    if (i >= n) return false;
+    uint8_t b = p[i++];
+    *major = b >> 5;
+    *info = b & 31;
+    if (*info < 24) { *v = *info; return true; }
+    if (*info > 27) return false;
+    size_t k = (size_t)1 << (*info - 24);
+    if (n - i < k) return false;
+    *v = 0;
+    for (size_t j = 0; j < k; j++) *v = (*v << 8) | p[i++];
+    return true;
+  }
+  bool number(double* out) {
+    uint8_t m, info;
+    uint64_t v;
+    if (!head(&m, &v, &info)) return false;
+    if (m == 0) { *out = (double)v; return true; }
+    if (m == 1) { *out = -1.0 - (double)v; return true; }
+    if (m == 7 && info == 26) { uint32_t bits = (uint32_t)v; float f; memcpy(&f, &bits, 4); *out = f; return true; }
+    return false;
+  }
+};
+
+static bool parseCbor(const std::string& s, Batch* b) {
+  Cbor c = { (const uint8_t*)s.data(), s.size(), 0 };
+  uint8_t m, info;
+  uint64_t n;
+  if (!c.head(&m, &n, &info) || m != 5) return false;
+  for (uint64_t e = 0; e < n; e++) {
+    uint64_t kl;
+    if (!c.head(&m, &kl, &info) || m != 3 || kl > c.n - c.i) return false;
+    std::string key((const char*)c.p + c.i, (size_t)kl);
+    c.i += (size_t)kl;
+    std::vector<int64_t> arr;
+    double x = 0;
+    bool isArr = c.i < c.n && (c.p[c.i] >> 5) == 4;
+    if (isArr) {
+      uint64_t an = 0;
+      c.head(&m, &an, &info);
+      for (uint64_t j = 0; j < an; j++) {
+        if (!c.number(&x)) return false;
+        arr.push_back((int64_t)x);
+      }
+    } else if (!c.number(&x)) {
+      return false;
+    }
+    if (key == "t") b->t0 = (uint32_t)x;
+    else if (key == "q") b->q = x;
+    else if (key == "w") b->w = (uint32_t)x;
+    else if (key == "dt") { b->dtArray = isArr; b->dt = isArr ? arr : std::vector<int64_t>(1, (int64_t)x); }
+    else b->cols[key] = arr;
+  }
+  return c.i == c.n;
+}
+
+static float colAt(const Batch& b, const char* key, size_t i, std::vector<int64_t>& acc) {
+  auto it = b.cols.find(key);
+  if (it == b.cols.end() || i >= it->second.size()) return NAN;
+  int64_t& x = acc[it->first == "v" ? 0 : it->first == "lo" ? 1 : 2];
+  x = (i ? x : 0) + it->second[i];
+  return (float)((double)x * b.q);
+}
+
+static void record(const char* topic, const uint8_t* payload, unsigned int len, bool) {
+  packets++;
+  wireBytes += MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + len;
+  if (chartTopic != topic) return;
+  batches++;
+  std::string s((const char*)payload, len);
+  Batch b;
+  bool ok = (len && payload[0] == '{') ? parseJson(s, &b) : parseCbor(s, &b);
+  const std::vector<int64_t>* lead = NULL;
+  for (auto& kv : b.cols) lead = &kv.second;
+  if (!ok || !lead || b.dt.empty() || (b.dtArray && b.dt.size() != lead->size())) { decodeOk = false; return; }
+  sawDtArray |= b.dtArray;
+  lastW = b.w;
+  std::vector<int64_t> acc(3, 0);
+  uint32_t t = b.t0;
+  for (size_t i = 0; i < lead->size(); i++) {
+    if (i) t += (uint32_t)(b.dtArray ? b.dt[i] : b.dt[0]);
+    Point pt = { t, colAt(b, "v", i, acc), colAt(b, "lo", i, acc), colAt(b, "hi", i, acc) };
+    rx.push_back(pt);
+  }
+}
+
+static void resetRx() {
+  rx.clear();
+  batches = packets = wireBytes = 0;
+  decodeOk = true;
+  sawDtArray = false;
+}
+
+// 10 s of a 100 Hz sensor: a slow sine plus small noise, 3 decimals.
+static float signal(unsigned long i) {
+  return 21.5f + 3.0f * sinf((float)i * 0.01f) + 0.001f * (float)((i * 37) % 11);
+}
+
+static void drain() {
+  MpTxStats st;
+  for (mqttpanel_tx_stats(&st); st.depth > 0; mqttpanel_tx_stats(&st)) mqttpanel_loop();
+}
+
+static void step10ms() {
+  mqttpanel_loop();
+  host::clock_advance_us(10000);
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "explained/mqttpanel_explained.cpp (time series)");
+  host::clock_manual(true);
+  host::clock_advance_us(5000000);
+
+  client.connect("bench");
+  mqttpanel_begin(&client, kBase);
+  client.host_set_observer(record);
+  const unsigned long kSamples = 1000; // 10 s at 100 Hz
+  String perSample = String(kBase) + "/number/1/val";
+  chartTopic = (String(kBase) + "/chart/1/val").c_str();
+
+  // --- Baseline: one message per sample ---
+  resetRx();
+  for (unsigned long i = 0; i < kSamples; i++) {
+    mqttpanel_number_pub(perSample.c_str(), signal(i));
+    step10ms();
+  }
+  drain();
+  unsigned long basePackets = packets, baseBytes = wireBytes;
+
+  // --- Batched JSON (32 samples or 1 s, q = 0.001: the sensor has 3 decimals) ---
+  MpSeriesConfig cfg;
+  cfg.resolution = 0.001f;
+  int id = mqttpanel_series(chartTopic.c_str(), cfg);
+  bench_check(id == 0, "series registered");
+  resetRx();
+  uint32_t t0 = millis();
+  for (unsigned long i = 0; i < kSamples; i++) {
+    mqttpanel_series_add(id, signal(i));
+    step10ms();
+  }
+  mqttpanel_series_flush(id);
+  drain();
+  unsigned long jsonPackets = packets, jsonBytes = wireBytes;
+  bool exact = decodeOk && rx.size() == kSamples;
+  for (size_t i = 0; exact && i < rx.size(); i++) {
+    exact = rx[i].t == t0 + 10 * i && fabsf(rx[i].v - signal(i)) <= 0.0005f + 1e-4f;
+  }
+  bench_check(exact, "JSON batches decode to every sample: same times, within q/2");
+  bench_check(!sawDtArray, "fixed rate: dt is a single number");
+
+  // --- Batched CBOR ---
+  mqttpanel_state_format(MP_FRAME_CBOR);
+  resetRx();
+  t0 = millis();
+  for (unsigned long i = 0; i < kSamples; i++) {
+    mqttpanel_series_add(id, signal(i));
+    step10ms();
+  }
+  mqttpanel_series_flush(id);
+  drain();
+  unsigned long cborPackets = packets, cborBytes = wireBytes;
+  exact = decodeOk && rx.size() == kSamples;
+  for (size_t i = 0; exact && i < rx.size(); i++) {
+    exact = rx[i].t == t0 + 10 * i && fabsf(rx[i].v - signal(i)) <= 0.0005f + 1e-4f;
+  }
+  bench_check(exact, "CBOR batches decode to every sample");
+  mqttpanel_state_format(MP_FRAME_JSON);
+
+  printf("10 s at 100 Hz: per-sample %lu msgs / %lu B, JSON batches %lu msgs / %lu B, CBOR batches %lu msgs / %lu B\n",
+         basePackets, baseBytes, jsonPackets, jsonBytes, cborPackets, cborBytes);
+  printf("per second: %.0f / %.1f / %.1f msgs, %.0f / %.0f / %.0f B\n",
+         basePackets / 10.0, jsonPackets / 10.0, cborPackets / 10.0, baseBytes / 10.0, jsonBytes / 10.0, cborBytes / 10.0);
+  bench_check(basePackets == kSamples && jsonPackets * 20 <= basePackets, "at least 20x fewer messages");
+  bench_check(jsonBytes * 4 <= baseBytes && cborBytes < jsonBytes, "at least 4x fewer bytes; CBOR smaller than JSON");
+
+  // --- Triggers ---
+  MpSeriesConfig slow;
+  slow.capacity = 16;
+  slow.flushSamples = 8;
+  slow.flushMs = 500;
+  chartTopic = (String(kBase) + "/chart/2/val").c_str();
+  int id2 = mqttpanel_series(chartTopic.c_str(), slow);
+  resetRx();
+  mqttpanel_series_add(id2, 1.0f);
+  uint32_t added = millis();
+  while (batches == 0 && millis() - added < 2000) step10ms();
+  bench_check(batches == 1 && rx.size() == 1 && millis() - added >= 500 && millis() - added <= 520,
+              "time trigger: a lone sample goes out after flushMs");
+  resetRx();
+  for (int i = 0; i < 8; i++) mqttpanel_series_add(id2, (float)i);
+  mqttpanel_loop();
+  bench_check(batches == 1 && rx.size() == 8, "size trigger: flushSamples points go out on the next loop");
+  resetRx();
+  for (int i = 0; i < 3; i++) mqttpanel_series_add(id2, (float)i);
+  mqttpanel_loop();
+  bench_check(batches == 0, "below both triggers: nothing yet");
+  mqttpanel_series_flush(id2);
+  mqttpanel_loop();
+  bench_check(batches == 1 && rx.size() == 3, "mqttpanel_series_flush sends right away");
+
+  // Irregular timestamps
+  resetRx();
+  const uint32_t stamps[5] = { 1000, 1013, 1020, 1041, 1042 };
+  for (int i = 0; i < 5; i++) mqttpanel_series_add_at(id2, stamps[i], 2.5f * i);
+  mqttpanel_series_flush(id2);
+  mqttpanel_loop();
+  bool times = sawDtArray && rx.size() == 5;
+  for (int i = 0; times && i < 5; i++) times = rx[i].t == stamps[i] && fabsf(rx[i].v - 2.5f * i) < 1e-4f;
+  bench_check(times, "jittered timestamps: dt array, exact times");
+  bench_check(!mqttpanel_series_add(id2, NAN) && !mqttpanel_series_add(7, 1.0f), "NaN and unknown ids are refused");
+
+  // --- Downsampling: 100 Hz -> 10 Hz with mean / min / max ---
+  MpSeriesConfig ds;
+  ds.windowMs = 100;
+  ds.reduce = MP_REDUCE_MEAN | MP_REDUCE_MIN | MP_REDUCE_MAX;
+  ds.flushSamples = 10;
+  chartTopic = (String(kBase) + "/chart/3/val").c_str();
+  int id3 = mqttpanel_series(chartTopic.c_str(), ds);
+  resetRx();
+  t0 = millis();
+  for (unsigned long i = 0; i < kSamples; i++) {
+    mqttpanel_series_add(id3, signal(i));
+    step10ms();
+  }
+  mqttpanel_series_flush(id3);
+  drain();
+  bool reduced = decodeOk && rx.size() == kSamples / 10 && lastW == 100;
+  for (size_t w = 0; reduced && w < rx.size(); w++) {
+    float lo = 1e9f, hi = -1e9f, sum = 0;
+    for (unsigned long i = w * 10; i < w * 10 + 10; i++) {
+      float v = signal(i);
+      lo = fminf(lo, v);
+      hi = fmaxf(hi, v);
+      sum += v;
+    }
+    reduced = rx[w].t == t0 + 100 * w && fabsf(rx[w].v - sum / 10) < 0.006f &&
+              fabsf(rx[w].lo - lo) < 0.006f && fabsf(rx[w].hi - hi) < 0.006f;
+  }
+  bench_check(reduced, "windows of 10 samples: mean / min / max per window, window start as t");
+  printf("downsampled: %lu msgs / %lu B for 10 s (%.0f B/s)\n", packets, wireBytes, wireBytes / 10.0);
+
+  // --- Broker away: the ring keeps the newest points ---
+  MpSeriesStats st;
+  mqttpanel_series_stats(id, &st);
+  uint32_t droppedBefore = st.dropped;
+  chartTopic = (String(kBase) + "/chart/1/val").c_str();
+  client.host_drop_connection();
+  for (unsigned long i = 0; i < 200; i++) {
+    mqttpanel_series_add(id, (float)i);
+    step10ms();
+  }
+  mqttpanel_series_stats(id, &st);
+  bench_check(st.depth == 64 && st.dropped - droppedBefore == 136, "offline: ring full, oldest dropped and counted");
+  resetRx();
+  client.connect("bench");
+  for (int i = 0; i < 4; i++) step10ms();
+  drain();
+  bench_check(rx.size() == 64 && rx.front().v == 136.0f && rx.back().v == 199.0f, "after reconnect the newest 64 go out");
+
+  // --- Link drops in the middle of a batch: the points stay in the ring ---
+  resetRx();
+  mqttpanel_series_stats(id, &st);
+  droppedBefore = st.dropped;
+  uint32_t batchesBefore = st.batches;
+  for (int i = 0; i < 20; i++) mqttpanel_series_add(id, (float)(300 + i));
+  client.host_drop_mid_publish(1);
+  mqttpanel_series_flush(id);
+  for (int i = 0; i < 4; i++) step10ms();
+  mqttpanel_series_stats(id, &st);
+  bench_check(!client.connected() && st.depth == 20 && st.batches == batchesBefore && st.dropped == droppedBefore,
+              "failed batch: points kept, not counted as sent");
+  client.connect("bench");
+  for (int i = 0; i < 4; i++) step10ms();
+  drain();
+  bench_check(rx.size() == 20 && rx.front().v == 300.0f && rx.back().v == 319.0f, "and go out after the reconnect");
+
+  // --- Pool and registration limits ---
+  MpSeriesConfig huge;
+  huge.capacity = MPTP_SERIES_WORDS;
+  bench_check(mqttpanel_series((String(kBase) + "/chart/9/val").c_str(), huge) == -1, "pool exhausted: refused");
+  bench_check(mqttpanel_series((String(kBase) + "/chart/a-very-long-relative-topic/val").c_str()) == -1,
+              "key too long: refused");
+
+  // --- Dual-core: batches cross through the hand-off queue ---
+  mqttpanel_dual_core(true);
+  resetRx();
+  for (int i = 0; i < 64; i++) mqttpanel_series_add(id, (float)i);
+  for (int i = 0; i < 4; i++) { mqttpanel_app_loop(); mqttpanel_loop(); }
+  bench_check(rx.size() == 64 && rx.back().v == 63.0f, "dual-core: batches go out from the network core");
+  mqttpanel_dual_core(false);
+
+  // --- Cost per sample ---
+  client.host_set_observer(nullptr);
+  const unsigned long N = bench_iters(200000);
+  BenchResult pub = bench_run("per sample: mqttpanel_number_pub + loop", N, [&](unsigned long i) {
+    mqttpanel_number_pub(perSample.c_str(), signal(i));
+    mqttpanel_loop();
+  });
+  BenchResult add = bench_run("per sample: mqttpanel_series_add + loop (JSON)", N, [&](unsigned long i) {
+    mqttpanel_series_add(id, signal(i));
+    mqttpanel_loop();
+  });
+  mqttpanel_state_format(MP_FRAME_CBOR);
+  BenchResult addCbor = bench_run("per sample: mqttpanel_series_add + loop (CBOR)", N, [&](unsigned long i) {
+    mqttpanel_series_add(id, signal(i));
+    mqttpanel_loop();
+  });
+  printf("per sample: pub %.0f ns, series JSON %.0f ns, CBOR %.0f ns; sample pool %u B\n",
+         pub.nsPerOp, add.nsPerOp, addCbor.nsPerOp, (unsigned)(MPTP_SERIES_WORDS * 4));
+  bench_check(add.allocsPerOp == 0 && addCbor.allocsPerOp == 0, "batching allocates nothing");
+
+  return bench_finish();
+}
@@ -0,0 +1,137 @@
+// State mode (mqttpanel_state_mode) in explained/mqttpanel_explained.cpp:
+// a sync as N per-channel /val publishes vs. one <base>/state document, and a
+// batched <base>/set vs. N single /set messages.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <string>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static const char* kBase = "MyProject/1700000000000";
+
+static bool sw[MPTP_MAX_CHANNELS];
+static int dim[MPTP_MAX_CHANNELS];
+static String txt[MPTP_MAX_CHANNELS];
+static float temp = 21.5f;
+
+static std::string lastTopic, lastPayload;
+
+static void record(const char* topic, const uint8_t* payload, unsigned int len, bool) {
+  lastTopic = topic;
+  lastPayload.assign((const char*)payload, len);
+}
+
+static String topicOf(const char* type, int idx) {
+  return String(kBase) + "/" + type + "/" + String(idx) + "/set";
+}
+
+static int registerPanel() {
+  int n = 0;
+  mqttpanel_bind(topicOf("number", 1).c_str(), &temp);
+  for (int i = 1; n < MPTP_MAX_CHANNELS - 2; i++, n++) {
+    switch (n % 3) {
+      case 0: mqttpanel_switch_sub(topicOf("switch", i).c_str(), &sw[n]); break;
+      case 1: mqttpanel_dimmer_sub(topicOf("dimmer", i).c_str(), &dim[n]); break;
+      case 2: mqttpanel_text_sub(topicOf("text", i).c_str(), &txt[n]); txt[n] = "Hello"; break;
+    }
+  }
+  mqttpanel_sync_sub(topicOf("sync", 1).c_str());
+  return n + 2;
+}
+
+static void drain() {
+  MpTxStats st;
+  for (mqttpanel_tx_stats(&st); st.depth > 0; mqttpanel_tx_stats(&st)) mqttpanel_loop();
+}
+
+static String syncTopic;
+
+static void sync() {
+  client.host_inject(syncTopic.c_str(), (const uint8_t*)"1", 1);
+  drain();
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "explained/mqttpanel_explained.cpp (state mode)");
+
+  client.connect("bench");
+  mqttpanel_begin(&client);
+  int channels = registerPanel();
+  syncTopic = topicOf("sync", 1);
+  mqttpanel_tx_budget(8, 1024);
+  const unsigned long N = bench_iters(100000);
+
+  // --- Sync: per-channel /val vs. one <base>/state ---
+  client.host_reset_counters();
+  sync();
+  unsigned long perMsgs = client.host_pub_count(), perBytes = client.host_pub_bytes();
+  bench_run("sync: per-channel /val (inject + drain)", N, [&](unsigned long) { sync(); });
+
+  bench_check(mqttpanel_state_mode(true), "state mode turns on once the base is known");
+  client.host_reset_counters();
+  sync();
+  unsigned long stMsgs = client.host_pub_count(), stBytes = client.host_pub_bytes();
+  bench_run("sync: one <base>/state (inject + drain)", N, [&](unsigned long) { sync(); });
+  printf("sync of %d channels: per-channel = %lu msgs / %lu bytes, state = %lu msg / %lu bytes\n",
+         channels, perMsgs, perBytes, stMsgs, stBytes);
+  bench_check(stMsgs == 1, "state mode syncs in one message");
+  bench_check(stBytes < perBytes, "state document is smaller than the per-channel publishes");
+
+  client.host_set_observer(record);
+  sync();
+  client.host_set_observer(nullptr);
+  bench_check(lastTopic == std::string(kBase) + "/state", "state goes to <base>/state");
+  bench_check(lastPayload.find("\"dimmer/2\":\"0\"") != std::string::npos &&
+              lastPayload.find("\"number/1\":\"21.50\"") != std::string::npos &&
+              lastPayload.find("sync") == std::string::npos,
+              "state document holds every bound channel and skips sync");
+
+  // --- Batched <base>/set vs. single /set messages ---
+  String setTopic = String(kBase) + "/set";
+  const char* batch = "{\"switch/1\":\"1\",\"dimmer/2\":75,\"text/3\":\"Hi\",\"number/1\":19.5,\"nope/1\":\"1\"}";
+  client.host_inject(setTopic.c_str(), (const uint8_t*)batch, (unsigned)strlen(batch));
+  bench_check(sw[0] && dim[1] == 75 && txt[2] == "Hi" && temp == 19.5f, "batched set applies every known key");
+  const char* clamp = "{\"dimmer/2\":250}";
+  client.host_inject(setTopic.c_str(), (const uint8_t*)clamp, (unsigned)strlen(clamp));
+  bench_check(dim[1] == 100, "batched set goes through the channel's own policy");
+  const char* junk = "{\"dimmer/2\":";
+  client.host_inject(setTopic.c_str(), (const uint8_t*)junk, (unsigned)strlen(junk));
+  bench_check(dim[1] == 100, "malformed batch is ignored");
+
+  String s1 = topicOf("switch", 1), d2 = topicOf("dimmer", 2), t3 = topicOf("text", 3);
+  bench_run("rx: 3 single /set messages", N, [&](unsigned long i) {
+    client.host_inject(s1.c_str(), (const uint8_t*)((i & 1) ? "1" : "0"), 1);
+    client.host_inject(d2.c_str(), (const uint8_t*)"42", 2);
+    client.host_inject(t3.c_str(), (const uint8_t*)"Hi", 2);
+  });
+  const char* three = "{\"switch/1\":\"1\",\"dimmer/2\":\"42\",\"text/3\":\"Hi\"}";
+  bench_run("rx: one batched <base>/set (3 keys)", N, [&](unsigned long) {
+    client.host_inject(setTopic.c_str(), (const uint8_t*)three, (unsigned)strlen(three));
+  });
+
+  // Link drops in the middle of the state document: it stays pending and goes out after the reconnect
+  MpTxStats st0, st;
+  mqttpanel_tx_stats(&st0);
+  client.host_reset_counters();
+  mqttpanel_publish_all_vals();
+  client.host_drop_mid_publish(1);
+  for (int i = 0; i < 3; i++) mqttpanel_loop();
+  mqttpanel_tx_stats(&st);
+  bench_check(!client.connected() && st.depth == 1 && st.sent == st0.sent, "failed state publish stays pending, not sent");
+  client.connect("bench");
+  drain();
+  mqttpanel_tx_stats(&st);
+  bench_check(client.host_pub_count() == 1 && st.sent == st0.sent + 1 && st.dropped == st0.dropped,
+              "state document is sent once after the reconnect");
+
+  mqttpanel_state_mode(false);
+  client.host_reset_counters();
+  sync();
+  bench_check(client.host_pub_count() == perMsgs, "turning state mode off restores per-channel sync");
+
+  return bench_finish();
+}
@@ -0,0 +1,182 @@
+// Large payloads in mqttpanel.cpp: a 32 KB "image" published with
+// mqttpanel_pub_begin/write/end and mqttpanel_pub_stream (from a LittleFS file)
+// vs. a String through mqttpanel_pub, which needs a packet buffer as large as
+// the message; plus chunked receive of oversized messages with the default
+// 256 B PubSubClient buffer.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <LittleFS.h>
+#include <string>
+#include <vector>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static char mqtt_server[40] = "127.0.0.1";
+static char mqtt_port[6] = "1883";
+static char mqtt_topic[40] = "MyProject/1700000000000";
+
+static const size_t kImage = 32 * 1024;
+static std::vector<uint8_t> image;
+
+static unsigned long rxCount = 0;
+static void rx_raw(const char*, size_t, const uint8_t*, size_t) { rxCount++; }
+
+static std::string lastTopic, lastPayload;
+static unsigned long pubs = 0;
+static void record(const char* topic, const uint8_t* payload, unsigned int len, bool) {
+  pubs++;
+  lastTopic = topic;
+  lastPayload.assign((const char*)payload, len);
+}
+
+// Reassembles what the chunk handler hands out and checks the contract.
+static std::string rxData, rxTopic;
+static size_t rxTotal = 0, rxChunks = 0, rxMaxChunk = 0;
+static bool rxOrdered = true, rxDone = false;
+static void on_chunk(const char* topic, size_t topicLen, const uint8_t* data, size_t n, size_t offset,
+                     size_t total, bool done, void*) {
+  if (offset != rxData.size()) rxOrdered = false;
+  if (!done && (topic || total)) rxOrdered = false;
+  rxData.append((const char*)data, n);
+  rxChunks++;
+  if (n > rxMaxChunk) rxMaxChunk = n;
+  if (done) {
+    rxDone = true;
+    rxTopic.assign(topic, topicLen);
+    rxTotal = total;
+  }
+}
+static size_t sunk = 0;
+static void on_chunk_sink(const char*, size_t, const uint8_t*, size_t n, size_t, size_t, bool, void*) { sunk += n; }
+
+static void resetRx() {
+  rxData.clear();
+  rxTopic.clear();
+  rxTotal = rxChunks = rxMaxChunk = 0;
+  rxOrdered = true;
+  rxDone = false;
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp (large payloads)");
+
+  image.resize(kImage);
+  for (size_t i = 0; i < kImage; i++) image[i] = (uint8_t)('A' + (i * 131 + (i >> 8)) % 26); // text: mqttpanel_pub takes a C string
+  std::string imageStr((const char*)image.data(), image.size());
+  String imgTopic = String(mqtt_topic) + "/image/1/val";
+
+  mqttpanel_begin(&client, rx_raw, mqtt_server, mqtt_port, mqtt_topic, 3, 10, 0, 4, 20);
+  for (int i = 0; i < 3; i++) mqttpanel_loop();
+  bench_check(client.connected(), "client connected after the first loops");
+
+  // --- Streaming publish ---
+  client.host_set_observer(record);
+  bool ok = mqttpanel_pub_begin(imgTopic.c_str(), kImage);
+  for (size_t off = 0; ok && off < kImage; off += 256) ok = mqttpanel_pub_write(image.data() + off, 256) == 256;
+  ok = mqttpanel_pub_end() && ok;
+  bench_check(ok && pubs == 1 && lastTopic == imgTopic.c_str() && lastPayload == imageStr,
+              "32 KB goes out through the 256 B packet buffer, byte for byte");
+
+  File f = LittleFS.open("/img.jpg", "w");
+  f.write(image.data(), image.size());
+  f.close();
+  f = LittleFS.open("/img.jpg", "r");
+  ok = mqttpanel_pub_stream(imgTopic.c_str(), f, f.size());
+  f.close();
+  bench_check(ok && pubs == 2 && lastPayload == imageStr, "mqttpanel_pub_stream from a LittleFS file");
+
+  // mqttpanel_pub while a stream is open waits for it
+  pubs = 0;
+  mqttpanel_pub_begin(imgTopic.c_str(), 4);
+  mqttpanel_pub(String(mqtt_topic) + "/status", "busy");
+  bench_check(!mqttpanel_pub_begin(imgTopic.c_str(), 4), "one stream at a time");
+  mqttpanel_pub_write((const uint8_t*)"abcd", 4);
+  bench_check(mqttpanel_pub_write((const uint8_t*)"e", 1) == 0, "no byte past the announced length");
+  mqttpanel_pub_end();
+  bench_check(pubs == 1 && lastPayload == "abcd", "a pub during the stream does not cut into it");
+  for (int i = 0; i < 200 && pubs < 2; i++) { mqttpanel_loop(); delay(10); }
+  bench_check(pubs == 2 && lastPayload == "busy", "it goes out after mqttpanel_pub_end()");
+
+  // Too short: the session is dropped (the broker would read the next packet as payload)
+  mqttpanel_pub_begin(imgTopic.c_str(), 100);
+  mqttpanel_pub_write(image.data(), 50);
+  bench_check(!mqttpanel_pub_end() && !client.connected(), "a short stream fails and drops the session");
+  for (int i = 0; i < 400 && !client.connected(); i++) { mqttpanel_loop(); delay(10); }
+  bench_check(client.connected(), "reconnects after the short stream");
+  bench_check(!mqttpanel_pub_begin(imgTopic.c_str(), 0) || mqttpanel_pub_end(), "empty payload is fine");
+
+  // --- Cost: stream vs. String through a packet buffer as large as the message ---
+  client.host_set_observer(nullptr);
+  const unsigned long N = bench_iters(2000);
+  BenchResult stream = bench_run("32 KB: pub_begin + 128 x 256 B write + end", N, [&](unsigned long) {
+    mqttpanel_pub_begin(imgTopic.c_str(), kImage);
+    for (size_t off = 0; off < kImage; off += 256) mqttpanel_pub_write(image.data() + off, 256);
+    mqttpanel_pub_end();
+  });
+  unsigned long before = client.host_pub_count();
+  mqttpanel_pub(imgTopic, String(imageStr.c_str()));
+  bench_check(client.host_pub_count() == before, "mqttpanel_pub cannot send it with the default buffer");
+  client.setBufferSize(kImage + 64);
+  BenchResult str = bench_run("32 KB: String + mqttpanel_pub, 32 KB buffer", N, [&](unsigned long) {
+    String s;
+    s.reserve(kImage);
+    s.concat((const char*)image.data(), kImage); // the payload has to exist as one String first
+    mqttpanel_pub(imgTopic, s);
+  });
+  client.setBufferSize(MQTT_MAX_PACKET_SIZE);
+  printf("RAM for a 32 KB message: stream %u B (packet buffer) vs. String %u B (buffer) + %u B (String)\n",
+         (unsigned)MQTT_MAX_PACKET_SIZE, (unsigned)(kImage + 64), (unsigned)kImage);
+  bench_check(stream.allocsPerOp == 0 && str.allocsPerOp >= 1, "streaming allocates nothing");
+
+  // --- Chunked receive ---
+  std::string small = "57";
+  String dimTopic = String(mqtt_topic) + "/dimmer/1/set";
+  rxCount = 0;
+  bench_check(!client.host_inject(imgTopic.c_str(), image.data(), kImage) && rxCount == 0,
+              "without chunk mode an oversized message is dropped");
+  client.setBufferSize(1024);
+  bench_check(!mqttpanel_on_chunks(on_chunk), "refused while the packet buffer is larger than MP_CHUNK_BYTES");
+  client.setBufferSize(MQTT_MAX_PACKET_SIZE);
+  bench_check(mqttpanel_on_chunks(on_chunk), "chunk mode on");
+
+  client.host_inject(imgTopic.c_str(), image.data(), kImage);
+  bench_check(rxDone && rxData == imageStr && rxTotal == kImage && rxTopic == imgTopic.c_str(),
+              "32 KB arrives in order, topic and total on the last chunk");
+  bench_check(rxOrdered && rxMaxChunk <= MP_CHUNK_BYTES && rxChunks == kImage / MP_CHUNK_BYTES,
+              "fragments of at most MP_CHUNK_BYTES, topic NULL until done");
+  bench_check(rxCount == 0, "oversized messages do not reach the callback");
+
+  resetRx();
+  client.host_inject(dimTopic.c_str(), (const uint8_t*)small.data(), small.size());
+  bench_check(rxChunks == 0 && rxCount == 1, "messages that fit take the normal path");
+  std::string edge(MQTT_MAX_PACKET_SIZE - dimTopic.length() - 1, 'x');
+  client.host_inject(dimTopic.c_str(), (const uint8_t*)edge.data(), edge.size());
+  bench_check(rxChunks == 0 && rxCount == 2, "a message that exactly fills the buffer is not chunked");
+  edge += 'x';
+  client.host_inject(dimTopic.c_str(), (const uint8_t*)edge.data(), edge.size());
+  bench_check(rxChunks == 1 && rxData == edge && rxCount == 2, "one byte more is");
+
+  mqttpanel_on_chunks(NULL);
+  resetRx();
+  client.host_inject(imgTopic.c_str(), image.data(), kImage);
+  bench_check(rxChunks == 0 && rxCount == 2, "chunk mode off: dropped again (not delivered cut)");
+  client.host_inject(dimTopic.c_str(), (const uint8_t*)small.data(), small.size());
+  bench_check(rxCount == 3, "small messages still delivered");
+
+  mqttpanel_on_chunks(on_chunk_sink);
+  BenchResult rx = bench_run("rx 32 KB in 256 B chunks", N, [&](unsigned long) {
+    client.host_inject(imgTopic.c_str(), image.data(), kImage);
+  });
+  BenchResult rxSmall = bench_run("rx 2 B message, chunk mode on", N * 100, [&](unsigned long) {
+    client.host_inject(dimTopic.c_str(), (const uint8_t*)small.data(), small.size());
+  });
+  printf("rx: %.1f MB/s through a %u B chunk buffer, %.0f ns per small message\n",
+         (double)kImage * 1000.0 / rx.nsPerOp, (unsigned)MP_CHUNK_BYTES, rxSmall.nsPerOp);
+  bench_check(sunk > 0 && rx.allocsPerOp == 0, "chunked receive allocates nothing");
+
+  return bench_finish();
+}
@@ -0,0 +1,193 @@
+// Topic table (mqttpanel_table) in mqttpanel.cpp: the sorted constexpr table the
+// app's code generator emits vs. the if (topic == String(mqtt_topic_head) + "...")
+// chain it used to emit and vs. 24 mqttpanel_on registrations; plus the
+// compile-time sort check, the value kinds and the dispatch order.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <climits>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "mqttpanel.h"
+#include "bench.h"
+
+static WiFiClient espClient;
+static PubSubClient client(espClient);
+
+static char mqtt_server[40] = "127.0.0.1";
+static char mqtt_port[6] = "1883";
+static char mqtt_topic_head[40] = "MyProject/1700000000000/"; // as generated: trailing slash
+
+static const char* kTypes[3] = { "switch", "dimmer", "text" };
+static bool sw[9];
+static int dim[9];
+static String txt[9];
+static float num1 = 0;
+static unsigned long fallback = 0, hooks = 0, calls = 0, handled = 0;
+
+// What the generator emitted before: one String per comparison, per message.
+static void mq_receiver(String topic, String msg) {
+  fallback++;
+  for (int i = 1; i <= 8; i++) {
+    if (topic == String(mqtt_topic_head) + "switch/" + String(i) + "/set") { sw[i] = (msg == "1"); return; }
+  }
+  for (int i = 1; i <= 8; i++) {
+    if (topic == String(mqtt_topic_head) + "dimmer/" + String(i) + "/set") { dim[i] = msg.toInt(); return; }
+  }
+  for (int i = 1; i <= 8; i++) {
+    if (topic == String(mqtt_topic_head) + "text/" + String(i) + "/set") { txt[i] = msg; return; }
+  }
+}
+
+static void on_switch(const char*, size_t, const uint8_t* p, size_t n, void* arg) { *(bool*)arg = (n == 1 && p[0] == '1'); }
+static void on_dimmer(const char*, size_t, const uint8_t* p, size_t n, void* arg) {
+  int v = 0;
+  for (size_t i = 0; i < n && p[i] >= '0' && p[i] <= '9'; i++) v = v * 10 + (p[i] - '0');
+  *(int*)arg = v;
+}
+static void on_text(const char*, size_t, const uint8_t* p, size_t n, void* arg) {
+  String& s = *(String*)arg;
+  s = "";
+  s.concat((const char*)p, (unsigned)n);
+}
+static void hook(const char*, size_t, const uint8_t*, size_t, void* arg) { if (arg == &sw[1] && sw[1]) hooks++; }
+static void call(const char*, size_t, const uint8_t*, size_t, void* arg) { calls += (arg == &calls); }
+static void other(const char*, size_t, const uint8_t*, size_t, void*) { handled++; }
+
+// As generate() emits it: sorted by topic, bound variables by address, all constant.
+MP_TOPIC_TABLE(mp_topics) = {
+  { "cmd/reboot",   MP_TOPIC_CALL,   &calls,  call },
+  { "dimmer/1/set", MP_TOPIC_DIMMER, &dim[1], NULL },
+  { "dimmer/2/set", MP_TOPIC_DIMMER, &dim[2], NULL },
+  { "dimmer/3/set", MP_TOPIC_DIMMER, &dim[3], NULL },
+  { "dimmer/4/set", MP_TOPIC_DIMMER, &dim[4], NULL },
+  { "dimmer/5/set", MP_TOPIC_DIMMER, &dim[5], NULL },
+  { "dimmer/6/set", MP_TOPIC_DIMMER, &dim[6], NULL },
+  { "dimmer/7/set", MP_TOPIC_DIMMER, &dim[7], NULL },
+  { "dimmer/8/set", MP_TOPIC_DIMMER, &dim[8], NULL },
+  { "number/1/set", MP_TOPIC_NUMBER, &num1,   NULL },
+  { "switch/1/set", MP_TOPIC_SWITCH, &sw[1],  hook },
+  { "switch/2/set", MP_TOPIC_SWITCH, &sw[2],  NULL },
+  { "switch/3/set", MP_TOPIC_SWITCH, &sw[3],  NULL },
+  { "switch/4/set", MP_TOPIC_SWITCH, &sw[4],  NULL },
+  { "switch/5/set", MP_TOPIC_SWITCH, &sw[5],  NULL },
+  { "switch/6/set", MP_TOPIC_SWITCH, &sw[6],  NULL },
+  { "switch/7/set", MP_TOPIC_SWITCH, &sw[7],  NULL },
+  { "switch/8/set", MP_TOPIC_SWITCH, &sw[8],  NULL },
+  { "text/1/set",   MP_TOPIC_TEXT,   &txt[1], NULL },
+  { "text/2/set",   MP_TOPIC_TEXT,   &txt[2], NULL },
+  { "text/3/set",   MP_TOPIC_TEXT,   &txt[3], NULL },
+  { "text/4/set",   MP_TOPIC_TEXT,   &txt[4], NULL },
+  { "text/5/set",   MP_TOPIC_TEXT,   &txt[5], NULL },
+  { "text/6/set",   MP_TOPIC_TEXT,   &txt[6], NULL },
+  { "text/7/set",   MP_TOPIC_TEXT,   &txt[7], NULL },
+  { "text/8/set",   MP_TOPIC_TEXT,   &txt[8], NULL },
+};
+static_assert(mp_table_sorted(mp_topics), "topic table must be sorted");
+
+// The check rejects what would break the binary search.
+MP_TOPIC_TABLE(unsorted) = { { "switch/1/set", MP_TOPIC_SWITCH, &sw[1], NULL }, { "dimmer/1/set", MP_TOPIC_DIMMER, &dim[1], NULL } };
+MP_TOPIC_TABLE(duplicate) = { { "a", MP_TOPIC_CALL, NULL, call }, { "a", MP_TOPIC_CALL, NULL, call } };
+MP_TOPIC_TABLE(prefix) = { { "a", MP_TOPIC_CALL, NULL, call }, { "a/b", MP_TOPIC_CALL, NULL, call } };
+static_assert(!mp_table_sorted(unsorted) && !mp_table_sorted(duplicate) && mp_table_sorted(prefix), "sort check");
+static_assert(std::is_trivially_copyable<MpTopicEntry>::value, "entries are plain data (flash-resident)");
+
+static void clearAll() {
+  for (int i = 1; i <= 8; i++) { sw[i] = false; dim[i] = 0; txt[i] = ""; }
+  fallback = 0;
+}
+
+int main(int argc, char** argv) {
+  bench_init(argc, argv, "mqttpanel.cpp (topic table)");
+
+  mqttpanel_begin(&client, mq_receiver, mqtt_server, mqtt_port, mqtt_topic_head, 3, 10, 0, 4, 20);
+  for (int i = 0; i < 3; i++) mqttpanel_loop();
+  bench_check(client.connected(), "client connected after the first loops");
+
+  std::vector<String> topics;
+  for (int t = 0; t < 3; t++)
+    for (int i = 1; i <= 8; i++) topics.push_back(String(mqtt_topic_head) + kTypes[t] + "/" + String(i) + "/set");
+  const char* payloads[3] = { "1", "57", "Hello" };
+  auto inject = [&](unsigned long i) {
+    size_t k = i % topics.size();
+    const char* p = payloads[k / 8];
+    client.host_inject(topics[k].c_str(), (const uint8_t*)p, (unsigned)strlen(p));
+  };
+  const unsigned long N = bench_iters(500000);
+
+  // --- Generated if-chain (String callback) ---
+  BenchResult chain = bench_run("24 topics: generated if (topic == String(...)) chain", N, inject);
+  bench_check(sw[8] && dim[8] == 57 && txt[8] == "Hello", "if-chain applies the values");
+
+  // --- 24 mqttpanel_on registrations ---
+  clearAll();
+  char pat[40];
+  BenchResult reg = bench_run("startup: 24 mqttpanel_on registrations", 1, [&](unsigned long) {
+    for (int i = 1; i <= 8; i++) {
+      snprintf(pat, sizeof(pat), "switch/%d/set", i); mqttpanel_on(pat, on_switch, &sw[i]);
+      snprintf(pat, sizeof(pat), "dimmer/%d/set", i); mqttpanel_on(pat, on_dimmer, &dim[i]);
+      snprintf(pat, sizeof(pat), "text/%d/set", i);   mqttpanel_on(pat, on_text, &txt[i]);
+    }
+  });
+  BenchResult tree = bench_run("24 topics: mqttpanel_on match tree", N, inject);
+  bench_check(fallback == 0 && sw[8] && dim[8] == 57 && txt[8] == "Hello", "handlers apply the values");
+  mqttpanel_on_clear();
+
+  // --- Topic table ---
+  clearAll();
+  BenchResult use = bench_run("startup: mqttpanel_table(mp_topics)", 1, [&](unsigned long) { mqttpanel_table(mp_topics); });
+  BenchResult table = bench_run("24 topics: constexpr topic table", N, inject);
+  bench_check(fallback == 0 && sw[8] && dim[8] == 57 && txt[8] == "Hello", "table applies the values, callback not called");
+  bench_check(table.allocsPerOp <= tree.allocsPerOp, "table dispatch allocates no more than the handlers (text only)");
+  printf("per message: if-chain %.0f ns / %.1f allocs, match tree %.0f ns, table %.0f ns\n",
+         chain.nsPerOp, chain.allocsPerOp, tree.nsPerOp, table.nsPerOp);
+  printf("startup: 24 registrations %.0f ns, table %.0f ns; table %u B const data, no RAM pools\n",
+         reg.nsPerOp, use.nsPerOp, (unsigned)sizeof(mp_topics));
+
+  // --- Kinds, hooks, order ---
+  std::string h = mqtt_topic_head;
+  hooks = 0;
+  client.host_inject((h + "switch/1/set").c_str(), (const uint8_t*)"1", 1);
+  bench_check(sw[1] && hooks == 1, "fn runs after the variable is written, arg = var");
+  client.host_inject((h + "switch/1/set").c_str(), (const uint8_t*)"true", 4);
+  bench_check(!sw[1], "switch: only \"1\" is on (as the generated receiver did)");
+  client.host_inject((h + "dimmer/2/set").c_str(), (const uint8_t*)"-42x", 4);
+  bench_check(dim[2] == -42, "dimmer: signed, stops at the first non-digit");
+  client.host_inject((h + "dimmer/2/set").c_str(), (const uint8_t*)"99999999999999999999", 20);
+  bench_check(dim[2] == INT_MAX, "dimmer: a long run of digits saturates instead of wrapping");
+  client.host_inject((h + "dimmer/2/set").c_str(), (const uint8_t*)"-99999999999999999999", 21);
+  bench_check(dim[2] == -INT_MAX, "dimmer: same for negative values");
+  client.host_inject((h + "number/1/set").c_str(), (const uint8_t*)"21.5", 4);
+  bench_check(num1 == 21.5f, "number: float");
+  client.host_inject((h + "cmd/reboot").c_str(), (const uint8_t*)"", 0);
+  bench_check(calls == 1, "call: fn only");
+
+  mqttpanel_on("switch/+/set", other);
+  mqttpanel_on("cmd/#", other);
+  handled = 0;
+  fallback = 0;
+  client.host_inject((h + "switch/2/set").c_str(), (const uint8_t*)"1", 1);
+  bench_check(sw[2] && handled == 0 && fallback == 0, "table before handlers");
+  client.host_inject((h + "switch/9/set").c_str(), (const uint8_t*)"1", 1);
+  client.host_inject((h + "cmd/reboot/now").c_str(), (const uint8_t*)"1", 1);
+  bench_check(handled == 2 && fallback == 0, "not in the table: handlers");
+  mqttpanel_on_clear();
+  client.host_inject((h + "dimmer/9/set").c_str(), (const uint8_t*)"1", 1);
+  client.host_inject((h + "dimmer/1/set/x").c_str(), (const uint8_t*)"1", 1);
+  client.host_inject((h + "dimmer").c_str(), (const uint8_t*)"1", 1);
+  client.host_inject((h + "switch/1/set-and-a-topic-longer-than-the-column").c_str(), (const uint8_t*)"1", 1);
+  bench_check(fallback == 4, "no match, prefix or too long: the begin() callback");
+
+  strcpy(mqtt_topic_head, "MyProject/1700000000000"); // the plain sketch form, no trailing slash
+  client.host_inject("MyProject/1700000000000/dimmer/3/set", (const uint8_t*)"9", 1);
+  strcpy(mqtt_topic_head, "MyProject/1700000000000/");
+  bench_check(dim[3] == 9, "<topic> without a trailing slash");
+
+  mqttpanel_table(NULL, 0);
+  fallback = 0;
+  client.host_inject((h + "dimmer/1/set").c_str(), (const uint8_t*)"1", 1);
+  bench_check(fallback == 1, "mqttpanel_table(NULL, 0) turns it off");
+
+  return bench_finish();
+}
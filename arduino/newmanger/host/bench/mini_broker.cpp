@@ -0,0 +1,223 @@
+#include "mini_broker.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Conn {
+  int fd;
+  std::string in;
+  std::vector<std::string> subs;
+};
+
+// MQTT filter match: "+" = one level, "#" = the rest (and the parent level).
+bool topic_match(const std::string& filter, const char* t, size_t n) {
+  size_t f = 0, i = 0;
+  for (;;) {
+    if (f < filter.size() && filter[f] == '#') return true;
+    size_t fe = filter.find('/', f);
+    if (fe == std::string::npos) fe = filter.size();
+    size_t te = i;
+    while (te < n && t[te] != '/') te++;
+    bool plus = fe - f == 1 && filter[f] == '+';
+    if (!plus && (fe - f != te - i || memcmp(filter.data() + f, t + i, fe - f) != 0)) return false;
+    if (te == n) return fe == filter.size() || filter.compare(fe, std::string::npos, "/#") == 0;
+    if (fe == filter.size()) return false;
+    f = fe + 1;
+    i = te + 1;
+  }
+}
+
+void send_all(int fd, const void* p, size_t n) {
+  const uint8_t* b = (const uint8_t*)p;
+  while (n) {
+    ssize_t w = send(fd, b, n, MSG_NOSIGNAL);
+    if (w <= 0) {
+      if (w < 0 && errno == EINTR) continue;
+      return; // the poll loop notices the dead connection
+    }
+    b += w;
+    n -= (size_t)w;
+  }
+}
+
+void put_len(std::string& s, uint32_t len) {
+  do {
+    uint8_t b = len % 128;
+    len /= 128;
+    s += (char)(len ? b | 128 : b);
+  } while (len);
+}
+
+} // namespace
+
+bool MiniBroker::start(uint16_t port) {
+  _listen = socket(AF_INET, SOCK_STREAM, 0);
+  if (_listen < 0) return false;
+  int one = 1;
+  setsockopt(_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  a.sin_port = htons(port);
+  socklen_t len = sizeof(a);
+  if (bind(_listen, (sockaddr*)&a, sizeof(a)) < 0 || listen(_listen, 16) < 0 ||
+      getsockname(_listen, (sockaddr*)&a, &len) < 0) {
+    close(_listen);
+    _listen = -1;
+    return false;
+  }
+  _port = ntohs(a.sin_port);
+  _running = true;
+  _thread = std::thread(&MiniBroker::run, this);
+  return true;
+}
+
+void MiniBroker::stop() {
+  if (!_running) return;
+  _running = false;
+  _thread.join();
+  close(_listen);
+  _listen = -1;
+}
+
+void MiniBroker::run() {
+  std::vector<Conn> conns;
+  std::vector<pollfd> fds;
+  std::string out;
+  while (_running) {
+    fds.clear();
+    fds.push_back({_listen, POLLIN, 0});
+    for (const Conn& c : conns) fds.push_back({c.fd, POLLIN, 0});
+    if (poll(fds.data(), fds.size(), 20) <= 0) continue;
+
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(_listen, nullptr, nullptr);
+      if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        conns.push_back({fd, std::string(), {}});
+      }
+    }
+
+    for (size_t k = 1; k < fds.size(); k++) {
+      if (!fds[k].revents) continue;
+      Conn& c = conns[k - 1];
+      char buf[16384];
+      ssize_t r = recv(c.fd, buf, sizeof(buf), 0);
+      if (r <= 0) {
+        close(c.fd);
+        c.fd = -1;
+        continue;
+      }
+      c.in.append(buf, (size_t)r);
+
+      size_t at = 0;
+      for (;;) {
+        if (at + 2 > c.in.size()) break;
+        uint8_t type = (uint8_t)c.in[at];
+        uint32_t len = 0, mul = 1;
+        size_t h = at + 1;
+        bool whole = false;
+        while (h < c.in.size() && h - at <= 4) {
+          uint8_t b = (uint8_t)c.in[h++];
+          len += (b & 127) * mul;
+          mul *= 128;
+          if (!(b & 128)) { whole = true; break; }
+        }
+        if (!whole || h + len > c.in.size()) break;
+        const uint8_t* b = (const uint8_t*)c.in.data() + h;
+        at = h + len;
+
+        switch (type & 0xF0) {
+          case 0x10: { // CONNECT
+            const uint8_t ack[4] = { 0x20, 2, 0, 0 };
+            send_all(c.fd, ack, 4);
+            break;
+          }
+          case 0x30: { // PUBLISH
+            if (len < 2) break;
+            uint8_t qos = (type >> 1) & 3;
+            uint16_t tl = (uint16_t)((b[0] << 8) | b[1]);
+            uint32_t p = 2u + tl + (qos ? 2u : 0u);
+            if (p > len) break;
+            if (qos == 1) {
+              const uint8_t ack[4] = { 0x40, 2, b[2 + tl], b[3 + tl] };
+              send_all(c.fd, ack, 4);
+            }
+            out.clear();
+            out += (char)0x30;
+            put_len(out, 2 + tl + (len - p));
+            out.append((const char*)b, 2 + tl);
+            out.append((const char*)b + p, len - p);
+            for (Conn& d : conns) {
+              if (d.fd < 0) continue;
+              for (const std::string& f : d.subs) {
+                if (!topic_match(f, (const char*)b + 2, tl)) continue;
+                send_all(d.fd, out.data(), out.size());
+                _routed++;
+                break;
+              }
+            }
+            break;
+          }
+          case 0x80:   // SUBSCRIBE
+          case 0xA0: { // UNSUBSCRIBE
+            bool sub = (type & 0xF0) == 0x80;
+            std::string ack;
+            ack += (char)(sub ? 0x90 : 0xB0);
+            std::string codes;
+            for (uint32_t i = 2; i + 2 <= len;) {
+              uint16_t fl = (uint16_t)((b[i] << 8) | b[i + 1]);
+              std::string f((const char*)b + i + 2, fl);
+              i += 2 + fl;
+              if (sub) {
+                c.subs.push_back(f);
+                codes += (char)0; // granted QoS 0
+                i++;
+              } else {
+                for (size_t j = 0; j < c.subs.size(); j++) {
+                  if (c.subs[j] == f) { c.subs.erase(c.subs.begin() + j); break; }
+                }
+              }
+            }
+            put_len(ack, 2 + (uint32_t)codes.size());
+            ack.append((const char*)b, 2);
+            ack += codes;
+            send_all(c.fd, ack.data(), ack.size());
+            break;
+          }
+          case 0xC0: { // PINGREQ
+            const uint8_t resp[2] = { 0xD0, 0 };
+            send_all(c.fd, resp, 2);
+            break;
+          }
+          case 0xE0: // DISCONNECT
+            close(c.fd);
+            c.fd = -1;
+            break;
+        }
+        if (c.fd < 0) break;
+      }
+      if (c.fd >= 0) c.in.erase(0, at);
+    }
+
+    for (size_t i = 0; i < conns.size();) {
+      if (conns[i].fd < 0) conns.erase(conns.begin() + i);
+      else i++;
+    }
+  }
+  for (Conn& c : conns) {
+    if (c.fd >= 0) close(c.fd);
+  }
+}
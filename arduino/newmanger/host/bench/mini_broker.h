@@ -0,0 +1,32 @@
+#ifndef MP_MINI_BROKER_H
+#define MP_MINI_BROKER_H
+// Minimal MQTT 3.1.1 broker on a background thread, for benches that need a
+// real TCP broker when mosquitto is not installed. CONNECT, SUBSCRIBE /
+// UNSUBSCRIBE (with + and #), PUBLISH (QoS 1 is acknowledged; everything is
+// delivered at QoS 0), PINGREQ, DISCONNECT. No retained messages, no
+// sessions, no auth. One poll() loop, so it adds no scheduling noise.
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+class MiniBroker {
+public:
+  ~MiniBroker() { stop(); }
+  // port 0 = any free port (see port()). Listens on 127.0.0.1 only.
+  bool start(uint16_t port = 0);
+  void stop();
+  uint16_t port() const { return _port; }
+  unsigned long routed() const { return _routed; } // PUBLISH packets delivered to subscribers
+
+private:
+  void run();
+
+  int _listen = -1;
+  uint16_t _port = 0;
+  std::atomic<bool> _running{false};
+  std::atomic<unsigned long> _routed{0};
+  std::thread _thread;
+};
+
+#endif
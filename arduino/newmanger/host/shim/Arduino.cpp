@@ -0,0 +1,205 @@
+#include "Arduino.h"
+
+#include <chrono>
+#include <thread>
+
+// ==========================================
+// Host hooks
+// ==========================================
+namespace host {
+
+std::atomic<unsigned long> alloc_count(0);
+std::atomic<unsigned long> alloc_bytes(0);
+
+void* tracked_realloc(void* ptr, size_t size) {
+  alloc_count++;
+  alloc_bytes += size;
+  return realloc(ptr, size);
+}
+
+void tracked_free(void* ptr) { free(ptr); }
+
+static bool s_manualClock = false;
+static uint64_t s_manualUs = 0;
+
+static uint64_t realUs() {
+  using namespace std::chrono;
+  static const steady_clock::time_point t0 = steady_clock::now();
+  return (uint64_t)duration_cast<microseconds>(steady_clock::now() - t0).count();
+}
+
+void clock_manual(bool on) {
+  if (on && !s_manualClock) s_manualUs = realUs();
+  s_manualClock = on;
+}
+
+static uint64_t s_atUs = 0;
+static void (*s_atFn)() = nullptr;
+
+void clock_at(uint64_t atUs, void (*fn)()) {
+  s_atUs = atUs;
+  s_atFn = fn;
+}
+
+void clock_advance_us(uint64_t us) {
+  uint64_t to = s_manualUs + us;
+  if (s_atFn && s_atUs <= to) {
+    if (s_atUs > s_manualUs) s_manualUs = s_atUs;
+    void (*fn)() = s_atFn;
+    s_atFn = nullptr;
+    fn();
+  }
+  if (to > s_manualUs) s_manualUs = to;
+}
+
+uint64_t clock_now_us() { return s_manualClock ? s_manualUs : realUs(); }
+
+static int s_gpioIn[64];
+static int s_gpioOut[64];
+static bool s_gpioInit = false;
+static void (*s_gpioIsr[64])() = {};
+static int s_gpioIsrMode[64];
+static unsigned long s_gpioAccess = 0;
+
+static void gpioInit() {
+  if (s_gpioInit) return;
+  for (int i = 0; i < 64; i++) { s_gpioIn[i] = HIGH; s_gpioOut[i] = LOW; }
+  s_gpioInit = true;
+}
+
+void gpio_set_input(uint8_t pin, int level) {
+  gpioInit();
+  pin &= 63;
+  int was = s_gpioIn[pin];
+  s_gpioIn[pin] = level;
+  if (!s_gpioIsr[pin] || (was != LOW) == (level != LOW)) return;
+  int mode = s_gpioIsrMode[pin];
+  if (mode == CHANGE || (mode == RISING && level != LOW) || (mode == FALLING && level == LOW)) s_gpioIsr[pin]();
+}
+int gpio_get_output(uint8_t pin) { gpioInit(); return s_gpioOut[pin & 63]; }
+unsigned long gpio_access_count() { return s_gpioAccess; }
+
+static uint32_t s_heapFree = 40 * 1024;
+static uint32_t s_heapBlock = 32 * 1024;
+void heap_set(uint32_t freeBytes, uint32_t maxBlock) { s_heapFree = freeBytes; s_heapBlock = maxBlock; }
+
+static bool s_serialEcho = false;
+void serial_echo(bool on) { s_serialEcho = on; }
+
+} // namespace host
+
+// ==========================================
+// Arduino core API
+// ==========================================
+unsigned long millis() { return (unsigned long)(host::clock_now_us() / 1000); }
+unsigned long micros() { return (unsigned long)host::clock_now_us(); }
+
+void delay(unsigned long ms) {
+  if (host::s_manualClock) host::clock_advance_us((uint64_t)ms * 1000);
+  else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {}
+
+void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; host::gpioInit(); }
+int digitalRead(uint8_t pin) { host::gpioInit(); host::s_gpioAccess++; return host::s_gpioIn[pin & 63]; }
+void digitalWrite(uint8_t pin, uint8_t val) {
+  host::gpioInit();
+  host::s_gpioAccess++;
+  host::s_gpioOut[pin & 63] = val ? HIGH : LOW;
+}
+void analogWrite(uint8_t pin, int val) { host::gpioInit(); host::s_gpioOut[pin & 63] = val; }
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) {
+  host::s_gpioIsr[interrupt & 63] = isr;
+  host::s_gpioIsrMode[interrupt & 63] = mode;
+}
+void detachInterrupt(uint8_t interrupt) { host::s_gpioIsr[interrupt & 63] = nullptr; }
+
+long random(long howbig) { return howbig <= 0 ? 0 : (long)(rand() % howbig); }
+long random(long howsmall, long howbig) { return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall); }
+void randomSeed(unsigned long seed) { srand((unsigned)seed); }
+
+// --- Numeric conversions ---
+static char* utoa_impl(unsigned long v, char* buf, int base) {
+  char tmp[66];
+  char* p = tmp + sizeof(tmp) - 1;
+  *p = 0;
+  do { unsigned d = (unsigned)(v % base); *--p = (char)(d < 10 ? '0' + d : 'a' + d - 10); v /= base; } while (v);
+  strcpy(buf, p);
+  return buf;
+}
+
+char* ltoa(long value, char* buf, int base) {
+  if (value < 0 && base == 10) { buf[0] = '-'; utoa_impl(0UL - (unsigned long)value, buf + 1, base); return buf; }
+  return utoa_impl((unsigned long)value, buf, base);
+}
+char* itoa(int value, char* buf, int base) {
+  if (value < 0 && base == 10) return ltoa(value, buf, base);
+  return utoa_impl((unsigned)value, buf, base);
+}
+char* utoa(unsigned value, char* buf, int base) { return utoa_impl(value, buf, base); }
+char* ultoa(unsigned long value, char* buf, int base) { return utoa_impl(value, buf, base); }
+
+char* dtostrf(double val, signed char width, unsigned char prec, char* buf) {
+  sprintf(buf, "%*.*f", width, prec, val);
+  return buf;
+}
+
+#if !defined(__GLIBC__) || !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t n = strlen(src);
+  if (size) {
+    size_t c = n >= size ? size - 1 : n;
+    memcpy(dst, src, c);
+    dst[c] = 0;
+  }
+  return n;
+}
+
+size_t strlcat(char* dst, const char* src, size_t size) {
+  size_t d = strnlen(dst, size);
+  if (d == size) return size + strlen(src);
+  return d + strlcpy(dst + d, src, size - d);
+}
+#endif
+
+// --- Print ---
+size_t Print::print(long v, int base) { char b[66]; ltoa(v, b, base); return write(b); }
+size_t Print::print(unsigned long v, int base) { char b[66]; utoa_impl(v, b, base); return write(b); }
+size_t Print::print(double v, int prec) { char b[64]; dtostrf(v, 1, (unsigned char)prec, b); return write(b); }
+
+size_t Print::printf(const char* fmt, ...) {
+  char b[256];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(b, sizeof(b), fmt, ap);
+  va_end(ap);
+  if (n < 0) return 0;
+  return write((const uint8_t*)b, (size_t)n < sizeof(b) ? (size_t)n : sizeof(b) - 1);
+}
+
+// --- Serial ---
+HardwareSerial Serial;
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (host::s_serialEcho) fputc(c, stdout);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t size) {
+  if (host::s_serialEcho) fwrite(buf, 1, size, stdout);
+  return size;
+}
+
+// --- ESP ---
+EspClass ESP;
+
+void EspClass::restart() {
+  fprintf(stderr, "[host] ESP.restart() requested\n");
+  exit(3);
+}
+
+// The host has no fixed heap; report a nominal ESP8266-sized one so code
+// that logs it behaves.
+uint32_t EspClass::getFreeHeap() { return host::s_heapFree; }
+uint32_t EspClass::getMaxFreeBlockSize() { return host::s_heapBlock; }
@@ -0,0 +1,97 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+// Host (Linux) stand-in for the Arduino core.
+// Only what mqttpanel needs: String, millis/delay, GPIO, Serial, ESP, itoa/dtostrf.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "host_hooks.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define F(s) (s)
+#define memcpy_P memcpy
+#define strcmp_P strcmp
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define NOT_AN_INTERRUPT -1
+#define IRAM_ATTR
+
+#define DEC 10
+#define HEX 16
+
+// --- Time ---
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+// --- GPIO ---
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+void analogWrite(uint8_t pin, int val);
+inline int digitalPinToInterrupt(uint8_t pin) { return pin < 64 ? pin : NOT_AN_INTERRUPT; }
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+// --- Random ---
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+// --- Numeric conversions (AVR / ESP libc extras) ---
+char* itoa(int value, char* buf, int base);
+char* ltoa(long value, char* buf, int base);
+char* utoa(unsigned value, char* buf, int base);
+char* ultoa(unsigned long value, char* buf, int base);
+char* dtostrf(double val, signed char width, unsigned char prec, char* buf);
+#if !defined(__GLIBC__) || !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char* dst, const char* src, size_t size);
+size_t strlcat(char* dst, const char* src, size_t size);
+#endif
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+
+// --- Serial ---
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  using Print::write;
+  int available() { return 0; }
+  int read() { return -1; }
+  String readString() { return String(); }
+  operator bool() const { return true; }
+};
+extern HardwareSerial Serial;
+
+// --- ESP system object ---
+class EspClass {
+public:
+  [[noreturn]] void restart();
+  uint32_t getFreeHeap();
+  uint32_t getMaxFreeBlockSize();
+  uint32_t getChipId() { return 0x00C0FFEE; }
+};
+extern EspClass ESP;
+
+#endif
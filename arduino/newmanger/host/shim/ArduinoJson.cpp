@@ -0,0 +1,209 @@
+#include "ArduinoJson.h"
+
+#include <stdlib.h>
+
+static JsonVariant s_null;
+
+JsonVariant& JsonDocument::operator[](const char* key) {
+  for (auto& m : _members)
+    if (m.first == key) return m.second;
+  _members.emplace_back(key, JsonVariant());
+  return _members.back().second;
+}
+
+const JsonVariant& JsonDocument::operator[](const char* key) const {
+  for (const auto& m : _members)
+    if (m.first == key) return m.second;
+  return s_null;
+}
+
+const char* DeserializationError::c_str() const {
+  switch (_code) {
+    case Ok: return "Ok";
+    case EmptyInput: return "EmptyInput";
+    case IncompleteInput: return "IncompleteInput";
+    case InvalidInput: return "InvalidInput";
+    case NoMemory: return "NoMemory";
+    case TooDeep: return "TooDeep";
+  }
+  return "?";
+}
+
+// ==========================================
+// Parser (flat object only)
+// ==========================================
+namespace {
+
+struct Reader {
+  const char* p;
+  const char* e;
+  void ws() { while (p < e && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++; }
+  bool eat(char c) { ws(); if (p < e && *p == c) { p++; return true; } return false; }
+};
+
+bool parseString(Reader& r, std::string& out) {
+  if (!r.eat('"')) return false;
+  out.clear();
+  while (r.p < r.e && *r.p != '"') {
+    char c = *r.p++;
+    if (c == '\\' && r.p < r.e) {
+      char x = *r.p++;
+      switch (x) {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'r': c = '\r'; break;
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'u': {
+          if (r.e - r.p < 4) return false;
+          char hex[5] = {r.p[0], r.p[1], r.p[2], r.p[3], 0};
+          r.p += 4;
+          long cp = strtol(hex, nullptr, 16);
+          if (cp < 0x80) c = (char)cp;
+          else if (cp < 0x800) { out += (char)(0xC0 | (cp >> 6)); c = (char)(0x80 | (cp & 0x3F)); }
+          else { out += (char)(0xE0 | (cp >> 12)); out += (char)(0x80 | ((cp >> 6) & 0x3F)); c = (char)(0x80 | (cp & 0x3F)); }
+          break;
+        }
+        default: c = x; break;
+      }
+    }
+    out += c;
+  }
+  if (r.p >= r.e) return false;
+  r.p++;
+  return true;
+}
+
+DeserializationError parseValue(Reader& r, JsonVariant& v) {
+  r.ws();
+  if (r.p >= r.e) return DeserializationError::IncompleteInput;
+  char c = *r.p;
+  if (c == '"') {
+    std::string s;
+    if (!parseString(r, s)) return DeserializationError::IncompleteInput;
+    v.kind = JsonVariant::STR;
+    v.s = s;
+    return DeserializationError::Ok;
+  }
+  if (c == '{' || c == '[') return DeserializationError::TooDeep;
+  if (r.e - r.p >= 4 && !strncmp(r.p, "true", 4)) { r.p += 4; v.set(true); return DeserializationError::Ok; }
+  if (r.e - r.p >= 5 && !strncmp(r.p, "false", 5)) { r.p += 5; v.set(false); return DeserializationError::Ok; }
+  if (r.e - r.p >= 4 && !strncmp(r.p, "null", 4)) { r.p += 4; v = JsonVariant(); return DeserializationError::Ok; }
+  char buf[40];
+  size_t n = 0;
+  bool isFloat = false;
+  while (r.p < r.e && n < sizeof(buf) - 1 && strchr("+-0123456789.eE", *r.p)) {
+    if (*r.p == '.' || *r.p == 'e' || *r.p == 'E') isFloat = true;
+    buf[n++] = *r.p++;
+  }
+  if (n == 0) return DeserializationError::InvalidInput;
+  buf[n] = 0;
+  if (isFloat) v.set(strtod(buf, nullptr));
+  else v.set(strtol(buf, nullptr, 10));
+  return DeserializationError::Ok;
+}
+
+} // namespace
+
+DeserializationError deserializeJson(JsonDocument& doc, const char* input, size_t len) {
+  doc.clear();
+  Reader r{input, input + len};
+  r.ws();
+  if (r.p >= r.e) return DeserializationError::EmptyInput;
+  if (!r.eat('{')) return DeserializationError::InvalidInput;
+  if (r.eat('}')) return DeserializationError::Ok;
+  for (;;) {
+    std::string key;
+    r.ws();
+    if (!parseString(r, key)) return DeserializationError::IncompleteInput;
+    if (!r.eat(':')) return DeserializationError::InvalidInput;
+    JsonVariant v;
+    DeserializationError err = parseValue(r, v);
+    if (err) return err;
+    doc[key.c_str()] = v;
+    if (r.eat(',')) continue;
+    if (r.eat('}')) return DeserializationError::Ok;
+    return DeserializationError::IncompleteInput;
+  }
+}
+
+DeserializationError deserializeJson(JsonDocument& doc, const char* input) {
+  return deserializeJson(doc, input, input ? strlen(input) : 0);
+}
+
+DeserializationError deserializeJson(JsonDocument& doc, const uint8_t* input, size_t len) {
+  return deserializeJson(doc, (const char*)input, len);
+}
+
+DeserializationError deserializeJson(JsonDocument& doc, const String& input) {
+  return deserializeJson(doc, input.c_str(), input.length());
+}
+
+DeserializationError deserializeJson(JsonDocument& doc, fs::File& input) {
+  std::string buf;
+  int c;
+  while ((c = input.read()) >= 0) buf += (char)c;
+  return deserializeJson(doc, buf.data(), buf.size());
+}
+
+// ==========================================
+// Serializer
+// ==========================================
+static void appendEscaped(std::string& out, const std::string& s) {
+  out += '"';
+  for (char c : s) {
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default: out += c; break;
+    }
+  }
+  out += '"';
+}
+
+static std::string toText(const JsonDocument& doc) {
+  std::string out = "{";
+  bool first = true;
+  for (const auto& m : doc.members()) {
+    if (!first) out += ',';
+    first = false;
+    appendEscaped(out, m.first);
+    out += ':';
+    const JsonVariant& v = m.second;
+    char num[40];
+    switch (v.kind) {
+      case JsonVariant::NUL: out += "null"; break;
+      case JsonVariant::BOOL: out += v.b ? "true" : "false"; break;
+      case JsonVariant::INT: snprintf(num, sizeof(num), "%ld", v.i); out += num; break;
+      case JsonVariant::FLOAT: snprintf(num, sizeof(num), "%.9g", v.d); out += num; break;
+      case JsonVariant::STR: appendEscaped(out, v.s); break;
+    }
+  }
+  out += '}';
+  return out;
+}
+
+size_t serializeJson(const JsonDocument& doc, Print& out) {
+  std::string s = toText(doc);
+  return out.write((const uint8_t*)s.data(), s.size());
+}
+
+size_t serializeJson(const JsonDocument& doc, char* out, size_t size) {
+  std::string s = toText(doc);
+  if (size == 0) return 0;
+  size_t n = s.size() < size - 1 ? s.size() : size - 1;
+  memcpy(out, s.data(), n);
+  out[n] = 0;
+  return n;
+}
+
+size_t serializeJson(const JsonDocument& doc, String& out) {
+  std::string s = toText(doc);
+  out = String(s.c_str(), (unsigned int)s.size());
+  return s.size();
+}
+
+size_t measureJson(const JsonDocument& doc) { return toText(doc).size(); }
@@ -0,0 +1,148 @@
+#ifndef HOST_ARDUINOJSON_H
+#define HOST_ARDUINOJSON_H
+// Host stand-in for ArduinoJson 7 - only the flat-object subset mqttpanel
+// uses (string/number/bool members, no nesting). Same call shapes as the real
+// library so the firmware sources compile unchanged.
+
+#include "Arduino.h"
+#include "FS.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class JsonVariant {
+public:
+  enum Kind { NUL, BOOL, INT, FLOAT, STR };
+
+  JsonVariant() : kind(NUL), b(false), i(0), d(0) {}
+
+  bool isNull() const { return kind == NUL; }
+  template <typename T> bool is() const;
+  template <typename T> T as() const;
+
+  const char* operator|(const char* def) const { return kind == STR ? s.c_str() : def; }
+  long operator|(int def) const { return kind == INT ? i : kind == FLOAT ? (long)d : def; }
+  long operator|(long def) const { return kind == INT ? i : kind == FLOAT ? (long)d : def; }
+  double operator|(double def) const { return kind == FLOAT ? d : kind == INT ? (double)i : def; }
+  bool operator|(bool def) const { return kind == BOOL ? b : def; }
+
+  template <typename T> JsonVariant& operator=(const T& v) { set(v); return *this; }
+
+  void set(bool v) { kind = BOOL; b = v; }
+  void set(int v) { kind = INT; i = v; }
+  void set(long v) { kind = INT; i = v; }
+  void set(unsigned v) { kind = INT; i = (long)v; }
+  void set(unsigned long v) { kind = INT; i = (long)v; }
+  void set(float v) { kind = FLOAT; d = v; }
+  void set(double v) { kind = FLOAT; d = v; }
+  void set(const char* v) { if (v) { kind = STR; s = v; } else kind = NUL; }
+  void set(char* v) { set((const char*)v); }
+  void set(const String& v) { kind = STR; s.assign(v.c_str(), v.length()); }
+
+  Kind kind;
+  bool b;
+  long i;
+  double d;
+  std::string s;
+};
+
+template <> inline bool JsonVariant::is<bool>() const { return kind == BOOL; }
+template <> inline bool JsonVariant::is<int>() const { return kind == INT; }
+template <> inline bool JsonVariant::is<long>() const { return kind == INT; }
+template <> inline bool JsonVariant::is<float>() const { return kind == INT || kind == FLOAT; }
+template <> inline bool JsonVariant::is<double>() const { return kind == INT || kind == FLOAT; }
+template <> inline bool JsonVariant::is<const char*>() const { return kind == STR; }
+
+template <> inline bool JsonVariant::as<bool>() const { return kind == BOOL ? b : kind == INT ? i != 0 : false; }
+template <> inline int JsonVariant::as<int>() const { return (int)(*this | 0L); }
+template <> inline long JsonVariant::as<long>() const { return *this | 0L; }
+template <> inline float JsonVariant::as<float>() const { return (float)(*this | 0.0); }
+template <> inline double JsonVariant::as<double>() const { return *this | 0.0; }
+template <> inline const char* JsonVariant::as<const char*>() const { return kind == STR ? s.c_str() : nullptr; }
+
+class JsonDocument;
+
+class JsonPair {
+public:
+  JsonPair(const std::string* k, const JsonVariant* v) : _k(k), _v(v) {}
+  struct Key {
+    const std::string* k;
+    const char* c_str() const { return k->c_str(); }
+  };
+  Key key() const { return Key{_k}; }
+  const JsonVariant& value() const { return *_v; }
+
+private:
+  const std::string* _k;
+  const JsonVariant* _v;
+};
+
+class JsonObject {
+public:
+  typedef std::vector<std::pair<std::string, JsonVariant>> Members;
+  class iterator {
+  public:
+    explicit iterator(Members::const_iterator it) : _it(it) {}
+    JsonPair operator*() const { return JsonPair(&_it->first, &_it->second); }
+    iterator& operator++() { ++_it; return *this; }
+    bool operator!=(const iterator& o) const { return _it != o._it; }
+  private:
+    Members::const_iterator _it;
+  };
+  explicit JsonObject(const Members* m) : _m(m) {}
+  iterator begin() const { return iterator(_m->begin()); }
+  iterator end() const { return iterator(_m->end()); }
+  size_t size() const { return _m->size(); }
+
+private:
+  const Members* _m;
+};
+
+class JsonDocument {
+public:
+  // Writable member access: creates the key on first use.
+  JsonVariant& operator[](const char* key);
+  JsonVariant& operator[](const String& key) { return (*this)[key.c_str()]; }
+  // Read-only lookup without inserting; returns a null variant if missing.
+  const JsonVariant& operator[](const char* key) const;
+
+  template <typename T> T as() const;
+  bool isNull() const { return _members.empty(); }
+  size_t size() const { return _members.size(); }
+  void clear() { _members.clear(); }
+
+  JsonObject::Members& members() { return _members; }
+  const JsonObject::Members& members() const { return _members; }
+
+private:
+  JsonObject::Members _members;
+};
+
+template <> inline JsonObject JsonDocument::as<JsonObject>() const { return JsonObject(&_members); }
+
+class DeserializationError {
+public:
+  enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput, NoMemory, TooDeep };
+  DeserializationError(Code c = Ok) : _code(c) {}
+  explicit operator bool() const { return _code != Ok; }
+  Code code() const { return _code; }
+  const char* c_str() const;
+  bool operator==(Code c) const { return _code == c; }
+
+private:
+  Code _code;
+};
+
+DeserializationError deserializeJson(JsonDocument& doc, const char* input, size_t len);
+DeserializationError deserializeJson(JsonDocument& doc, const char* input);
+DeserializationError deserializeJson(JsonDocument& doc, const uint8_t* input, size_t len);
+DeserializationError deserializeJson(JsonDocument& doc, const String& input);
+DeserializationError deserializeJson(JsonDocument& doc, fs::File& input);
+
+size_t serializeJson(const JsonDocument& doc, Print& out);
+size_t serializeJson(const JsonDocument& doc, char* out, size_t size);
+size_t serializeJson(const JsonDocument& doc, String& out);
+size_t measureJson(const JsonDocument& doc);
+
+#endif
@@ -0,0 +1,4 @@
+#ifndef HOST_ESP8266WIFI_H
+#define HOST_ESP8266WIFI_H
+#include "WiFi.h"
+#endif
@@ -0,0 +1,140 @@
+#include "LittleFS.h"
+
+#include <map>
+#include <string>
+
+namespace fs {
+
+static std::map<std::string, std::string>& files() {
+  static std::map<std::string, std::string> m;
+  return m;
+}
+
+static bool s_mountOk = true;
+static bool s_mounted = false;
+static unsigned s_failOpens = 0;
+
+struct FileImpl {
+  std::string path;
+  size_t pos;
+  bool writable;
+  int refs;
+};
+
+File::File(const File& o) : _impl(o._impl) { if (_impl) _impl->refs++; }
+
+File& File::operator=(const File& o) {
+  if (this != &o) {
+    close();
+    _impl = o._impl;
+    if (_impl) _impl->refs++;
+  }
+  return *this;
+}
+
+File::~File() { close(); }
+
+size_t File::write(uint8_t c) { return write(&c, 1); }
+
+size_t File::write(const uint8_t* buf, size_t size) {
+  if (!_impl || !_impl->writable) return 0;
+  std::string& d = files()[_impl->path];
+  if (_impl->pos > d.size()) _impl->pos = d.size();
+  d.replace(_impl->pos, size, (const char*)buf, size);
+  _impl->pos += size;
+  return size;
+}
+
+int File::available() {
+  if (!_impl) return 0;
+  const std::string& d = files()[_impl->path];
+  return _impl->pos < d.size() ? (int)(d.size() - _impl->pos) : 0;
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+  if (!_impl) return 0;
+  const std::string& d = files()[_impl->path];
+  if (_impl->pos >= d.size()) return 0;
+  size_t n = d.size() - _impl->pos;
+  if (n > size) n = size;
+  memcpy(buf, d.data() + _impl->pos, n);
+  _impl->pos += n;
+  return n;
+}
+
+int File::peek() {
+  if (!_impl) return -1;
+  const std::string& d = files()[_impl->path];
+  return _impl->pos < d.size() ? (uint8_t)d[_impl->pos] : -1;
+}
+
+bool File::seek(uint32_t pos) {
+  if (!_impl || pos > files()[_impl->path].size()) return false;
+  _impl->pos = pos;
+  return true;
+}
+
+size_t File::position() const { return _impl ? _impl->pos : 0; }
+
+size_t File::size() const { return _impl ? files()[_impl->path].size() : 0; }
+
+void File::close() {
+  if (_impl && --_impl->refs == 0) delete _impl;
+  _impl = nullptr;
+}
+
+bool FS::begin() {
+  s_mounted = s_mountOk;
+  return s_mounted;
+}
+
+void FS::end() { s_mounted = false; }
+
+bool FS::format() {
+  files().clear();
+  s_mountOk = true;
+  return true;
+}
+
+bool FS::exists(const char* path) { return s_mounted && files().count(path) != 0; }
+
+bool FS::remove(const char* path) { return s_mounted && files().erase(path) != 0; }
+
+bool FS::rename(const char* from, const char* to) {
+  auto it = files().find(from);
+  if (!s_mounted || it == files().end()) return false;
+  files()[to] = it->second;
+  files().erase(from);
+  return true;
+}
+
+File FS::open(const char* path, const char* mode) {
+  if (!s_mounted) return File();
+  if (s_failOpens) {
+    s_failOpens--;
+    return File();
+  }
+  bool write = mode[0] == 'w' || mode[0] == 'a';
+  if (!write && !files().count(path)) return File();
+  std::string& d = files()[path];
+  if (mode[0] == 'w') d.clear();
+  FileImpl* impl = new FileImpl{path, mode[0] == 'a' ? d.size() : 0, write, 1};
+  return File(impl);
+}
+
+void FS::host_set_mount_ok(bool ok) { s_mountOk = ok; }
+void FS::host_fail_opens(unsigned n) { s_failOpens = n; }
+
+size_t FS::host_file_size(const char* path) {
+  auto it = files().find(path);
+  return it == files().end() ? 0 : it->second.size();
+}
+
+} // namespace fs
+
+fs::FS LittleFS;
@@ -0,0 +1,62 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+// Host stand-in for the ESP FS / LittleFS API, backed by an in-memory map.
+
+#include "Arduino.h"
+
+namespace fs {
+
+struct FileImpl;
+
+class File : public Stream {
+public:
+  File() : _impl(nullptr) {}
+  explicit File(FileImpl* impl) : _impl(impl) {}
+  File(const File& o);
+  File& operator=(const File& o);
+  ~File();
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  size_t read(uint8_t* buf, size_t size);
+  size_t readBytes(char* buf, size_t size) override { return read((uint8_t*)buf, size); }
+  using Stream::readBytes;
+  int peek() override;
+  bool seek(uint32_t pos);
+  size_t position() const;
+  size_t size() const;
+  void close();
+  operator bool() const { return _impl != nullptr; }
+
+private:
+  FileImpl* _impl;
+};
+
+class FS {
+public:
+  bool begin();
+  void end();
+  bool format();
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path);
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* from, const char* to);
+  File open(const char* path, const char* mode);
+  File open(const String& path, const char* mode) { return open(path.c_str(), mode); }
+
+  // --- Host-only controls ---
+  void host_set_mount_ok(bool ok);
+  void host_fail_opens(unsigned n); // the next n open() calls fail (flash I/O error)
+  size_t host_file_size(const char* path);
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif
@@ -0,0 +1,166 @@
+#include "PubSubClient.h"
+
+PubSubClient::PubSubClient()
+    : _client(nullptr), callback(nullptr), _stream(nullptr), _buffer(nullptr), _bufferSize(0),
+      _keepAlive(15), _socketTimeout(15), _domain(nullptr), _port(0),
+      _connected(false), _connectOk(true), _state(MQTT_DISCONNECTED),
+      _observer(nullptr), _pubCount(0), _pubBytes(0), _subCount(0),
+      _streamExpected(0), _streamWritten(0), _streamRetained(false), _streaming(false),
+      _dropIn(0), _pubDropIn(0), _dropNow(false) {
+  _streamTopic[0] = 0;
+  setBufferSize(MQTT_MAX_PACKET_SIZE);
+}
+
+PubSubClient::PubSubClient(Client& client) : PubSubClient() { _client = &client; }
+
+PubSubClient::~PubSubClient() { free(_buffer); }
+
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port) {
+  _domain = domain;
+  _port = port;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setStream(Stream& stream) {
+  _stream = &stream;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+  this->callback = callback;
+  return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+  if (size == 0) return false;
+  uint8_t* nb = (uint8_t*)realloc(_buffer, size);
+  if (!nb) return false;
+  _buffer = nb;
+  _bufferSize = size;
+  return true;
+}
+
+bool PubSubClient::connect(const char* id) { return connect(id, nullptr, nullptr); }
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass) {
+  (void)id; (void)user; (void)pass;
+  // Like the real client: reuse an already open socket, otherwise open one.
+  if (_client && !_client->connected() && !_client->connect(_domain, _port)) {
+    _connected = false;
+    _state = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  _connected = _connectOk;
+  _state = _connected ? MQTT_CONNECTED : MQTT_CONNECT_FAILED;
+  return _connected;
+}
+
+void PubSubClient::disconnect() {
+  if (_client) _client->stop();
+  _connected = false;
+  _state = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::connected() { return _connected; }
+
+bool PubSubClient::loop() { return _connected; }
+
+// Same size rule as the real client: fixed header + topic length + topic + payload.
+bool PubSubClient::fits(const char* topic, unsigned int plength) const {
+  return (size_t)MQTT_MAX_HEADER_SIZE + 2 + strnlen(topic, _bufferSize) + plength <= _bufferSize;
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload) {
+  return publish(topic, (const uint8_t*)payload, payload ? (unsigned int)strnlen(payload, _bufferSize) : 0, false);
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+  return publish(topic, (const uint8_t*)payload, payload ? (unsigned int)strnlen(payload, _bufferSize) : 0, retained);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength) {
+  return publish(topic, payload, plength, false);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained) {
+  if (!_connected || !fits(topic, plength)) return false;
+  if (_pubDropIn && --_pubDropIn == 0) {
+    host_drop_connection();
+    return false;
+  }
+  _pubCount++;
+  _pubBytes += MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + plength;
+  if (_observer) _observer(topic, payload, plength, retained);
+  return true;
+}
+
+bool PubSubClient::beginPublish(const char* topic, unsigned int plength, bool retained) {
+  if (!_connected) return false;
+  strlcpy(_streamTopic, topic, sizeof(_streamTopic));
+  _streamExpected = plength;
+  _streamWritten = 0;
+  _streamBuf.clear();
+  _streamRetained = retained;
+  _streaming = true;
+  _dropNow = _dropIn && --_dropIn == 0;
+  return true;
+}
+
+size_t PubSubClient::write(uint8_t c) { return write(&c, 1); }
+
+size_t PubSubClient::write(const uint8_t* buf, size_t size) {
+  if (!_streaming || !_connected) return 0;
+  if (_dropNow) {
+    _dropNow = false;
+    host_drop_connection();
+    return 0;
+  }
+  if (_observer) _streamBuf.insert(_streamBuf.end(), buf, buf + size);
+  _streamWritten += (unsigned int)size;
+  return size;
+}
+
+int PubSubClient::endPublish() {
+  if (!_streaming) return 0;
+  _streaming = false;
+  if (_streamWritten != _streamExpected) return 0;
+  _pubCount++;
+  _pubBytes += MQTT_MAX_HEADER_SIZE + 2 + strlen(_streamTopic) + _streamWritten;
+  if (_observer) _observer(_streamTopic, _streamBuf.data(), _streamWritten, _streamRetained);
+  return 1;
+}
+
+bool PubSubClient::subscribe(const char* topic) { return subscribe(topic, 0); }
+
+bool PubSubClient::subscribe(const char* topic, uint8_t qos) {
+  (void)qos;
+  if (!_connected || !topic) return false;
+  _subCount++;
+  return true;
+}
+
+bool PubSubClient::unsubscribe(const char* topic) { return _connected && topic; }
+
+bool PubSubClient::host_inject(const char* topic, const uint8_t* payload, unsigned int len) {
+  if (!callback) return false;
+  size_t tl = strlen(topic);
+  if (tl + 1 > _bufferSize) return false;
+  // With setStream() the real client writes every payload byte to the stream
+  // as it reads it, and an oversized packet is cut to the buffer, not dropped.
+  if (_stream) {
+    for (unsigned int i = 0; i < len; i++) _stream->write(payload[i]);
+  }
+  if (tl + 1 + len > _bufferSize) {
+    if (!_stream) return false;
+    len = (unsigned int)(_bufferSize - tl - 1);
+  }
+  // The real client NUL-terminates the topic in place and passes payload as
+  // a pointer into the same buffer (not terminated).
+  char* t = (char*)_buffer;
+  memcpy(t, topic, tl);
+  t[tl] = 0;
+  uint8_t* p = _buffer + tl + 1;
+  memcpy(p, payload, len);
+  callback(t, p, len);
+  return true;
+}
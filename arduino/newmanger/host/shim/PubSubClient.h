@@ -0,0 +1,117 @@
+#ifndef HOST_PUBSUBCLIENT_H
+#define HOST_PUBSUBCLIENT_H
+// Host stand-in for knolleary/PubSubClient.
+// Same public API as the real library (2.8). There is no socket behind it:
+// publishes are counted (and optionally handed to an observer), inbound
+// traffic is injected with host_inject() and delivered exactly the way the
+// real client does it - topic and payload pointing into its packet buffer.
+
+#include "Arduino.h"
+#include "Client.h"
+
+#include <vector>
+
+#define MQTT_MAX_PACKET_SIZE 256
+#define MQTT_MAX_HEADER_SIZE 5
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+#define MQTT_CALLBACK_SIGNATURE void (*callback)(char*, uint8_t*, unsigned int)
+
+class PubSubClient : public Print {
+public:
+  typedef void (*PublishObserver)(const char* topic, const uint8_t* payload, unsigned int len, bool retained);
+
+  PubSubClient();
+  explicit PubSubClient(Client& client);
+  ~PubSubClient();
+
+  PubSubClient& setServer(const char* domain, uint16_t port);
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+  PubSubClient& setStream(Stream& stream);
+  PubSubClient& setClient(Client& client) { _client = &client; return *this; }
+  PubSubClient& setKeepAlive(uint16_t keepAlive) { _keepAlive = keepAlive; return *this; }
+  PubSubClient& setSocketTimeout(uint16_t timeout) { _socketTimeout = timeout; return *this; }
+  bool setBufferSize(uint16_t size);
+  uint16_t getBufferSize() { return _bufferSize; }
+
+  bool connect(const char* id);
+  bool connect(const char* id, const char* user, const char* pass);
+  void disconnect();
+
+  bool publish(const char* topic, const char* payload);
+  bool publish(const char* topic, const char* payload, bool retained);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int plength);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained);
+
+  bool beginPublish(const char* topic, unsigned int plength, bool retained);
+  int endPublish();
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  using Print::write;
+
+  bool subscribe(const char* topic);
+  bool subscribe(const char* topic, uint8_t qos);
+  bool unsubscribe(const char* topic);
+
+  bool loop();
+  bool connected();
+  int state() { return _state; }
+
+  // --- Host-only controls ---
+  // Deliver an inbound PUBLISH to the registered callback. Returns false if
+  // it would not fit in the packet buffer (the real client drops it too);
+  // with setStream() the payload goes to the stream and the callback gets
+  // what fit.
+  bool host_inject(const char* topic, const uint8_t* payload, unsigned int len);
+  void host_set_connect_result(bool ok) { _connectOk = ok; }
+  void host_drop_connection() { if (_client) _client->stop(); _connected = false; _state = MQTT_CONNECTION_LOST; }
+  // The n-th streamed publish from now (beginPublish/write/endPublish) loses
+  // the link in the middle of its payload; endPublish then returns 0.
+  void host_drop_mid_publish(unsigned n) { _dropIn = n; }
+  // The n-th publish() from now loses the link while writing and returns false.
+  void host_drop_on_publish(unsigned n) { _pubDropIn = n; }
+  void host_set_observer(PublishObserver obs) { _observer = obs; }
+  unsigned long host_pub_count() const { return _pubCount; }
+  unsigned long host_pub_bytes() const { return _pubBytes; }
+  unsigned long host_sub_count() const { return _subCount; }
+  void host_reset_counters() { _pubCount = 0; _pubBytes = 0; _subCount = 0; }
+
+private:
+  bool fits(const char* topic, unsigned int plength) const;
+
+  Client* _client;
+  MQTT_CALLBACK_SIGNATURE;
+  Stream* _stream;
+  uint8_t* _buffer;
+  uint16_t _bufferSize;
+  uint16_t _keepAlive;
+  uint16_t _socketTimeout;
+  const char* _domain;
+  uint16_t _port;
+  bool _connected;
+  bool _connectOk;
+  int _state;
+
+  PublishObserver _observer;
+  unsigned long _pubCount;
+  unsigned long _pubBytes;
+  unsigned long _subCount;
+
+  // beginPublish/endPublish streaming state (payload kept for the observer)
+  char _streamTopic[MQTT_MAX_PACKET_SIZE];
+  std::vector<uint8_t> _streamBuf;
+  unsigned int _streamExpected;
+  unsigned int _streamWritten;
+  bool _streamRetained;
+  bool _streaming;
+  unsigned _dropIn;
+  unsigned _pubDropIn;
+  bool _dropNow;
+};
+
+#endif
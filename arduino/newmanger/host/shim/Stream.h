@@ -0,0 +1,26 @@
+#ifndef HOST_STREAM_H
+#define HOST_STREAM_H
+
+#include "Print.h"
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual size_t readBytes(char* buf, size_t size) {
+    size_t n = 0;
+    for (int c; n < size && (c = read()) >= 0; n++) buf[n] = (char)c;
+    return n;
+  }
+  size_t readBytes(uint8_t* buf, size_t size) { return readBytes((char*)buf, size); }
+
+  // Milliseconds; the ESP8266 WiFiClient also uses it as its connect timeout.
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  unsigned long getTimeout() const { return _timeout; }
+
+protected:
+  unsigned long _timeout = 1000;
+};
+
+#endif
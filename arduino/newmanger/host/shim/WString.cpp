@@ -0,0 +1,180 @@
+#include "Arduino.h"
+
+#include <ctype.h>
+
+// --- numeric constructors ---
+String::String(unsigned char v, unsigned char base) { init(); char b[9]; utoa(v, b, base); copy(b, strlen(b)); }
+String::String(int v, unsigned char base) { init(); char b[34]; itoa(v, b, base); copy(b, strlen(b)); }
+String::String(unsigned int v, unsigned char base) { init(); char b[33]; utoa(v, b, base); copy(b, strlen(b)); }
+String::String(long v, unsigned char base) { init(); char b[66]; ltoa(v, b, base); copy(b, strlen(b)); }
+String::String(unsigned long v, unsigned char base) {
+  init();
+  char b[66];
+  char* p = b + sizeof(b) - 1;
+  *p = 0;
+  do { unsigned d = v % base; *--p = (char)(d < 10 ? '0' + d : 'a' + d - 10); v /= base; } while (v);
+  copy(p, strlen(p));
+}
+String::String(float v, unsigned char decimals) { init(); char b[40]; dtostrf(v, 1, decimals, b); copy(b, strlen(b)); }
+String::String(double v, unsigned char decimals) { init(); char b[40]; dtostrf(v, 1, decimals, b); copy(b, strlen(b)); }
+
+// --- memory ---
+void String::release() {
+  if (!sso_ && heap_) host::tracked_free(heap_);
+  heap_ = nullptr;
+}
+
+bool String::changeBuffer(unsigned int maxStrLen) {
+  if (maxStrLen <= SSO_CAP) {
+    if (!sso_) {
+      char tmp[SSO_CAP + 1];
+      memcpy(tmp, heap_, len_ + 1 <= sizeof(tmp) ? len_ + 1 : sizeof(tmp));
+      host::tracked_free(heap_);
+      heap_ = nullptr;
+      sso_ = true;
+      memcpy(inline_, tmp, sizeof(tmp));
+    }
+    cap_ = SSO_CAP;
+    return true;
+  }
+  char* nb;
+  if (sso_) {
+    nb = (char*)host::tracked_realloc(nullptr, maxStrLen + 1);
+    if (!nb) return false;
+    memcpy(nb, inline_, len_ + 1);
+  } else {
+    nb = (char*)host::tracked_realloc(heap_, maxStrLen + 1);
+    if (!nb) return false;
+  }
+  heap_ = nb;
+  sso_ = false;
+  cap_ = maxStrLen;
+  return true;
+}
+
+bool String::reserve(unsigned int size) {
+  if (size <= cap_) return true;
+  return changeBuffer(size);
+}
+
+void String::copy(const char* cstr, unsigned int length) {
+  if (!reserve(length)) { invalidate(); return; }
+  memmove(wbuffer(), cstr, length);
+  setLen(length);
+}
+
+void String::move(String& rhs) {
+  release();
+  if (rhs.sso_) {
+    init();
+    memcpy(inline_, rhs.inline_, sizeof(inline_));
+    len_ = rhs.len_;
+  } else {
+    sso_ = false;
+    heap_ = rhs.heap_;
+    cap_ = rhs.cap_;
+    len_ = rhs.len_;
+    rhs.heap_ = nullptr;
+  }
+  rhs.init();
+}
+
+bool String::concat(const char* cstr, unsigned int length) {
+  if (length == 0) return true;
+  unsigned int newlen = len_ + length;
+  // Same growth rule as the ESP cores: exactly the new length, no slack.
+  if (cstr >= c_str() && cstr < c_str() + len_) {
+    String tmp(cstr, length);
+    if (!reserve(newlen)) return false;
+    memcpy(wbuffer() + len_, tmp.c_str(), length);
+  } else {
+    if (!reserve(newlen)) return false;
+    memcpy(wbuffer() + len_, cstr, length);
+  }
+  setLen(newlen);
+  return true;
+}
+
+// --- comparison / search ---
+bool String::startsWith(const String& p) const {
+  return p.len_ <= len_ && memcmp(c_str(), p.c_str(), p.len_) == 0;
+}
+
+bool String::endsWith(const String& s) const {
+  return s.len_ <= len_ && memcmp(c_str() + len_ - s.len_, s.c_str(), s.len_) == 0;
+}
+
+char& String::operator[](unsigned int i) {
+  static char dummy;
+  if (i >= len_) { dummy = 0; return dummy; }
+  return wbuffer()[i];
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  if (from >= len_) return -1;
+  const char* p = strchr(c_str() + from, c);
+  return p ? (int)(p - c_str()) : -1;
+}
+
+int String::indexOf(const String& s, unsigned int from) const {
+  if (from >= len_) return -1;
+  const char* p = strstr(c_str() + from, s.c_str());
+  return p ? (int)(p - c_str()) : -1;
+}
+
+int String::lastIndexOf(char c) const {
+  const char* p = strrchr(c_str(), c);
+  return p ? (int)(p - c_str()) : -1;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) { unsigned int t = from; from = to; to = t; }
+  if (from >= len_) return String();
+  if (to > len_) to = len_;
+  return String(c_str() + from, to - from);
+}
+
+// --- modification ---
+void String::remove(unsigned int index, unsigned int count) {
+  if (index >= len_) return;
+  if (count > len_ - index) count = len_ - index;
+  char* b = wbuffer();
+  memmove(b + index, b + index + count, len_ - index - count);
+  setLen(len_ - count);
+}
+
+void String::replace(const String& find, const String& repl) {
+  if (find.len_ == 0) return;
+  String out;
+  const char* s = c_str();
+  const char* hit;
+  while ((hit = strstr(s, find.c_str())) != nullptr) {
+    out.concat(s, (unsigned int)(hit - s));
+    out.concat(repl);
+    s = hit + find.len_;
+  }
+  out.concat(s);
+  *this = static_cast<String&&>(out);
+}
+
+void String::toLowerCase() { for (char* p = wbuffer(); *p; ++p) *p = (char)tolower(*p); }
+void String::toUpperCase() { for (char* p = wbuffer(); *p; ++p) *p = (char)toupper(*p); }
+
+void String::trim() {
+  char* b = wbuffer();
+  unsigned int s = 0, e = len_;
+  while (s < e && isspace((unsigned char)b[s])) s++;
+  while (e > s && isspace((unsigned char)b[e - 1])) e--;
+  memmove(b, b + s, e - s);
+  setLen(e - s);
+}
+
+long String::atol_(const char* s) { return atol(s); }
+float String::toFloat() const { return (float)atof(c_str()); }
+double String::toDouble() const { return atof(c_str()); }
+
+// --- operators ---
+String operator+(const String& lhs, const String& rhs) { String r(lhs); r.concat(rhs); return r; }
+String operator+(const String& lhs, const char* rhs) { String r(lhs); r.concat(rhs); return r; }
+String operator+(const char* lhs, const String& rhs) { String r(lhs); r.concat(rhs); return r; }
+String operator+(const String& lhs, char rhs) { String r(lhs); r.concat(rhs); return r; }
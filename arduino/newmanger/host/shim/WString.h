@@ -0,0 +1,117 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+// Host stand-in for the ESP8266/ESP32 core String.
+// Allocation behaviour is kept close to the device cores on purpose, because
+// that is what the benches measure:
+//  - strings up to SSO_CAP chars live inline (no heap),
+//  - concat() grows the buffer to the exact new length (one realloc per append).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+class String {
+public:
+  static const unsigned SSO_CAP = 11; // 12-byte inline buffer on 32-bit cores
+
+  String() { init(); }
+  String(const char* cstr) { init(); if (cstr) copy(cstr, strlen(cstr)); }
+  String(const char* cstr, unsigned int length) { init(); if (cstr) copy(cstr, length); }
+  String(const String& s) { init(); copy(s.c_str(), s.length()); }
+  String(String&& s) noexcept { init(); move(s); }
+  explicit String(char c) { init(); copy(&c, 1); }
+  explicit String(unsigned char v, unsigned char base = 10);
+  explicit String(int v, unsigned char base = 10);
+  explicit String(unsigned int v, unsigned char base = 10);
+  explicit String(long v, unsigned char base = 10);
+  explicit String(unsigned long v, unsigned char base = 10);
+  explicit String(float v, unsigned char decimals = 2);
+  explicit String(double v, unsigned char decimals = 2);
+  ~String() { release(); }
+
+  String& operator=(const String& rhs) { if (this != &rhs) copy(rhs.c_str(), rhs.length()); return *this; }
+  String& operator=(String&& rhs) noexcept { if (this != &rhs) move(rhs); return *this; }
+  String& operator=(const char* cstr) { if (cstr) copy(cstr, strlen(cstr)); else invalidate(); return *this; }
+
+  bool reserve(unsigned int size);
+  unsigned int length() const { return len_; }
+  bool isEmpty() const { return len_ == 0; }
+  const char* c_str() const { return sso_ ? inline_ : heap_; }
+  char* begin() { return wbuffer(); }
+  char* end() { return wbuffer() + len_; }
+
+  // --- concat ---
+  bool concat(const String& s) { return concat(s.c_str(), s.length()); }
+  bool concat(const char* cstr) { return cstr ? concat(cstr, strlen(cstr)) : false; }
+  bool concat(const char* cstr, unsigned int length);
+  bool concat(char c) { return concat(&c, 1); }
+  bool concat(int v) { return concat(String(v)); }
+  bool concat(unsigned int v) { return concat(String(v)); }
+  bool concat(long v) { return concat(String(v)); }
+  bool concat(unsigned long v) { return concat(String(v)); }
+  bool concat(double v) { return concat(String(v)); }
+
+  template <typename T> String& operator+=(const T& v) { concat(v); return *this; }
+
+  // --- comparison ---
+  int compareTo(const String& s) const { return strcmp(c_str(), s.c_str()); }
+  bool equals(const String& s) const { return len_ == s.len_ && memcmp(c_str(), s.c_str(), len_) == 0; }
+  bool equals(const char* cstr) const { return cstr ? strcmp(c_str(), cstr) == 0 : len_ == 0; }
+  bool operator==(const String& s) const { return equals(s); }
+  bool operator==(const char* cstr) const { return equals(cstr); }
+  bool operator!=(const String& s) const { return !equals(s); }
+  bool operator!=(const char* cstr) const { return !equals(cstr); }
+  bool operator<(const String& s) const { return compareTo(s) < 0; }
+  bool startsWith(const String& prefix) const;
+  bool endsWith(const String& suffix) const;
+
+  // --- access / search ---
+  char charAt(unsigned int i) const { return i < len_ ? c_str()[i] : 0; }
+  void setCharAt(unsigned int i, char c) { if (i < len_) wbuffer()[i] = c; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  char& operator[](unsigned int i);
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const String& s, unsigned int from = 0) const;
+  int lastIndexOf(char c) const;
+  String substring(unsigned int from) const { return substring(from, len_); }
+  String substring(unsigned int from, unsigned int to) const;
+
+  // --- modification ---
+  void remove(unsigned int index) { remove(index, (unsigned int)-1); }
+  void remove(unsigned int index, unsigned int count);
+  void replace(const String& find, const String& repl);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+  void clear() { setLen(0); }
+
+  // --- parsing ---
+  long toInt() const { return atol_(c_str()); }
+  float toFloat() const;
+  double toDouble() const;
+
+private:
+  void init() { sso_ = true; heap_ = nullptr; cap_ = SSO_CAP; len_ = 0; inline_[0] = 0; }
+  void release();
+  void invalidate() { release(); init(); }
+  bool changeBuffer(unsigned int maxStrLen);
+  void copy(const char* cstr, unsigned int length);
+  void move(String& rhs);
+  char* wbuffer() { return sso_ ? inline_ : heap_; }
+  void setLen(unsigned int l) { len_ = l; wbuffer()[l] = 0; }
+  static long atol_(const char* s);
+
+  bool sso_;
+  char* heap_;
+  unsigned int cap_;
+  unsigned int len_;
+  char inline_[SSO_CAP + 1];
+};
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+String operator+(const char* lhs, const String& rhs);
+String operator+(const String& lhs, char rhs);
+inline bool operator==(const char* lhs, const String& rhs) { return rhs.equals(lhs); }
+
+#endif
@@ -0,0 +1,314 @@
+#include "WiFi.h"
+#include "WiFiUdp.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+
+static bool s_wifiUp = true;
+static bool s_brokerUp = true;
+static uint32_t s_brokerLatencyMs = 0;
+static bool s_sockets = false;
+
+// Access point in range + timing of each connection phase
+static String s_apSsid = "HostAP";
+static String s_apPass = "password";
+static uint8_t s_apBssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+static int32_t s_apChannel = 6;
+static uint32_t s_scanMs = 0, s_assocMs = 0, s_dhcpMs = 0;
+static const uint32_t kLeaseIp = IPAddress(192, 168, 1, 50);
+
+// Station state
+static String s_ssid, s_pass;
+static uint32_t s_staticIp = 0, s_gw = 0, s_mask = 0, s_dns = 0;
+static uint32_t s_ip = 0;
+
+static bool join(bool scan) {
+  delay((scan ? s_scanMs : 0) + s_assocMs);
+  if (!s_staticIp) {
+    delay(s_dhcpMs);
+    s_ip = kLeaseIp;
+    s_gw = IPAddress(192, 168, 1, 1);
+    s_mask = IPAddress(255, 255, 255, 0);
+    s_dns = s_gw;
+  } else {
+    s_ip = s_staticIp;
+  }
+  s_wifiUp = true;
+  return true;
+}
+
+namespace host {
+void wifi_set_connected(bool on) { s_wifiUp = on; }
+void wifi_set_ap(const char* ssid, const char* pass, const uint8_t bssid[6], int32_t channel) {
+  s_apSsid = ssid;
+  s_apPass = pass;
+  memcpy(s_apBssid, bssid, 6);
+  s_apChannel = channel;
+}
+void wifi_set_timing(uint32_t scanMs, uint32_t assocMs, uint32_t dhcpMs) {
+  s_scanMs = scanMs;
+  s_assocMs = assocMs;
+  s_dhcpMs = dhcpMs;
+}
+bool wifi_full_connect() {
+  s_ssid = s_apSsid;
+  s_pass = s_apPass;
+  return join(true);
+}
+void tcp_set_broker(bool up, uint32_t latencyMs) {
+  s_brokerUp = up;
+  s_brokerLatencyMs = latencyMs;
+}
+void tcp_use_sockets(bool on) { s_sockets = on; }
+}
+
+// Non-blocking connect bounded by the Stream timeout, like the ESP8266 core.
+static int tcp_open(const char* host, uint16_t port, unsigned long timeoutMs) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  char ps[8];
+  snprintf(ps, sizeof(ps), "%u", (unsigned)port);
+  addrinfo* res = nullptr;
+  if (getaddrinfo(host, ps, &hints, &res) != 0) return -1;
+  int fd = -1;
+  for (addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) continue;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int rc = ::connect(fd, ai->ai_addr, ai->ai_addrlen);
+    if (rc < 0 && errno == EINPROGRESS) {
+      pollfd p = { fd, POLLOUT, 0 };
+      int err = 0;
+      socklen_t len = sizeof(err);
+      if (poll(&p, 1, (int)timeoutMs) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && !err) rc = 0;
+    }
+    if (rc < 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(res);
+  if (fd >= 0) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  return fd;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  if (s_sockets) {
+    stop();
+    if (!s_wifiUp) return 0;
+    _fd = tcp_open(host, port, _timeout);
+    _open = _fd >= 0;
+    return _open ? 1 : 0;
+  }
+  (void)host; (void)port;
+  bool ok = s_wifiUp && s_brokerUp && s_brokerLatencyMs <= _timeout;
+  delay(ok ? s_brokerLatencyMs : _timeout);
+  _open = ok;
+  return ok ? 1 : 0;
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size) {
+  if (_fd < 0) return size; // simulated
+  size_t sent = 0;
+  while (sent < size) {
+    ssize_t n = send(_fd, buf + sent, size - sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += (size_t)n;
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      pollfd p = { _fd, POLLOUT, 0 };
+      if (poll(&p, 1, (int)_timeout) == 1) continue;
+    }
+    stop(); // error, or the send buffer stayed full for the whole timeout
+    break;
+  }
+  return sent;
+}
+
+int WiFiClient::available() {
+  if (_fd < 0) return 0;
+  int n = 0;
+  if (ioctl(_fd, FIONREAD, &n) == 0 && n > 0) return n;
+  uint8_t c;
+  ssize_t r = recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) stop(); // peer closed
+  return r > 0 ? 1 : 0;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+  if (_fd < 0) return -1;
+  ssize_t r = recv(_fd, buf, size, MSG_DONTWAIT);
+  if (r > 0) return (int)r;
+  if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) stop();
+  return -1;
+}
+
+int WiFiClient::peek() {
+  if (_fd < 0) return -1;
+  uint8_t c;
+  return recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? c : -1;
+}
+
+void WiFiClient::stop() {
+  if (_fd >= 0) close(_fd);
+  _fd = -1;
+  _open = false;
+}
+
+bool WiFiClient::host_wait(uint32_t us) {
+  if (_fd < 0) return false;
+  pollfd p = { _fd, POLLIN, 0 };
+  timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+  return ppoll(&p, 1, &ts, nullptr) == 1;
+}
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+  stop();
+  _fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (_fd < 0) return 0;
+  int one = 1;
+  setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_ANY);
+  a.sin_port = htons(port);
+  socklen_t len = sizeof(a);
+  if (bind(_fd, (sockaddr*)&a, sizeof(a)) < 0 || getsockname(_fd, (sockaddr*)&a, &len) < 0) {
+    stop();
+    return 0;
+  }
+  fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+  _port = ntohs(a.sin_port);
+  return 1;
+}
+
+void WiFiUDP::stop() {
+  if (_fd >= 0) close(_fd);
+  _fd = -1;
+  _port = 0;
+  _rxLen = _rxPos = _txLen = 0;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+  _txIp = ip;
+  _txPort = port;
+  _txLen = 0;
+  return 1;
+}
+
+int WiFiUDP::beginPacket(const char* host, uint16_t port) {
+  in_addr a;
+  if (inet_aton(host, &a) == 0) return 0;
+  return beginPacket(IPAddress(a.s_addr), port);
+}
+
+size_t WiFiUDP::write(const uint8_t* buf, size_t size) {
+  if (size > sizeof(_tx) - _txLen) size = sizeof(_tx) - _txLen;
+  memcpy(_tx + _txLen, buf, size);
+  _txLen += size;
+  return size;
+}
+
+int WiFiUDP::endPacket() {
+  if (_fd < 0 || !s_wifiUp) return 0;
+  sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = _txIp; // IPAddress keeps network byte order
+  a.sin_port = htons(_txPort);
+  ssize_t n = sendto(_fd, _tx, _txLen, 0, (sockaddr*)&a, sizeof(a));
+  _txLen = 0;
+  return n >= 0 ? 1 : 0;
+}
+
+int WiFiUDP::parsePacket() {
+  _rxLen = _rxPos = 0;
+  if (_fd < 0) return 0;
+  sockaddr_in a;
+  socklen_t len = sizeof(a);
+  ssize_t n = recvfrom(_fd, _rx, sizeof(_rx), MSG_DONTWAIT, (sockaddr*)&a, &len);
+  if (n <= 0) return 0;
+  _rxLen = (size_t)n;
+  _remoteIp = a.sin_addr.s_addr;
+  _remotePort = ntohs(a.sin_port);
+  return (int)n;
+}
+
+int WiFiUDP::read(unsigned char* buf, size_t len) {
+  size_t n = _rxLen - _rxPos;
+  if (n == 0) return -1;
+  if (n > len) n = len;
+  memcpy(buf, _rx + _rxPos, n);
+  _rxPos += n;
+  return (int)n;
+}
+
+bool WiFiUDP::host_wait(uint32_t us) {
+  if (_fd < 0) return false;
+  pollfd p = { _fd, POLLIN, 0 };
+  timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+  return ppoll(&p, 1, &ts, nullptr) == 1;
+}
+
+wl_status_t WiFiClass::status() { return s_wifiUp ? WL_CONNECTED : WL_DISCONNECTED; }
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* pass, int32_t channel, const uint8_t* bssid, bool connect) {
+  s_wifiUp = false;
+  s_ssid = ssid;
+  s_pass = pass ? pass : "";
+  if (!connect) return WL_DISCONNECTED;
+  if (s_ssid != s_apSsid || s_pass != s_apPass) { delay(s_scanMs); return WL_NO_SSID_AVAIL; }
+  // Pinned to a BSSID that is not around (AP replaced / moved): never associates.
+  if (bssid && memcmp(bssid, s_apBssid, 6) != 0) { delay(s_scanMs); return WL_NO_SSID_AVAIL; }
+  bool known = bssid && channel == s_apChannel;
+  join(!known);
+  return WL_CONNECTED;
+}
+
+bool WiFiClass::config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1) {
+  s_staticIp = local;
+  if (local.isSet()) {
+    s_gw = gateway;
+    s_mask = subnet;
+    s_dns = dns1;
+  }
+  return true;
+}
+
+bool WiFiClass::disconnect(bool wifiOff) {
+  (void)wifiOff;
+  s_wifiUp = false;
+  s_ip = 0;
+  return true;
+}
+
+String WiFiClass::SSID() const { return s_wifiUp ? s_ssid : String(); }
+String WiFiClass::psk() const { return s_pass; } // stored station config, like the SDK
+uint8_t* WiFiClass::BSSID() { return s_apBssid; }
+int32_t WiFiClass::channel() { return s_wifiUp ? s_apChannel : 0; }
+IPAddress WiFiClass::localIP() { return s_wifiUp ? s_ip : 0; }
+IPAddress WiFiClass::gatewayIP() { return s_gw; }
+IPAddress WiFiClass::subnetMask() { return s_mask; }
+IPAddress WiFiClass::dnsIP(uint8_t n) { return n == 0 ? s_dns : 0; }
@@ -0,0 +1,83 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+// Host stand-in for the ESP32 WiFi / ESP8266WiFi libraries.
+
+#include "Arduino.h"
+#include "Client.h"
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } WiFiMode_t;
+
+class IPAddress {
+public:
+  IPAddress() : _addr(0) {}
+  IPAddress(uint32_t addr) : _addr(addr) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : _addr((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+  operator uint32_t() const { return _addr; }
+  bool isSet() const { return _addr != 0; }
+
+private:
+  uint32_t _addr;
+};
+
+// Station side only. begin() completes synchronously and advances the clock
+// by the simulated scan / association / DHCP time (host::wifi_set_timing).
+class WiFiClass {
+public:
+  wl_status_t status();
+  bool mode(WiFiMode_t m) { (void)m; return true; }
+  bool persistent(bool on) { (void)on; return true; }
+  wl_status_t begin(const char* ssid, const char* pass = nullptr, int32_t channel = 0,
+                    const uint8_t* bssid = nullptr, bool connect = true);
+  bool config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1 = IPAddress());
+  bool disconnect(bool wifiOff = false);
+
+  String SSID() const;
+  String psk() const;
+  uint8_t* BSSID();
+  int32_t channel();
+  IPAddress localIP();
+  IPAddress gatewayIP();
+  IPAddress subnetMask();
+  IPAddress dnsIP(uint8_t n = 0);
+};
+extern WiFiClass WiFi;
+
+// Simulated by default: connect() succeeds or fails per host::tcp_set_broker()
+// and nothing is sent anywhere. With host::tcp_use_sockets(true) it is a real
+// non-blocking TCP socket (POSIX), for runs against an actual broker.
+class WiFiClient : public Client {
+public:
+  ~WiFiClient() override { stop(); }
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override { return _open; }
+  operator bool() override { return _open; }
+  using Print::write;
+
+  // Socket mode: blocks until data arrives or us elapse (stands in for the
+  // time the device spends elsewhere, so host threads do not busy-spin).
+  bool host_wait(uint32_t us);
+
+private:
+  bool _open = false;
+  int _fd = -1;
+};
+
+#endif
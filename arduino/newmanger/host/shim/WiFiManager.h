@@ -0,0 +1,52 @@
+#ifndef HOST_WIFIMANAGER_H
+#define HOST_WIFIMANAGER_H
+// Host stand-in for tzapu/WiFiManager: autoConnect() joins the host AP with
+// a full scan (host::wifi_full_connect) and the portal returns at once with
+// the parameters unchanged.
+
+#include "Arduino.h"
+#include "WiFi.h"
+
+class WiFiManagerParameter {
+public:
+  WiFiManagerParameter(const char* id, const char* label, const char* defaultValue, int length,
+                       const char* custom = "")
+      : _id(id), _label(label), _length(length), _custom(custom) {
+    _value = (char*)calloc((size_t)length + 1, 1);
+    if (defaultValue) strlcpy(_value, defaultValue, (size_t)length + 1);
+  }
+  ~WiFiManagerParameter() { free(_value); }
+  const char* getID() const { return _id; }
+  const char* getLabel() const { return _label; }
+  const char* getValue() const { return _value; }
+  int getValueLength() const { return _length; }
+  const char* getCustomHTML() const { return _custom; }
+
+private:
+  WiFiManagerParameter(const WiFiManagerParameter&);
+  WiFiManagerParameter& operator=(const WiFiManagerParameter&);
+  const char* _id;
+  const char* _label;
+  char* _value;
+  int _length;
+  const char* _custom;
+};
+
+class WiFiManager {
+public:
+  void setCustomHeadElement(const char* html) { (void)html; }
+  void setSaveConfigCallback(void (*func)()) { _saveCb = func; }
+  bool addParameter(WiFiManagerParameter* p) { (void)p; return true; }
+  void setConnectTimeout(unsigned long seconds) { (void)seconds; }
+  void setConfigPortalTimeout(unsigned long seconds) { (void)seconds; }
+  void setBreakAfterConfig(bool shouldBreak) { (void)shouldBreak; }
+  void setConfigPortalBlocking(bool shouldBlock) { (void)shouldBlock; }
+  bool autoConnect(const char* apName) { (void)apName; return host::wifi_full_connect(); }
+  bool startConfigPortal(const char* apName) { (void)apName; return true; }
+  void resetSettings() {}
+
+private:
+  void (*_saveCb)() = nullptr;
+};
+
+#endif
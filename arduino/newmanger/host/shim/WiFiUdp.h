@@ -0,0 +1,51 @@
+#ifndef HOST_WIFIUDP_H
+#define HOST_WIFIUDP_H
+// Host stand-in for WiFiUdp.h (ESP32 / ESP8266 cores).
+// Always a real non-blocking UDP socket bound to 0.0.0.0, so a bench can talk
+// to it over loopback. Same packet API as the cores: parsePacket() / read()
+// for one datagram at a time, beginPacket() / write() / endPacket() to send.
+
+#include "Arduino.h"
+#include "WiFi.h"
+
+class WiFiUDP : public Stream {
+public:
+  ~WiFiUDP() override { stop(); }
+  uint8_t begin(uint16_t port);          // 1 = bound; port 0 = any free port (see host_port())
+  void stop();
+
+  int beginPacket(IPAddress ip, uint16_t port);
+  int beginPacket(const char* host, uint16_t port);
+  int endPacket();                       // 1 = sent
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t size) override;
+  using Print::write;
+
+  int parsePacket();                     // size of the next datagram, 0 = none waiting
+  int available() override { return (int)(_rxLen - _rxPos); }
+  int read() override { return _rxPos < _rxLen ? _rx[_rxPos++] : -1; }
+  int read(unsigned char* buf, size_t len);
+  int read(char* buf, size_t len) { return read((unsigned char*)buf, len); }
+  int peek() override { return _rxPos < _rxLen ? _rx[_rxPos] : -1; }
+  void flush() {}
+  IPAddress remoteIP() const { return IPAddress(_remoteIp); }
+  uint16_t remotePort() const { return _remotePort; }
+
+  // --- Host-only ---
+  uint16_t host_port() const { return _port; }
+  bool host_wait(uint32_t us);           // blocks until a datagram arrives or us elapse
+
+private:
+  int _fd = -1;
+  uint16_t _port = 0;
+  uint8_t _rx[1472];                     // one Ethernet-sized datagram, like the cores
+  size_t _rxLen = 0, _rxPos = 0;
+  uint32_t _remoteIp = 0;
+  uint16_t _remotePort = 0;
+  uint8_t _tx[1472];
+  size_t _txLen = 0;
+  uint32_t _txIp = 0;
+  uint16_t _txPort = 0;
+};
+
+#endif
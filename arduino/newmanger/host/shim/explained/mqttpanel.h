@@ -0,0 +1,3 @@
+// The channel router sources include "mqttpanel.h" (the name the header has
+// once copied into a sketch). In the host build that name resolves here.
+#include "../../../explained/mqttpanel_explained.h"
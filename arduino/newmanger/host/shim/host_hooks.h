@@ -0,0 +1,67 @@
+#ifndef HOST_HOOKS_H
+#define HOST_HOOKS_H
+// Control surface of the host shims: used by benches to drive the fake
+// hardware (clock, GPIO, Wi-Fi) and to read allocation counters.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+namespace host {
+
+// --- Heap accounting ---
+// Every String buffer goes through tracked_realloc/tracked_free; benches that
+// also override operator new add to the same counters. Atomic because the
+// dual-core bench allocates from several threads.
+extern std::atomic<unsigned long> alloc_count;
+extern std::atomic<unsigned long> alloc_bytes;
+void* tracked_realloc(void* ptr, size_t size);
+void tracked_free(void* ptr);
+
+// --- Heap ---
+// What ESP.getFreeHeap() / getMaxFreeBlockSize() report (default 40 KB / 32 KB).
+void heap_set(uint32_t freeBytes, uint32_t maxBlock);
+
+// --- Clock ---
+// Real monotonic time by default. In manual mode millis()/micros() only move
+// through clock_advance_us() and delay().
+void clock_manual(bool on);
+void clock_advance_us(uint64_t us);
+uint64_t clock_now_us();
+// Manual mode: fn runs once when the clock passes atUs (an outside event in
+// the middle of a delay(), e.g. a button press or a datagram). One at a time.
+void clock_at(uint64_t atUs, void (*fn)());
+
+// --- GPIO ---
+// A level change runs the pin's attachInterrupt() handler right away (when its
+// mode matches), like the real interrupt would.
+void gpio_set_input(uint8_t pin, int level);
+int gpio_get_output(uint8_t pin);
+// digitalRead() + digitalWrite() calls so far (what a loop costs in pin accesses)
+unsigned long gpio_access_count();
+
+// --- Wi-Fi ---
+void wifi_set_connected(bool on);
+// The access point in range and how long connecting to it takes. A scan is
+// paid whenever WiFi.begin() is not given the AP's BSSID + channel; DHCP
+// whenever no static IP was configured.
+void wifi_set_ap(const char* ssid, const char* pass, const uint8_t bssid[6], int32_t channel);
+void wifi_set_timing(uint32_t scanMs, uint32_t assocMs, uint32_t dhcpMs);
+// What WiFiManager::autoConnect() does with its saved credentials: full scan,
+// association and DHCP. Returns false if the AP is not reachable.
+bool wifi_full_connect();
+// Broker reachability for WiFiClient::connect(): when up, the TCP handshake
+// takes latencyMs; when down, connect() fails after the client's timeout.
+// Both advance the manual clock (the real call blocks for that long).
+void tcp_set_broker(bool up, uint32_t latencyMs = 0);
+// WiFiClient opens real TCP connections instead (POSIX sockets, TCP_NODELAY).
+// Use with the real clock; tcp_set_broker() no longer applies.
+void tcp_use_sockets(bool on);
+
+// --- Serial ---
+// Off by default so benches are not dominated by stdout.
+void serial_echo(bool on);
+
+} // namespace host
+
+#endif
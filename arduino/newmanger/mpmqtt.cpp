@@ -0,0 +1,575 @@
+#include "mpmqtt.h"
+
+// MQTT 3.1.1 control packet types (high nibble of the fixed header)
+#define MP_MQTT_CONNECT     0x10
+#define MP_MQTT_CONNACK     0x20
+#define MP_MQTT_PUBLISH     0x30
+#define MP_MQTT_PUBACK      0x40
+#define MP_MQTT_SUBSCRIBE   0x82
+#define MP_MQTT_SUBACK      0x90
+#define MP_MQTT_UNSUBSCRIBE 0xA2
+#define MP_MQTT_PINGREQ     0xC0
+#define MP_MQTT_PINGRESP    0xD0
+#define MP_MQTT_DISCONNECT  0xE0
+
+#define MP_MQTT_DEFAULT_BUFFER 256
+
+static uint8_t _varint_len(uint32_t n) {
+  uint8_t k = 1;
+  while (n >= 128) { n >>= 7; k++; }
+  return k;
+}
+
+MpMqttClient::MpMqttClient(Client& client)
+  : _sock(&client), _cb(NULL), _stream(NULL), _domain(NULL), _port(1883), _keepAlive(15),
+    _socketTimeout(15), _state(MQTT_DISCONNECTED),
+    _rx((uint8_t*)malloc(MP_MQTT_DEFAULT_BUFFER)), _rxSize(MP_MQTT_DEFAULT_BUFFER), _rxType(0),
+    _tx((uint8_t*)malloc(MP_MQTT_DEFAULT_BUFFER)), _txSize(MP_MQTT_DEFAULT_BUFFER), _txLen(0),
+    _pubLeft(0), _pubStore(false), _qos(0), _window(1), _slotHead(0), _slotCount(0),
+    _store(NULL), _storeSize(0), _storeHead(0), _storeUsed(0), _lastId(0),
+    _lastIn(0), _lastOut(0), _pingOut(false), _inCb(false), _connRc(-1) {
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+MpMqttClient::~MpMqttClient() {
+  free(_rx);
+  free(_tx);
+  free(_store);
+}
+
+MpMqttClient& MpMqttClient::setServer(const char* domain, uint16_t port) {
+  _domain = domain;
+  _port = port;
+  return *this;
+}
+
+MpMqttClient& MpMqttClient::setCallback(Callback cb) {
+  _cb = cb;
+  return *this;
+}
+
+MpMqttClient& MpMqttClient::setStream(Stream& stream) {
+  _stream = &stream;
+  return *this;
+}
+
+bool MpMqttClient::setBufferSize(uint16_t size) {
+  if (size == 0 || _rxType) return false; // not in the middle of a packet
+  uint8_t* p = (uint8_t*)realloc(_rx, size);
+  if (!p) return false;
+  _rx = p;
+  _rxSize = size;
+  return true;
+}
+
+bool MpMqttClient::setTxBufferSize(uint16_t size) {
+  if (size == 0) return false;
+  flush();
+  uint8_t* p = (uint8_t*)realloc(_tx, size);
+  if (!p) return false;
+  _tx = p;
+  _txSize = size;
+  return true;
+}
+
+bool MpMqttClient::setQos(uint8_t qos, uint8_t window, uint16_t storeBytes) {
+  if (qos > 1 || _slotCount) return false;
+  if (qos == 1 && storeBytes != _storeSize) {
+    uint8_t* p = (uint8_t*)realloc(_store, storeBytes);
+    if (!p) return false;
+    _store = p;
+    _storeSize = storeBytes;
+  }
+  _qos = qos;
+  _window = window < 1 ? 1 : window > MP_MQTT_MAX_WINDOW ? MP_MQTT_MAX_WINDOW : window;
+  _storeHead = 0;
+  _storeUsed = 0;
+  return true;
+}
+
+void MpMqttClient::stats(MpMqttStats* out) {
+  if (!out) return;
+  *out = _stats;
+  out->inflight = _slotCount;
+}
+
+// loop() acts once either direction has been quiet for more than the keepalive
+uint32_t MpMqttClient::pingDueMs() {
+  if (_state != MQTT_CONNECTED || !_keepAlive) return UINT32_MAX;
+  unsigned long now = millis();
+  unsigned long ka = _keepAlive * 1000UL;
+  unsigned long quiet = now - _lastIn > now - _lastOut ? now - _lastIn : now - _lastOut;
+  return quiet > ka ? 0 : (uint32_t)(ka - quiet + 1);
+}
+
+// --- Output ---
+// Everything goes through the TX buffer; one socket write per flush. A packet
+// larger than the buffer is written through after flushing what is queued.
+
+void MpMqttClient::flush() {
+  if (_txLen == 0) return;
+  size_t w = _sock->write(_tx, _txLen);
+  _stats.writes++;
+  _stats.writeBytes += (uint32_t)w;
+  bool ok = (w == _txLen);
+  _txLen = 0;
+  _lastOut = millis();
+  if (!ok) _lost(MQTT_CONNECTION_LOST);
+}
+
+void MpMqttClient::_out(const void* p, size_t n) {
+  if (_state != MQTT_CONNECTED && _connRc != -1) return; // connection gone: drop the rest of the packet
+  if ((size_t)_txLen + n > _txSize) {
+    flush();
+    if (n > _txSize) {
+      size_t w = _sock->write((const uint8_t*)p, n);
+      _stats.writes++;
+      _stats.writeBytes += (uint32_t)w;
+      _lastOut = millis();
+      if (w != n) _lost(MQTT_CONNECTION_LOST);
+      return;
+    }
+  }
+  memcpy(_tx + _txLen, p, n);
+  _txLen = (uint16_t)(_txLen + n);
+}
+
+void MpMqttClient::_open_packet(uint8_t type, uint32_t len) {
+  uint8_t h[5];
+  uint8_t k = 0;
+  h[k++] = type;
+  do {
+    uint8_t b = len % 128;
+    len /= 128;
+    h[k++] = (uint8_t)(len ? b | 128 : b);
+  } while (len);
+  _out(h, k);
+}
+
+void MpMqttClient::_out_str(const char* s) {
+  size_t n = strlen(s);
+  uint8_t l[2] = { (uint8_t)(n >> 8), (uint8_t)n };
+  _out(l, 2);
+  _out(s, n);
+}
+
+// --- QoS 1 window ---
+// In-flight PUBLISH packets are kept, in send order, in one byte ring (_store)
+// with a slot each. Brokers acknowledge QoS 1 in order (MQTT-4.6.0-2), so the
+// ring is freed from the head; an out-of-order PUBACK just marks its slot.
+
+bool MpMqttClient::_room(uint32_t size) {
+  return _slotCount < _window && size <= _storeSize - _storeUsed;
+}
+
+bool MpMqttClient::_wait_room(uint32_t size) {
+  if (_room(size)) return true;
+  if (_inCb) return false; // the RX buffer is in use: cannot read PUBACKs from inside the callback
+  flush();
+  unsigned long t0 = millis();
+  while (!_room(size)) {
+    if (!connected() || millis() - t0 >= _socketTimeout * 1000UL) return false;
+    if (!_poll()) delay(1);
+  }
+  return true;
+}
+
+void MpMqttClient::_keep(const void* p, uint32_t n) {
+  uint32_t pos = (_storeHead + _storeUsed) % _storeSize;
+  uint32_t first = _storeSize - pos;
+  if (first > n) first = n;
+  memcpy(_store + pos, p, first);
+  memcpy(_store, (const uint8_t*)p + first, n - first);
+  _storeUsed += n;
+}
+
+void MpMqttClient::_emit(const void* p, size_t n) {
+  _out(p, n);
+  if (_pubStore) _keep(p, (uint32_t)n);
+}
+
+uint16_t MpMqttClient::_next_id() {
+  if (++_lastId == 0) _lastId = 1;
+  return _lastId;
+}
+
+void MpMqttClient::_on_puback(uint16_t id) {
+  for (uint8_t i = 0; i < _slotCount; i++) {
+    Slot& s = _slots[(_slotHead + i) % MP_MQTT_MAX_WINDOW];
+    if (s.id != id || s.acked) continue;
+    s.acked = true;
+    _stats.acked++;
+    _stats.lastAckUs = (uint32_t)micros() - s.sentUs;
+    if (_stats.lastAckUs > _stats.maxAckUs) _stats.maxAckUs = _stats.lastAckUs;
+    break;
+  }
+  while (_slotCount && _slots[_slotHead].acked) {
+    Slot& s = _slots[_slotHead];
+    _storeHead = (_storeHead + s.size) % _storeSize;
+    _storeUsed -= s.size;
+    _slotHead = (uint8_t)((_slotHead + 1) % MP_MQTT_MAX_WINDOW);
+    _slotCount--;
+  }
+}
+
+// After a reconnect: everything still unacknowledged goes out again, DUP set.
+void MpMqttClient::_resend() {
+  for (uint8_t i = 0; i < _slotCount; i++) {
+    Slot& s = _slots[(_slotHead + i) % MP_MQTT_MAX_WINDOW];
+    if (s.acked) continue;
+    _store[s.pos] |= 0x08;
+    uint32_t first = _storeSize - s.pos;
+    if (first > s.size) first = s.size;
+    _out(_store + s.pos, first);
+    if (s.size > first) _out(_store, s.size - first);
+    s.sentUs = (uint32_t)micros();
+    _stats.resent++;
+  }
+}
+
+// --- Publish ---
+
+bool MpMqttClient::publish(const char* topic, const char* payload) {
+  return publish(topic, (const uint8_t*)payload, payload ? (unsigned int)strlen(payload) : 0, false);
+}
+
+bool MpMqttClient::publish(const char* topic, const char* payload, bool retained) {
+  return publish(topic, (const uint8_t*)payload, payload ? (unsigned int)strlen(payload) : 0, retained);
+}
+
+bool MpMqttClient::publish(const char* topic, const uint8_t* payload, unsigned int plength) {
+  return publish(topic, payload, plength, false);
+}
+
+bool MpMqttClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained) {
+  if (!beginPublish(topic, plength, retained)) return false;
+  if (plength) write(payload, plength);
+  return endPublish() == 1;
+}
+
+bool MpMqttClient::beginPublish(const char* topic, unsigned int plength, bool retained) {
+  if (!topic || _pubLeft || !connected()) return false;
+  size_t tl = strlen(topic);
+  if (tl > 0xFFFF) return false;
+  bool q1 = (_qos == 1);
+  uint32_t len = (uint32_t)(2 + tl + (q1 ? 2 : 0) + plength);
+  uint32_t size = 1 + _varint_len(len) + len;
+  if (q1 && size > _storeSize) { // cannot be kept for a resend: QoS 0
+    q1 = false;
+    len -= 2;
+    size = 1 + _varint_len(len) + len;
+  }
+  if (q1 && !_wait_room(size)) return false;
+  if (!connected()) return false;
+
+  uint16_t id = 0;
+  _pubStore = q1;
+  if (q1) {
+    id = _next_id();
+    Slot& s = _slots[(_slotHead + _slotCount) % MP_MQTT_MAX_WINDOW];
+    s.id = id;
+    s.acked = false;
+    s.pos = (_storeHead + _storeUsed) % _storeSize;
+    s.size = size;
+    s.sentUs = (uint32_t)micros();
+    _slotCount++;
+    if (_slotCount > _stats.peakInflight) _stats.peakInflight = _slotCount;
+  }
+
+  uint8_t h[5];
+  uint8_t k = 0;
+  h[k++] = (uint8_t)(MP_MQTT_PUBLISH | (q1 ? 0x02 : 0) | (retained ? 0x01 : 0));
+  for (uint32_t n = len; ; ) {
+    uint8_t b = n % 128;
+    n /= 128;
+    h[k++] = (uint8_t)(n ? b | 128 : b);
+    if (!n) break;
+  }
+  _emit(h, k);
+  uint8_t l[2] = { (uint8_t)(tl >> 8), (uint8_t)tl };
+  _emit(l, 2);
+  _emit(topic, tl);
+  if (q1) {
+    uint8_t b[2] = { (uint8_t)(id >> 8), (uint8_t)id };
+    _emit(b, 2);
+  }
+  _pubLeft = plength;
+  _stats.published++;
+  return true;
+}
+
+size_t MpMqttClient::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t MpMqttClient::write(const uint8_t* buf, size_t size) {
+  if (!_pubLeft || _state != MQTT_CONNECTED) return 0;
+  if (size > _pubLeft) size = _pubLeft;
+  _emit(buf, size);
+  _pubLeft -= (uint32_t)size;
+  return size;
+}
+
+int MpMqttClient::endPublish() {
+  if (_pubLeft) { // short: the broker would read the next packet as payload
+    _lost(MQTT_CONNECTION_LOST);
+    return 0;
+  }
+  _pubStore = false;
+  return _state == MQTT_CONNECTED ? 1 : 0;
+}
+
+// --- Subscribe ---
+
+bool MpMqttClient::subscribe(const char* topic) {
+  return subscribe(topic, 0);
+}
+
+bool MpMqttClient::subscribe(const char* topic, uint8_t qos) {
+  if (!topic || qos > 1 || _pubLeft || !connected()) return false;
+  uint16_t id = _next_id();
+  uint8_t b[2] = { (uint8_t)(id >> 8), (uint8_t)id };
+  _open_packet(MP_MQTT_SUBSCRIBE, (uint32_t)(2 + 2 + strlen(topic) + 1));
+  _out(b, 2);
+  _out_str(topic);
+  _out(&qos, 1);
+  return _state == MQTT_CONNECTED;
+}
+
+bool MpMqttClient::unsubscribe(const char* topic) {
+  if (!topic || _pubLeft || !connected()) return false;
+  uint16_t id = _next_id();
+  uint8_t b[2] = { (uint8_t)(id >> 8), (uint8_t)id };
+  _open_packet(MP_MQTT_UNSUBSCRIBE, (uint32_t)(2 + 2 + strlen(topic)));
+  _out(b, 2);
+  _out_str(topic);
+  return _state == MQTT_CONNECTED;
+}
+
+// --- Connection ---
+
+bool MpMqttClient::connect(const char* id) {
+  return connect(id, NULL, NULL);
+}
+
+bool MpMqttClient::connect(const char* id, const char* user, const char* pass) {
+  if (!_sock || !id) return false;
+  if (connected()) return true;
+  // Same as PubSubClient: an already open socket (mqttpanel's MP_CONN_TCP step) is reused.
+  if (!_sock->connected() && (!_domain || _sock->connect(_domain, _port) != 1)) {
+    _state = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  _rxType = 0;
+  _txLen = 0;
+  _pubLeft = 0;
+  _pubStore = false;
+  _connRc = -1;
+
+  uint8_t flags = 0x02; // clean session
+  uint32_t len = 10 + 2 + (uint32_t)strlen(id);
+  if (user) { flags |= 0x80; len += 2 + (uint32_t)strlen(user); }
+  if (pass) { flags |= 0x40; len += 2 + (uint32_t)strlen(pass); }
+  uint8_t vh[10] = { 0, 4, 'M', 'Q', 'T', 'T', MQTT_VERSION_3_1_1, flags,
+                     (uint8_t)(_keepAlive >> 8), (uint8_t)_keepAlive };
+  _open_packet(MP_MQTT_CONNECT, len);
+  _out(vh, sizeof(vh));
+  _out_str(id);
+  if (user) _out_str(user);
+  if (pass) _out_str(pass);
+  flush();
+
+  unsigned long t0 = millis();
+  while (_connRc < 0) {
+    if (!_sock->connected()) { _lost(MQTT_CONNECTION_LOST); return false; }
+    if (millis() - t0 >= _socketTimeout * 1000UL) { _lost(MQTT_CONNECTION_TIMEOUT); return false; }
+    if (!_poll()) delay(1);
+  }
+  if (_connRc != 0) {
+    _lost(_connRc);
+    return false;
+  }
+  _state = MQTT_CONNECTED;
+  _lastIn = _lastOut = millis();
+  _pingOut = false;
+  _resend();
+  flush();
+  return _state == MQTT_CONNECTED;
+}
+
+void MpMqttClient::disconnect() {
+  if (_state == MQTT_CONNECTED && _sock->connected()) {
+    uint8_t p[2] = { MP_MQTT_DISCONNECT, 0 };
+    _out(p, 2);
+    flush();
+  }
+  _lost(MQTT_DISCONNECTED);
+}
+
+// Socket closed (or given up on). Unacknowledged QoS 1 messages stay for the
+// next connect(); a half-written one is taken back out.
+void MpMqttClient::_lost(int state) {
+  if (_pubLeft && _pubStore && _slotCount) {
+    uint8_t last = (uint8_t)((_slotHead + _slotCount - 1) % MP_MQTT_MAX_WINDOW);
+    _storeUsed -= _slots[last].size - _pubLeft;
+    _slotCount--;
+  }
+  _pubLeft = 0;
+  _pubStore = false;
+  _txLen = 0;
+  _rxType = 0;
+  _state = state;
+  _connRc = (int16_t)(state == MQTT_CONNECTED ? 0 : -2);
+  _sock->stop();
+}
+
+bool MpMqttClient::connected() {
+  if (!_sock) return false;
+  if (_state != MQTT_CONNECTED) return false;
+  if (!_sock->connected()) {
+    _lost(MQTT_CONNECTION_LOST);
+    return false;
+  }
+  return true;
+}
+
+bool MpMqttClient::loop() {
+  if (!connected()) return false;
+  _poll();
+  if (_state != MQTT_CONNECTED) return false;
+
+  unsigned long now = millis();
+  unsigned long ka = _keepAlive * 1000UL;
+  if (ka && (now - _lastIn > ka || now - _lastOut > ka)) {
+    if (_pingOut) {
+      _lost(MQTT_CONNECTION_TIMEOUT);
+      return false;
+    }
+    uint8_t p[2] = { MP_MQTT_PINGREQ, 0 };
+    _out(p, 2);
+    _lastIn = now;
+    _pingOut = true;
+  }
+  flush();
+  return _state == MQTT_CONNECTED;
+}
+
+// --- Input ---
+// Reads whatever the socket has, across as many packets as that covers. A
+// packet may arrive in pieces over several calls. The RX buffer holds the
+// variable header + payload; past _rxSize the payload only goes to the
+// stream (setStream) and the callback gets the part that fit, otherwise the
+// message is dropped. Returns false if there was nothing to read.
+
+bool MpMqttClient::_poll() {
+  if (_inCb) return false;
+  int avail = _sock->available();
+  if (avail <= 0) return false;
+  while (avail > 0 && _sock->connected()) {
+    if (!_rxType) {
+      int b = _sock->read();
+      if (b <= 0) break;
+      avail--;
+      _rxType = (uint8_t)b;
+      _rxLen = 0;
+      _rxMul = 1;
+      _rxLenBytes = 0;
+      _rxLenDone = false;
+      _rxGot = 0;
+      _rxPayloadAt = 0;
+      continue;
+    }
+    if (!_rxLenDone) {
+      int b = _sock->read();
+      if (b < 0) break;
+      avail--;
+      _rxLen += (uint32_t)(b & 127) * _rxMul;
+      _rxMul *= 128;
+      if (b & 128) {
+        if (++_rxLenBytes == 4) { _lost(MQTT_CONNECTION_LOST); return true; } // malformed
+        continue;
+      }
+      _rxLenDone = true;
+      if (_rxLen == 0) { _packet(); _rxType = 0; }
+      continue;
+    }
+
+    uint32_t from = _rxGot;
+    uint32_t want = _rxLen - _rxGot;
+    uint8_t scratch[64];
+    uint8_t* dst;
+    uint32_t n;
+    if (_rxGot < _rxSize) {
+      dst = _rx + _rxGot;
+      n = _rxSize - _rxGot;
+    } else {
+      dst = scratch;
+      n = sizeof(scratch);
+    }
+    if (n > want) n = want;
+    if (n > (uint32_t)avail) n = (uint32_t)avail;
+    int r = _sock->read(dst, n);
+    if (r <= 0) break;
+    avail -= r;
+    _rxGot += (uint32_t)r;
+
+    bool pub = (_rxType & 0xF0) == MP_MQTT_PUBLISH;
+    if (pub && !_rxPayloadAt && _rxGot >= 2 && _rxSize >= 2) {
+      _rxPayloadAt = 2 + (((uint32_t)_rx[0] << 8) | _rx[1]) + (((_rxType >> 1) & 3) ? 2 : 0);
+    }
+    if (pub && _stream && _rxPayloadAt && _rxGot > _rxPayloadAt) {
+      uint32_t skip = from < _rxPayloadAt ? _rxPayloadAt - from : 0;
+      _stream->write(dst + skip, (size_t)r - skip);
+    }
+    if (_rxGot == _rxLen) { _packet(); _rxType = 0; }
+  }
+  _lastIn = millis();
+  return true;
+}
+
+void MpMqttClient::_packet() {
+  uint32_t stored = _rxLen < _rxSize ? _rxLen : _rxSize;
+  switch (_rxType & 0xF0) {
+    case MP_MQTT_CONNACK:
+      _connRc = stored >= 2 ? _rx[1] : 1; // malformed: treat as refused
+      break;
+
+    case MP_MQTT_PUBLISH: {
+      uint8_t qos = (_rxType >> 1) & 3;
+      uint32_t at = _rxPayloadAt;
+      uint16_t id = 0;
+      if (!at || at > stored) { _stats.dropped++; break; } // topic did not fit
+      if (qos) id = (uint16_t)((_rx[at - 2] << 8) | _rx[at - 1]);
+      if (_rxLen > _rxSize && !_stream) {
+        _stats.dropped++;
+      } else {
+        // NUL-terminate the topic in place, one byte to the left (as PubSubClient does)
+        uint16_t tl = (uint16_t)((_rx[0] << 8) | _rx[1]);
+        memmove(_rx + 1, _rx + 2, tl);
+        _rx[1 + tl] = '\0';
+        _stats.received++;
+        if (_cb) {
+          _inCb = true;
+          _cb((char*)_rx + 1, _rx + at, (unsigned int)(stored - at));
+          _inCb = false;
+        }
+      }
+      if (qos == 1 && _state == MQTT_CONNECTED) {
+        uint8_t ack[4] = { MP_MQTT_PUBACK, 2, (uint8_t)(id >> 8), (uint8_t)id };
+        _out(ack, 4);
+      }
+      break;
+    }
+
+    case MP_MQTT_PUBACK:
+      if (stored >= 2) _on_puback((uint16_t)((_rx[0] << 8) | _rx[1]));
+      break;
+
+    case MP_MQTT_PINGRESP:
+      _pingOut = false;
+      break;
+
+    default: // SUBACK / UNSUBACK: nothing to do
+      break;
+  }
+}
@@ -0,0 +1,174 @@
+#ifndef MPMQTT_H
+#define MPMQTT_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+// --- 內建 MQTT 3.1.1 Client (選用，編譯時加 -DMP_NATIVE_MQTT) ---
+// PubSubClient 只能送 QoS 0、每次 loop() 只處理一個封包、收發共用一塊緩衝區。
+// MpMqttClient 的介面跟 PubSubClient 一樣 (mqttpanel 不用改，草稿碼用 MpClient 宣告即可)，另外：
+//  - QoS 1 發送：最多 window 則同時在路上，不用一則一則等 PUBACK。
+//    窗滿了 publish() 會先收 PUBACK 騰出位置 (最多等 setSocketTimeout 秒)，等不到回傳 false。
+//  - 收、發各一塊緩衝區：收大訊息跟送訊息互不影響。
+//  - 發送先累積在 TX 緩衝區，滿了、loop()、flush() 才一次寫進 socket
+//    (mqttpanel_loop() 結束時會 flush，一圈送的東西通常只要一次 write)。
+//  - loop() 一次把 socket 裡已經收到的封包全部處理完。
+// 還沒收到 PUBACK 的訊息存在重送區，斷線重連後帶 DUP 旗標重送 (至少送到一次)。
+// 放不進重送區的大訊息 (例如 beginPublish 串流的圖片) 用 QoS 0 送。
+
+#ifndef MP_MQTT_MAX_WINDOW
+#define MP_MQTT_MAX_WINDOW 32   // setQos() 的 window 上限
+#endif
+
+#ifndef MQTT_VERSION_3_1_1
+#define MQTT_VERSION_3_1_1 4
+#endif
+#ifndef MQTT_MAX_HEADER_SIZE
+#define MQTT_MAX_HEADER_SIZE 5
+#endif
+
+// state() 的值跟 PubSubClient 一樣
+#ifndef MQTT_CONNECTED
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+#endif
+
+struct MpMqttStats {
+  uint32_t published;     // 送出的 PUBLISH (不含重送)
+  uint32_t acked;         // 收到的 PUBACK
+  uint32_t resent;        // 重連後重送的
+  uint32_t received;      // 收到的 PUBLISH
+  uint32_t dropped;       // 收到但太大、又沒有 setStream() 而丟掉的
+  uint32_t writes;        // 呼叫 socket write() 的次數
+  uint32_t writeBytes;    // 寫進 socket 的 bytes
+  uint16_t inflight;      // 現在有幾則還沒收到 PUBACK
+  uint16_t peakInflight;  // 最多同時幾則
+  uint32_t lastAckUs;     // 上一則從送出到收到 PUBACK 花了多久 (微秒)
+  uint32_t maxAckUs;      // 最久的一次
+};
+
+class MpMqttClient : public Print {
+public:
+  typedef void (*Callback)(char* topic, uint8_t* payload, unsigned int length);
+
+  explicit MpMqttClient(Client& client);
+  ~MpMqttClient();
+
+  // --- 跟 PubSubClient 一樣 ---
+  MpMqttClient& setServer(const char* domain, uint16_t port);
+  MpMqttClient& setCallback(Callback cb);
+  MpMqttClient& setStream(Stream& stream);  // 比 RX 緩衝區大的訊息：payload 邊收邊寫進 stream，callback 拿到放得下的部分
+  MpMqttClient& setClient(Client& client) { _sock = &client; return *this; }
+  MpMqttClient& setKeepAlive(uint16_t sec) { _keepAlive = sec; return *this; }
+  MpMqttClient& setSocketTimeout(uint16_t sec) { _socketTimeout = sec; return *this; }
+  bool setBufferSize(uint16_t size);        // RX 緩衝區 (一則訊息最大多少)
+  uint16_t getBufferSize() { return _rxSize; }
+
+  bool connect(const char* id);
+  bool connect(const char* id, const char* user, const char* pass);
+  void disconnect();
+
+  bool publish(const char* topic, const char* payload);
+  bool publish(const char* topic, const char* payload, bool retained);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int plength);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained);
+
+  bool beginPublish(const char* topic, unsigned int plength, bool retained);
+  int endPublish();
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  using Print::write;
+
+  bool subscribe(const char* topic);
+  bool subscribe(const char* topic, uint8_t qos);
+  bool unsubscribe(const char* topic);
+
+  bool loop();
+  bool connected();
+  int state() { return _state; }
+
+  // --- 新增的 ---
+  // 發送的 QoS (0 / 1) 與 QoS 1 的窗口：最多 window 則、合計 storeBytes bytes 還沒收到 PUBACK。
+  // 在 connect() 之前設好。回傳 false = 記憶體不夠 (維持原設定)。
+  bool setQos(uint8_t qos, uint8_t window = 8, uint16_t storeBytes = 2048);
+  bool setTxBufferSize(uint16_t size);      // TX 緩衝區 (預設 256)；大於它的封包直接寫，不經過緩衝
+  void flush();                             // 把 TX 緩衝區寫進 socket
+  void stats(MpMqttStats* out);
+  uint32_t pingDueMs();                     // 再過幾 ms loop() 要送 PINGREQ (或判定逾時)；沒連線 / keepalive 0 = UINT32_MAX
+
+private:
+  struct Slot {
+    uint16_t id;
+    bool acked;
+    uint32_t pos;      // 在重送區的位置
+    uint32_t size;     // 整個 PUBLISH 封包的長度
+    uint32_t sentUs;
+  };
+
+  void _open_packet(uint8_t type, uint32_t len);
+  void _out(const void* p, size_t n);
+  void _out_str(const char* s);
+  bool _room(uint32_t size);
+  bool _wait_room(uint32_t size);
+  void _emit(const void* p, size_t n);
+  void _keep(const void* p, uint32_t n);
+  void _resend();
+  void _on_puback(uint16_t id);
+  bool _poll();
+  void _packet();
+  void _lost(int state);
+  uint16_t _next_id();
+
+  Client* _sock;
+  Callback _cb;
+  Stream* _stream;
+  const char* _domain;
+  uint16_t _port;
+  uint16_t _keepAlive;
+  uint16_t _socketTimeout;
+  int _state;
+
+  // RX: [固定標頭 1B][剩餘長度]... 一點一點讀進來 (封包可能分好幾次才收完)
+  uint8_t* _rx;
+  uint16_t _rxSize;
+  uint8_t _rxType;       // 固定標頭 (0 = 在等下一個封包)
+  uint32_t _rxLen;       // 剩餘長度
+  uint8_t _rxLenBytes;   // 剩餘長度讀了幾個 byte
+  bool _rxLenDone;       // 剩餘長度讀完了 (接下來是內容)
+  uint32_t _rxMul;
+  uint32_t _rxGot;       // 已經讀了幾 bytes
+  uint32_t _rxPayloadAt; // PUBLISH：payload 從第幾個 byte 開始 (0 = 還不知道)
+
+  // TX
+  uint8_t* _tx;
+  uint16_t _txSize;
+  uint16_t _txLen;
+
+  // beginPublish 串流
+  uint32_t _pubLeft;
+  bool _pubStore;        // 同時存進重送區 (QoS 1)
+
+  // QoS 1
+  uint8_t _qos;
+  uint8_t _window;
+  Slot _slots[MP_MQTT_MAX_WINDOW];
+  uint8_t _slotHead;
+  uint8_t _slotCount;
+  uint8_t* _store;
+  uint32_t _storeSize;
+  uint32_t _storeHead;
+  uint32_t _storeUsed;
+  uint16_t _lastId;
+
+  unsigned long _lastIn;
+  unsigned long _lastOut;
+  bool _pingOut;
+  bool _inCb;            // 正在 callback 裡 (RX 緩衝區還在用，不能再讀 socket)
+  int16_t _connRc;       // CONNACK 的結果 (-1 = 還沒收到)
+  MpMqttStats _stats;
+};
+
+#endif
@@ -3,15 +3,19 @@
 // --- Platform Includes ---
 #ifdef ESP32
   #include <WiFi.h>
+  #include <WiFiUdp.h>
   #include <FS.h>
   #include <LittleFS.h>
 #elif defined(ESP8266)
   #include <ESP8266WiFi.h>
+  #include <WiFiUdp.h>
   #include <LittleFS.h>
 #endif
 
 #include <WiFiManager.h>
 #include <ArduinoJson.h>
+#include <limits.h>
+#include <utility>
 
 // ==========================================
 // 1. CSS STYLE
@@ -81,12 +85,16 @@ const char custom_style[] PROGMEM = R"=====(
 // ==========================================
 // 2. INTERNAL STATE
 // ==========================================
-static PubSubClient* _client = NULL;
-static MqttCallback _userCallback = NULL;
+// Per-broker state lives in MqttPanel (see mqttpanel.h); everything here is device-wide.
+static MqttPanel _main;                         // the mqttpanel_* functions and the portal config
+static MqttPanel* _panels[MP_MAX_PANELS];       // serviced by mqttpanel_loop(), _main in slot 0
+static_assert(MP_MAX_PANELS >= 1 && MP_MAX_PANELS <= 4, "one client callback trampoline per panel");
 
-static char* _p_server = NULL;
-static char* _p_port = NULL;
-static char* _p_topic = NULL;
+static MqttCallback _userCallback = NULL;       // String API (adapter), main panel only
+
+static char* _cfg_server = NULL;                // the sketch's buffers: config.json / portal / fast boot
+static char* _cfg_port = NULL;
+static char* _cfg_topic = NULL;
 
 static int _portal_sec = 3;
 static int _factory_sec = 10;
@@ -94,185 +102,1887 @@ static int _trigger_pin = 0;
 static int _led_pin = 4;     
 static int _check_wifi_sec = 60; // Default
 
-bool shouldSaveConfig = false;
+static bool shouldSaveConfig = false;
+
+// --- Button / LED ---
+// The ISR only counts edges; mqttpanel_loop() compares the count and hands the rest
+// to the scheduler: one timer (debounce, then the next hold threshold) per button.
+#ifndef IRAM_ATTR
+#define IRAM_ATTR ICACHE_RAM_ATTR
+#endif
+
+enum { MP_BTN_UP = 0, MP_BTN_DOWN, MP_BTN_HELD_PORTAL, MP_BTN_HELD_FACTORY, MP_BTN_SPENT };
+
+static volatile uint16_t _btnEdges = 0;         // written by the ISR only
+static uint16_t _btnSeen = 0;
+static uint16_t _btnPending = 0;                // edges since the last settled read
+static unsigned long _btnEdgeAt = 0;            // first of them (as seen by mqttpanel_loop)
+static bool _btnPolled = false;                 // no interrupt on this pin: sample it every loop
+static bool _btnRaw = false;                    // last polled level (LOW = true)
+static int _btnTimer = -1;
+static uint8_t _btnState = MP_BTN_UP;
+static unsigned long _btnDownAt = 0;
+static MpButtonEvent _btnQueue[MP_BTN_QUEUE];
+static uint8_t _btnHead = 0, _btnCount = 0;
+static MpButtonHandler _btnFn = NULL;
+static void* _btnArg = NULL;
+static MpButtonStats _btnStats;
+
+static MpLedPattern _ledUser = MP_LED_OFF;      // what mqttpanel_led() asked for
+static MpLedPattern _led = MP_LED_OFF;          // what is playing
+static uint8_t _ledStep = 0;
+static int _ledTask = -1;
+static bool _ledOverride = false;               // SLOW / FAST for a held button is playing
+
+// --- Idle ---
+// mqttpanel_idle() sleeps up to the earliest deadline of the scheduler and every panel.
+static MpIdleStats _idle;
+static unsigned long _idleSince = 0;            // start of the duty-cycle window
+static bool _idleStarted = false;
+
+// --- Fast boot ---
+// Fixed-layout binary record: read with one read(), checked with CRC32.
+// Any change to the layout changes `size`, so old records are just ignored.
+#define MP_BOOT_FILE "/mp_boot.bin"
+#define MP_BOOT_MAGIC 0x3242504DUL     // "MPB2" (MPB1 records carried the WiFi password)
+#define MP_FAST_WIFI_TIMEOUT_MS 3000   // cached BSSID/channel must associate within this
+
+struct MpBootRecord {
+  uint32_t magic;
+  uint16_t size;
+  uint16_t reserved;
+  char server[40];
+  char port[6];
+  char topic[40];
+  char ssid[33];                       // no password: the SDK keeps its own copy
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip, gateway, subnet, dns;
+  uint32_t crc;                        // CRC32 of every byte before this field
+};
+
+static bool _fastBoot = false;
+static bool _reuseIp = false;               // opt-in: the record carries no lease expiry
+static MpBootRecord _rec;              // valid only if _recOk
+static bool _recOk = false;
+static MpBootReport _boot;
+static unsigned long _bootStart = 0;
+static unsigned long _bootWifiAt = 0;
+static bool _bootReported = false;
+
+// --- Store-and-forward ---
+// RAM ring of records: [flags][topic len][payload len lo][payload len hi][topic][payload].
+// When it is full the oldest records move to the panel's spool file (same format, append
+// only), so the spool always holds older messages than the ring and replay keeps the order.
+#define MP_SPOOL_FILE "/mp_spool.bin"  // main panel; the others use /mp_spool<slot>.bin
+#define MP_SF_LATEST 0x01              // only the newest record of this topic matters
+#define MP_SF_BURST 4                  // replays per loop() at most
+
+// --- Metrics ---
+// Durations go into log2 buckets (see MpHist). The heap is sampled every
+// MP_HEAP_SAMPLE_MS: the largest-block query walks the heap on ESP8266.
+#define MP_HEAP_SAMPLE_MS 100
+#define MP_STATS_SUFFIX "/$stats"
+
+// --- Scheduler ---
+// Deadlines are in 64-bit microseconds (micros() extended across its 71 min wrap).
+// Ids carry a per-slot generation so a stale id never cancels a newer task.
+static_assert(MP_MAX_TASKS <= 32, "due tasks are collected in a 32-bit mask");
+
+struct MpTask {
+  MpTaskFn fn;                          // NULL = free slot
+  void* arg;
+  uint64_t due;
+  uint32_t periodUs;                    // 0 = one-shot
+  uint32_t budgetUs;
+  uint16_t gen;
+  MpTaskStats st;
+};
+
+static MpTask _tasks[MP_MAX_TASKS];
+static uint8_t _taskCount = 0;
+static uint64_t _schedNext = UINT64_MAX; // earliest due time
+static uint32_t _loopBudgetUs = 0;
+static uint64_t _loopStartAt = 0;
+static MpSchedStats _sched;
+
+// --- Topic handlers ---
+// Match tree: one node per distinct level, siblings ordered literal, '+', '#'.
+// Indexes are 1-based so 0 can mean "none".
+static_assert(MP_MATCH_NODES < 256 && MP_MAX_HANDLERS < 256, "tree links are uint8_t");
+static_assert(MP_MATCH_TEXT <= 65535, "level text offsets are uint16_t");
+
+enum { MP_LVL_TEXT = 0, MP_LVL_PLUS, MP_LVL_HASH };
+
+// --- Large payloads ---
+// PubSubClient (setStream) writes every inbound payload byte into the panel's
+// MpChunkSink while it reads the packet, then calls back with what fit in its own
+// buffer. Since that buffer is never larger than ours, a full chunk plus one byte
+// means "oversized".
 
 // --- Helper Declarations ---
 void _loadConfig();
 void _saveConfig();
 void _startPortal(const char* apName);
 void _saveConfigCallback() { shouldSaveConfig = true; }
+static bool _loadBootRecord(MpBootRecord* r);
+static void _saveBootRecord();
+static bool _fastWifi(const MpBootRecord& r);
+static void _mx_hist(MpHist& h, uint32_t us);
+static void _btn_begin();
+static void _btn_edge();
+static void _btn_dispatch();
+static void _led_play(const MpLedPattern& p);
+static uint64_t _sched_now();
+static void _sched_run();
 
-void _internal_callback(char* topic, byte* payload, unsigned int length) {
+// String adapter over the raw path: reserve once, then fill (no per-byte realloc).
+static void _string_adapter(const char* topic, size_t, const uint8_t* payload, size_t len) {
   if (_userCallback == NULL) return;
-  String msg = "";
-  for (int i=0; i<length; i++) msg += (char)payload[i];
-  _userCallback(String(topic), msg);
+  String msg;
+  msg.reserve(len);
+  for (size_t i=0; i<len; i++) msg += (char)payload[i];
+  _userCallback(String(topic), std::move(msg));
+}
+
+// Topic table, then registered handlers; the begin() callback only sees what none of them matched.
+inline void MqttPanel::_deliver(const char* topic, size_t topicLen, const uint8_t* payload, size_t length) {
+  if (_tbCount && _tb_dispatch(topic, topicLen, payload, length)) return;
+  if (_hdCount && _hd_dispatch(topic, topicLen, payload, length)) return;
+  if (_rawCallback) _rawCallback(topic, topicLen, payload, length);
+}
+
+// Client callbacks are plain function pointers: one trampoline per panel slot.
+template <int N>
+void MqttPanel::_rx(char* topic, uint8_t* payload, unsigned int length) {
+  if (N < MP_MAX_PANELS && _panels[N % MP_MAX_PANELS]) _panels[N % MP_MAX_PANELS]->_on_message(topic, payload, length);
+}
+
+// PubSubClient NUL-terminates the topic in its buffer; payload points right after it.
+void MqttPanel::_on_message(char* topic, uint8_t* payload, unsigned int length) {
+  size_t topicLen = strlen(topic);
+  if (_chunkAttached && _chunk_done(topic, topicLen, length)) return; // oversized: went out in chunks
+  if (_statsEvery && _is_stats_topic(topic, topicLen)) return; // our own $stats, echoed by <topic>/#
+  if (_brCount) _br_capture(topic, topicLen, payload, length);    // mirrored later, delivery goes on
+  if (!_mxOn) {
+    _deliver(topic, topicLen, payload, length);
+    return;
+  }
+  unsigned long t0 = micros();
+  _deliver(topic, topicLen, payload, length);
+  _mx_hist(_mx.rx, (uint32_t)(micros() - t0));
+  _mx.msgsIn++;
+  _mx.bytesIn += (uint32_t)(topicLen + length);
 }
 
 // ==========================================
 // 3. API IMPLEMENTATION
 // ==========================================
 
-void mqttpanel_begin(PubSubClient* client, MqttCallback cb, 
+void mqttpanel_begin(MpClient* client, MqttCallback cb, 
               char* srv, char* port, char* topic,
               int portal_sec, int factory_sec,
               int trigger_pin, int led_pin,
               int check_wifi_sec) 
 {
-  _client = client;
   _userCallback = cb;
-  _p_server = srv;
-  _p_port = port;
-  _p_topic = topic;
+  mqttpanel_begin(client, cb ? _string_adapter : (MqttRawCallback)NULL,
+                  srv, port, topic, portal_sec, factory_sec,
+                  trigger_pin, led_pin, check_wifi_sec);
+}
+
+void mqttpanel_begin(MpClient* client, MqttRawCallback cb,
+              char* srv, char* port, char* topic,
+              int portal_sec, int factory_sec,
+              int trigger_pin, int led_pin,
+              int check_wifi_sec)
+{
+  _cfg_server = srv;
+  _cfg_port = port;
+  _cfg_topic = topic;
   _portal_sec = portal_sec;
   _factory_sec = factory_sec;
   _trigger_pin = trigger_pin;
   _led_pin = led_pin;
   _check_wifi_sec = check_wifi_sec;
 
-  if (LittleFS.begin()) {
-     _loadConfig();
-  } else {
+  // Boot phases are timed for mqttpanel_boot_report()
+  memset(&_boot, 0, sizeof(_boot));
+  _bootStart = millis();
+  _bootReported = false;
+
+  bool mounted = LittleFS.begin();
+  if (!mounted) {
      #ifdef ESP32
      LittleFS.format();
      #endif
      LittleFS.begin();
   }
+  _boot.fsMountMs = millis() - _bootStart;
 
-  // Boot Button Check
-  if (digitalRead(_trigger_pin) == LOW) {
-    delay(2000);
-    if (digitalRead(_trigger_pin) == LOW) {
-       Serial.println("[MP] BOOT RESET TRIGGERED");
-       WiFiManager wm;
-       wm.resetSettings();
-       LittleFS.remove("/config.json");
-       for(int i=0;i<5;i++) { digitalWrite(_led_pin,!digitalRead(_led_pin)); delay(100); }
+  // Warm boot: binary record instead of parsing /config.json
+  unsigned long t = millis();
+  _recOk = false;
+  if (mounted) {
+     _recOk = _fastBoot && _loadBootRecord(&_rec);
+     if (_recOk) {
+        strlcpy(_cfg_server, _rec.server, 40);
+        strlcpy(_cfg_port, _rec.port, 6);
+        strlcpy(_cfg_topic, _rec.topic, 40);
+     } else {
+        _loadConfig();
+     }
+  }
+  _boot.configCached = _recOk;
+  _boot.configMs = millis() - t;
+
+  // Boot Button Check: one read, no wait. Handled before the WiFi step, which can sit in the portal
+  _btn_begin();
+  _btn_dispatch();
+
+  // Warm boot: join the cached BSSID/channel (no scan), reuse the IP lease (no DHCP)
+  t = millis();
+  _boot.wifiCached = _recOk && _fastWifi(_rec);
+
+  if (!_boot.wifiCached) {
+    WiFiManager wm;
+    wm.setCustomHeadElement(custom_style);
+    wm.setSaveConfigCallback(_saveConfigCallback);
+    
+    // Define Params with User Requested Placeholder
+    WiFiManagerParameter p_s("server", "MQTT Server", _cfg_server, 40, "placeholder='your mqtt broker address'");
+    WiFiManagerParameter p_p("port", "MQTT Port", _cfg_port, 6, "placeholder='1883'");
+    WiFiManagerParameter p_t("topic", "MQTT Topic", _cfg_topic, 40, "placeholder='topic/prefix'");
+    
+    wm.addParameter(&p_s); 
+    wm.addParameter(&p_p); 
+    wm.addParameter(&p_t);
+    wm.setConnectTimeout(30);
+
+    if (!wm.autoConnect("Antigravity_Setup")) {
        ESP.restart();
     }
+
+    strcpy(_cfg_server, p_s.getValue());
+    strcpy(_cfg_port, p_p.getValue());
+    strcpy(_cfg_topic, p_t.getValue());
+    
+    if (shouldSaveConfig) _saveConfig();
   }
+  _boot.wifiMs = millis() - t;
+  _bootWifiAt = millis();
 
-  WiFiManager wm;
-  wm.setCustomHeadElement(custom_style);
-  wm.setSaveConfigCallback(_saveConfigCallback);
-  
-  // Define Params with User Requested Placeholder
-  WiFiManagerParameter p_s("server", "MQTT Server", _p_server, 40, "placeholder='your mqtt broker address'");
-  WiFiManagerParameter p_p("port", "MQTT Port", _p_port, 6, "placeholder='1883'");
-  WiFiManagerParameter p_t("topic", "MQTT Topic", _p_topic, 40, "placeholder='topic/prefix'");
-  
-  wm.addParameter(&p_s); 
-  wm.addParameter(&p_p); 
-  wm.addParameter(&p_t);
-  wm.setConnectTimeout(30);
+  // Refresh the record after a normal-path join (only writes flash when something changed)
+  if (_fastBoot && !_boot.wifiCached) _saveBootRecord();
+
+  // CRITICAL FIX: Must update PubSubClient server address after config load!
+  int p = atoi(_cfg_port);
+  _main._attach(client, cb, _cfg_server, p > 0 ? (uint16_t)p : 0, _cfg_topic);
+  _main._outageStart = _bootStart; // the first connect is timed from boot
+}
 
-  if (!wm.autoConnect("Antigravity_Setup")) {
-     ESP.restart();
+bool MqttPanel::begin(MpClient* client, MqttRawCallback cb, const char* server, uint16_t port, const char* topic) {
+  if (!client || this == &_main) return false;
+  if (_slot < 0) {
+    for (int i = 1; i < MP_MAX_PANELS && _slot < 0; i++) {
+      if (!_panels[i]) _slot = (int8_t)i;
+    }
+    if (_slot < 0) return false;
   }
+  _attach(client, cb, server, port, topic);
+  return true;
+}
 
-  strcpy(_p_server, p_s.getValue());
-  strcpy(_p_port, p_p.getValue());
-  strcpy(_p_topic, p_t.getValue());
-  
-  if (shouldSaveConfig) _saveConfig();
+void MqttPanel::end() {
+  if (_slot <= 0) return; // the main panel goes with the device
+  if (_client && _client->connected()) _client->disconnect();
+  if (_sock) _sock->stop();
+  _panels[_slot] = NULL;
+  _slot = -1;
+  _client = NULL;
+  _connState = MP_CONN_WIFI_DOWN; // bridges into it hold their latest values, as in an outage
+}
+
+MqttPanel& mqttpanel_main() { return _main; }
+
+// Shared by mqttpanel_begin (after the portal / config load) and MqttPanel::begin
+void MqttPanel::_attach(MpClient* client, MqttRawCallback cb, const char* server, uint16_t port,
+                        const char* topic) {
+  static void (* const rx[4])(char*, uint8_t*, unsigned int) = { _rx<0>, _rx<1>, _rx<2>, _rx<3> };
+  if (this == &_main) _slot = 0;
+  _client = client;
+  _rawCallback = cb;
+  _p_server = server;
+  _port = port;
+  _p_topic = topic;
+  _chunkSink.owner = this;
+
+  memset(&_connStats, 0, sizeof(_connStats));
+  _connState = MP_CONN_WIFI_DOWN;
+  _outageStart = millis();
+  metrics_reset();
+  _sf_open();
+  _panels[_slot] = this;
 
   if (_client) {
-     _client->setCallback(_internal_callback);
-     // CRITICAL FIX: Must update PubSubClient server address after config load!
-     int p = atoi(_p_port);
-     if (p > 0) _client->setServer(_p_server, p);
+     _client->setCallback(rx[_slot]);
+     if (_chunkFn && !_chunkAttached) { _client->setStream(_chunkSink); _chunkAttached = true; }
+     if (_port > 0) _client->setServer(_p_server, _port);
+     // CONNACK wait is bounded by the socket timeout (seconds, default 15)
+     _client->setSocketTimeout((_policy.connectTimeoutMs + 999) / 1000);
+     _client->setKeepAlive(_policy.keepAliveSec);
   }
 }
 
+// The pass is cut into slices; tasks that fell due meanwhile run between them.
 void mqttpanel_loop() {
-  // 1. Check Button Logic
-  static unsigned long pressStart = 0;
-  if (digitalRead(_trigger_pin) == LOW) {
-    if (pressStart == 0) pressStart = millis();
-    unsigned long durWait = millis() - pressStart;
-    if (durWait > _factory_sec * 1000) digitalWrite(_led_pin, (millis()/50)%2);
-    else if (durWait > _portal_sec * 1000) digitalWrite(_led_pin, (millis()/200)%2);
-    
-  } else {
-    if (pressStart > 0) {
-       unsigned long duration = (millis() - pressStart) / 1000; 
-       pressStart = 0;
-       
-       if (duration >= _factory_sec) {
-          Serial.println("[MP] FACTORY RESET!");
-          WiFiManager wm;
-          wm.resetSettings();
-          LittleFS.remove("/config.json");
-          ESP.restart();
-       } 
-       else if (duration >= _portal_sec) {
-          _startPortal("Antigravity_OnDemand");
-       }
+  unsigned long t0 = micros();
+  uint64_t start = _sched_now();
+  if (_loopStartAt) _mx_hist(_sched.period, (uint32_t)(start - _loopStartAt));
+  _loopStartAt = start;
+  _sched_run();
+
+  // 1. Button: nothing to do unless the ISR saw an edge or an event is waiting
+  if (_btnPolled && (digitalRead(_trigger_pin) == LOW) != _btnRaw) {
+    _btnRaw = !_btnRaw;
+    _btnEdges++;
+  }
+  if (_btnEdges != _btnSeen) _btn_edge();
+  _sched_run();
+  if (_btnCount) _btn_dispatch();
+
+  // 2-5 for every broker, the main panel first
+  for (int i = 0; i < MP_MAX_PANELS; i++) {
+    if (_panels[i]) _panels[i]->_service(t0);
+  }
+}
+
+void MqttPanel::_service(unsigned long t0) {
+  // Direct LAN commands first: they must not wait behind a blocking connect attempt
+  if (_lan) _lan_poll();
+
+  // 2. WiFi & MQTT Watchdog (one bounded step per loop, see _conn_step)
+  unsigned long t = micros();
+  _conn_step();
+  unsigned long ioUs = micros() - t;
+  if (ioUs > _sched.ioMaxUs) _sched.ioMaxUs = (uint32_t)ioUs;
+  _sched_run();
+
+  // 3. Backlog from the last outage (rate limited); optional work, yields to the loop budget
+  bool overBudget = _loopBudgetUs && micros() - t0 >= _loopBudgetUs;
+  if (_connState == MP_CONN_ONLINE && !_txOpen) {
+    if (overBudget && _sf_pending()) {
+      _sched.deferred++;
+    } else {
+      t = micros();
+      _sf_replay();
+      unsigned long us = micros() - t;
+      if (us > _sched.replayMaxUs) _sched.replayMaxUs = (uint32_t)us;
+      overBudget = _loopBudgetUs && micros() - t0 >= _loopBudgetUs;
     }
   }
 
-  // 2. WiFi & MQTT Watchdog
-  static unsigned long lastWiFiCheck = 0;
-  
-  if (WiFi.status() == WL_CONNECTED) {
-     lastWiFiCheck = millis(); // Refresh timestamp because WiFi is OK
-     
-     if (_client) {
-        if (!_client->connected()) {
-            static unsigned long lastTry = 0;
-            static int retryCount = 0;
-            
-            if (millis() - lastTry > 5000) {
-              lastTry = millis();
-              Serial.println("[MQTT] Connecting...");
-              
-              String id = "ESP-" + String(random(0xffff), HEX);
-              if (_client->connect(id.c_str())) {
-                  Serial.println("[MQTT] Connected!");
-                  mqttpanel_sub(String(_p_topic) + "/#");
-                  retryCount = 0;
-              } else {
-                  Serial.print("[MQTT] Failed rc=");
-                  Serial.println(_client->state());
-                  retryCount++;
-                  
-                  if (retryCount >= 5) {
-                    Serial.println("\n[MP] MQTT Failure Limit Reached. Opening Portal...");
-                    _startPortal("Antigravity_Fix");
-                  }
-              }
-            }
-        } else {
-            _client->loop();
-        }
-     }
-  } else {
-      // WiFi IS DOWN
-      // Dynamic Check using _check_wifi_sec
-      unsigned long timeout = (unsigned long)_check_wifi_sec * 1000;
-      if (millis() - lastWiFiCheck > timeout) {
-          Serial.println("\n[MP] WiFi Failure (" + String(_check_wifi_sec) + "s). Opening Portal...");
-          _startPortal("Antigravity_Fix");
-          lastWiFiCheck = millis(); // Reset
-      }
+  // 4. Metrics (+ periodic <topic>/$stats)
+  if (_mxOn) {
+    unsigned long t1 = micros(); // one clock read: the histogram and the heap sample share it
+    _mx.loops++;
+    _mx_hist(_mx.loop, (uint32_t)(t1 - t0));
+    if (t1 - _mxHeapAt >= MP_HEAP_SAMPLE_MS * 1000UL) _mx_heap();
+    if (_statsEvery && _connState == MP_CONN_ONLINE && !_txOpen && millis() - _statsAt >= _statsEvery) {
+      if (overBudget) _sched.deferred++;
+      else _mx_publish();
+    }
+  }
+
+  // Bridged topics whose interval is up go to the other panel's send buffer (flushed below or in its own slice)
+  if (_brCount) _br_service();
+
+#ifdef MP_NATIVE_MQTT
+  // 5. Everything this pass queued (pubs, acks, replay) goes out in one socket write
+  if (_client && _connState == MP_CONN_ONLINE) _client->flush();
+#endif
+}
+
+// --- Button / LED ---
+static void IRAM_ATTR _btn_isr() { _btnEdges++; }
+
+static void _btn_settle(void*);
+static void _btn_hold(void*);
+
+static bool _btn_arm(uint32_t ms, MpTaskFn fn) {
+  if (_btnTimer >= 0) mqttpanel_cancel(_btnTimer);
+  _btnTimer = mqttpanel_after(ms, fn);
+  return _btnTimer >= 0;
+}
+
+static void _btn_queue(MpButtonKind kind, uint32_t heldMs) {
+  if (_btnCount == MP_BTN_QUEUE) {
+    _btnStats.dropped++;
+    return;
+  }
+  MpButtonEvent& ev = _btnQueue[(_btnHead + _btnCount) % MP_BTN_QUEUE];
+  ev.kind = kind;
+  ev.heldMs = heldMs;
+  _btnCount++;
+  _btnStats.events++;
+}
+
+// Next hold threshold for the pressed button, if any is left
+static void _btn_plan() {
+  uint32_t held = (uint32_t)(millis() - _btnDownAt);
+  uint32_t next = UINT32_MAX;
+  if (_btnState == MP_BTN_DOWN && (uint32_t)_portal_sec * 1000 < next) next = (uint32_t)_portal_sec * 1000;
+  if (_btnState <= MP_BTN_HELD_PORTAL && (uint32_t)_factory_sec * 1000 < next) next = (uint32_t)_factory_sec * 1000;
+  if (next == UINT32_MAX) return;
+  _btn_arm(next > held ? next - held : 0, _btn_hold);
+}
+
+static void _btn_press() {
+  _btnState = MP_BTN_DOWN;
+  _btnDownAt = _btnEdgeAt;
+  _btn_plan();
+}
+
+static void _btn_release() {
+  uint32_t held = (uint32_t)(_btnEdgeAt - _btnDownAt);
+  uint8_t s = _btnState;
+  _btnState = MP_BTN_UP;
+  if (_ledOverride) {
+    _ledOverride = false;
+    _led_play(_ledUser);
   }
+  if (s == MP_BTN_SPENT) return; // its event went out while it was held
+  MpButtonKind kind = MP_BTN_CLICK;
+  if (held >= (uint32_t)_factory_sec * 1000) kind = MP_BTN_FACTORY;
+  else if (held >= (uint32_t)_portal_sec * 1000) kind = MP_BTN_PORTAL;
+  _btn_queue(kind, held);
 }
 
-void mqttpanel_pub(String topic, String payload) {
-  if (_client && _client->connected()) _client->publish(topic.c_str(), payload.c_str());
+// Debounce timer: the level has been quiet for MP_BTN_DEBOUNCE_MS
+static void _btn_settle(void*) {
+  _btnTimer = -1;
+  bool down = digitalRead(_trigger_pin) == LOW;
+  bool changed = down != (_btnState != MP_BTN_UP);
+  uint16_t n = _btnPending;
+  _btnPending = 0;
+  if (n > (changed ? 1 : 0)) _btnStats.bounces += n - (changed ? 1 : 0);
+  if (!changed) {
+    if (down) _btn_plan(); // the glitch cancelled the hold timer
+    return;
+  }
+  if (down) _btn_press();
+  else _btn_release();
 }
 
-void mqttpanel_sub(String topic) {
+// Hold timer: a threshold was reached while the button is still down
+static void _btn_hold(void*) {
+  _btnTimer = -1;
+  uint32_t held = (uint32_t)(millis() - _btnDownAt);
+  uint8_t s = _btnState;
+  if (s < MP_BTN_HELD_FACTORY && held >= (uint32_t)_factory_sec * 1000) s = MP_BTN_HELD_FACTORY;
+  else if (s < MP_BTN_HELD_PORTAL && held >= (uint32_t)_portal_sec * 1000) s = MP_BTN_HELD_PORTAL;
+  if (s != _btnState) {
+    _btnState = s;
+    _ledOverride = true;
+    _led_play(s == MP_BTN_HELD_FACTORY ? MP_LED_FAST : MP_LED_SLOW);
+  }
+  _btn_plan();
+}
+
+static void _btn_begin() {
+  if (_btnTimer >= 0) mqttpanel_cancel(_btnTimer);
+  _btnTimer = -1;
+  _btnHead = _btnCount = 0;
+  _btnPending = 0;
+  _btnState = MP_BTN_UP;
+  int irq = digitalPinToInterrupt(_trigger_pin);
+  _btnPolled = irq < 0;
+  if (!_btnPolled) attachInterrupt(irq, _btn_isr, CHANGE);
+  _btnSeen = _btnEdges;
+  _btnRaw = digitalRead(_trigger_pin) == LOW;
+  if (_btnRaw) { // held at power-on: the event is raised now, releasing it raises nothing more
+    _btnState = MP_BTN_SPENT;
+    _btnDownAt = millis();
+    _btn_queue(MP_BTN_BOOT_RESET, 0);
+  }
+}
+
+// Every edge pushes the debounce timer back; it reads the pin once things are quiet
+static void _btn_edge() {
+  uint16_t e = _btnEdges;
+  if (!_btn_arm(MP_BTN_DEBOUNCE_MS, _btn_settle)) return; // scheduler full: retry next loop
+  if (_btnPending == 0) _btnEdgeAt = millis();
+  _btnPending += (uint16_t)(e - _btnSeen);
+  _btnStats.edges += (uint16_t)(e - _btnSeen);
+  _btnSeen = e;
+}
+
+static void _factory_reset(bool blink) {
+  WiFiManager wm;
+  wm.resetSettings();
+  LittleFS.remove("/config.json");
+  LittleFS.remove(MP_BOOT_FILE);
+  if (blink) {
+    for(int i=0;i<5;i++) { digitalWrite(_led_pin,!digitalRead(_led_pin)); delay(100); }
+  }
+  ESP.restart();
+}
+
+// Events run here, outside the timers: the defaults block (portal) or restart
+static void _btn_dispatch() {
+  while (_btnCount) {
+    MpButtonEvent ev = _btnQueue[_btnHead];
+    _btnHead = (_btnHead + 1) % MP_BTN_QUEUE;
+    _btnCount--;
+    if (_btnFn && _btnFn(ev, _btnArg)) continue;
+    if (ev.kind == MP_BTN_PORTAL) {
+       _startPortal("Antigravity_OnDemand");
+    } else if (ev.kind == MP_BTN_FACTORY) {
+       Serial.println("[MP] FACTORY RESET!");
+       _factory_reset(false);
+    } else if (ev.kind == MP_BTN_BOOT_RESET) {
+       Serial.println("[MP] BOOT RESET TRIGGERED");
+       _factory_reset(true);
+    }
+  }
+}
+
+void mqttpanel_on_button(MpButtonHandler fn, void* arg) {
+  _btnFn = fn;
+  _btnArg = arg;
+}
+
+void mqttpanel_button_stats(MpButtonStats* out) {
+  if (out) *out = _btnStats;
+}
+
+// Only a change of level is written
+static void _led_step(void*) {
+  uint32_t was = (_led.bits >> _ledStep) & 1;
+  _ledStep = _ledStep + 1 < _led.steps ? _ledStep + 1 : 0;
+  uint32_t on = (_led.bits >> _ledStep) & 1;
+  if (on != was) digitalWrite(_led_pin, on ? HIGH : LOW);
+}
+
+static void _led_play(const MpLedPattern& p) {
+  if (_ledTask >= 0) mqttpanel_cancel(_ledTask);
+  _ledTask = -1;
+  _led = p;
+  if (_led.steps > 32) _led.steps = 32;
+  _ledStep = 0;
+  digitalWrite(_led_pin, (_led.bits & 1) ? HIGH : LOW);
+  if (_led.steps > 1 && _led.stepMs) _ledTask = mqttpanel_every(_led.stepMs, _led_step);
+}
+
+void mqttpanel_led(const MpLedPattern& pattern) {
+  _ledUser = pattern;
+  if (!_ledOverride) _led_play(pattern);
+}
+
+void MqttPanel::pub(String topic, String payload) { _pub(topic, payload, false); }
+
+void MqttPanel::pub_latest(String topic, String payload) { _pub(topic, payload, true); }
+
+void MqttPanel::_pub(const String& topic, const String& payload, bool latest) {
+  if (_lan) _lan_val(topic.c_str(), topic.length(), payload.c_str(), payload.length()); // LAN first: lowest latency
+  if (!_client) return;
+  // Online with nothing waiting: send now. Otherwise queue behind the backlog (keeps order);
+  // a streaming publish in progress owns the socket until mqttpanel_pub_end().
+  if (_client->connected() && !_sf_pending() && !_txOpen) {
+    if (_client->publish(topic.c_str(), payload.c_str())) {
+      _mx_out(topic.length(), payload.length());
+      return;
+    }
+    if (_client->connected()) { // refused with the link up (e.g. bigger than the client buffer): a retry fails too
+      _sfStats.dropped++;
+      return;
+    }
+    // the link died during the write: replay it with the backlog
+  }
+  _sf_enqueue(topic.c_str(), payload.c_str(), latest);
+}
+
+void MqttPanel::sub(String topic) {
   if (_client && _client->connected()) {
     _client->subscribe(topic.c_str());
     Serial.println("[Sub] " + topic);
   }
 }
 
+void mqttpanel_pub(String topic, String payload) { _main.pub(std::move(topic), std::move(payload)); }
+void mqttpanel_pub_latest(String topic, String payload) { _main.pub_latest(std::move(topic), std::move(payload)); }
+void mqttpanel_sub(String topic) { _main.sub(std::move(topic)); }
+
 bool mqttpanel_is_connected() {
   return (WiFi.status() == WL_CONNECTED);
 }
 
+// --- Large Payloads ---
+bool MqttPanel::pub_begin(const char* topic, size_t len, bool retained) {
+  if (!_client || !topic || _txOpen || !_client->connected()) return false;
+  if (!_client->beginPublish(topic, (unsigned int)len, retained)) return false;
+  _txOpen = true;
+  _txFailed = false;
+  _txLeft = _txLen = len;
+  _txTopicLen = strlen(topic);
+  return true;
+}
+
+size_t MqttPanel::pub_write(const uint8_t* data, size_t n) {
+  if (!_txOpen || _txFailed || !data) return 0;
+  if (n > _txLeft) n = _txLeft; // never past the announced length
+  size_t w = _client->write(data, n);
+  if (w < n) _txFailed = true;
+  _txLeft -= w;
+  return w;
+}
+
+bool MqttPanel::pub_end() {
+  if (!_txOpen) return false;
+  _txOpen = false;
+  bool ok = _client->endPublish() && !_txFailed && _txLeft == 0;
+  if (ok) {
+    _mx_out(_txTopicLen, _txLen);
+  } else {
+    // The broker is still waiting for the rest of the announced payload: anything
+    // sent next would be read as part of it. Drop the session; the state machine reconnects.
+    Serial.println("[MQTT] Stream publish cut short, reconnecting");
+    _client->disconnect();
+  }
+  return ok;
+}
+
+bool MqttPanel::pub_stream(const char* topic, Stream& src, size_t len, bool retained) {
+  if (!pub_begin(topic, len, retained)) return false;
+  uint8_t buf[MP_CHUNK_BYTES];
+  while (_txLeft) {
+    size_t n = src.readBytes((char*)buf, _txLeft < sizeof(buf) ? _txLeft : sizeof(buf));
+    if (n == 0 || pub_write(buf, n) < n) break;
+  }
+  return pub_end();
+}
+
+bool mqttpanel_pub_begin(const char* topic, size_t len, bool retained) { return _main.pub_begin(topic, len, retained); }
+size_t mqttpanel_pub_write(const uint8_t* data, size_t n) { return _main.pub_write(data, n); }
+bool mqttpanel_pub_end() { return _main.pub_end(); }
+bool mqttpanel_pub_stream(const char* topic, Stream& src, size_t len, bool retained) {
+  return _main.pub_stream(topic, src, len, retained);
+}
+
+bool MqttPanel::on_chunks(MpChunkHandler fn, void* arg) {
+  if (fn && _client && _client->getBufferSize() > MP_CHUNK_BYTES) return false; // see MpChunkSink
+  _chunkFn = fn;
+  _chunkArg = arg;
+  _chunkSink.owner = this;
+  _chunkSink.reset();
+  if (fn && _client && !_chunkAttached) {
+    _client->setStream(_chunkSink);
+    _chunkAttached = true;
+  }
+  return true;
+}
+
+bool mqttpanel_on_chunks(MpChunkHandler fn, void* arg) { return _main.on_chunks(fn, arg); }
+
+size_t MqttPanel::MpChunkSink::write(uint8_t c) {
+  if (used == sizeof(buf)) {
+    if (owner->_chunkFn) owner->_chunkFn(NULL, 0, buf, used, offset, 0, false, owner->_chunkArg);
+    offset += used;
+    used = 0;
+  }
+  buf[used++] = c;
+  return 1;
+}
+
+// Called with every PUBLISH: the sink holds the tail of this payload. More bytes
+// than the callback got means PubSubClient cut it, so it belongs to the chunk handler.
+bool MqttPanel::_chunk_done(const char* topic, size_t topicLen, size_t len) {
+  size_t total = _chunkSink.offset + _chunkSink.used;
+  bool cut = total > len;
+  if (cut && _chunkFn) {
+    _chunkFn(topic, topicLen, _chunkSink.buf, _chunkSink.used, _chunkSink.offset, total, true, _chunkArg);
+  }
+  _chunkSink.reset();
+  return cut;
+}
+
+// --- MQTT Connection State Machine ---
+void MqttPanel::conn_policy(const MpConnPolicy& policy) {
+  _policy = policy;
+  if (_policy.backoffMinMs == 0) _policy.backoffMinMs = 1;
+  if (_policy.backoffMaxMs < _policy.backoffMinMs) _policy.backoffMaxMs = _policy.backoffMinMs;
+  if (_policy.jitterPct > 100) _policy.jitterPct = 100;
+  if (_client) {
+    _client->setSocketTimeout((_policy.connectTimeoutMs + 999) / 1000);
+    _client->setKeepAlive(_policy.keepAliveSec);
+  }
+}
+
+void MqttPanel::conn_stats(MpConnStats* out) {
+  if (!out) return;
+  *out = _connStats;
+  out->state = _connState;
+  long wait = (long)(_nextTry - millis());
+  out->nextRetryMs = (_connState == MP_CONN_BACKOFF && wait > 0) ? (uint32_t)wait : 0;
+}
+
+void mqttpanel_conn_policy(const MpConnPolicy& policy) { _main.conn_policy(policy); }
+void mqttpanel_conn_socket(WiFiClient* sock) { _main.conn_socket(sock); }
+void mqttpanel_conn_stats(MpConnStats* out) { _main.conn_stats(out); }
+
+// backoffMin * 2^(streak-1), capped at backoffMax, then +-jitterPct
+unsigned long MqttPanel::_backoff_ms(uint8_t streak) {
+  unsigned long d = _policy.backoffMinMs;
+  for (uint8_t i = 1; i < streak && d < _policy.backoffMaxMs; i++) d *= 2;
+  if (d > _policy.backoffMaxMs) d = _policy.backoffMaxMs;
+  long span = (long)(d * _policy.jitterPct / 100);
+  if (span > 0) d = (unsigned long)((long)d + random(-span, span + 1));
+  return d;
+}
+
+void MqttPanel::_conn_failed() {
+  _connStats.failures++;
+  if (_connStats.streak < 255) _connStats.streak++;
+  _connStats.lastRc = _client->state();
+  Serial.print("[MQTT] Failed rc=");
+  Serial.println(_connStats.lastRc);
+  if (_sock) _sock->stop();
+
+  bool byCount = _policy.portalAfterFailures && _connStats.streak >= _policy.portalAfterFailures;
+  bool byTime = _policy.portalAfterMs && millis() - _outageStart >= _policy.portalAfterMs;
+  if ((byCount || byTime) && this == &_main) { // the portal only edits the main broker
+    Serial.println("\n[MP] MQTT Failure Limit Reached. Opening Portal...");
+    _startPortal("Antigravity_Fix");
+  }
+
+  _nextTry = millis() + _backoff_ms(_connStats.streak);
+  _connState = MP_CONN_BACKOFF;
+}
+
+void MqttPanel::_conn_online() {
+  unsigned long took = millis() - _outageStart;
+  _connStats.connects++;
+  if (_connStats.connects > 1 && _mxOn) _mx.reconnects++;
+  _connStats.streak = 0;
+  _connStats.lastReconnectMs = took;
+  if (took > _connStats.maxReconnectMs) _connStats.maxReconnectMs = took;
+  _connState = MP_CONN_ONLINE;
+  _chunkSink.reset(); // a message cut by the drop never reached the callback
+  Serial.println("[MQTT] Connected!");
+  sub(String(_p_topic) + "/#");
+
+  if (!_bootReported && this == &_main) {
+    _bootReported = true;
+    _boot.mqttMs = millis() - _bootWifiAt;
+    _boot.totalMs = millis() - _bootStart;
+    Serial.printf("[MP] Boot: fs %lu ms, config %lu ms (%s), wifi %lu ms (%s), mqtt %lu ms, total %lu ms\n",
+                  (unsigned long)_boot.fsMountMs, (unsigned long)_boot.configMs, _boot.configCached ? "bin" : "json",
+                  (unsigned long)_boot.wifiMs, _boot.wifiCached ? "cached" : "scan",
+                  (unsigned long)_boot.mqttMs, (unsigned long)_boot.totalMs);
+  }
+}
+
+void MqttPanel::_conn_step() {
+  if (WiFi.status() != WL_CONNECTED) {
+    // WiFi IS DOWN
+    if (_connState == MP_CONN_ONLINE) _outageStart = millis();
+    if (_connState != MP_CONN_WIFI_DOWN && _sock) _sock->stop();
+    _connState = MP_CONN_WIFI_DOWN;
+    // Dynamic Check using _check_wifi_sec
+    unsigned long timeout = (unsigned long)_check_wifi_sec * 1000;
+    if (this == &_main && _policy.portalOnWifiLoss && millis() - _wifiOkAt > timeout) {
+      Serial.println("\n[MP] WiFi Failure (" + String(_check_wifi_sec) + "s). Opening Portal...");
+      _startPortal("Antigravity_Fix");
+      _wifiOkAt = millis(); // Reset
+    }
+    return;
+  }
+  _wifiOkAt = millis(); // Refresh timestamp because WiFi is OK
+  if (!_client) return;
+
+  unsigned long t0 = millis();
+  switch (_connState) {
+    case MP_CONN_WIFI_DOWN:
+      _connState = MP_CONN_BACKOFF; // WiFi just came back: try right away
+      _nextTry = millis();
+      break;
+
+    case MP_CONN_ONLINE:
+      if (_client->connected()) {
+        _client->loop();
+        return;
+      }
+      Serial.println("[MQTT] Connection lost");
+      _outageStart = millis();
+      _connState = MP_CONN_BACKOFF;
+      _nextTry = millis() + _backoff_ms(1);
+      break;
+
+    case MP_CONN_BACKOFF:
+      if ((long)(millis() - _nextTry) < 0) return;
+      _connStats.attempts++;
+      Serial.println("[MQTT] Connecting...");
+      _connState = _sock ? MP_CONN_TCP : MP_CONN_MQTT;
+      break;
+
+    case MP_CONN_TCP: {
+      // Own step with its own timeout; PubSubClient::connect() reuses the open socket.
+#ifdef ESP32
+      bool ok = _sock->connect(_p_server, _port > 0 ? _port : 1883, (int32_t)_policy.connectTimeoutMs);
+#else
+      _sock->setTimeout(_policy.connectTimeoutMs);
+      bool ok = _sock->connect(_p_server, _port > 0 ? _port : 1883);
+#endif
+      if (ok) _connState = MP_CONN_MQTT;
+      else _conn_failed();
+      break;
+    }
+
+    case MP_CONN_MQTT: {
+      String id = "ESP-" + String(random(0xffff), HEX);
+      if (_client->connect(id.c_str())) _conn_online();
+      else _conn_failed();
+      break;
+    }
+  }
+  unsigned long blocked = millis() - t0;
+  if (blocked > _connStats.maxBlockMs) _connStats.maxBlockMs = blocked;
+}
+
+// --- Store-and-Forward ---
+void MqttPanel::sf_config(uint16_t replayPerSec, uint32_t spillMaxBytes) {
+  _sfPerSec = replayPerSec ? replayPerSec : 1;
+  _sfSpillMax = spillMaxBytes;
+}
+
+void MqttPanel::sf_stats(MpSfStats* out) {
+  if (!out) return;
+  *out = _sfStats;
+  out->ramUsed = _sfUsed;
+  out->spillBytes = _sfSpillSize - _sfSpillRead;
+}
+
+void mqttpanel_sf_config(uint16_t replayPerSec, uint32_t spillMaxBytes) { _main.sf_config(replayPerSec, spillMaxBytes); }
+void mqttpanel_sf_stats(MpSfStats* out) { _main.sf_stats(out); }
+
+// Empty ring; messages spooled before a reboot are replayed too
+void MqttPanel::_sf_open() {
+  if (_slot == 0) strlcpy(_sfFile, MP_SPOOL_FILE, sizeof(_sfFile));
+  else snprintf(_sfFile, sizeof(_sfFile), "/mp_spool%d.bin", _slot);
+  _sfHead = _sfUsed = _sfRecs = 0;
+  _sfStats.queued = 0;
+  _sfSpillSize = 0;
+  _sfSpillRead = 0;
+  if (LittleFS.exists(_sfFile)) {
+     File f = LittleFS.open(_sfFile, "r");
+     if (f) _sfSpillSize = f.size();
+     f.close();
+  }
+}
+
+static uint16_t _sf_pos(uint32_t pos) { return (uint16_t)(pos % MP_SF_RAM_BYTES); }
+
+void MqttPanel::_sf_put(uint16_t pos, const void* src, uint16_t n) {
+  uint16_t first = (uint16_t)(MP_SF_RAM_BYTES - pos);
+  if (first > n) first = n;
+  memcpy(_sfRing + pos, src, first);
+  memcpy(_sfRing, (const uint8_t*)src + first, n - first);
+}
+
+void MqttPanel::_sf_get(uint16_t pos, void* dst, uint16_t n) {
+  uint16_t first = (uint16_t)(MP_SF_RAM_BYTES - pos);
+  if (first > n) first = n;
+  memcpy(dst, _sfRing + pos, first);
+  memcpy((uint8_t*)dst + first, _sfRing, n - first);
+}
+
+// Write n ring bytes starting at pos to any Print (the spool file or the MQTT client)
+void MqttPanel::_sf_write(Print& out, uint16_t pos, uint16_t n) {
+  uint16_t first = (uint16_t)(MP_SF_RAM_BYTES - pos);
+  if (first > n) first = n;
+  out.write(_sfRing + pos, first);
+  if (n > first) out.write(_sfRing, n - first);
+}
+
+bool MqttPanel::_sf_pending() {
+  return _sfRecs > 0 || _sfSpillRead < _sfSpillSize;
+}
+
+// Remove the oldest ring record; spool it if allowed and there is room, else count it dropped
+void MqttPanel::_sf_pop(bool spill) {
+  uint8_t h[4];
+  _sf_get(_sfHead, h, 4);
+  uint16_t len = (uint16_t)(4 + h[1] + (h[2] | (h[3] << 8)));
+
+  if (spill && _sfSpillMax && _sfSpillSize + len <= _sfSpillMax) {
+    File f = LittleFS.open(_sfFile, "a");
+    if (f) {
+      _sf_write(f, _sfHead, len);
+      _sfSpillSize += len;
+      if (_sfSpillSize - _sfSpillRead > _sfStats.spillPeak) _sfStats.spillPeak = _sfSpillSize - _sfSpillRead;
+    } else {
+      _sfStats.dropped++;
+    }
+    f.close();
+  } else if (spill) {
+    _sfStats.dropped++;
+  }
+  _sfStats.queued--;
+  _sfHead = _sf_pos((uint32_t)_sfHead + len);
+  _sfUsed -= len;
+  _sfRecs--;
+}
+
+// Cut len bytes at pos out of the ring: everything after it moves up (wraps as needed)
+void MqttPanel::_sf_cut(uint16_t pos, uint16_t len) {
+  uint16_t off = _sf_pos((uint32_t)pos + MP_SF_RAM_BYTES - _sfHead); // distance from the oldest byte
+  uint16_t tail = (uint16_t)(_sfUsed - off - len);                  // bytes after the cut
+  uint8_t buf[32];
+  for (uint16_t done = 0; done < tail;) {
+    uint16_t n = (uint16_t)(tail - done);
+    if (n > sizeof(buf)) n = sizeof(buf);
+    _sf_get(_sf_pos((uint32_t)pos + len + done), buf, n);
+    _sf_put(_sf_pos((uint32_t)pos + done), buf, n);
+    done += n;
+  }
+  _sfUsed -= len;
+  _sfRecs--;
+}
+
+// Latest-only: remove the older record of the same topic (at most one exists)
+void MqttPanel::_sf_collapse(const char* topic, uint8_t tl) {
+  uint16_t pos = _sfHead;
+  for (uint16_t k = 0; k < _sfRecs; k++) {
+    uint8_t h[4];
+    _sf_get(pos, h, 4);
+    uint16_t pl = (uint16_t)(h[2] | (h[3] << 8));
+    if (h[0] == MP_SF_LATEST && h[1] == tl) {
+      char t[256];
+      _sf_get(_sf_pos((uint32_t)pos + 4), t, tl);
+      if (memcmp(t, topic, tl) == 0) {
+        _sf_cut(pos, (uint16_t)(4 + tl + pl));
+        _sfStats.queued--;
+        _sfStats.collapsed++;
+        return;
+      }
+    }
+    pos = _sf_pos((uint32_t)pos + 4 + h[1] + pl);
+  }
+}
+
+void MqttPanel::_sf_enqueue(const char* topic, const char* payload, bool latest) {
+  size_t tl = strlen(topic);
+  size_t pl = strlen(payload);
+  size_t need = 4 + tl + pl;
+  if (tl > 255 || need > MP_SF_RAM_BYTES) { _sfStats.dropped++; return; }
+
+  if (latest) _sf_collapse(topic, (uint8_t)tl);
+  while ((size_t)(MP_SF_RAM_BYTES - _sfUsed) < need) _sf_pop(true); // make room: spool or drop the oldest
+
+  uint8_t h[4] = { (uint8_t)(latest ? MP_SF_LATEST : 0), (uint8_t)tl, (uint8_t)(pl & 0xFF), (uint8_t)(pl >> 8) };
+  uint16_t pos = _sf_pos((uint32_t)_sfHead + _sfUsed);
+  _sf_put(pos, h, 4);
+  _sf_put(_sf_pos((uint32_t)pos + 4), topic, (uint16_t)tl);
+  _sf_put(_sf_pos((uint32_t)pos + 4 + tl), payload, (uint16_t)pl);
+  _sfUsed += (uint16_t)need;
+  _sfRecs++;
+  _sfStats.queued++;
+  _sfStats.buffered++;
+  if (_sfUsed > _sfStats.ramPeak) _sfStats.ramPeak = _sfUsed;
+}
+
+// Oldest spooled record -> MQTT, payload streamed from the file in small chunks
+bool MqttPanel::_sf_send_spooled() {
+  File f = LittleFS.open(_sfFile, "r");
+  uint8_t h[4];
+  if (!f || !f.seek(_sfSpillRead) || f.read(h, 4) != 4) return false; // flash I/O error: retry next replay
+  uint16_t pl = (uint16_t)(h[2] | (h[3] << 8));
+  if (_sfSpillRead + 4 + h[1] + pl > _sfSpillSize) {
+    // Header points past what was spooled: the file is corrupt, give up on it rather than loop forever
+    f.close();
+    LittleFS.remove(_sfFile);
+    _sfSpillSize = _sfSpillRead = 0;
+    return true;
+  }
+  char topic[256];
+  if (f.read((uint8_t*)topic, h[1]) != h[1]) return false;
+  topic[h[1]] = '\0';
+  bool sent = false;
+  if (_client->beginPublish(topic, pl, false)) {
+    uint8_t buf[64];
+    uint16_t left = pl;
+    while (left > 0) {
+      size_t n = f.read(buf, left < sizeof(buf) ? left : sizeof(buf));
+      if (n == 0) break;
+      _client->write(buf, n);
+      left -= (uint16_t)n;
+    }
+    if (left > 0) {
+      // Read failed mid-payload: the broker already has a partial packet, so the connection
+      // can't be reused. Drop it; the record stays first in the spool for the next connection.
+      _client->disconnect();
+      return false;
+    }
+    sent = _client->endPublish() == 1;
+  }
+  f.close();
+  if (sent) _mx_out(h[1], pl);
+  if (!sent && !_client->connected()) return false; // keep it for the next connection
+  _sfSpillRead += 4 + h[1] + pl;
+  if (_sfSpillRead >= _sfSpillSize) {
+    LittleFS.remove(_sfFile);
+    _sfSpillSize = _sfSpillRead = 0;
+  }
+  return true;
+}
+
+bool MqttPanel::_sf_send_ram() {
+  uint8_t h[4];
+  _sf_get(_sfHead, h, 4);
+  uint8_t tl = h[1];
+  uint16_t pl = (uint16_t)(h[2] | (h[3] << 8));
+  char topic[256];
+  _sf_get(_sf_pos((uint32_t)_sfHead + 4), topic, tl);
+  topic[tl] = '\0';
+  if (!_client->beginPublish(topic, pl, false)) return false;
+  _sf_write(*_client, _sf_pos((uint32_t)_sfHead + 4 + tl), pl);
+  bool sent = _client->endPublish() == 1;
+  if (!sent) return false; // link went down mid-record: it stays at the head for the next connection
+  _mx_out(tl, pl);
+  _sf_pop(false);
+  return true;
+}
+
+void MqttPanel::_sf_replay() {
+  unsigned long now = millis();
+  unsigned long dt = now - _sfRefillAt;
+  _sfRefillAt = now;
+  if (!_sf_pending()) return;
+
+  if (dt > 10000) dt = 10000;
+  _sfCredit += (uint32_t)dt * _sfPerSec; // ms * msgs/s = 1/1000 msgs
+  if (_sfCredit > MP_SF_BURST * 1000UL) _sfCredit = MP_SF_BURST * 1000UL;
+
+  while (_sfCredit >= 1000 && _sf_pending()) {
+    if (_sfReplayN == 0) _sfReplayStart = now;
+    bool ok = (_sfSpillRead < _sfSpillSize) ? _sf_send_spooled() : _sf_send_ram();
+    if (!ok) return;
+    _sfCredit -= 1000;
+    _sfReplayN++;
+    _sfStats.replayed++;
+  }
+  if (!_sf_pending() && _sfReplayN > 0) {
+    unsigned long ms = millis() - _sfReplayStart;
+    _sfStats.replayMsgsPerSec = ms ? (uint32_t)((uint64_t)_sfReplayN * 1000 / ms) : _sfReplayN;
+    _sfReplayN = 0;
+  }
+}
+
+// --- Metrics ---
+void MqttPanel::metrics(MpMetrics* out) {
+  if (!out) return;
+  *out = _mx;
+  out->uptimeMs = millis();
+}
+
+void MqttPanel::metrics_reset() {
+  memset(&_mx, 0, sizeof(_mx));
+  _mx_heap();
+}
+
+void MqttPanel::stats_interval(uint32_t ms) {
+  _statsEvery = ms;
+  _statsAt = millis();
+}
+
+void mqttpanel_metrics(MpMetrics* out) { _main.metrics(out); }
+void mqttpanel_metrics_reset() { _main.metrics_reset(); }
+void mqttpanel_metrics_enable(bool on) { _main.metrics_enable(on); }
+void mqttpanel_stats_interval(uint32_t ms) { _main.stats_interval(ms); }
+
+uint32_t mqttpanel_hist_percentile(const MpHist& h, uint8_t pct) {
+  uint32_t total = 0;
+  for (int i = 0; i < MP_HIST_BUCKETS; i++) total += h.count[i];
+  if (total == 0) return 0;
+  uint32_t want = (uint32_t)(((uint64_t)total * pct + 99) / 100);
+  if (want == 0) want = 1;
+  uint32_t seen = 0;
+  for (int i = 0; i < MP_HIST_BUCKETS; i++) {
+    seen += h.count[i];
+    if (seen < want) continue;
+    uint32_t top = (i == MP_HIST_BUCKETS - 1) ? h.maxUs : (64UL << i);
+    return top < h.maxUs ? top : h.maxUs;
+  }
+  return h.maxUs;
+}
+
+// Bucket 0: < 64 us; bucket i: < 64 << i us; the last one is open-ended
+static void _mx_hist(MpHist& h, uint32_t us) {
+  int i = 0;
+  if (us >= 64) {
+    i = 32 - __builtin_clz(us) - 6;
+    if (i >= MP_HIST_BUCKETS) i = MP_HIST_BUCKETS - 1;
+  }
+  h.count[i]++;
+  if (us > h.maxUs) h.maxUs = us;
+}
+
+void MqttPanel::_mx_out(size_t topicLen, size_t len) {
+  if (!_mxOn) return;
+  _mx.msgsOut++;
+  _mx.bytesOut += (uint32_t)(topicLen + len);
+}
+
+void MqttPanel::_mx_heap() {
+  _mxHeapAt = micros();
+  uint32_t freeHeap = ESP.getFreeHeap();
+#ifdef ESP32
+  uint32_t block = ESP.getMaxAllocHeap();
+  uint32_t low = ESP.getMinFreeHeap(); // tracked by the IDF allocator, exact between samples
+#else
+  uint32_t block = ESP.getMaxFreeBlockSize();
+  uint32_t low = freeHeap;
+#endif
+  _mx.heapFree = freeHeap;
+  _mx.blockMax = block;
+  if (_mx.heapMin == 0 || low < _mx.heapMin) _mx.heapMin = low;
+  if (_mx.blockMin == 0 || block < _mx.blockMin) _mx.blockMin = block;
+}
+
+bool MqttPanel::_is_stats_topic(const char* topic, size_t len) {
+  size_t n = _p_topic ? strlen(_p_topic) : 0;
+  return len == n + sizeof(MP_STATS_SUFFIX) - 1 && memcmp(topic, _p_topic, n) == 0 &&
+         memcmp(topic + n, MP_STATS_SUFFIX, sizeof(MP_STATS_SUFFIX) - 1) == 0;
+}
+
+// Streamed with beginPublish: the document is longer than PubSubClient's default buffer
+void MqttPanel::_mx_publish() {
+  _statsAt = millis();
+  _mx_heap();
+  char topic[48];
+  snprintf(topic, sizeof(topic), "%s" MP_STATS_SUFFIX, _p_topic ? _p_topic : "");
+  char buf[320];
+  int n = snprintf(buf, sizeof(buf),
+    "{\"up\":%lu,\"loops\":%lu,\"in\":%lu,\"out\":%lu,\"inB\":%lu,\"outB\":%lu,\"rc\":%lu,"
+    "\"heap\":%lu,\"heapMin\":%lu,\"blk\":%lu,\"blkMin\":%lu,\"loop\":[%lu,%lu,%lu],\"rx\":[%lu,%lu,%lu]}",
+    (unsigned long)(millis() / 1000), (unsigned long)_mx.loops,
+    (unsigned long)_mx.msgsIn, (unsigned long)_mx.msgsOut, (unsigned long)_mx.bytesIn, (unsigned long)_mx.bytesOut,
+    (unsigned long)_mx.reconnects, (unsigned long)_mx.heapFree, (unsigned long)_mx.heapMin,
+    (unsigned long)_mx.blockMax, (unsigned long)_mx.blockMin,
+    (unsigned long)mqttpanel_hist_percentile(_mx.loop, 50), (unsigned long)mqttpanel_hist_percentile(_mx.loop, 99),
+    (unsigned long)_mx.loop.maxUs,
+    (unsigned long)mqttpanel_hist_percentile(_mx.rx, 50), (unsigned long)mqttpanel_hist_percentile(_mx.rx, 99),
+    (unsigned long)_mx.rx.maxUs);
+  if (n <= 0 || n >= (int)sizeof(buf)) return;
+  if (!_client->beginPublish(topic, (unsigned int)n, false)) return;
+  _client->write((const uint8_t*)buf, (size_t)n);
+  if (_client->endPublish()) _mx_out(strlen(topic), (size_t)n);
+}
+
+// --- Scheduler ---
+static uint64_t _sched_now() {
+  static uint32_t last = 0;
+  static uint64_t high = 0;
+  uint32_t now = (uint32_t)micros();
+  if (now < last) high += 1ULL << 32;
+  last = now;
+  return high | now;
+}
+
+static void _sched_plan() {
+  _schedNext = UINT64_MAX;
+  for (int i = 0; i < MP_MAX_TASKS; i++) {
+    if (_tasks[i].fn && _tasks[i].due < _schedNext) _schedNext = _tasks[i].due;
+  }
+}
+
+static int _sched_add(uint32_t delayMs, uint32_t periodMs, MpTaskFn fn, void* arg, uint32_t budgetUs) {
+  if (!fn) return -1;
+  for (int i = 0; i < MP_MAX_TASKS; i++) {
+    MpTask& t = _tasks[i];
+    if (t.fn) continue;
+    t.gen++;
+    t.fn = fn;
+    t.arg = arg;
+    t.periodUs = periodMs * 1000UL;
+    t.budgetUs = budgetUs;
+    t.due = _sched_now() + (uint64_t)delayMs * 1000;
+    memset(&t.st, 0, sizeof(t.st));
+    _taskCount++;
+    if (t.due < _schedNext) _schedNext = t.due;
+    return i + MP_MAX_TASKS * t.gen;
+  }
+  return -1;
+}
+
+static MpTask* _sched_task(int id) {
+  if (id < 0) return NULL;
+  MpTask& t = _tasks[id % MP_MAX_TASKS];
+  return t.gen == (uint16_t)(id / MP_MAX_TASKS) ? &t : NULL;
+}
+
+int mqttpanel_every(uint32_t periodMs, MpTaskFn fn, void* arg, uint32_t budgetUs) {
+  if (periodMs == 0) periodMs = 1;
+  return _sched_add(periodMs, periodMs, fn, arg, budgetUs);
+}
+
+int mqttpanel_after(uint32_t delayMs, MpTaskFn fn, void* arg, uint32_t budgetUs) {
+  return _sched_add(delayMs, 0, fn, arg, budgetUs);
+}
+
+void mqttpanel_cancel(int id) {
+  MpTask* t = _sched_task(id);
+  if (!t || !t->fn) return;
+  t->fn = NULL;
+  t->gen++; // the id is dead even for mqttpanel_task_stats
+  _taskCount--;
+  _sched_plan();
+}
+
+bool mqttpanel_task_stats(int id, MpTaskStats* out) {
+  MpTask* t = _sched_task(id);
+  if (!t || !out) return false;
+  *out = t->st;
+  return true;
+}
+
+void mqttpanel_loop_budget(uint32_t us) { _loopBudgetUs = us; }
+
+void mqttpanel_sched_stats(MpSchedStats* out) {
+  if (out) *out = _sched;
+}
+
+// Runs every task that is due, earliest deadline first, each at most once per
+// call: a task slower than its own period cannot starve the MQTT slices.
+static void _sched_run() {
+  if (_taskCount == 0) return;
+  uint64_t now = _sched_now();
+  if (now < _schedNext) return;
+
+  uint32_t due = 0;
+  for (int i = 0; i < MP_MAX_TASKS; i++) {
+    if (_tasks[i].fn && _tasks[i].due <= now) due |= 1UL << i;
+  }
+  while (due) {
+    int k = -1;
+    for (int i = 0; i < MP_MAX_TASKS; i++) {
+      if ((due & (1UL << i)) && (k < 0 || _tasks[i].due < _tasks[k].due)) k = i;
+    }
+    due &= ~(1UL << k);
+    MpTask& t = _tasks[k];
+    if (!t.fn || t.due > now) continue; // cancelled (or the slot reused) by an earlier task in this pass
+
+    uint64_t start = _sched_now();
+    _mx_hist(t.st.late, (uint32_t)(start - t.due));
+    MpTaskFn fn = t.fn;
+    void* arg = t.arg;
+    uint16_t gen = t.gen;
+    if (t.periodUs) {
+      t.due += t.periodUs;
+      if (t.due <= start) { // a whole period or more behind: skip, do not burst
+        uint64_t n = (start - t.due) / t.periodUs + 1;
+        t.due += n * t.periodUs;
+        t.st.skipped += (uint32_t)n;
+      }
+    } else {
+      t.fn = NULL; // one-shot: slot is free before it runs, so it can re-arm itself
+      _taskCount--;
+    }
+
+    fn(arg);
+
+    uint32_t took = (uint32_t)(_sched_now() - start);
+    if (t.gen != gen) continue; // cancelled itself
+    t.st.runs++;
+    t.st.lastUs = took;
+    if (took > t.st.maxUs) t.st.maxUs = took;
+    if (t.budgetUs && took > t.budgetUs) {
+      t.st.overruns++;
+      _sched.overruns++;
+    }
+  }
+  _sched_plan();
+}
+
+// --- Topic Handlers ---
+struct MqttPanel::MpMatchMsg {
+  const char* topic;
+  size_t topicLen;
+  const uint8_t* payload;
+  size_t len;
+  const char* rel;                      // topic with the <topic>/ prefix stripped
+  size_t relLen;
+  uint8_t hits;
+};
+
+// Splits the pattern level [s, s+n) into kind; false = '+' / '#' mixed with text.
+static bool _hd_kind(const char* s, size_t n, uint8_t* kind) {
+  if (n == 1 && s[0] == '+') { *kind = MP_LVL_PLUS; return true; }
+  if (n == 1 && s[0] == '#') { *kind = MP_LVL_HASH; return true; }
+  *kind = MP_LVL_TEXT;
+  return !memchr(s, '+', n) && !memchr(s, '#', n);
+}
+
+uint8_t MqttPanel::_hd_find(uint8_t first, uint8_t kind, const char* s, size_t n) {
+  for (uint8_t c = first; c; c = _hdNodes[c - 1].next) {
+    const MpMatchNode& d = _hdNodes[c - 1];
+    if (d.kind == kind && (kind != MP_LVL_TEXT || (d.len == n && memcmp(_hdText + d.text, s, n) == 0))) return c;
+  }
+  return 0;
+}
+
+// Level text is interned: "set" under 24 channels is stored once.
+int MqttPanel::_hd_intern(const char* s, size_t n, bool dryRun) {
+  for (size_t i = 0; i + n <= _hdTextUsed; i++) {
+    if (memcmp(_hdText + i, s, n) == 0) return (int)i;
+  }
+  if (_hdTextUsed + n > MP_MATCH_TEXT) return -1;
+  if (dryRun) return -2;
+  memcpy(_hdText + _hdTextUsed, s, n);
+  _hdTextUsed = (uint16_t)(_hdTextUsed + n);
+  return _hdTextUsed - (int)n;
+}
+
+bool MqttPanel::on(const char* pattern, MpTopicHandler fn, void* arg) {
+  if (!pattern || !fn || _hdCount >= MP_MAX_HANDLERS) return false;
+  size_t len = strlen(pattern);
+
+  // Pass 1: validate and count what is missing, so a full pool never leaves half a path behind.
+  uint8_t parent = 0;
+  bool exists = true;
+  size_t newNodes = 0, newText = 0;
+  for (size_t pos = 0;;) {
+    const char* slash = (const char*)memchr(pattern + pos, '/', len - pos);
+    size_t n = slash ? (size_t)(slash - pattern) - pos : len - pos;
+    uint8_t kind;
+    if (n > 255 || !_hd_kind(pattern + pos, n, &kind)) return false;
+    if (kind == MP_LVL_HASH && slash) return false; // '#' must be the last level
+    uint8_t c = exists ? _hd_find(parent ? _hdNodes[parent - 1].child : _hdRoot, kind, pattern + pos, n) : 0;
+    if (!c) {
+      exists = false;
+      newNodes++;
+      int at = kind == MP_LVL_TEXT ? _hd_intern(pattern + pos, n, true) : 0;
+      if (at == -1) return false;
+      if (at == -2) newText += n;
+    }
+    parent = c;
+    if (!slash) break;
+    pos += n + 1;
+  }
+  if (_hdNodeCount + newNodes > MP_MATCH_NODES || _hdTextUsed + newText > MP_MATCH_TEXT) return false;
+
+  // Pass 2: insert, keeping siblings ordered literal, '+', '#' (dispatch order).
+  parent = 0;
+  for (size_t pos = 0;;) {
+    const char* slash = (const char*)memchr(pattern + pos, '/', len - pos);
+    size_t n = slash ? (size_t)(slash - pattern) - pos : len - pos;
+    uint8_t kind;
+    _hd_kind(pattern + pos, n, &kind);
+    uint8_t* head = parent ? &_hdNodes[parent - 1].child : &_hdRoot;
+    uint8_t c = _hd_find(*head, kind, pattern + pos, n);
+    if (!c) {
+      MpMatchNode& d = _hdNodes[_hdNodeCount];
+      c = ++_hdNodeCount;
+      d.kind = kind;
+      d.len = (uint8_t)n;
+      d.text = kind == MP_LVL_TEXT ? (uint16_t)_hd_intern(pattern + pos, n, false) : 0;
+      d.child = 0;
+      d.handler = 0;
+      uint8_t* link = head;
+      while (*link && _hdNodes[*link - 1].kind <= kind) link = &_hdNodes[*link - 1].next;
+      d.next = *link;
+      *link = c;
+    }
+    parent = c;
+    if (!slash) break;
+    pos += n + 1;
+  }
+
+  MpHandler& h = _handlers[_hdCount];
+  h.fn = fn;
+  h.arg = arg;
+  h.next = 0;
+  uint8_t* link = &_hdNodes[parent - 1].handler; // same pattern twice: both run, in registration order
+  while (*link) link = &_handlers[*link - 1].next;
+  *link = ++_hdCount;
+  return true;
+}
+
+void MqttPanel::on_clear() {
+  _hdNodeCount = 0;
+  _hdCount = 0;
+  _hdTextUsed = 0;
+  _hdRoot = 0;
+}
+
+bool mqttpanel_on(const char* pattern, MpTopicHandler fn, void* arg) { return _main.on(pattern, fn, arg); }
+void mqttpanel_on_clear() { _main.on_clear(); }
+
+void MqttPanel::_hd_fire(uint8_t node, MpMatchMsg& m) {
+  for (uint8_t h = _hdNodes[node - 1].handler; h; h = _handlers[h - 1].next) {
+    _handlers[h - 1].fn(m.topic, m.topicLen, m.payload, m.len, _handlers[h - 1].arg);
+    m.hits++;
+  }
+}
+
+// No levels left: only a trailing '#' still matches ("a/#" matches "a").
+void MqttPanel::_hd_end(uint8_t c, MpMatchMsg& m) {
+  for (; c; c = _hdNodes[c - 1].next) {
+    if (_hdNodes[c - 1].kind == MP_LVL_HASH) _hd_fire(c, m);
+  }
+}
+
+// Matches the level starting at pos against the siblings from c.
+void MqttPanel::_hd_level(uint8_t c, size_t pos, MpMatchMsg& m) {
+  const char* s = m.rel + pos;
+  const char* slash = (const char*)memchr(s, '/', m.relLen - pos);
+  size_t n = slash ? (size_t)(slash - s) : m.relLen - pos;
+  bool sys = pos == 0 && n > 0 && s[0] == '$'; // wildcards never match a leading $ level
+  for (; c; c = _hdNodes[c - 1].next) {
+    const MpMatchNode& d = _hdNodes[c - 1];
+    if (d.kind == MP_LVL_TEXT) {
+      if (d.len != n || memcmp(_hdText + d.text, s, n) != 0) continue;
+    } else if (sys) {
+      continue;
+    }
+    if (d.kind == MP_LVL_HASH) { _hd_fire(c, m); continue; }
+    if (slash) _hd_level(d.child, pos + n + 1, m);
+    else { _hd_fire(c, m); _hd_end(d.child, m); }
+  }
+}
+
+// Strips the <topic>/ prefix; topics outside <topic> are returned whole.
+void MqttPanel::_rel_topic(const char* topic, size_t topicLen, const char** rel, size_t* relLen) {
+  *rel = topic;
+  *relLen = topicLen;
+  size_t n = _p_topic ? strlen(_p_topic) : 0;
+  if (n > 0 && topicLen > n && memcmp(topic, _p_topic, n) == 0) {
+    if (_p_topic[n - 1] == '/') { *rel = topic + n; *relLen = topicLen - n; }         // generated sketches keep a trailing '/'
+    else if (topic[n] == '/') { *rel = topic + n + 1; *relLen = topicLen - n - 1; }
+  }
+}
+
+bool MqttPanel::_hd_dispatch(const char* topic, size_t topicLen, const uint8_t* payload, size_t len) {
+  MpMatchMsg m = { topic, topicLen, payload, len, topic, topicLen, 0 };
+  _rel_topic(topic, topicLen, &m.rel, &m.relLen);
+  _hd_level(_hdRoot, 0, m);
+  return m.hits > 0;
+}
+
+bool mqttpanel_topic_level(const char* topic, size_t topicLen, int index, const char** level, size_t* levelLen) {
+  if (!topic || !level || !levelLen) return false;
+  int count = 1;
+  for (size_t i = 0; i < topicLen; i++) count += topic[i] == '/';
+  if (index < 0) index += count;
+  if (index < 0 || index >= count) return false;
+  size_t start = 0;
+  for (int k = 0; k < index; k++) start = (const char*)memchr(topic + start, '/', topicLen - start) - topic + 1;
+  const char* slash = (const char*)memchr(topic + start, '/', topicLen - start);
+  *level = topic + start;
+  *levelLen = slash ? (size_t)(slash - *level) : topicLen - start;
+  return true;
+}
+
+// --- Topic Table ---
+void MqttPanel::table(const MpTopicEntry* table, size_t count) {
+  _tb = count ? table : NULL;
+  _tbCount = table ? count : 0;
+}
+
+void mqttpanel_table(const MpTopicEntry* table, size_t count) { _main.table(table, count); }
+
+static int _tb_int(const uint8_t* p, size_t n) {
+  size_t i = 0;
+  bool neg = n > 0 && p[0] == '-';
+  if (neg || (n > 0 && p[0] == '+')) i++;
+  long v = 0;
+  for (; i < n && p[i] >= '0' && p[i] <= '9'; i++) {
+    int d = p[i] - '0';
+    if (v > (INT_MAX - d) / 10) { v = INT_MAX; break; } // saturate: long is only 32 bits on the ESP
+    v = v * 10 + d;
+  }
+  return (int)(neg ? -v : v);
+}
+
+// rel is the tail of the NUL-terminated topic in the client buffer, so strcmp_P can run on it.
+bool MqttPanel::_tb_dispatch(const char* topic, size_t topicLen, const uint8_t* payload, size_t len) {
+  const char* rel;
+  size_t relLen;
+  _rel_topic(topic, topicLen, &rel, &relLen);
+  if (relLen >= MP_TABLE_TOPIC) return false;
+  size_t lo = 0, hi = _tbCount;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    int c = strcmp_P(rel, _tb[mid].topic);
+    if (c == 0) {
+      MpTopicEntry e;
+      memcpy_P(&e, &_tb[mid], sizeof(e));
+      switch (e.kind) {
+        case MP_TOPIC_SWITCH: *(bool*)e.var = len == 1 && payload[0] == '1'; break;
+        case MP_TOPIC_DIMMER: *(int*)e.var = _tb_int(payload, len); break;
+        case MP_TOPIC_NUMBER: {
+          char num[24];
+          size_t n = len < sizeof(num) - 1 ? len : sizeof(num) - 1;
+          memcpy(num, payload, n);
+          num[n] = '\0';
+          *(float*)e.var = strtof(num, NULL);
+          break;
+        }
+        case MP_TOPIC_TEXT: {
+          String& s = *(String*)e.var;
+          s = "";
+          s.concat((const char*)payload, (unsigned)len);
+          break;
+        }
+        case MP_TOPIC_CALL: break;
+      }
+      if (e.fn) e.fn(topic, topicLen, payload, len, e.var);
+      return true;
+    }
+    if (c < 0) hi = mid;
+    else lo = mid + 1;
+  }
+  return false;
+}
+
+// --- Bridge ---
+// MQTT filter match on the relative topic: "+" = one level, "#" = the rest (and the parent level).
+static bool _br_match(const char* f, const char* t, size_t n) {
+  if (n > 0 && t[0] == '$' && (f[0] == '+' || f[0] == '#')) return false;
+  size_t i = 0;
+  for (;;) {
+    if (f[0] == '#') return true;
+    const char* fe = strchr(f, '/');
+    size_t fl = fe ? (size_t)(fe - f) : strlen(f);
+    size_t te = i;
+    while (te < n && t[te] != '/') te++;
+    bool plus = fl == 1 && f[0] == '+';
+    if (!plus && (fl != te - i || memcmp(f, t + i, fl) != 0)) return false;
+    if (te == n) return !fe || strcmp(fe, "/#") == 0;
+    if (!fe) return false;
+    f = fe + 1;
+    i = te + 1;
+  }
+}
+
+bool MqttPanel::bridge(MqttPanel& to, const char* pattern, uint32_t intervalMs) {
+  if (!pattern || &to == this || _brCount >= MP_BRIDGE_RULES) return false;
+  _brRules[_brCount++] = { pattern, &to, intervalMs };
+  return true;
+}
+
+void MqttPanel::bridge_clear() {
+  _brCount = 0;
+  memset(_brSlots, 0, sizeof(_brSlots));
+}
+
+void MqttPanel::bridge_stats(MpBridgeStats* out) {
+  if (out) *out = _brStats;
+}
+
+// Inbound side: remember the newest value per topic, nothing is sent here.
+void MqttPanel::_br_capture(const char* topic, size_t topicLen, const uint8_t* payload, size_t len) {
+  const char* rel;
+  size_t relLen;
+  _rel_topic(topic, topicLen, &rel, &relLen);
+  uint8_t r = 0;
+  while (r < _brCount && !_br_match(_brRules[r].pattern, rel, relLen)) r++;
+  if (r == _brCount) return;
+  _brStats.seen++;
+  if (relLen >= MP_BRIDGE_TOPIC || len > MP_BRIDGE_PAYLOAD) { _brStats.dropped++; return; }
+
+  MpBridgeSlot* slot = NULL;
+  MpBridgeSlot* empty = NULL;
+  for (int i = 0; i < MP_BRIDGE_SLOTS && !slot; i++) {
+    MpBridgeSlot& b = _brSlots[i];
+    if (!b.topic[0]) { if (!empty) empty = &b; continue; }
+    if (strncmp(b.topic, rel, relLen) == 0 && b.topic[relLen] == '\0') slot = &b;
+  }
+  if (!slot) {
+    if (!empty) { _brStats.dropped++; return; }
+    slot = empty;
+    memcpy(slot->topic, rel, relLen);
+    slot->topic[relLen] = '\0';
+    slot->dirty = false;
+    slot->sentAt = millis() - _brRules[r].intervalMs; // a new topic goes out right away
+  }
+  if (slot->dirty) _brStats.coalesced++;
+  memcpy(slot->payload, payload, len);
+  slot->len = (uint8_t)len;
+  slot->rule = r;
+  slot->dirty = true;
+}
+
+// Outbound side: due values go to the other panel as <its topic>/<relative topic>.
+// While it is offline they stay dirty, so it gets the latest one when it is back.
+void MqttPanel::_br_service() {
+  unsigned long now = millis();
+  for (int i = 0; i < MP_BRIDGE_SLOTS; i++) {
+    MpBridgeSlot& b = _brSlots[i];
+    if (!b.dirty) continue;
+    const MpBridgeRule& rule = _brRules[b.rule];
+    MqttPanel& to = *rule.to;
+    if (now - b.sentAt < rule.intervalMs) continue;
+    if (!to.connected() || to._txOpen || to._sf_pending()) continue;
+    const char* head = to._p_topic ? to._p_topic : "";
+    size_t hl = strlen(head);
+    char topic[MP_BRIDGE_TOPIC + 48];
+    int n = snprintf(topic, sizeof(topic), hl && head[hl - 1] != '/' ? "%s/%s" : "%s%s", head, b.topic);
+    if (n <= 0 || n >= (int)sizeof(topic)) { b.dirty = false; _brStats.dropped++; continue; }
+    if (!to._client->publish(topic, b.payload, b.len)) continue;
+    to._mx_out((size_t)n, b.len);
+    b.dirty = false;
+    b.sentAt = now;
+    _brStats.forwarded++;
+  }
+}
+
+// --- LAN Control ---
+// One UDP socket, text lines "<rel topic> <payload>". Peers are whoever sent a
+// datagram within MP_LAN_PEER_TTL_MS; /val publishes go to each of them.
+#define MP_LAN_BURST 8                 // datagrams per loop() at most
+#define MP_LAN_TOPIC 128               // full topic built for dispatch
+
+bool MqttPanel::lan_begin(WiFiUDP* udp, uint16_t port) {
+  lan_end();
+  if (!udp || !udp->begin(port)) return false;
+  _lan = udp;
+  return true;
+}
+
+void MqttPanel::lan_end() {
+  if (_lan) _lan->stop();
+  _lan = NULL;
+  _lanHeld = 0;
+  memset(_lanPeers, 0, sizeof(_lanPeers));
+}
+
+void MqttPanel::lan_stats(MpLanStats* out) {
+  if (!out) return;
+  *out = _lanStats;
+  out->peers = 0;
+  for (int i = 0; i < MP_LAN_PEERS; i++) {
+    if (_lanPeers[i].ip && millis() - _lanPeers[i].seenAt < MP_LAN_PEER_TTL_MS) out->peers++;
+  }
+}
+
+bool mqttpanel_lan_begin(WiFiUDP* udp, uint16_t port) { return _main.lan_begin(udp, port); }
+void mqttpanel_lan_end() { _main.lan_end(); }
+void mqttpanel_lan_stats(MpLanStats* out) { _main.lan_stats(out); }
+
+void MqttPanel::_lan_poll() {
+  char pkt[MP_LAN_PACKET + 1];
+  for (int k = 0; k < MP_LAN_BURST; k++) {
+    int size = _lanHeld ? _lanHeld : _lan->parsePacket();
+    _lanHeld = 0;
+    if (size <= 0) return;
+    if (size > MP_LAN_PACKET) { _lanStats.bad++; continue; } // parsePacket() drops the rest on the next call
+
+    // Sender becomes (or stays) a peer; a new one replaces a free, expired or the stalest slot
+    uint32_t ip = _lan->remoteIP();
+    uint16_t port = _lan->remotePort();
+    unsigned long now = millis();
+    MpLanPeer* peer = NULL;
+    MpLanPeer* spare = &_lanPeers[0];
+    for (int i = 0; i < MP_LAN_PEERS; i++) {
+      MpLanPeer& p = _lanPeers[i];
+      if (p.ip == ip && p.port == port) { peer = &p; break; }
+      if (spare->ip && (!p.ip || now - p.seenAt > now - spare->seenAt)) spare = &p;
+    }
+    if (!peer) peer = spare;
+    peer->ip = ip;
+    peer->port = port;
+    peer->seenAt = now;
+
+    int n = _lan->read(pkt, MP_LAN_PACKET);
+    if (n <= 0) continue;
+    pkt[n] = '\0';
+    for (char* line = pkt; line < pkt + n;) {
+      char* end = (char*)memchr(line, '\n', (size_t)(pkt + n - line));
+      size_t len = end ? (size_t)(end - line) : (size_t)(pkt + n - line);
+      if (len && line[len - 1] == '\r') line[--len] = '\0';
+      if (len && !(len == 1 && line[0] == '?')) _lan_line(line, len);
+      if (!end) break;
+      line = end + 1;
+    }
+  }
+}
+
+// "<rel>/set <payload>": dispatched as <topic>/<rel>/set, exactly like a broker message
+void MqttPanel::_lan_line(char* line, size_t n) {
+  char* sp = (char*)memchr(line, ' ', n);
+  size_t rl = sp ? (size_t)(sp - line) : n;
+  const char* head = _p_topic ? _p_topic : "";
+  size_t hl = strlen(head);
+  bool slash = hl && head[hl - 1] != '/';
+  if (rl < 4 || memcmp(line + rl - 4, "/set", 4) != 0 || hl + slash + rl >= MP_LAN_TOPIC) {
+    _lanStats.bad++;
+    return;
+  }
+  char topic[MP_LAN_TOPIC];
+  memcpy(topic, head, hl);
+  if (slash) topic[hl] = '/';
+  memcpy(topic + hl + slash, line, rl);
+  topic[hl + slash + rl] = '\0';
+  uint8_t* payload = sp ? (uint8_t*)sp + 1 : (uint8_t*)line + n;
+  _lanStats.cmds++;
+  _on_message(topic, payload, (unsigned int)(line + n - (char*)payload));
+}
+
+// Called by pub / pub_latest: <topic>/.../val goes to every live peer as "<rel> <payload>"
+void MqttPanel::_lan_val(const char* topic, size_t topicLen, const char* payload, size_t len) {
+  if (topicLen < 4 || memcmp(topic + topicLen - 4, "/val", 4) != 0) return;
+  const char* rel;
+  size_t relLen;
+  _rel_topic(topic, topicLen, &rel, &relLen);
+  if (rel == topic) return; // not under <topic>
+  unsigned long now = millis();
+  for (int i = 0; i < MP_LAN_PEERS; i++) {
+    const MpLanPeer& p = _lanPeers[i];
+    if (!p.ip || now - p.seenAt >= MP_LAN_PEER_TTL_MS) continue;
+    _lan->beginPacket(IPAddress(p.ip), p.port);
+    _lan->write((const uint8_t*)rel, relLen);
+    _lan->write((uint8_t)' ');
+    _lan->write((const uint8_t*)payload, len);
+    if (_lan->endPacket()) _lanStats.vals++;
+  }
+}
+
+// --- Idle ---
+static inline uint32_t _idle_until(unsigned long due, unsigned long now) {
+  return (long)(due - now) > 0 ? (uint32_t)(due - now) : 0;
+}
+
+// Milliseconds until this panel has time-driven work: connect steps, keepalive, replay credit, $stats, bridge
+uint32_t MqttPanel::_idle_ms(unsigned long now) {
+  if (_txOpen) return 0;
+  uint32_t ms = UINT32_MAX;
+  switch (_connState) {
+    case MP_CONN_WIFI_DOWN:
+      ms = MP_IDLE_OFFLINE_MS;
+      break;
+    case MP_CONN_BACKOFF:
+      ms = _idle_until(_nextTry, now);
+      break;
+    case MP_CONN_TCP:
+    case MP_CONN_MQTT:
+      return 0;
+    case MP_CONN_ONLINE:
+#ifdef MP_NATIVE_MQTT
+      ms = _client ? _client->pingDueMs() : UINT32_MAX;
+#else
+      // PubSubClient keeps its last-activity times private: loop() often enough that a ping is never late by much
+      if (_policy.keepAliveSec) ms = _policy.keepAliveSec * 250UL;
+#endif
+      if (_sf_pending()) {
+        uint32_t need = _sfCredit >= 1000 ? 0 : (1000 - _sfCredit + _sfPerSec - 1) / _sfPerSec;
+        uint32_t w = _idle_until(_sfRefillAt + need, now);
+        if (w < ms) ms = w;
+      }
+      if (_mxOn && _statsEvery) {
+        uint32_t w = _idle_until(_statsAt + _statsEvery, now);
+        if (w < ms) ms = w;
+      }
+      break;
+  }
+  // Bridged values wait for their interval; a busy or disconnected target wakes us through its own deadline
+  for (int i = 0; i < MP_BRIDGE_SLOTS && _brCount; i++) {
+    const MpBridgeSlot& b = _brSlots[i];
+    if (!b.dirty) continue;
+    MqttPanel* to = _brRules[b.rule].to;
+    if (!to->connected() || to->_txOpen || to->_sf_pending()) continue;
+    uint32_t w = _idle_until(b.sentAt + _brRules[b.rule].intervalMs, now);
+    if (w < ms) ms = w;
+  }
+  return ms;
+}
+
+// Something arrived: MQTT bytes (or the socket closed), or a LAN datagram (kept for _lan_poll)
+bool MqttPanel::_idle_io() {
+  if (_sock && _connState == MP_CONN_ONLINE && (_sock->available() > 0 || !_sock->connected())) return true;
+  if (_lan && !_lanHeld) {
+    int n = _lan->parsePacket();
+    if (n > 0) _lanHeld = n;
+  }
+  return _lanHeld > 0;
+}
+
+static bool _idle_button() {
+  if (_btnEdges != _btnSeen || _btnCount) return true;
+  return _btnPolled && (digitalRead(_trigger_pin) == LOW) != _btnRaw;
+}
+
+uint32_t mqttpanel_idle_deadline() {
+  if (_idle_button()) return 0;
+  uint32_t ms = UINT32_MAX;
+  if (_taskCount) {
+    uint64_t now = _sched_now();
+    uint64_t w = _schedNext <= now ? 0 : (_schedNext - now + 999) / 1000;
+    ms = w < UINT32_MAX ? (uint32_t)w : UINT32_MAX;
+  }
+  unsigned long now = millis();
+  for (int i = 0; i < MP_MAX_PANELS && ms; i++) {
+    if (!_panels[i]) continue;
+    uint32_t w = _panels[i]->_idle_ms(now);
+    if (w < ms) ms = w;
+  }
+  return ms;
+}
+
+// Sleeps in delay() slices: the cores only save power inside delay(), and an
+// interrupt cannot cut it short, so the wake sources are checked between slices.
+uint32_t mqttpanel_idle(uint32_t maxMs, uint16_t sliceMs) {
+  unsigned long start = millis();
+  if (!_idleStarted) {
+    _idleStarted = true;
+    _idleSince = start;
+  }
+  if (sliceMs == 0) sliceMs = 1;
+  uint32_t ms = mqttpanel_idle_deadline();
+  if (ms > maxMs) ms = maxMs;
+  for (int i = 0; i < MP_MAX_PANELS; i++) {
+    // online without a socket to watch: inbound messages can only be noticed by looping
+    if (_panels[i] && _panels[i]->_connState == MP_CONN_ONLINE && !_panels[i]->_sock && ms > sliceMs) ms = sliceMs;
+  }
+
+  uint32_t* why = &_idle.wakeTimer;
+  for (;;) {
+    if (_idle_button()) { why = &_idle.wakeButton; break; }
+    bool io = false;
+    for (int i = 0; i < MP_MAX_PANELS && !io; i++) io = _panels[i] && _panels[i]->_idle_io();
+    if (io) { why = &_idle.wakeIo; break; }
+    unsigned long slept = millis() - start;
+    if (slept >= ms) break;
+    uint32_t left = ms - (uint32_t)slept;
+    delay(left < sliceMs ? left : sliceMs);
+  }
+
+  uint32_t slept = (uint32_t)(millis() - start);
+  if (slept == 0) {
+    _idle.skipped++;
+    return 0;
+  }
+  _idle.sleeps++;
+  _idle.sleptMs += slept;
+  if (slept > _idle.maxSleepMs) _idle.maxSleepMs = slept;
+  (*why)++;
+  return slept;
+}
+
+void mqttpanel_idle_stats(MpIdleStats* out) {
+  if (!out) return;
+  *out = _idle;
+  uint32_t total = _idleStarted ? (uint32_t)(millis() - _idleSince) : 0;
+  out->awakeMs = total > _idle.sleptMs ? total - _idle.sleptMs : 0;
+  out->awakePct = total ? (uint8_t)((uint64_t)out->awakeMs * 100 / total) : 100;
+}
+
+void mqttpanel_idle_stats_reset() {
+  memset(&_idle, 0, sizeof(_idle));
+  _idleStarted = true;
+  _idleSince = millis();
+}
+
 // --- Config Helpers ---
 void _loadConfig() {
   if (LittleFS.exists("/config.json")) {
@@ -280,9 +1990,9 @@ void _loadConfig() {
     if (f) {
       JsonDocument doc;
       deserializeJson(doc, f);
-      if (_p_server) strlcpy(_p_server, doc["mqtt_server"] | "", 40);
-      if (_p_port) strlcpy(_p_port, doc["mqtt_port"] | "", 6);
-      if (_p_topic) strlcpy(_p_topic, doc["mqtt_topic"] | "", 40);
+      if (_cfg_server) strlcpy(_cfg_server, doc["mqtt_server"] | "", 40);
+      if (_cfg_port) strlcpy(_cfg_port, doc["mqtt_port"] | "", 6);
+      if (_cfg_topic) strlcpy(_cfg_topic, doc["mqtt_topic"] | "", 40);
       f.close();
     }
   }
@@ -290,12 +2000,93 @@ void _loadConfig() {
 
 void _saveConfig() {
   JsonDocument doc;
-  doc["mqtt_server"] = _p_server;
-  doc["mqtt_port"] = _p_port;
-  doc["mqtt_topic"] = _p_topic;
+  doc["mqtt_server"] = _cfg_server;
+  doc["mqtt_port"] = _cfg_port;
+  doc["mqtt_topic"] = _cfg_topic;
   File f = LittleFS.open("/config.json", "w");
   if (f) serializeJson(doc, f);
   f.close();
+  // Settings changed (portal): drop the fast-boot record, the next cold boot rebuilds it
+  LittleFS.remove(MP_BOOT_FILE);
+}
+
+// --- Fast Boot Helpers ---
+void mqttpanel_fast_boot(bool enable, bool reuseIp) {
+  _fastBoot = enable;
+  _reuseIp = reuseIp;
+}
+
+void mqttpanel_boot_report(MpBootReport* out) {
+  if (out) *out = _boot;
+}
+
+// CRC-32 (same as zlib), 4 bits at a time: 64-byte table instead of 1 KB
+static uint32_t _crc32(const uint8_t* p, size_t n) {
+  static const uint32_t t[16] = {
+    0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+    0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL, 0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL
+  };
+  uint32_t crc = 0xFFFFFFFFUL;
+  while (n--) {
+    crc = t[(crc ^ *p) & 0x0F] ^ (crc >> 4);
+    crc = t[(crc ^ (*p++ >> 4)) & 0x0F] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+static bool _loadBootRecord(MpBootRecord* r) {
+  File f = LittleFS.open(MP_BOOT_FILE, "r");
+  if (!f) return false;
+  bool ok = f.size() == sizeof(*r) && f.read((uint8_t*)r, sizeof(*r)) == sizeof(*r);
+  f.close();
+  return ok && r->magic == MP_BOOT_MAGIC && r->size == sizeof(*r) &&
+         r->crc == _crc32((const uint8_t*)r, offsetof(MpBootRecord, crc));
+}
+
+static void _saveBootRecord() {
+  MpBootRecord r;
+  memset(&r, 0, sizeof(r)); // padding too, so the CRC is stable
+  r.magic = MP_BOOT_MAGIC;
+  r.size = sizeof(r);
+  strlcpy(r.server, _cfg_server, sizeof(r.server));
+  strlcpy(r.port, _cfg_port, sizeof(r.port));
+  strlcpy(r.topic, _cfg_topic, sizeof(r.topic));
+  strlcpy(r.ssid, WiFi.SSID().c_str(), sizeof(r.ssid));
+  memcpy(r.bssid, WiFi.BSSID(), sizeof(r.bssid));
+  r.channel = WiFi.channel();
+  r.ip = WiFi.localIP();
+  r.gateway = WiFi.gatewayIP();
+  r.subnet = WiFi.subnetMask();
+  r.dns = WiFi.dnsIP();
+  r.crc = _crc32((const uint8_t*)&r, offsetof(MpBootRecord, crc));
+
+  if (_recOk && memcmp(&r, &_rec, sizeof(r)) == 0) return; // unchanged: no flash write
+  File f = LittleFS.open(MP_BOOT_FILE, "w");
+  if (f) f.write((const uint8_t*)&r, sizeof(r));
+  f.close();
+  _rec = r;
+  _recOk = true;
+}
+
+static bool _fastWifi(const MpBootRecord& r) {
+  if (!r.ssid[0] || r.channel <= 0) return false;
+  WiFi.mode(WIFI_STA);
+  String psk = WiFi.psk(); // the station config the SDK persisted, readable before associating
+  if (_reuseIp && r.ip) WiFi.config(IPAddress(r.ip), IPAddress(r.gateway), IPAddress(r.subnet), IPAddress(r.dns));
+  WiFi.begin(r.ssid, psk.c_str(), r.channel, r.bssid);
+
+  unsigned long t = millis();
+  while (WiFi.status() != WL_CONNECTED) {
+    if (millis() - t > MP_FAST_WIFI_TIMEOUT_MS) {
+      // AP moved / replaced / lease gone: back to DHCP and the normal path
+      Serial.println("[MP] Fast WiFi failed, scanning...");
+      WiFi.disconnect();
+      WiFi.config(IPAddress(), IPAddress(), IPAddress());
+      return false;
+    }
+    delay(10);
+  }
+  return true;
 }
 
 void _startPortal(const char* apName) {
@@ -303,9 +2094,9 @@ void _startPortal(const char* apName) {
   WiFiManager wm;
   wm.setCustomHeadElement(custom_style);
   
-  WiFiManagerParameter p_s("server", "MQTT Server", _p_server, 40, "placeholder='your mqtt broker address'");
-  WiFiManagerParameter p_p("port", "MQTT Port", _p_port, 6, "placeholder='1883'");
-  WiFiManagerParameter p_t("topic", "MQTT Topic", _p_topic, 40, "placeholder='topic/prefix'");
+  WiFiManagerParameter p_s("server", "MQTT Server", _cfg_server, 40, "placeholder='your mqtt broker address'");
+  WiFiManagerParameter p_p("port", "MQTT Port", _cfg_port, 6, "placeholder='1883'");
+  WiFiManagerParameter p_t("topic", "MQTT Topic", _cfg_topic, 40, "placeholder='topic/prefix'");
   
   wm.addParameter(&p_s); wm.addParameter(&p_p); wm.addParameter(&p_t);
   wm.setSaveConfigCallback(_saveConfigCallback);
@@ -314,9 +2105,9 @@ void _startPortal(const char* apName) {
   wm.startConfigPortal(apName);
   
   // Save Parameters
-  strcpy(_p_server, p_s.getValue());
-  strcpy(_p_port, p_p.getValue());
-  strcpy(_p_topic, p_t.getValue());
+  strcpy(_cfg_server, p_s.getValue());
+  strcpy(_cfg_port, p_p.getValue());
+  strcpy(_cfg_topic, p_t.getValue());
   _saveConfig(); 
   
   Serial.println("[MP] Params Saved. Restarting...");
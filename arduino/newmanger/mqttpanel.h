@@ -2,16 +2,30 @@
 #define MQTTPANEL_H
 
 #include <Arduino.h>
+
+// MQTT client：預設 PubSubClient；編譯時加 -DMP_NATIVE_MQTT 改用內建的 MpMqttClient (見 mpmqtt.h)。
+// 草稿碼用 MpClient 宣告就兩種都能編。
+#ifdef MP_NATIVE_MQTT
+#include "mpmqtt.h"
+typedef MpMqttClient MpClient;
+#else
 #include <PubSubClient.h>
+typedef PubSubClient MpClient;
+#endif
 
 // --- Callback Type ---
 typedef void (*MqttCallback)(String topic, String msg);
 
+// Zero-copy 版本：topic / payload 直接指向 PubSubClient 的接收緩衝區，不做任何配置。
+// 只在 callback 執行期間有效 (要保存請自行複製)；payload 不以 '\0' 結尾。
+typedef void (*MqttRawCallback)(const char* topic, size_t topicLen,
+                                const uint8_t* payload, size_t len);
+
 // --- API ---
 
 /**
  * 系統初始化
- * @param client: PubSubClient 物件
+ * @param client: MQTT client 物件 (PubSubClient 或 MpMqttClient)
  * @param cb: 您的接收函式
  * @param srv: 存放 Server 的變數指標
  * @param port: 存放 Port 的變數指標
@@ -22,7 +36,14 @@ typedef void (*MqttCallback)(String topic, String msg);
  * @param led_pin: LED 腳位 (e.g. 4)
  * @param check_wifi_sec: WiFi 斷線幾秒後重啟 AP (e.g. 20)
  */
-void mqttpanel_begin(PubSubClient* client, MqttCallback cb, 
+void mqttpanel_begin(MpClient* client, MqttCallback cb, 
+              char* srv, char* port, char* topic,
+              int portal_sec, int factory_sec,
+              int trigger_pin, int led_pin,
+              int check_wifi_sec);
+
+// 同上，但使用 zero-copy callback (每則訊息 0 次 heap 配置)
+void mqttpanel_begin(MpClient* client, MqttRawCallback cb,
               char* srv, char* port, char* topic,
               int portal_sec, int factory_sec,
               int trigger_pin, int led_pin,
@@ -32,10 +53,778 @@ void mqttpanel_begin(PubSubClient* client, MqttCallback cb,
 void mqttpanel_loop();
 
 // MQTT 操作
+// 斷線時 mqttpanel_pub 不會再直接丟掉，而是先存進緩衝區 (見下方 Store-and-Forward)，
+// 連上後在 mqttpanel_loop() 裡照順序慢慢補送。
 void mqttpanel_pub(String topic, String payload);
+// 同上，但這個 Topic 只保留最新一筆 (例如狀態類的 Topic：斷線期間變了 100 次，只補送最後一次)
+void mqttpanel_pub_latest(String topic, String payload);
 void mqttpanel_sub(String topic);
 
+// --- 大型 Payload：串流發送 / 分段接收 ---
+// mqttpanel_pub 受限於 PubSubClient 的封包緩衝區 (setBufferSize，整包都要放得下)。
+// 圖片這種大資料改用串流發送：先告訴總長度，再一段一段寫，直接寫進 socket，
+// 不需要跟 payload 一樣大的緩衝區，也不用先組成 String。
+// 只有連線中才能送 (不進 Store-and-Forward)；送的期間 mqttpanel_pub 會先排隊，送完才補。
+//
+//   if (mqttpanel_pub_begin(topic, jpgLen)) {
+//     while (...) mqttpanel_pub_write(chunk, n);
+//     mqttpanel_pub_end();
+//   }
+
+// 回傳 false = 沒連線、或上一個串流還沒 end
+bool mqttpanel_pub_begin(const char* topic, size_t len, bool retained = false);
+// 回傳實際寫入的 bytes (寫不進去 = 連線斷了，mqttpanel_pub_end 會回傳 false)
+size_t mqttpanel_pub_write(const uint8_t* data, size_t n);
+// 回傳 true = 寫滿了 begin 說的長度而且都送出去了
+bool mqttpanel_pub_end();
+// 從 Stream (例如 LittleFS 的 File) 讀 len bytes 直接送出，每次搬 MP_CHUNK_BYTES
+bool mqttpanel_pub_stream(const char* topic, Stream& src, size_t len, bool retained = false);
+
+// 分段接收：比 PubSubClient 緩衝區大的訊息，payload 邊收邊交給 handler，
+// 每段最多 MP_CHUNK_BYTES (只用這一塊固定的緩衝區)，比 RAM 還大的資料也收得下。
+// 放得進緩衝區的訊息照舊走 Topic 表 / handler / callback，不會進這裡。
+//
+// PubSubClient 是先讀 payload、整包讀完才看 topic，所以前面幾段的 topic 是 NULL、total 是 0；
+// 最後一段 (done = true) 才帶 topic 和總長度，這時再決定要保留還是丟掉收到的資料。
+#ifndef MP_CHUNK_BYTES
+#define MP_CHUNK_BYTES 256
+#endif
+
+typedef void (*MpChunkHandler)(const char* topic, size_t topicLen,
+                               const uint8_t* data, size_t n, size_t offset,
+                               size_t total, bool done, void* arg);
+
+// NULL = 關掉 (超過緩衝區的訊息就跟以前一樣丟掉)
+// 回傳 false = PubSubClient 的緩衝區比 MP_CHUNK_BYTES 大 (分段模式就是讓它保持小)
+bool mqttpanel_on_chunks(MpChunkHandler fn, void* arg = NULL);
+
+// --- Store-and-Forward (斷線暫存 + 補送) ---
+#ifndef MP_SF_RAM_BYTES
+#define MP_SF_RAM_BYTES 2048   // RAM 環狀緩衝區大小；每則佔 4 + topic + payload bytes
+#endif
+
+/**
+ * 設定補送策略
+ * @param replayPerSec: 連上後每秒最多補送幾則 (避免一連上就把 Broker / 自己塞爆)
+ * @param spillMaxBytes: RAM 滿了以後，最舊的訊息搬到 LittleFS 的 /mp_spool.bin，最多放這麼多 bytes
+ *                       (0 = 不用 LittleFS，RAM 滿了就丟最舊的)。長時間斷線才需要。
+ *                       這個檔案重開機後也會繼續補送。
+ */
+void mqttpanel_sf_config(uint16_t replayPerSec, uint32_t spillMaxBytes);
+
+struct MpSfStats {
+  uint16_t ramUsed;          // RAM 緩衝區目前用了幾 bytes
+  uint16_t ramPeak;          // 最高用到幾 bytes
+  uint16_t queued;           // RAM 裡還有幾則等著補送
+  uint32_t spillBytes;       // LittleFS 裡還沒補送的 bytes
+  uint32_t spillPeak;        // 最多曾經放了幾 bytes
+  uint32_t buffered;         // 總共暫存過幾則
+  uint32_t collapsed;        // 被 mqttpanel_pub_latest 蓋掉的舊資料
+  uint32_t dropped;          // 放不下被丟掉的 (最舊的先丟)，或連線還在卻送不出去的 (例如超過 client 緩衝區)
+  uint32_t replayed;         // 總共補送幾則
+  uint32_t replayMsgsPerSec; // 上一輪補送的實際速度
+};
+void mqttpanel_sf_stats(MpSfStats* out);
+
 // 狀態查詢
 bool mqttpanel_is_connected();
 
+// --- MQTT 連線狀態機 ---
+// mqttpanel_loop() 每圈最多做「一步」連線動作 (TCP 連線 / 送 CONNECT)，
+// 失敗就用指數退避 (exponential backoff) + 隨機抖動 (jitter) 排下一次，
+// Broker 掛掉時 loop() 還是照常在跑，不會每次卡住整個 TCP + CONNECT timeout。
+// 注意：這是「有上限的卡住」(bounded blocking)，不是非阻塞：Arduino 的 WiFiClient::connect()
+// 跟 PubSubClient::connect() (等 CONNACK) 都是同步呼叫，所以 TCP / MQTT 那一步
+// 還是會卡住 loop() 最多 connectTimeoutMs (DNS 查詢不在這個上限裡)。實際最久多少看 MpConnStats.maxBlockMs。
+
+enum MpConnState {
+  MP_CONN_WIFI_DOWN = 0, // 等 WiFi
+  MP_CONN_BACKOFF,       // 等下一次重試的時間到
+  MP_CONN_TCP,           // 這一圈開 TCP socket (有 mqttpanel_conn_socket 才會分開做；同步，最多 connectTimeoutMs)
+  MP_CONN_MQTT,          // 這一圈送 CONNECT 並等 CONNACK (同步，最多 socket timeout = connectTimeoutMs 進位到秒)
+  MP_CONN_ONLINE         // 已連線
+};
+
+struct MpConnPolicy {
+  uint16_t backoffMinMs = 1000;      // 第一次重試等多久，之後每次失敗加倍
+  uint32_t backoffMaxMs = 60000;     // 最多等多久
+  uint8_t jitterPct = 25;            // 每次等待隨機 ±25%，避免很多台同時重連
+  uint16_t connectTimeoutMs = 1000;  // TCP 連線 / CONNACK 最多等多久 (一步連線動作卡住 loop 的上限；CONNACK 以秒計，進位)
+  uint8_t portalAfterFailures = 5;   // 連續失敗幾次就開設定頁面 (0 = 不看次數)
+  uint32_t portalAfterMs = 0;        // MQTT 斷線超過幾毫秒就開設定頁面 (0 = 不看時間)
+  bool portalOnWifiLoss = true;      // WiFi 斷線 check_wifi_sec 秒後開設定頁面
+  uint16_t keepAliveSec = 15;        // MQTT keepalive (交給 client.setKeepAlive；省電待機也要知道)
+};
+// 注意：設定頁面 (portal) 本身還是會卡住，存檔後重開機；
+// 只想一直重連、永遠不開 portal：portalAfterFailures = 0, portalAfterMs = 0, portalOnWifiLoss = false
+
+struct MpConnStats {
+  MpConnState state;
+  uint32_t attempts;        // 總共試了幾次
+  uint32_t failures;        // 失敗幾次
+  uint32_t connects;        // 成功幾次
+  uint8_t streak;           // 目前連續失敗幾次
+  int lastRc;               // 上次失敗的 PubSubClient state()
+  uint32_t nextRetryMs;     // 還要等多久才會再試 (BACKOFF 時)
+  uint32_t lastReconnectMs; // 上次從「斷線」到「重新連上」花了多久 (開機算第一次)
+  uint32_t maxReconnectMs;  // 最久的一次
+  uint32_t maxBlockMs;      // 單一步連線動作卡住 loop() 最久多少
+};
+
+/**
+ * 設定重連策略 (可以在 mqttpanel_begin 前或後呼叫)
+ */
+void mqttpanel_conn_policy(const MpConnPolicy& policy);
+
+/**
+ * (選用) 把 PubSubClient 底下的 WiFiClient 交給模組
+ * 給了之後 TCP 連線跟 MQTT CONNECT 會分在兩圈做，而且 TCP 連線最多等 connectTimeoutMs
+ * (沒給的話就是一次呼叫 PubSubClient::connect()，卡住時間由核心的預設值決定)
+ */
+class WiFiClient;
+void mqttpanel_conn_socket(WiFiClient* sock);
+
+void mqttpanel_conn_stats(MpConnStats* out);
+
+// --- 快速開機 (Fast Boot) ---
+
+/**
+ * 開啟快速開機 (在 mqttpanel_begin 之前呼叫)
+ * 設定另外存一份固定格式的二進位檔 /mp_boot.bin (有 CRC 檢查)，
+ * 並記住上次連上的 BSSID / 頻道 / IP。熱開機時：不解析 JSON、不掃描 WiFi (reuseIp 時也不等 DHCP)。
+ * 任何一項對不上 (CRC 錯、AP 換了、連不上) 就自動退回原本的流程 (config.json + WiFiManager)。
+ * 退回之前會先等 cached AP 最多 MP_FAST_WIFI_TIMEOUT_MS (3 秒，這段會卡住 mqttpanel_begin)。
+ * @param enable: 開 / 關
+ * @param reuseIp: 沿用上次拿到的 IP (當成靜態 IP 設定，只會用在同一個 BSSID 上)。
+ *                 紀錄裡沒有租約期限：租約過期、IP 被別台拿走時會衝突，所以預設不開；
+ *                 只有路由器幫這台保留固定 IP (DHCP reservation) 時才建議打開
+ */
+void mqttpanel_fast_boot(bool enable, bool reuseIp = false);
+
+// 開機各階段花了多久 (MQTT 第一次連上時也會印在 Serial)
+struct MpBootReport {
+  uint32_t fsMountMs;   // LittleFS 掛載
+  uint32_t configMs;    // 讀設定 (bin 或 json)
+  uint32_t wifiMs;      // WiFi 連上 (含掃描 / DHCP)
+  uint32_t mqttMs;      // WiFi 連上 -> MQTT 連上
+  uint32_t totalMs;     // mqttpanel_begin -> MQTT 連上 (= 最快能發佈第一則訊息的時間)
+  bool configCached;    // 設定是從 /mp_boot.bin 讀的
+  bool wifiCached;      // WiFi 是用快取的 BSSID/頻道 連上的
+};
+void mqttpanel_boot_report(MpBootReport* out);
+
+// --- 執行期統計 (Metrics) ---
+// 不用再到處加 Serial.print：loop 耗時、收發量、重連次數、heap 最低點都在這裡。
+// 計數器很便宜 (每圈兩次 micros() + 幾個加法)，正式版也可以一直開著。
+
+#define MP_HIST_BUCKETS 12     // 耗時直方圖：第 0 格 < 64us，之後每格上限加倍，最後一格 >= 65ms
+
+struct MpHist {
+  uint32_t count[MP_HIST_BUCKETS]; // count[i] = 耗時 < (64us << i) 的次數 (最後一格不設上限)
+  uint32_t maxUs;                  // 最久的一次
+};
+
+struct MpMetrics {
+  uint32_t uptimeMs;
+  uint32_t loops;           // mqttpanel_loop() 跑了幾圈
+  uint32_t msgsIn;          // 收到幾則 (自己的 $stats 不算)
+  uint32_t bytesIn;         // topic + payload
+  uint32_t msgsOut;         // 送出幾則 (含補送、$stats)
+  uint32_t bytesOut;
+  uint32_t reconnects;      // 斷線後重新連上幾次 (開機第一次不算)
+  uint32_t heapFree;        // 目前可用 heap
+  uint32_t heapMin;         // 可用 heap 最低點
+  uint32_t blockMax;        // 目前最大的連續可用區塊 (決定還能不能 new 一大塊)
+  uint32_t blockMin;        // 最大連續區塊的最低點 (碎片化的指標)
+  MpHist loop;              // mqttpanel_loop() 每圈耗時
+  MpHist rx;                // 收到訊息的 callback 耗時 (含您的 callback)
+};
+
+void mqttpanel_metrics(MpMetrics* out);
+void mqttpanel_metrics_reset();           // 計數 / 直方圖 / heap 最低點 全部重新開始
+void mqttpanel_metrics_enable(bool on);   // 預設開；關掉後 loop 不量時間也不取樣 heap
+
+// 直方圖的百分位數 (例如 99 = p99)，回傳那一格的上限 (us，不會超過 maxUs)
+uint32_t mqttpanel_hist_percentile(const MpHist& h, uint8_t pct);
+
+/**
+ * 定期把統計發到 <topic>/$stats (預設 0 = 不發)
+ * 內容是精簡的 JSON，例如：
+ *   {"up":3600,"loops":512340,"in":120,"out":98,"inB":4210,"outB":3011,"rc":1,
+ *    "heap":40960,"heapMin":38112,"blk":32768,"blkMin":30208,
+ *    "loop":[64,128,901],"rx":[64,256,1400]}
+ * loop / rx 是 [p50, p99, max] (us)。自己發的 $stats 收到時會直接略過，不會進您的 callback。
+ */
+void mqttpanel_stats_interval(uint32_t ms);
+
+// --- 協同式排程器 (Cooperative Scheduler) ---
+// 不用再自己寫 if (millis() - last > 10000) 計時器：把函式註冊成 Task，
+// mqttpanel_loop() 會在到期時呼叫它。mqttpanel_loop() 本身也切成幾段
+// (按鈕 / 連線與收發 / 補送 / $stats)，每段之間都會先跑到期的 Task，
+// 所以控制迴圈的節奏不會被 MQTT 的工作拖慢一整圈。
+// Task 不能卡住 (不要 delay)；要在 loop() 裡常常呼叫 mqttpanel_loop()。
+
+#ifndef MP_MAX_TASKS
+#define MP_MAX_TASKS 8
+#endif
+
+typedef void (*MpTaskFn)(void* arg);
+
+/**
+ * 週期性 Task：每 periodMs 毫秒跑一次 (固定頻率，不會越跑越慢)
+ * @param budgetUs: 這個 Task 每次最多該跑多久 (超過記一次 overrun；0 = 不檢查)
+ * @return Task 編號 (給 mqttpanel_cancel / mqttpanel_task_stats 用)，-1 = 滿了
+ * 晚了超過一整個週期的話，錯過的那幾次直接跳過 (記在 skipped)，不會連續補跑。
+ */
+int mqttpanel_every(uint32_t periodMs, MpTaskFn fn, void* arg = NULL, uint32_t budgetUs = 0);
+
+// 單次 Task：delayMs 毫秒後跑一次，跑完自動釋放 (在 Task 裡可以再排下一次)
+int mqttpanel_after(uint32_t delayMs, MpTaskFn fn, void* arg = NULL, uint32_t budgetUs = 0);
+
+void mqttpanel_cancel(int id);
+
+struct MpTaskStats {
+  uint32_t runs;
+  uint32_t overruns;   // 執行超過 budgetUs 的次數
+  uint32_t skipped;    // 晚太多被跳過的週期
+  uint32_t lastUs;     // 上次執行花多久
+  uint32_t maxUs;
+  MpHist late;         // 實際開始比預定晚多少 (= jitter)
+};
+// 單次 Task 跑完後還可以讀，直到那個位置被新的 Task 用掉。回傳 false = 編號無效
+bool mqttpanel_task_stats(int id, MpTaskStats* out);
+
+/**
+ * 每圈 mqttpanel_loop() 的時間預算 (微秒，0 = 不限制，預設)
+ * 連線與收發每圈一定會做；補送 (Store-and-Forward) 跟 $stats 超過預算就延到下一圈。
+ */
+void mqttpanel_loop_budget(uint32_t us);
+
+struct MpSchedStats {
+  MpHist period;       // 兩次 mqttpanel_loop() 開始的間隔 (= 整個 loop() 一圈，最差反應時間看 maxUs)
+  uint32_t ioMaxUs;    // 連線與收發那段最久花多久
+  uint32_t replayMaxUs;// 補送那段最久花多久
+  uint32_t deferred;   // 因為超過預算延到下一圈的次數
+  uint32_t overruns;   // 所有 Task 的 overrun 加總
+};
+void mqttpanel_sched_stats(MpSchedStats* out);
+
+// --- 按鈕與 LED (Button / LED) ---
+// 按鈕用 GPIO 中斷 (CHANGE) 偵測：沒人按的時候 mqttpanel_loop() 不讀腳位、不算時間，
+// 只比較一個計數器。有邊緣進來才排一個 MP_BTN_DEBOUNCE_MS 的 Task 去讀一次穩定的電位
+// (彈跳期間的邊緣只會把這個 Task 往後延)，按住時再排 Task 在 portal_sec / factory_sec
+// 到的那一刻切換 LED 閃法。放開後依按住時間排成一個事件，在 mqttpanel_loop() 裡交給
+// mqttpanel_on_button 的函式 (沒設或回傳 false 就做預設動作)：
+//   MP_BTN_CLICK      短按                      (預設：不做事)
+//   MP_BTN_PORTAL     按住 >= portal_sec 放開    (預設：開設定頁面)
+//   MP_BTN_FACTORY    按住 >= factory_sec 放開   (預設：清設定、重開機)
+//   MP_BTN_BOOT_RESET mqttpanel_begin 讀腳位時已經按著 (heldMs = 0；預設：清設定、重開機)
+// 開機重置只讀一次腳位、不等待，在 mqttpanel_begin 裡連 WiFi / 開設定頁面之前就交出去
+// (WiFi 設定錯了卡在設定頁面時也能重置)；handler 回傳 true 就照常開機。
+// 計時都用上面的排程器 (按住或彈跳時最多佔 1 個 Task，LED 閃爍時再 1 個)。
+// 腳位沒有中斷可用 (例如 ESP8266 的 GPIO16) 就退回每圈讀一次腳位，其他都一樣。
+
+#ifndef MP_BTN_DEBOUNCE_MS
+#define MP_BTN_DEBOUNCE_MS 30  // 最後一個邊緣之後電位要穩定多久才算數
+#endif
+#ifndef MP_BTN_QUEUE
+#define MP_BTN_QUEUE 4         // 還沒交出去的事件最多幾個 (滿了丟新的，記在 dropped)
+#endif
+
+enum MpButtonKind : uint8_t {
+  MP_BTN_CLICK = 0,
+  MP_BTN_PORTAL,
+  MP_BTN_FACTORY,
+  MP_BTN_BOOT_RESET,
+};
+
+struct MpButtonEvent {
+  MpButtonKind kind;
+  uint32_t heldMs;     // 按住多久 (去彈跳後的電位)
+};
+
+// 回傳 true = 自己處理掉了，不做預設動作
+typedef bool (*MpButtonHandler)(const MpButtonEvent& ev, void* arg);
+void mqttpanel_on_button(MpButtonHandler fn, void* arg = NULL);
+
+struct MpButtonStats {
+  uint32_t edges;      // 中斷看到的邊緣 (含彈跳)
+  uint32_t bounces;    // 被濾掉的邊緣 (彈跳 / 雜訊)
+  uint32_t events;     // 排進佇列的事件
+  uint32_t dropped;    // 佇列滿了丟掉的
+};
+void mqttpanel_button_stats(MpButtonStats* out);
+
+// LED 閃法：bits 的第 0 ~ steps-1 位元依序各亮 (1) / 暗 (0) stepMs 毫秒，然後重來。
+// 只在亮暗改變時才寫腳位；steps <= 1 的固定亮 / 暗不佔 Task。
+struct MpLedPattern {
+  uint32_t bits;
+  uint8_t steps;       // 1 ~ 32
+  uint16_t stepMs;
+};
+constexpr MpLedPattern MP_LED_OFF = { 0x0, 1, 0 };
+constexpr MpLedPattern MP_LED_ON = { 0x1, 1, 0 };
+constexpr MpLedPattern MP_LED_SLOW = { 0x1, 2, 200 };      // 按住超過 portal_sec
+constexpr MpLedPattern MP_LED_FAST = { 0x1, 2, 50 };       // 按住超過 factory_sec
+constexpr MpLedPattern MP_LED_HEARTBEAT = { 0x5, 10, 100 }; // 每秒閃兩下
+
+// 設定平常的閃法 (預設 MP_LED_OFF)；按鈕按住時先顯示 SLOW / FAST，放開後換回這個
+void mqttpanel_led(const MpLedPattern& pattern);
+
+// --- 省電待機 (Tickless Idle) ---
+// loop() 沒事也一直空轉，電池 / 太陽能供電的節點很耗電。在 loop() 最後呼叫 mqttpanel_idle()：
+// 先算出下一件「時間到了才要做」的事還有多久 (排程器的 Task、按鈕 / LED 計時、keepalive、
+// 重連的退避時間、補送的速率、$stats、Bridge)，睡到那時候；
+// 中間每 sliceMs 看一次 socket / 區網 UDP / 按鈕，有東西進來就提早醒來。
+// 睡覺用的是 delay()：ESP32 會讓出 CPU 給 idle task (WiFi 預設 modem sleep)；
+// ESP8266 在 setup() 加 WiFi.setSleepMode(WIFI_LIGHT_SLEEP) 後，delay() 期間會進 light sleep。
+//
+//   void loop() {
+//     mqttpanel_loop();
+//     mqttpanel_idle();
+//   }
+//
+// MQTT 訊息要能叫醒它，請在 setup() 呼叫 mqttpanel_conn_socket(&espClient)；
+// 沒給 socket 的話連線中最多只睡 sliceMs (收到的訊息最多晚 sliceMs 處理)。
+// PubSubClient 的 keepalive 看不到上次收發的時間，連線中最多睡 keepalive 的 1/4
+// (MpConnPolicy.keepAliveSec；不要另外呼叫 client.setKeepAlive)。
+
+#ifndef MP_IDLE_SLICE_MS
+#define MP_IDLE_SLICE_MS 10    // 預設多久看一次 socket / 按鈕 (= 有東西進來最多晚多久醒)
+#endif
+#ifndef MP_IDLE_OFFLINE_MS
+#define MP_IDLE_OFFLINE_MS 250 // WiFi 斷線時多久看一次 WiFi 狀態
+#endif
+
+/**
+ * 睡到下一件事 (或 maxMs) 為止
+ * @param maxMs: 最多睡多久 (0 = 不睡)
+ * @param sliceMs: 多久看一次 socket / 按鈕；越大越省電、反應越慢
+ * @return 實際睡了多少 ms (0 = 現在就有事，沒睡)
+ */
+uint32_t mqttpanel_idle(uint32_t maxMs = 1000, uint16_t sliceMs = MP_IDLE_SLICE_MS);
+
+// 下一件事還有多久 (ms，0 = 現在就有事，UINT32_MAX = 沒有排定的事)；只算不睡
+uint32_t mqttpanel_idle_deadline();
+
+struct MpIdleStats {
+  uint32_t sleeps;       // 真的睡了幾次
+  uint32_t skipped;      // 呼叫了但現在就有事，沒睡
+  uint32_t sleptMs;      // 總共睡了多久
+  uint32_t awakeMs;      // 其他時間 (醒著做事 / 空轉)
+  uint8_t awakePct;      // 醒著的比例 (duty cycle)
+  uint32_t wakeTimer;    // 睡到時間到才醒 (有事要做或 maxMs 到了)
+  uint32_t wakeIo;       // 被 MQTT socket / 區網 UDP 叫醒
+  uint32_t wakeButton;   // 被按鈕叫醒
+  uint32_t maxSleepMs;   // 最長的一次
+};
+void mqttpanel_idle_stats(MpIdleStats* out);
+void mqttpanel_idle_stats_reset();   // 從現在開始重新算 (duty cycle 也是)
+
+// --- Topic Handlers (依 Topic 分派) ---
+// 不用再在 callback 裡寫一長串 if (topic == String(mqtt_topic_head) + "...")：
+// 每種 Topic 註冊自己的處理函式，支援 MQTT 萬用字元：
+//   "+" = 剛好一層，例如 "dimmer/+/set"
+//   "#" = 後面任意層 (要放最後)，例如 "cmd/#" (也會對到 "cmd" 本身)
+// 註冊時就把所有 pattern 編成一棵樹，收到訊息時一層一層走一次就找到，
+// 不用組字串、不配置記憶體，花的時間跟 pattern 數量無關。
+//
+// pattern 是相對於 <topic>/ 的路徑 (<topic> 底下的訊息會先去掉前綴再比對)；
+// 用 mqttpanel_sub 另外訂閱、不在 <topic> 底下的，就拿完整 Topic 比對。
+// 一則訊息對到幾個就呼叫幾個 (完全相同的先，再來 "+"，最後 "#")；
+// 一個都沒對到，才交給 mqttpanel_begin 的 callback。
+// 跟 MQTT 規定一樣，"$" 開頭的第一層 (例如 $stats) 不會被萬用字元對到。
+
+#ifndef MP_MAX_HANDLERS
+#define MP_MAX_HANDLERS 24     // 最多幾個 handler
+#endif
+#ifndef MP_MATCH_NODES
+#define MP_MATCH_NODES 64      // 樹的節點：每個「不同的層」一個 (共用前面的層)
+#endif
+#ifndef MP_MATCH_TEXT
+#define MP_MATCH_TEXT 256      // 各層文字共用的空間 (相同的字只存一次)
+#endif
+
+// topic / payload 跟 MqttRawCallback 一樣直接指向接收緩衝區 (payload 不以 '\0' 結尾)
+typedef void (*MpTopicHandler)(const char* topic, size_t topicLen,
+                               const uint8_t* payload, size_t len, void* arg);
+
+// 回傳 false = pattern 不合法 ("#" 不在最後、"+" / "#" 跟其他字混在同一層) 或空間滿了
+bool mqttpanel_on(const char* pattern, MpTopicHandler fn, void* arg = NULL);
+
+// 清掉所有 handler (例如換了一組面板設定要重新註冊)
+void mqttpanel_on_clear();
+
+// 取出 Topic 的第 index 層 (0 = 第一層；負數從後面數，-1 = 最後一層)
+// 例如 handler 註冊 "dimmer/+/set"，用 index -2 拿到 "+" 那一層的編號
+bool mqttpanel_topic_level(const char* topic, size_t topicLen, int index,
+                           const char** level, size_t* levelLen);
+
+// --- Topic Table (編譯期產生的 Topic 表) ---
+// App 的程式產生器 (MqttPanelCraft) 會輸出一張排好序的 constexpr 表：
+// 相對 Topic、頻道型態、綁定的變數，編譯時就決定好，放在 Flash 不佔 RAM，
+// 開機不用一個一個註冊 (mqttpanel_table 只記住表的位置)。
+// 收到訊息時用二分搜尋找到那一列，直接把 payload 寫進變數，再呼叫該列的 fn (可 NULL)。
+//
+// 查表順序：Topic 表 → mqttpanel_on 的 handler → mqttpanel_begin 的 callback，
+// 前面對到了後面就不會收到。表只做完全相同的比對 (萬用字元請用 mqttpanel_on)。
+//
+//   MP_TOPIC_TABLE(mp_topics) = {
+//     { "dimmer/1/set", MP_TOPIC_DIMMER, &dim_1, NULL },
+//     { "switch/1/set", MP_TOPIC_SWITCH, &sw_1,  on_sw_1 },
+//   };
+//   static_assert(mp_table_sorted(mp_topics), "topic table must be sorted");
+//   ... setup(): mqttpanel_table(mp_topics);
+
+#ifndef MP_TABLE_TOPIC
+#define MP_TABLE_TOPIC 32      // 每列相對 Topic 的長度上限 (含結尾 '\0')，太長編譯時就會報錯
+#endif
+
+enum MpTopicKind : uint8_t {
+  MP_TOPIC_SWITCH,       // bool*   ("1" = true)
+  MP_TOPIC_DIMMER,       // int*
+  MP_TOPIC_NUMBER,       // float*
+  MP_TOPIC_TEXT,         // String*
+  MP_TOPIC_CALL          // 不寫變數，只呼叫 fn (var 當作 arg 傳給 fn)
+};
+
+// Topic 直接放在列裡 (不是指標)，整張表才能一起放進 Flash (ESP8266 的 PROGMEM)
+struct MpTopicEntry {
+  char topic[MP_TABLE_TOPIC];
+  MpTopicKind kind;
+  void* var;
+  MpTopicHandler fn;     // 變數寫好後呼叫，arg = var
+};
+
+// 宣告一張放在 Flash 的表
+#define MP_TOPIC_TABLE(name) static constexpr MpTopicEntry name[] PROGMEM
+
+// 編譯期檢查：Topic 要照位元組順序由小到大排好、不能重複 (二分搜尋的前提)
+constexpr bool mp_topic_less(const char* a, const char* b) {
+  return *a != *b ? (unsigned char)*a < (unsigned char)*b : (*a != '\0' && mp_topic_less(a + 1, b + 1));
+}
+template <size_t N>
+constexpr bool mp_table_sorted(const MpTopicEntry (&table)[N], size_t i = 1) {
+  return i >= N || (mp_topic_less(table[i - 1].topic, table[i].topic) && mp_table_sorted(table, i + 1));
+}
+
+// 使用這張表 (NULL / 0 = 不用)；表要一直存在 (通常就是上面那個 static constexpr 陣列)
+void mqttpanel_table(const MpTopicEntry* table, size_t count);
+template <size_t N>
+inline void mqttpanel_table(const MpTopicEntry (&table)[N]) { mqttpanel_table(table, N); }
+
+// --- 區網直連 (LAN Control) ---
+// App 的指令原本是 手機 → Broker → 裝置 → Broker → 手機，同一個 WiFi 底下也要多繞幾十 ms，
+// 搖桿 / 滑桿會覺得「黏」。開了區網直連之後，裝置另外在 UDP port 上收指令，
+// 直接回 /val 給同一個區網的手機；從外面連進來還是走 Broker。
+//
+// 格式 (純文字，一行一則，一個 datagram 可以放好幾行，用 '\n' 分開)：
+//   手機 → 裝置：<相對 Topic> <payload>，例如 "dimmer/1/set 40" (只收 /set 結尾的 Topic)
+//               空的 datagram 或 "?" = 只報到 (開始收 /val，不送指令)
+//   裝置 → 手機：mqttpanel_pub 發佈 <topic>/.../val 時，同時送 "dimmer/1/val 40"
+//               給最近 MP_LAN_PEER_TTL_MS 內傳過封包的每一支手機
+// 指令跟從 Broker 收到的訊息走同一條路 (Topic 表 → handler → callback)，不用另外寫。
+// 範圍：只有經過 mqttpanel_pub / mqttpanel_pub_latest (MqttPanel::pub / pub_latest) 的 /val 會送到區網；
+// 直接呼叫 client.publish()、串流發佈 (mqttpanel_pub_begin / pub_stream)、Store-and-Forward 補送都不會。
+// explained/ 版的通道路由器 (mqttpanel_explained.cpp) 是另一套函式庫，沒有區網直連。
+// 沒有密碼：請只在信任的區網打開。
+//
+//   WiFiUDP lanUdp;
+//   ... setup()，在 mqttpanel_begin 之後：mqttpanel_lan_begin(&lanUdp);
+
+#ifndef MP_LAN_PORT
+#define MP_LAN_PORT 1884       // 預設的 UDP port
+#endif
+#ifndef MP_LAN_PEERS
+#define MP_LAN_PEERS 4         // 同時幾支手機 / 平板 (滿了就換掉最久沒出聲的)
+#endif
+#ifndef MP_LAN_PACKET
+#define MP_LAN_PACKET 256      // 一個 datagram 最多幾 bytes，超過的整包丟掉
+#endif
+#ifndef MP_LAN_PEER_TTL_MS
+#define MP_LAN_PEER_TTL_MS 30000 // 手機多久沒傳東西就不再送 /val 給它 (App 每 10 秒送一次 "?" 即可)
+#endif
+
+struct MpLanStats {
+  uint32_t cmds;        // 收到並交給分派的指令
+  uint32_t vals;        // 送出的 /val datagram (一支手機算一次)
+  uint32_t bad;         // 格式不對、不是 /set、或太長被丟掉的
+  uint8_t peers;        // 目前有幾支手機在收 /val
+};
+
+class WiFiUDP;
+// 回傳 false = UDP port 開不起來
+bool mqttpanel_lan_begin(WiFiUDP* udp, uint16_t port = MP_LAN_PORT);
+void mqttpanel_lan_end();
+void mqttpanel_lan_stats(MpLanStats* out);
+
+// --- 多個 Broker (MqttPanel) ---
+// 上面的 mqttpanel_* 函式操作的是「主面板」(mqttpanel_main())：設定頁面 / config.json 裡的那台 Broker。
+// 要同時連第二台 (例如區網 Broker 做 <10 ms 的控制、雲端 Broker 做監看)，另外宣告一個 MqttPanel：
+// 每個面板有自己的連線狀態機、Store-and-Forward 緩衝區、handler 樹、Topic 表、統計。
+// WiFi、設定頁面、按鈕、快速開機、排程器整台只有一份；mqttpanel_loop() 一次服務所有面板。
+//
+//   WiFiClient cloudNet;
+//   MpClient cloudClient(cloudNet);
+//   MqttPanel cloud;
+//   ... setup()，在 mqttpanel_begin 之後：
+//   cloud.begin(&cloudClient, NULL, "cloud.example.com", 1883, "site7");
+//   mqttpanel_main().bridge(cloud, "+/+/val", 5000); // 區網的 /val 每個 Topic 最多 5 秒一次轉到雲端
+//
+// 橋接 (bridge)：收到符合 pattern 的訊息時只記下最新的值，到時間才送到另一個面板
+// (<對方的 topic>/<相對 Topic>)，中間變了幾次都只送最後一次；對方斷線時也是留著最新值等連上。
+// 原本的分派 (Topic 表 / handler / callback) 照常進行，橋接不會搶走訊息。
+// 自己發的 /val 也會被轉送：面板訂閱了 <topic>/#，Broker 會把它送回來。
+
+#ifndef MP_MAX_PANELS
+#define MP_MAX_PANELS 2        // 最多幾個面板 (含主面板)
+#endif
+#ifndef MP_BRIDGE_RULES
+#define MP_BRIDGE_RULES 4      // 每個面板最多幾條 bridge()
+#endif
+#ifndef MP_BRIDGE_SLOTS
+#define MP_BRIDGE_SLOTS 8      // 每個面板最多同時記住幾個 Topic 的最新值
+#endif
+#ifndef MP_BRIDGE_TOPIC
+#define MP_BRIDGE_TOPIC 48     // 相對 Topic 長度上限 (含結尾 '\0')
+#endif
+#ifndef MP_BRIDGE_PAYLOAD
+#define MP_BRIDGE_PAYLOAD 32   // payload 長度上限 (/val 是短短的數值或文字)
+#endif
+
+struct MpBridgeStats {
+  uint32_t seen;        // 符合 pattern 的訊息
+  uint32_t forwarded;   // 實際送到對方的
+  uint32_t coalesced;   // 還沒送就被新值蓋掉的
+  uint32_t dropped;     // Topic / payload 太長、或 slot 滿了
+};
+
+class MqttPanel {
+public:
+  MqttPanel() {}
+
+  /**
+   * 連上另一台 Broker (主面板請用 mqttpanel_begin)
+   * 要在 mqttpanel_begin 之後呼叫 (WiFi 跟 LittleFS 由主面板準備好)。
+   * server / topic 只記指標，要一直存在。
+   * @return false = 面板滿了 (MP_MAX_PANELS) 或 client 是 NULL
+   */
+  bool begin(MpClient* client, MqttRawCallback cb, const char* server, uint16_t port, const char* topic);
+  void end();                    // 斷線並從 mqttpanel_loop() 移除 (主面板不能 end)
+  bool connected() const { return _connState == MP_CONN_ONLINE; }
+  MpClient* client() const { return _client; }
+
+  // 跟同名的 mqttpanel_* 函式一樣，只是作用在這個面板
+  void pub(String topic, String payload);
+  void pub_latest(String topic, String payload);
+  void sub(String topic);
+  bool pub_begin(const char* topic, size_t len, bool retained = false);
+  size_t pub_write(const uint8_t* data, size_t n);
+  bool pub_end();
+  bool pub_stream(const char* topic, Stream& src, size_t len, bool retained = false);
+  bool on_chunks(MpChunkHandler fn, void* arg = NULL);
+  void sf_config(uint16_t replayPerSec, uint32_t spillMaxBytes);
+  void sf_stats(MpSfStats* out);
+  void conn_policy(const MpConnPolicy& policy);
+  void conn_socket(WiFiClient* sock) { _sock = sock; }
+  void conn_stats(MpConnStats* out);
+  void metrics(MpMetrics* out);
+  void metrics_reset();
+  void metrics_enable(bool on) { _mxOn = on; }
+  void stats_interval(uint32_t ms);
+  bool on(const char* pattern, MpTopicHandler fn, void* arg = NULL);
+  void on_clear();
+  void table(const MpTopicEntry* table, size_t count);
+  template <size_t N>
+  void table(const MpTopicEntry (&t)[N]) { table(t, N); }
+
+  /**
+   * 把這個面板收到、符合 pattern 的訊息轉送到 to，同一個 Topic 最多每 intervalMs 送一次
+   * pattern 跟 mqttpanel_on 一樣是相對於 <topic>/ 的路徑，可以用 "+" / "#" (只記指標，要一直存在)
+   * @return false = 規則滿了 (MP_BRIDGE_RULES) 或 to 就是自己
+   */
+  bool bridge(MqttPanel& to, const char* pattern, uint32_t intervalMs);
+  void bridge_clear();
+  void bridge_stats(MpBridgeStats* out);
+
+  // 區網直連 (見上方 mqttpanel_lan_begin)；Topic 是相對於這個面板的 <topic>/
+  bool lan_begin(WiFiUDP* udp, uint16_t port = MP_LAN_PORT);
+  void lan_end();
+  void lan_stats(MpLanStats* out);
+
+private:
+  friend void mqttpanel_begin(MpClient*, MqttRawCallback, char*, char*, char*, int, int, int, int, int);
+  friend void mqttpanel_loop();
+  friend uint32_t mqttpanel_idle_deadline();
+  friend uint32_t mqttpanel_idle(uint32_t, uint16_t);
+
+  struct MpMatchNode {
+    uint16_t text;                      // level text in _hdText
+    uint8_t len;
+    uint8_t kind;                       // MP_LVL_*
+    uint8_t child;                      // first child
+    uint8_t next;                       // next sibling
+    uint8_t handler;                    // first handler ending here
+  };
+  struct MpHandler {
+    MpTopicHandler fn;
+    void* arg;
+    uint8_t next;                       // next handler on the same node
+  };
+  struct MpMatchMsg;
+
+  // PubSubClient (setStream) writes every inbound payload byte here, see _chunk_done
+  class MpChunkSink : public Stream {
+  public:
+    MqttPanel* owner = NULL;
+    uint8_t buf[MP_CHUNK_BYTES];
+    size_t used = 0;                    // bytes in buf
+    size_t offset = 0;                  // bytes already handed out
+    size_t write(uint8_t c) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void reset() { used = 0; offset = 0; }
+  };
+
+  struct MpBridgeRule {
+    const char* pattern;
+    MqttPanel* to;
+    uint32_t intervalMs;
+  };
+  struct MpBridgeSlot {
+    char topic[MP_BRIDGE_TOPIC];        // relative to <topic>/, '\0' = free slot
+    uint8_t payload[MP_BRIDGE_PAYLOAD];
+    uint8_t len;
+    uint8_t rule;
+    bool dirty;                         // newer than what the other side has
+    unsigned long sentAt;
+  };
+  struct MpLanPeer {
+    uint32_t ip;                        // 0 = free slot
+    uint16_t port;
+    unsigned long seenAt;
+  };
+
+  template <int N> static void _rx(char* topic, uint8_t* payload, unsigned int length);
+  void _attach(MpClient* client, MqttRawCallback cb, const char* server, uint16_t port, const char* topic);
+  void _service(unsigned long t0);
+  void _on_message(char* topic, uint8_t* payload, unsigned int length);
+  void _deliver(const char* topic, size_t topicLen, const uint8_t* payload, size_t length);
+  void _rel_topic(const char* topic, size_t topicLen, const char** rel, size_t* relLen);
+  void _conn_step();
+  void _conn_failed();
+  void _conn_online();
+  unsigned long _backoff_ms(uint8_t streak);
+  void _sf_open();
+  void _pub(const String& topic, const String& payload, bool latest);
+  void _sf_enqueue(const char* topic, const char* payload, bool latest);
+  bool _sf_pending();
+  void _sf_replay();
+  void _sf_put(uint16_t pos, const void* src, uint16_t n);
+  void _sf_get(uint16_t pos, void* dst, uint16_t n);
+  void _sf_write(Print& out, uint16_t pos, uint16_t n);
+  void _sf_pop(bool spill);
+  void _sf_cut(uint16_t pos, uint16_t len);
+  void _sf_collapse(const char* topic, uint8_t tl);
+  bool _sf_send_spooled();
+  bool _sf_send_ram();
+  void _mx_out(size_t topicLen, size_t len);
+  void _mx_heap();
+  void _mx_publish();
+  bool _is_stats_topic(const char* topic, size_t len);
+  uint8_t _hd_find(uint8_t first, uint8_t kind, const char* s, size_t n);
+  int _hd_intern(const char* s, size_t n, bool dryRun);
+  void _hd_fire(uint8_t node, MpMatchMsg& m);
+  void _hd_end(uint8_t c, MpMatchMsg& m);
+  void _hd_level(uint8_t c, size_t pos, MpMatchMsg& m);
+  bool _hd_dispatch(const char* topic, size_t topicLen, const uint8_t* payload, size_t len);
+  bool _tb_dispatch(const char* topic, size_t topicLen, const uint8_t* payload, size_t len);
+  bool _chunk_done(const char* topic, size_t topicLen, size_t len);
+  void _br_capture(const char* topic, size_t topicLen, const uint8_t* payload, size_t len);
+  void _br_service();
+  void _lan_poll();
+  void _lan_line(char* line, size_t n);
+  void _lan_val(const char* topic, size_t topicLen, const char* payload, size_t len);
+  uint32_t _idle_ms(unsigned long now);
+  bool _idle_io();
+
+  // --- Connection ---
+  int8_t _slot = -1;                    // index in the panel list, -1 = not started
+  MpClient* _client = NULL;
+  MqttRawCallback _rawCallback = NULL;
+  const char* _p_server = NULL;
+  uint16_t _port = 0;
+  const char* _p_topic = NULL;
+  MpConnPolicy _policy;
+  WiFiClient* _sock = NULL;             // optional: lets TCP connect run as its own bounded step
+  MpConnState _connState = MP_CONN_WIFI_DOWN;
+  unsigned long _nextTry = 0;           // BACKOFF: when to try again
+  unsigned long _outageStart = 0;       // when MQTT went down (boot counts)
+  unsigned long _wifiOkAt = 0;          // last time this panel saw WiFi up (portal timeout; main panel only)
+  MpConnStats _connStats = {};
+
+  // --- Store-and-forward ---
+  char _sfFile[20] = "";                // spool file, one per panel
+  uint8_t _sfRing[MP_SF_RAM_BYTES];
+  uint16_t _sfHead = 0;                 // oldest record
+  uint16_t _sfUsed = 0;                 // bytes in the ring
+  uint16_t _sfRecs = 0;                 // records in the ring
+  uint16_t _sfPerSec = 20;
+  uint32_t _sfSpillMax = 0;             // 0 = no spool file
+  uint32_t _sfSpillSize = 0;            // spool file size
+  uint32_t _sfSpillRead = 0;            // replay offset in the spool
+  uint32_t _sfCredit = 0;               // token bucket, 1/1000 message units
+  unsigned long _sfRefillAt = 0;
+  unsigned long _sfReplayStart = 0;
+  uint32_t _sfReplayN = 0;
+  MpSfStats _sfStats = {};
+
+  // --- Metrics ---
+  bool _mxOn = true;
+  MpMetrics _mx = {};
+  unsigned long _mxHeapAt = 0;          // last heap sample (micros)
+  uint32_t _statsEvery = 0;             // $stats period, 0 = off
+  unsigned long _statsAt = 0;           // last $stats publish
+
+  // --- Topic handlers ---
+  MpMatchNode _hdNodes[MP_MATCH_NODES];
+  MpHandler _handlers[MP_MAX_HANDLERS];
+  char _hdText[MP_MATCH_TEXT];
+  uint8_t _hdNodeCount = 0;
+  uint8_t _hdCount = 0;
+  uint16_t _hdTextUsed = 0;
+  uint8_t _hdRoot = 0;                  // first top-level node
+
+  // --- Topic table ---
+  const MpTopicEntry* _tb = NULL;       // sorted, usually in flash (read through the _P helpers)
+  size_t _tbCount = 0;
+
+  // --- Large payloads ---
+  MpChunkSink _chunkSink;
+  MpChunkHandler _chunkFn = NULL;
+  void* _chunkArg = NULL;
+  bool _chunkAttached = false;          // setStream() cannot be undone, the sink stays
+  bool _txOpen = false;                 // streaming publish in progress
+  bool _txFailed = false;
+  size_t _txLeft = 0;
+  size_t _txLen = 0;
+  size_t _txTopicLen = 0;
+
+  // --- Bridge ---
+  MpBridgeRule _brRules[MP_BRIDGE_RULES];
+  uint8_t _brCount = 0;
+  MpBridgeSlot _brSlots[MP_BRIDGE_SLOTS] = {};
+  MpBridgeStats _brStats = {};
+
+  // --- LAN control ---
+  WiFiUDP* _lan = NULL;
+  MpLanPeer _lanPeers[MP_LAN_PEERS] = {};
+  MpLanStats _lanStats = {};
+  int _lanHeld = 0;                     // datagram parsed by the idle wake check, not handled yet
+};
+
+// 主面板 (mqttpanel_* 函式操作的那一個)
+MqttPanel& mqttpanel_main();
+
 #endif
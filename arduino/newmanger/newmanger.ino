@@ -14,6 +14,7 @@
 #elif defined(ESP8266)
   #include <ESP8266WiFi.h>
 #endif
+#include <WiFiUdp.h>
 
 // --- 1. 使用者設定區 (User Config) ---
 // 這裡定義預設值。如果 LittleFS 有存檔，會優先讀取檔案內的數值。
@@ -29,13 +30,17 @@ char mqtt_topic[40]  = "test_topic";
 // 硬體腳位
 #define TRIGGER_PIN 0  // 按鈕 (Boot)
 #define LED_PIN     4  // 指示燈
+#define DIMMER_PIN  5  // 調光輸出 (PWM)
 
 // --- Objects ---
 WiFiClient espClient;
-PubSubClient client(espClient);
+MpClient client(espClient);  // PubSubClient (或 -DMP_NATIVE_MQTT 時的 MpMqttClient)
+WiFiUDP lanUdp;              // 區網直連：同一個 WiFi 的 App 直接送 /set、收 /val
 
 // --- 接收函式宣告 ---
 void mq_receiver(String topic, String msg);
+void report_status(void*);
+void on_dimmer(const char* topic, size_t topicLen, const uint8_t* payload, size_t len, void*);
 
 // --- Setup ---
 void setup() {
@@ -57,24 +62,51 @@ void setup() {
   Serial.printf(" - Server: %s\n", mqtt_server); // 這裡已經是最終確認的數值了
   Serial.printf(" - Port:   %s\n", mqtt_port);
   Serial.printf(" - Topic:  %s\n", mqtt_topic);
+
+  // 3. 週期工作交給排程器 (固定頻率，不會因 loop() 變慢而漂移)
+  mqttpanel_every(10000, report_status);
+
+  // 4. 調光：App 送 <topic>/dimmer/<n>/set，套用後回報 <topic>/dimmer/<n>/val
+  mqttpanel_on("dimmer/+/set", on_dimmer);
+
+  // 5. 區網直連 (UDP 1884)：手機在同一個 WiFi 就不繞 Broker，從外面連進來還是走 Broker
+  mqttpanel_lan_begin(&lanUdp);
 }
 
 // --- Loop ---
 void loop() {
-  mqttpanel_loop(); // 模組會自動處理 WiFi 保活、按鈕偵測
-
-  // --- 您的邏輯 ---
-  static unsigned long lastTime = 0;
-  if (millis() - lastTime > 10000) {
-     lastTime = millis();
-     
-     if (mqttpanel_is_connected()) {
-        String topic = String(mqtt_topic) + "/status";
-        mqttpanel_pub(topic, "Running...");
-     }
+  mqttpanel_loop(); // 模組會自動處理 WiFi 保活、按鈕偵測，並執行到期的排程工作
+  // 電池 / 太陽能供電：沒事的時候睡到下一件事 (見 mqttpanel.h 的「省電待機」；
+  // 要被 MQTT 訊息叫醒，setup() 裡再加 mqttpanel_conn_socket(&espClient))
+  // mqttpanel_idle();
+}
+
+// --- 您的邏輯 (每 10 秒由 mqttpanel_every 呼叫) ---
+void report_status(void*) {
+  if (mqttpanel_is_connected()) {
+     String topic = String(mqtt_topic) + "/status";
+     mqttpanel_pub(topic, "Running...");
   }
 }
 
+// --- 調光 (App 看到 /val 回來才算設定成功) ---
+void on_dimmer(const char* topic, size_t topicLen, const uint8_t* payload, size_t len, void*) {
+  const char* id;
+  size_t idLen;
+  if (!mqttpanel_topic_level(topic, topicLen, -2, &id, &idLen)) return;
+  int level = 0;
+  for (size_t i = 0; i < len && payload[i] >= '0' && payload[i] <= '9' && level <= 100; i++) {
+    level = level * 10 + (payload[i] - '0');
+  }
+  if (level > 100) level = 100;
+  analogWrite(DIMMER_PIN, level * 255 / 100);
+
+  String val = String(mqtt_topic) + "/dimmer/";
+  val.concat(id, idLen);
+  val += "/val";
+  mqttpanel_pub(val, String(level));
+}
+
 // --- 接收回呼 ---
 void mq_receiver(String topic, String msg) {
   Serial.println("[RX] " + topic + " : " + msg);